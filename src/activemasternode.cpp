@@ -190,7 +190,11 @@ bool CActiveMasternode::SendMasternodePing(std::string& errorMessage)
         //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
         CMasternodeBroadcast mnb(*pmn);
         uint256 hash = mnb.GetHash();
-        if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = mnp;
+        SeenMasternodeBroadcastMap::iterator it = mnodeman.mapSeenMasternodeBroadcast.find(hash);
+        if (it != mnodeman.mapSeenMasternodeBroadcast.end()) {
+            (*it).second.lastPing = mnp;
+            mnodeman.mapSeenMasternodeBroadcast.update_time(hash, mnp.sigTime);
+        }
 
         mnp.Relay();
 
@@ -8,10 +8,13 @@
 
 
 #include "chainparams.h"
+#include "crypto/common.h"
 #include "hash.h"
 #include "libzerocoin/bignum.h"
 #include "libzerocoin/CoinSpend.h"
 #include "primitives/transaction.h"
+#include "protocol.h"
+#include "random.h"
 #include "script/script.h"
 #include "script/standard.h"
 #include "streams.h"
@@ -19,10 +22,91 @@
 #include <math.h>
 #include <stdlib.h>
 
+#include <limits>
+
 
 #define LN2SQUARED 0.4804530139182014246671025263266649717305529515945455
 #define LN2 0.6931471805599453094172321214581765680755001343602552
 
+/** Size of a serialized outpoint: the hash of the transaction, then the index of the output */
+static const size_t OUTPOINT_SIZE = 36;
+static const size_t INV_SIZE = 36;
+
+/** Serialize an outpoint as the network does, without going through a stream */
+static inline void SerializeOutPoint(const uint256& hash, uint32_t n, unsigned char* pch)
+{
+    memcpy(pch, hash.begin(), 32);
+    WriteLE32(pch + 32, n);
+}
+
+/** Serialize an inventory item as the network does, without going through a stream */
+static inline void SerializeInv(const CInv& inv, unsigned char* pch)
+{
+    WriteLE32(pch, inv.type);
+    memcpy(pch + 4, inv.hash.begin(), 32);
+}
+
+CBloomTxElements::CBloomTxElements(const CTransaction& tx) : hash(tx.GetHash())
+{
+    vOutputEnd.reserve(tx.vout.size());
+    vfOutputPubKey.reserve(tx.vout.size());
+    for (const CTxOut& txout : tx.vout) {
+        // Any arbitrary script data element in the scriptPubKey, the commitment of a zerocoin mint
+        CScript::const_iterator pc = txout.scriptPubKey.begin();
+        std::vector<unsigned char> data;
+        opcodetype opcode;
+        if (txout.IsZerocoinMint()) {
+            if (txout.scriptPubKey.size() > 6 && txout.scriptPubKey.GetOp(pc, opcode, data))
+                AddElement(txout.scriptPubKey.data() + 6, txout.scriptPubKey.size() - 6);
+        } else {
+            while (pc < txout.scriptPubKey.end() && txout.scriptPubKey.GetOp(pc, opcode, data))
+                AddElement(data.data(), data.size());
+        }
+        vOutputEnd.push_back(vElementEnd.size());
+
+        txnouttype type;
+        std::vector<std::vector<unsigned char> > vSolutions;
+        vfOutputPubKey.push_back(Solver(txout.scriptPubKey, type, vSolutions) && (type == TX_PUBKEY || type == TX_MULTISIG));
+    }
+
+    for (const CTxIn& txin : tx.vin) {
+        // The outpoint spent, then any arbitrary script data element in the scriptSig, the serial of a zerocoin spend
+        unsigned char pchOutPoint[OUTPOINT_SIZE];
+        SerializeOutPoint(txin.prevout.hash, txin.prevout.n, pchOutPoint);
+        AddElement(pchOutPoint, OUTPOINT_SIZE);
+
+        CScript::const_iterator pc = txin.scriptSig.begin();
+        std::vector<unsigned char> data;
+        opcodetype opcode;
+        if (txin.IsZerocoinSpend()) {
+            if (txin.scriptSig.size() >= 44 && txin.scriptSig.GetOp(pc, opcode, data)) {
+                CDataStream s(std::vector<unsigned char>(txin.scriptSig.begin() + 44, txin.scriptSig.end()),
+                        SER_NETWORK, PROTOCOL_VERSION);
+                data = libzerocoin::CoinSpend::ParseSerial(s);
+                AddElement(data.data(), data.size());
+            }
+        } else {
+            while (pc < txin.scriptSig.end() && txin.scriptSig.GetOp(pc, opcode, data))
+                AddElement(data.data(), data.size());
+        }
+    }
+}
+
+void CBloomTxElements::AddElement(const unsigned char* pch, size_t nLen)
+{
+    // An empty element never matches
+    if (nLen == 0)
+        return;
+    vData.insert(vData.end(), pch, pch + nLen);
+    vElementEnd.push_back(vData.size());
+}
+
+size_t CBloomTxElements::GetMemoryUsage() const
+{
+    return sizeof(*this) + vData.capacity() + (vElementEnd.capacity() + vOutputEnd.capacity()) * sizeof(uint32_t) +
+           vfOutputPubKey.capacity() / 8;
+}
+
 
 CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweakIn, unsigned char nFlagsIn) :
  /**
@@ -44,10 +128,21 @@ CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int
 {
 }
 
-inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const
+// Private constructor used by CRollingBloomFilter
+CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweakIn) :
+    vData((unsigned int)(-1 / LN2SQUARED * nElements * log(nFPRate)) / 8),
+    isFull(false),
+    isEmpty(true),
+    nHashFuncs((unsigned int)(vData.size() * 8 / nElements * LN2)),
+    nTweak(nTweakIn),
+    nFlags(BLOOM_UPDATE_NONE)
+{
+}
+
+inline unsigned int CBloomFilter::Hash(unsigned int nHashNum, const unsigned char* pchData, size_t nDataLen) const
 {
     // 0xFBA4C795 chosen as it guarantees a reasonable bit difference between nHashNum values.
-    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, vDataToHash) % (vData.size() * 8);
+    return MurmurHash3(nHashNum * 0xFBA4C795 + nTweak, pchData, nDataLen) % (vData.size() * 8);
 }
 
 void CBloomFilter::setNotFull()
@@ -55,33 +150,36 @@ void CBloomFilter::setNotFull()
     isFull = false;
 }
 
-void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+void CBloomFilter::insert(const unsigned char* pchKey, size_t nKeyLen)
 {
     if (isFull)
         return;
     for (unsigned int i = 0; i < nHashFuncs; i++) {
-        unsigned int nIndex = Hash(i, vKey);
+        unsigned int nIndex = Hash(i, pchKey, nKeyLen);
         // Sets bit nIndex of vData
         vData[nIndex >> 3] |= (1 << (7 & nIndex));
     }
     isEmpty = false;
 }
 
+void CBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    insert(vKey.data(), vKey.size());
+}
+
 void CBloomFilter::insert(const COutPoint& outpoint)
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    insert(data);
+    unsigned char pchOutPoint[OUTPOINT_SIZE];
+    SerializeOutPoint(outpoint.hash, outpoint.n, pchOutPoint);
+    insert(pchOutPoint, OUTPOINT_SIZE);
 }
 
 void CBloomFilter::insert(const uint256& hash)
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    insert(data);
+    insert(hash.begin(), hash.size());
 }
 
-bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+bool CBloomFilter::contains(const unsigned char* pchKey, size_t nKeyLen) const
 {
     if (isFull) {
         return true;
@@ -90,7 +188,7 @@ bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
         return false;
     }
     for (unsigned int i = 0; i < nHashFuncs; i++) {
-        unsigned int nIndex = Hash(i, vKey);
+        unsigned int nIndex = Hash(i, pchKey, nKeyLen);
         // Checks bit nIndex of vData
         if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
             return false;
@@ -98,18 +196,21 @@ bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
     return true;
 }
 
+bool CBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return contains(vKey.data(), vKey.size());
+}
+
 bool CBloomFilter::contains(const COutPoint& outpoint) const
 {
-    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
-    stream << outpoint;
-    std::vector<unsigned char> data(stream.begin(), stream.end());
-    return contains(data);
+    unsigned char pchOutPoint[OUTPOINT_SIZE];
+    SerializeOutPoint(outpoint.hash, outpoint.n, pchOutPoint);
+    return contains(pchOutPoint, OUTPOINT_SIZE);
 }
 
 bool CBloomFilter::contains(const uint256& hash) const
 {
-    std::vector<unsigned char> data(hash.begin(), hash.end());
-    return contains(data);
+    return contains(hash.begin(), hash.size());
 }
 
 void CBloomFilter::clear()
@@ -157,6 +258,15 @@ bool CBloomFilter::Merge(const CBloomFilter& filter) {
 }
 
 bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return IsRelevantAndUpdate(CBloomTxElements(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CBloomTxElements& tx)
 {
     bool fFound = false;
     // Match if the filter contains the hash of tx
@@ -165,69 +275,38 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
         return true;
     if (isEmpty)
         return false;
-    const uint256& hash = tx.GetHash();
-    if (contains(hash))
+    if (contains(tx.hash))
         fFound = true;
 
-    for (unsigned int i = 0; i < tx.vout.size(); i++) {
-        const CTxOut& txout = tx.vout[i];
+    uint32_t nElement = 0;
+    for (unsigned int i = 0; i < tx.vOutputEnd.size(); i++) {
         // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        std::vector<unsigned char> data;
-        while (pc < txout.scriptPubKey.end()) {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data)){
-                break;
-            }
-
-            if (txout.IsZerocoinMint()){
-                data = std::vector<unsigned char>(txout.scriptPubKey.begin() + 6, txout.scriptPubKey.begin() + txout.scriptPubKey.size());
-            }
-
-            if (data.size() != 0 && contains(data)) {
+        for (; nElement < tx.vOutputEnd[i]; nElement++) {
+            if (contains(tx.ElementBegin(nElement), tx.ElementSize(nElement))) {
                 fFound = true;
-                if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
-                    insert(COutPoint(hash, i));
-                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY) {
-                    txnouttype type;
-                    std::vector<std::vector<unsigned char> > vSolutions;
-                    if (Solver(txout.scriptPubKey, type, vSolutions) &&
-                        (type == TX_PUBKEY || type == TX_MULTISIG))
-                        insert(COutPoint(hash, i));
+                if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL ||
+                    ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY && tx.vfOutputPubKey[i])) {
+                    unsigned char pchOutPoint[OUTPOINT_SIZE];
+                    SerializeOutPoint(tx.hash, i, pchOutPoint);
+                    insert(pchOutPoint, OUTPOINT_SIZE);
                 }
                 break;
             }
         }
+        nElement = tx.vOutputEnd[i];
     }
 
     if (fFound)
         return true;
 
-    for (const CTxIn& txin : tx.vin) {
-        // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+    // Match if the filter contains an outpoint tx spends, the first element of each input,
+    // or any arbitrary script data element in any scriptSig in tx
+    for (; nElement < tx.vElementEnd.size(); nElement++) {
+        if (contains(tx.ElementBegin(nElement), tx.ElementSize(nElement)))
             return true;
-
-        // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        std::vector<unsigned char> data;
-        while (pc < txin.scriptSig.end()) {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data))
-                break;
-            if (txin.IsZerocoinSpend()) {
-                CDataStream s(std::vector<unsigned char>(txin.scriptSig.begin() + 44, txin.scriptSig.end()),
-                        SER_NETWORK, PROTOCOL_VERSION);
-
-                data = libzerocoin::CoinSpend::ParseSerial(s);
-            }
-            if (data.size() != 0 && contains(data)) {
-                return true;
-            }
-        }
     }
 
     return false;
@@ -244,3 +323,87 @@ void CBloomFilter::UpdateEmptyFull()
     isFull = full;
     isEmpty = empty;
 }
+
+CRollingBloomFilter::CRollingBloomFilter(unsigned int nElements, double fpRate) :
+    b1(nElements * 2, fpRate, 0), b2(nElements * 2, fpRate, 0)
+{
+    // Implemented using two bloom filters of 2 * nElements each.
+    // We fill them up, and clear them, staggered, every nElements
+    // inserted, so at least one always contains the last nElements
+    // inserted.
+    nBloomSize = nElements * 2;
+    reset();
+}
+
+void CRollingBloomFilter::insert(const unsigned char* pchKey, size_t nKeyLen)
+{
+    if (nInsertions == 0) {
+        b1.clear();
+    } else if (nInsertions == nBloomSize / 2) {
+        b2.clear();
+    }
+    b1.insert(pchKey, nKeyLen);
+    b2.insert(pchKey, nKeyLen);
+    if (++nInsertions == nBloomSize) {
+        nInsertions = 0;
+    }
+}
+
+void CRollingBloomFilter::insert(const std::vector<unsigned char>& vKey)
+{
+    insert(vKey.data(), vKey.size());
+}
+
+void CRollingBloomFilter::insert(const uint256& hash)
+{
+    insert(hash.begin(), hash.size());
+}
+
+void CRollingBloomFilter::insert(const CInv& inv)
+{
+    unsigned char pchInv[INV_SIZE];
+    SerializeInv(inv, pchInv);
+    insert(pchInv, INV_SIZE);
+}
+
+bool CRollingBloomFilter::contains(const unsigned char* pchKey, size_t nKeyLen) const
+{
+    // The filter cleared last still holds the items inserted since
+    if (nInsertions < nBloomSize / 2) {
+        return b2.contains(pchKey, nKeyLen);
+    }
+    return b1.contains(pchKey, nKeyLen);
+}
+
+bool CRollingBloomFilter::contains(const std::vector<unsigned char>& vKey) const
+{
+    return contains(vKey.data(), vKey.size());
+}
+
+bool CRollingBloomFilter::contains(const uint256& hash) const
+{
+    return contains(hash.begin(), hash.size());
+}
+
+bool CRollingBloomFilter::contains(const CInv& inv) const
+{
+    unsigned char pchInv[INV_SIZE];
+    SerializeInv(inv, pchInv);
+    return contains(pchInv, INV_SIZE);
+}
+
+void CRollingBloomFilter::reset()
+{
+    // A tweak of its own keeps the false positives of each filter apart
+    unsigned int nNewTweak = GetRand(std::numeric_limits<unsigned int>::max());
+    b1.clear();
+    b1.nTweak = nNewTweak;
+    b2.clear();
+    b2.nTweak = nNewTweak;
+    nInsertions = 0;
+}
+
+size_t CRollingBloomFilter::GetMemoryUsage() const
+{
+    return b1.vData.capacity() + b2.vData.capacity();
+}
@@ -9,12 +9,13 @@
 
 #include "libzerocoin/bignum.h"
 #include "serialize.h"
+#include "uint256.h"
 
 #include <vector>
 
+class CInv;
 class COutPoint;
 class CTransaction;
-class uint256;
 
 //! 20,000 items with fp rate < 0.1% or 10,000 items and <0.0001%
 static const unsigned int MAX_BLOOM_FILTER_SIZE = 36000; // bytes
@@ -32,6 +33,37 @@ enum bloomflags {
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * The data a bloom filter is matched against in a transaction: its hash, the data elements
+ * of each scriptPubKey and, for each input, the serialized prevout followed by the data
+ * elements of the scriptSig. Extracted once, it lets any number of filters be tested
+ * against the transaction without parsing its scripts or serializing its outpoints again.
+ */
+class CBloomTxElements
+{
+public:
+    uint256 hash;
+    /** All the elements, back to back */
+    std::vector<unsigned char> vData;
+    /** Offset in vData of the end of each element, the next one starts there */
+    std::vector<uint32_t> vElementEnd;
+    /** Number of elements up to the end of each output, the ones after the last output belong to the inputs */
+    std::vector<uint32_t> vOutputEnd;
+    /** Whether each output pays to a public key or a multisig, for BLOOM_UPDATE_P2PUBKEY_ONLY */
+    std::vector<bool> vfOutputPubKey;
+
+    CBloomTxElements() {}
+    explicit CBloomTxElements(const CTransaction& tx);
+
+    const unsigned char* ElementBegin(uint32_t nElement) const { return vData.data() + (nElement ? vElementEnd[nElement - 1] : 0); }
+    size_t ElementSize(uint32_t nElement) const { return vElementEnd[nElement] - (nElement ? vElementEnd[nElement - 1] : 0); }
+
+    size_t GetMemoryUsage() const;
+
+private:
+    void AddElement(const unsigned char* pch, size_t nLen);
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we sends them.
@@ -53,7 +85,11 @@ private:
     unsigned int nTweak;
     unsigned char nFlags;
 
-    unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
+    unsigned int Hash(unsigned int nHashNum, const unsigned char* pchData, size_t nDataLen) const;
+
+    // Private constructor for CRollingBloomFilter, no restrictions on size
+    CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweak);
+    friend class CRollingBloomFilter;
 
 public:
     /**
@@ -81,10 +117,12 @@ public:
 
     void setNotFull();
 
+    void insert(const unsigned char* pchKey, size_t nKeyLen);
     void insert(const std::vector<unsigned char>& vKey);
     void insert(const COutPoint& outpoint);
     void insert(const uint256& hash);
 
+    bool contains(const unsigned char* pchKey, size_t nKeyLen) const;
     bool contains(const std::vector<unsigned char>& vKey) const;
     bool contains(const COutPoint& outpoint) const;
     bool contains(const uint256& hash) const;
@@ -100,9 +138,51 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    //! Same as above, on the elements of a transaction extracted beforehand
+    bool IsRelevantAndUpdate(const CBloomTxElements& tx);
+
+    //! Whether the filter matches everything or nothing, so that matching does not need the elements of a transaction
+    bool IsFullOrEmpty() const { return isFull || isEmpty; }
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
 };
 
+/**
+ * RollingBloomFilter is a probabilistic "keep track of most recently inserted" set.
+ * Construct it with the number of items to keep track of, and a false-positive rate.
+ *
+ * contains(item) will always return true if item was one of the last N things
+ * insert()'ed ... but may also return true for items that were not inserted.
+ *
+ * Unlike a set of the items themselves, its memory use does not depend on how
+ * many items were inserted, and inserting does not allocate.
+ */
+class CRollingBloomFilter
+{
+public:
+    CRollingBloomFilter(unsigned int nElements, double nFPRate);
+
+    void insert(const unsigned char* pchKey, size_t nKeyLen);
+    void insert(const std::vector<unsigned char>& vKey);
+    void insert(const uint256& hash);
+    //! Keyed by type and hash, as the same hash announced as another type is another item
+    void insert(const CInv& inv);
+    bool contains(const unsigned char* pchKey, size_t nKeyLen) const;
+    bool contains(const std::vector<unsigned char>& vKey) const;
+    bool contains(const uint256& hash) const;
+    bool contains(const CInv& inv) const;
+
+    //! Forget everything, and hash with a new random tweak from now on
+    void reset();
+
+    //! Bytes taken by the bit arrays
+    size_t GetMemoryUsage() const;
+
+private:
+    unsigned int nBloomSize;
+    unsigned int nInsertions;
+    CBloomFilter b1, b2;
+};
+
 #endif // BITCOIN_BLOOM_H
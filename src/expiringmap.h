@@ -0,0 +1,240 @@
+// Copyright (c) 2019 The Syndicate Ltd developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_EXPIRINGMAP_H
+#define BITCOIN_EXPIRINGMAP_H
+
+#include "serialize.h"
+#include "version.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
+/** Default time policy: the value carries no time, entries must be inserted with an explicit one. */
+template <typename V>
+struct expiringmap_no_time {
+    int64_t operator()(const V& v) const { return 0; }
+};
+
+/** Time policy for values with an nTime member. */
+template <typename V>
+struct expiringmap_ntime {
+    int64_t operator()(const V& v) const { return v.nTime; }
+};
+
+/** Snapshot of an expiringmap's size and memory accounting */
+struct expiringmap_stats {
+    size_t nSize;
+    size_t nUsage;
+    size_t nMaxUsage;
+};
+
+/**
+ * STL-like hash map whose entries are indexed by a time (or any other monotonic
+ * value such as a block height), so old entries can be expired in O(log n) per
+ * removed entry instead of scanning the whole map. An optional memory cap evicts
+ * the oldest entries first. The serialized format is the same as std::map's;
+ * after loading, entry times are taken from the values through TimeOf.
+ */
+template <typename K, typename V, typename TimeOf = expiringmap_no_time<V>, typename Hasher = boost::hash<K> >
+class expiringmap
+{
+public:
+    typedef K key_type;
+    typedef V mapped_type;
+    typedef std::pair<const key_type, mapped_type> value_type;
+    typedef boost::unordered_map<K, V, Hasher> map_type;
+    typedef typename map_type::iterator iterator;
+    typedef typename map_type::const_iterator const_iterator;
+    typedef typename map_type::size_type size_type;
+
+    /** Approximate per-entry bookkeeping overhead of the hash table and time index nodes */
+    static const size_t ENTRY_OVERHEAD = 6 * sizeof(void*) + 2 * sizeof(K) + 2 * sizeof(int64_t);
+
+protected:
+    struct entry_info {
+        int64_t nTime;
+        size_t nUsage;
+    };
+    typedef std::set<std::pair<int64_t, K> > time_index;
+
+    map_type map;
+    boost::unordered_map<K, entry_info, Hasher> mapInfo;
+    time_index setByTime;
+    size_t nUsage;
+    size_t nMaxUsage;
+
+    static size_t EntryUsage(const V& v)
+    {
+        return ENTRY_OVERHEAD + sizeof(V) + ::GetSerializeSize(v, SER_NETWORK, PROTOCOL_VERSION);
+    }
+
+    void Index(const K& k, const V& v, int64_t nTime)
+    {
+        entry_info info;
+        info.nTime = nTime;
+        info.nUsage = EntryUsage(v);
+        mapInfo[k] = info;
+        setByTime.insert(std::make_pair(nTime, k));
+        nUsage += info.nUsage;
+    }
+
+    void Unindex(const K& k)
+    {
+        typename boost::unordered_map<K, entry_info, Hasher>::iterator it = mapInfo.find(k);
+        if (it == mapInfo.end())
+            return;
+        setByTime.erase(std::make_pair(it->second.nTime, k));
+        nUsage -= it->second.nUsage;
+        mapInfo.erase(it);
+    }
+
+    void LimitUsage()
+    {
+        while (nMaxUsage && nUsage > nMaxUsage && map.size() > 1)
+            erase(setByTime.begin()->second);
+    }
+
+public:
+    expiringmap(size_t nMaxUsageIn = 0) : nUsage(0), nMaxUsage(nMaxUsageIn) {}
+
+    iterator begin() { return map.begin(); }
+    iterator end() { return map.end(); }
+    const_iterator begin() const { return map.begin(); }
+    const_iterator end() const { return map.end(); }
+    size_type size() const { return map.size(); }
+    bool empty() const { return map.empty(); }
+    iterator find(const key_type& k) { return map.find(k); }
+    const_iterator find(const key_type& k) const { return map.find(k); }
+    size_type count(const key_type& k) const { return map.count(k); }
+    mapped_type& at(const key_type& k) { return map.at(k); }
+    const mapped_type& at(const key_type& k) const { return map.at(k); }
+
+    /** Insert an entry indexed at nTime. Existing entries are left untouched, like std::map::insert. */
+    bool insert(const key_type& k, const mapped_type& v, int64_t nTime)
+    {
+        std::pair<iterator, bool> ret = map.insert(std::make_pair(k, v));
+        if (!ret.second)
+            return false;
+        Index(k, v, nTime);
+        LimitUsage();
+        return true;
+    }
+
+    /** Insert an entry indexed at the time carried by the value. */
+    bool insert(const value_type& x)
+    {
+        return insert(x.first, x.second, TimeOf()(x.second));
+    }
+
+    /** Replace (or add) an entry and re-index it at nTime. */
+    void update(const key_type& k, const mapped_type& v, int64_t nTime)
+    {
+        erase(k);
+        insert(k, v, nTime);
+    }
+
+    /** Move an existing entry to a new position in the time index, e.g. after modifying it in place. */
+    void update_time(const key_type& k, int64_t nTime)
+    {
+        iterator it = map.find(k);
+        if (it == map.end())
+            return;
+        Unindex(k);
+        Index(k, it->second, nTime);
+    }
+
+    /** Time an entry is indexed at, or -1 if it does not exist */
+    int64_t get_time(const key_type& k) const
+    {
+        typename boost::unordered_map<K, entry_info, Hasher>::const_iterator it = mapInfo.find(k);
+        return it == mapInfo.end() ? -1 : it->second.nTime;
+    }
+
+    size_type erase(const key_type& k)
+    {
+        Unindex(k);
+        return map.erase(k);
+    }
+
+    iterator erase(iterator it)
+    {
+        Unindex(it->first);
+        return map.erase(it);
+    }
+
+    /** Remove every entry indexed before nTimeLimit, optionally handing the removed entries back. */
+    size_type expire(int64_t nTimeLimit, std::vector<std::pair<K, V> >* pvExpired = NULL)
+    {
+        size_type nRemoved = 0;
+        while (!setByTime.empty() && setByTime.begin()->first < nTimeLimit) {
+            K k = setByTime.begin()->second;
+            iterator it = map.find(k);
+            if (pvExpired && it != map.end())
+                pvExpired->push_back(std::make_pair(it->first, it->second));
+            erase(k);
+            nRemoved++;
+        }
+        return nRemoved;
+    }
+
+    void clear()
+    {
+        map.clear();
+        mapInfo.clear();
+        setByTime.clear();
+        nUsage = 0;
+    }
+
+    /** Approximate memory used by the entries, in bytes */
+    size_t usage() const { return nUsage; }
+    size_t max_usage() const { return nMaxUsage; }
+    expiringmap_stats stats() const
+    {
+        expiringmap_stats ret;
+        ret.nSize = map.size();
+        ret.nUsage = nUsage;
+        ret.nMaxUsage = nMaxUsage;
+        return ret;
+    }
+    void max_usage(size_t nMaxUsageIn)
+    {
+        nMaxUsage = nMaxUsageIn;
+        LimitUsage();
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        unsigned int nSize = GetSizeOfCompactSize(map.size());
+        for (const_iterator mi = map.begin(); mi != map.end(); ++mi)
+            nSize += ::GetSerializeSize((*mi), nType, nVersion);
+        return nSize;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& os, int nType, int nVersion) const
+    {
+        WriteCompactSize(os, map.size());
+        for (const_iterator mi = map.begin(); mi != map.end(); ++mi)
+            ::Serialize(os, (*mi), nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& is, int nType, int nVersion)
+    {
+        clear();
+        unsigned int nSize = ReadCompactSize(is);
+        for (unsigned int i = 0; i < nSize; i++) {
+            std::pair<K, V> item;
+            ::Unserialize(is, item, nType, nVersion);
+            insert(item.first, item.second, TimeOf()(item.second));
+        }
+    }
+};
+
+#endif // BITCOIN_EXPIRINGMAP_H
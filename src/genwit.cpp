@@ -9,10 +9,10 @@
 #include "chainparams.h"
 #include "util.h"
 
-CGenWit::CGenWit() : accWitValue(0) {}
+CGenWit::CGenWit() : accWitValue(0), pfrom(nullptr) {}
 
 CGenWit::CGenWit(const CBloomFilter &filter, int startingHeight, libzerocoin::CoinDenomination den, int requestNum, CBigNum accWitValue)
-        : filter(filter), startingHeight(startingHeight), den(den), requestNum(requestNum), accWitValue(accWitValue) {}
+        : filter(filter), startingHeight(startingHeight), den(den), requestNum(requestNum), accWitValue(accWitValue), pfrom(nullptr) {}
 
 bool CGenWit::isValid(int chainActiveHeight) {
     if (den == libzerocoin::CoinDenomination::ZQ_ERROR){
@@ -62,7 +62,7 @@ const CBigNum &CGenWit::getAccWitValue() const {
 }
 
 const std::string CGenWit::toString() const {
-    return "From: " + pfrom->addrName + ",\n" +
+    return "From: " + (pfrom ? pfrom->addrName : std::string("local")) + ",\n" +
            "Height: " + std::to_string(startingHeight) + ",\n" +
            "accWit: " + accWitValue.GetHex();
 }
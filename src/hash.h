@@ -324,7 +324,29 @@ uint256 SerializeHash(const T& obj, int nType = SER_GETHASH, int nVersion = PROT
     return ss.GetHash();
 }
 
-unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
+unsigned int MurmurHash3(unsigned int nHashSeed, const unsigned char* pchData, size_t nDataLen);
+
+inline unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash)
+{
+    return MurmurHash3(nHashSeed, vDataToHash.empty() ? NULL : &vDataToHash[0], vDataToHash.size());
+}
+
+/** SipHash-2-4, keyed with k0 and k1. */
+class CSipHasher
+{
+private:
+    uint64_t v[4];
+    int count;
+
+public:
+    CSipHasher(uint64_t k0, uint64_t k1);
+    /** Hash a 64-bit integer, only whole 64-bit words can be written. */
+    CSipHasher& Write(uint64_t data);
+    uint64_t Finalize() const;
+};
+
+/** SipHash-2-4 of a uint256, same as CSipHasher(k0, k1).Write(val.Get64(0)) ... .Write(val.Get64(3)).Finalize(). */
+uint64_t SipHashUint256(uint64_t k0, uint64_t k1, const uint256& val);
 
 void BIP32Hash(const ChainCode chainCode, unsigned int nChild, unsigned char header, const unsigned char data[32], unsigned char output[64]);
 
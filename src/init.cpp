@@ -51,6 +51,7 @@
 #endif
 
 #include <fstream>
+#include <limits>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -207,6 +208,9 @@ void PrepareShutdown()
         bitdb.Flush(false);
     GenerateBitcoins(false, NULL, 0);
 #endif
+    // Witness threads read blocks and hold peer references, stop them before the node
+    if (nLocalServices & NODE_BLOOM_LIGHT_ZC)
+        lightWorker.StopLightZpivThread();
     StopNode();
     DumpMasternodes();
     DumpBudgets();
@@ -289,10 +293,6 @@ void Shutdown()
     }
     // Shutdown part 2: Stop TOR thread and delete wallet instance
     StopTorControl();
-    // Shutdown witness thread if it's enabled
-    if (nLocalServices == NODE_BLOOM_LIGHT_ZC) {
-        lightWorker.StopLightZpivThread();
-    }
 #ifdef ENABLE_WALLET
     delete pwalletMain;
     pwalletMain = NULL;
@@ -392,6 +392,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
     strUsage += HelpMessageOpt("-maxreorg=<n>", strprintf(_("Set the Maximum reorg depth (default: %u)"), Params(CBaseChainParams::MAIN).MaxReorganizationDepth()));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
+    strUsage += HelpMessageOpt("-maxorphantxsize=<n>", strprintf(_("Keep at most <n> kilobytes of unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), "syndicated.pid"));
@@ -404,6 +405,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
     strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-zerocoinindex", strprintf(_("Maintain a per-block index of zerocoin mints and serials, used by getserials and the zPIV wallet rescans (default: %u)"), 0));
     strUsage += HelpMessageOpt("-forcestart", _("Attempt to force blockchain corruption recovery") + " " + _("on startup"));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
@@ -417,11 +419,14 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-dnsseed", _("Query for peer addresses via DNS lookup, if low on addresses (default: 1 unless -connect)"));
     strUsage += HelpMessageOpt("-externalip=<ip>", _("Specify your own public address"));
     strUsage += HelpMessageOpt("-forcednsseed", strprintf(_("Always query for peer addresses via DNS lookup (default: %u)"), 0));
+    strUsage += HelpMessageOpt("-lightzpivmaxpeerrequests=<n>", strprintf(_("Maximum witness requests a zerocoin light node may have pending (default: %u)"), DEFAULT_LIGHTZPIV_MAX_PEER_REQUESTS));
+    strUsage += HelpMessageOpt("-lightzpivthreads=<n>", strprintf(_("Number of threads computing witnesses for zerocoin light nodes (default: %u)"), DEFAULT_LIGHTZPIV_THREADS));
     strUsage += HelpMessageOpt("-listen", _("Accept connections from outside (default: 1 if no -proxy or -connect)"));
     strUsage += HelpMessageOpt("-listenonion", strprintf(_("Automatically create Tor hidden service (default: %d)"), DEFAULT_LISTEN_ONION));
     strUsage += HelpMessageOpt("-maxconnections=<n>", strprintf(_("Maintain at most <n> connections to peers (default: %u)"), 125));
     strUsage += HelpMessageOpt("-maxreceivebuffer=<n>", strprintf(_("Maximum per-connection receive buffer, <n>*1000 bytes (default: %u)"), 5000));
     strUsage += HelpMessageOpt("-maxsendbuffer=<n>", strprintf(_("Maximum per-connection send buffer, <n>*1000 bytes (default: %u)"), 1000));
+    strUsage += HelpMessageOpt("-maxsendrate=<class>:<n>", _("Limit the upload of the messages of class <class> (consensus, masternode, inventory or bulk) to <n>*1000 bytes per second and per connection. Can be specified once per class."));
     strUsage += HelpMessageOpt("-onion=<ip:port>", strprintf(_("Use separate SOCKS5 proxy to reach peers via Tor hidden services (default: %s)"), "-proxy"));
     strUsage += HelpMessageOpt("-onlynet=<net>", _("Only connect to nodes in network <net> (ipv4, ipv6 or onion)"));
     strUsage += HelpMessageOpt("-permitbaremultisig", strprintf(_("Relay non-P2SH multisig (default: %u)"), 1));
@@ -500,7 +505,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-stopafterblockimport", strprintf(_("Stop running after importing blocks from disk (default: %u)"), 0));
         strUsage += HelpMessageOpt("-sporkkey=<privkey>", _("Enable spork administration functionality with the appropriate private key."));
     }
-    std::string debugCategories = "addrman, alert, bench, coindb, db, lock, rand, rpc, selectcoins, tor, mempool, net, proxy, http, libevent, syndicate, (obfuscation, swiftx, masternode, mnpayments, mnbudget, zero, precompute, staking)"; // Don't translate these and qt below
+    std::string debugCategories = "addrman, alert, bench, coindb, db, lock, rand, rpc, selectcoins, tor, mempool, net, cmpctblock, proxy, http, libevent, syndicate, (obfuscation, swiftx, masternode, mnpayments, mnbudget, zero, precompute, staking)"; // Don't translate these and qt below
     if (mode == HMM_BITCOIN_QT)
         debugCategories += ", qt";
     strUsage += HelpMessageOpt("-debug=<category>", strprintf(_("Output debugging information (default: %u, supplying <category> is optional)"), 0) + ". " +
@@ -518,6 +523,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), 15));
         strUsage += HelpMessageOpt("-relaypriority", strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), 1));
         strUsage += HelpMessageOpt("-maxsigcachesize=<n>", strprintf(_("Limit size of signature cache to <n> entries (default: %u)"), 50000));
+        strUsage += HelpMessageOpt("-maxzcspendcachesize=<n>", strprintf(_("Limit size of the parsed zerocoin spend cache to <n> entries (default: %u)"), DEFAULT_MAX_ZC_SPEND_CACHE_SIZE));
     }
     strUsage += HelpMessageOpt("-maxtipage=<n>", strprintf("Maximum tip age in seconds to consider node in initial block download (default: %u)", DEFAULT_MAX_TIP_AGE));
     strUsage += HelpMessageOpt("-minrelaytxfee=<amt>", strprintf(_("Fees (in PIV/Kb) smaller than this are considered zero fee for relaying (default: %s)"), FormatMoney(::minRelayTxFee.GetFeePerK())));
@@ -1286,6 +1292,18 @@ bool AppInit2()
         }
     }
 
+    if (mapArgs.count("-maxsendrate")) {
+        for (const std::string& strRate : mapMultiArgs["-maxsendrate"]) {
+            size_t nSep = strRate.find(':');
+            int nPriority = 0;
+            int64_t nRate = 0;
+            if (nSep == std::string::npos || !ParseSendPriority(strRate.substr(0, nSep), nPriority) ||
+                !ParseInt64(strRate.substr(nSep + 1), &nRate) || nRate <= 0 || nRate > std::numeric_limits<int32_t>::max())
+                return InitError(strprintf(_("Invalid -maxsendrate '%s'"), strRate));
+            nMaxSendRate[nPriority] = nRate * 1000;
+        }
+    }
+
     // Check for host lookup allowed before parsing any network related parameters
     fNameLookup = GetBoolArg("-dns", DEFAULT_NAME_LOOKUP);
 
@@ -1388,6 +1406,7 @@ bool AppInit2()
     assert(AccumulatorCheckpoints::LoadCheckpoints(Params().NetworkIDString()));
 
     fReindex = GetBoolArg("-reindex", false);
+    fZerocoinIndex = GetBoolArg("-zerocoinindex", false);
 
     // Create blocks directory if it doesn't already exist
     boost::filesystem::create_directories(GetDataDir() / "blocks");
@@ -1469,8 +1488,10 @@ bool AppInit2()
                 invalid_out::LoadOutpoints();
                 invalid_out::LoadSerials();
 
-                // Drop all information from the zerocoinDB and repopulate
-                if (GetBoolArg("-reindexzerocoin", false)) {
+                // Drop all information from the zerocoinDB and repopulate, also when -zerocoinindex was just switched on
+                bool fZerocoinIndexBuilt = false;
+                pblocktree->ReadFlag("zerocoinindex", fZerocoinIndexBuilt);
+                if (GetBoolArg("-reindexzerocoin", false) || (fZerocoinIndex && !fZerocoinIndexBuilt)) {
                     if (chainActive.Height() > Params().Zerocoin_StartHeight()) {
                         uiInterface.InitMessage(_("Reindexing zerocoin database..."));
                         std::string strError = ReindexZerocoinDB();
@@ -1480,6 +1501,15 @@ bool AppInit2()
                         }
                     }
                 }
+                pblocktree->WriteFlag("zerocoinindex", fZerocoinIndex);
+
+                // Build the fixed-base exponentiation tables before any zerocoin proof is created or checked
+                if (chainActive.Height() >= Params().Zerocoin_StartHeight()) {
+                    int64_t nStart = GetTimeMicros();
+                    Params().Zerocoin_Params(false)->precompute();
+                    Params().Zerocoin_Params(true)->precompute();
+                    LogPrint("bench", "Zerocoin exponentiation tables built in %.2fms\n", 0.001 * (GetTimeMicros() - nStart));
+                }
 
                 // Wrapped serials inflation check
                 bool reindexDueWrappedSerials = false;
@@ -1961,7 +1991,8 @@ bool AppInit2()
 
     if (nLocalServices & NODE_BLOOM_LIGHT_ZC) {
         // Run a thread to compute witnesses
-        lightWorker.StartLightZpivThread(threadGroup);
+        lightWorker.StartLightZpivThread(GetArg("-lightzpivthreads", DEFAULT_LIGHTZPIV_THREADS),
+                                         GetArg("-lightzpivmaxpeerrequests", DEFAULT_LIGHTZPIV_MAX_PEER_REQUESTS));
     }
 
 #ifdef ENABLE_WALLET
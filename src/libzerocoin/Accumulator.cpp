@@ -47,6 +47,21 @@ void Accumulator::increment(const CBigNum& bnValue) {
     this->value = this->value.pow_mod(bnValue, this->params->accumulatorModulus);
 }
 
+CBigNum ProductTree(const std::vector<CBigNum>& vValues, size_t nBegin, size_t nEnd) {
+    if (nEnd - nBegin == 1)
+        return vValues[nBegin];
+    size_t nMiddle = nBegin + (nEnd - nBegin) / 2;
+    return ProductTree(vValues, nBegin, nMiddle) * ProductTree(vValues, nMiddle, nEnd);
+}
+
+void Accumulator::increment(const std::vector<CBigNum>& vValues) {
+    if (vValues.empty())
+        return;
+    // Coin values are public, so the variable time exponentiation is fine here
+    CBigNum bnProduct = ProductTree(vValues, 0, vValues.size());
+    this->value = this->value.pow_mod_public(bnProduct, this->params->accumulatorModulus);
+}
+
 void Accumulator::accumulate(const PublicCoin& coin) {
     // Make sure we're initialized
     if(!(this->value)) {
@@ -18,6 +18,10 @@
 #include "Coin.h"
 
 namespace libzerocoin {
+
+/** Product of vValues[nBegin, nEnd), multiplying halves so the operands stay balanced */
+CBigNum ProductTree(const std::vector<CBigNum>& vValues, size_t nBegin, size_t nEnd);
+
 /**
  * \brief Implementation of the RSA-based accumulator.
  **/
@@ -64,6 +68,15 @@ public:
     void accumulate(const PublicCoin &coin);
     void increment(const CBigNum& bnValue);
 
+    /**
+     * Accumulate a batch of coin values. Raising the accumulator to each value in turn
+     * is the same as raising it once to their product, so the values are multiplied
+     * with a product tree and applied in a single exponentiation.
+     *
+     * @param vValues    the (already validated) coin values to accumulate
+     **/
+    void increment(const std::vector<CBigNum>& vValues);
+
     CoinDenomination getDenomination() const;
     /** Get the accumulator result
      *
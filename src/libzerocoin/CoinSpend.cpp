@@ -75,6 +75,28 @@ namespace libzerocoin
 }
 
 bool CoinSpend::Verify(const Accumulator& a, bool verifyParams) const
+{
+    if (!VerifyCommitments(a))
+        return false;
+
+    if (!serialNumberSoK.Verify(coinSerialNumber, serialCommitmentToCoinValue, signatureHash(), verifyParams)) {
+        //std::cout << "CoinsSpend::Verify: serialNumberSoK failed. sighash:" << signatureHash().GetHex() << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool CoinSpend::VerifyBatched(const Accumulator& a, SerialNumberSoKBatch& batch, bool verifyParams) const
+{
+    if (!VerifyCommitments(a))
+        return false;
+
+    batch.Add(serialNumberSoK, coinSerialNumber, serialCommitmentToCoinValue, signatureHash(), verifyParams);
+    return true;
+}
+
+bool CoinSpend::VerifyCommitments(const Accumulator& a) const
 {
     // Double check that the version is the same as marked in the serial
     if (ExtractVersionFromSerial(coinSerialNumber) != version) {
@@ -98,11 +120,6 @@ bool CoinSpend::Verify(const Accumulator& a, bool verifyParams) const
         return false;
     }
 
-    if (!serialNumberSoK.Verify(coinSerialNumber, serialCommitmentToCoinValue, signatureHash(), verifyParams)) {
-        //std::cout << "CoinsSpend::Verify: serialNumberSoK failed. sighash:" << signatureHash().GetHex() << "\n";
-        return false;
-    }
-
     return true;
 }
 
@@ -152,7 +169,7 @@ bool CoinSpend::HasValidSignature() const
     return pubkey.Verify(signatureHash(), vchSig);
 }
 
-CBigNum CoinSpend::CalculateValidSerial(ZerocoinParams* params)
+CBigNum CoinSpend::CalculateValidSerial(ZerocoinParams* params) const
 {
     CBigNum bnSerial = coinSerialNumber;
     bnSerial = bnSerial.mul_mod(CBigNum(1),params->coinCommitmentGroup.groupOrder);
@@ -127,12 +127,14 @@ public:
 
     virtual const uint256 signatureHash() const;
     virtual bool Verify(const Accumulator& a, bool verifyParams = true) const;
+    /** Like Verify, but queues the serial number SoK on batch instead of checking it here */
+    bool VerifyBatched(const Accumulator& a, SerialNumberSoKBatch& batch, bool verifyParams = true) const;
     bool HasValidSerial(ZerocoinParams* params) const;
     bool HasValidSignature() const;
     void setTxOutHash(uint256 txOutHash) { this->ptxHash = txOutHash; };
     void setDenom(libzerocoin::CoinDenomination denom) { this->denomination = denom; }
 
-    CBigNum CalculateValidSerial(ZerocoinParams* params);
+    CBigNum CalculateValidSerial(ZerocoinParams* params) const;
     std::string ToString() const;
 
     ADD_SERIALIZE_METHODS;
@@ -170,6 +172,8 @@ protected:
     uint256 ptxHash;
 
 private:
+    bool VerifyCommitments(const Accumulator& a) const;
+
     uint32_t accChecksum;
     CBigNum accCommitmentToCoinValue;
     CBigNum serialCommitmentToCoinValue;
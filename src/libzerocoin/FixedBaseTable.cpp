@@ -0,0 +1,83 @@
+/**
+ * @file       FixedBaseTable.cpp
+ *
+ * @brief      Precomputed tables for exponentiation of a fixed base.
+ *
+ * @copyright  Copyright 2019 The Syndicate Ltd developers
+ * @license    This project is released under the MIT license.
+ **/
+// Copyright (c) 2019 The Syndicate Ltd developers
+
+#include "FixedBaseTable.h"
+
+#include <algorithm>
+
+namespace libzerocoin {
+
+FixedBaseTable::FixedBaseTable(const CBigNum& base, const CBigNum& modulus, uint32_t maxExponentBits):
+	base(base), modulus(modulus) {
+	const uint32_t nRows = (maxExponentBits + FIXED_BASE_WINDOW - 1) / FIXED_BASE_WINDOW;
+	this->nMaxBits = nRows * FIXED_BASE_WINDOW;
+	this->rows.resize(nRows);
+
+	// rowBase = base^(2^(w*i)); its powers 1 .. 2^w fill row i and the last one starts row i+1
+	CBigNum rowBase = base % modulus;
+	CBigNum offset = CBigNum(1);
+	for (uint32_t i = 0; i < nRows; i++) {
+		std::vector<CBigNum>& row = this->rows[i];
+		row.resize(1 << FIXED_BASE_WINDOW);
+		row[0] = rowBase;
+		for (uint32_t d = 1; d < row.size(); d++)
+			row[d] = row[d - 1].mul_mod(rowBase, modulus);
+
+		offset = offset.mul_mod(rowBase, modulus);
+		rowBase = row.back();
+	}
+
+	this->top = rowBase;
+	this->offsetInverse = offset.inverse(modulus);
+}
+
+CBigNum FixedBaseTable::pow_mod(const CBigNum& e) const {
+	if (e < CBigNum(0))
+		return pow_mod(-e).inverse(this->modulus);
+
+	// Entry d of a row is the digit d plus one, so no entry is the identity and every
+	// multiplication works on full size operands. offsetInverse takes the extra ones back out.
+	CBigNum ret = this->offsetInverse;
+	for (uint32_t i = 0; i < this->rows.size(); i++) {
+		unsigned int d = e.getbits(i * FIXED_BASE_WINDOW, FIXED_BASE_WINDOW);
+		ret = ret.mul_mod(CBigNum::sec_select(this->rows[i], d), this->modulus);
+	}
+
+	if ((uint32_t)e.bitSize() > this->nMaxBits) {
+		CBigNum high = e;
+		high >>= this->nMaxBits;
+		ret = ret.mul_mod(this->top.pow_mod(high, this->modulus), this->modulus);
+	}
+
+	return ret;
+}
+
+CBigNum FixedBaseTable::pow_mod_public(const CBigNum& e) const {
+	if (e < CBigNum(0))
+		return pow_mod_public(-e).inverse(this->modulus);
+
+	CBigNum ret = CBigNum(1);
+	const uint32_t nBits = std::min((uint32_t)e.bitSize(), this->nMaxBits);
+	for (uint32_t i = 0; i * FIXED_BASE_WINDOW < nBits; i++) {
+		unsigned int d = e.getbits(i * FIXED_BASE_WINDOW, FIXED_BASE_WINDOW);
+		if (d)
+			ret = ret.mul_mod(this->rows[i][d - 1], this->modulus);
+	}
+
+	if ((uint32_t)e.bitSize() > this->nMaxBits) {
+		CBigNum high = e;
+		high >>= this->nMaxBits;
+		ret = ret.mul_mod(this->top.pow_mod_public(high, this->modulus), this->modulus);
+	}
+
+	return ret;
+}
+
+} /* namespace libzerocoin */
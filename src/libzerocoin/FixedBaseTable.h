@@ -0,0 +1,75 @@
+/**
+ * @file       FixedBaseTable.h
+ *
+ * @brief      Precomputed tables for exponentiation of a fixed base.
+ *
+ * @copyright  Copyright 2019 The Syndicate Ltd developers
+ * @license    This project is released under the MIT license.
+ **/
+// Copyright (c) 2019 The Syndicate Ltd developers
+
+#ifndef FIXEDBASETABLE_H_
+#define FIXEDBASETABLE_H_
+
+#include "bignum.h"
+
+#include <vector>
+
+// Exponent bits consumed per table row. Each row holds 2^FIXED_BASE_WINDOW entries.
+#define FIXED_BASE_WINDOW   4
+
+namespace libzerocoin {
+
+/**
+ * Fixed-window table for base^e mod modulus.
+ *
+ * Row i holds base^(d * 2^(w*i)) for d = 1 .. 2^w, so an exponent of up to
+ * maxExponentBits bits costs one modular multiplication per w-bit window and no
+ * squarings. Bits above maxExponentBits are handled by an ordinary exponentiation
+ * of base^(2^maxExponentBits).
+ */
+class FixedBaseTable {
+public:
+	/** @brief Build the table
+	 * @param base             the fixed base, invertible mod modulus
+	 * @param modulus          the modulus
+	 * @param maxExponentBits  the exponent size the table covers without falling back
+	 **/
+	FixedBaseTable(const CBigNum& base, const CBigNum& modulus, uint32_t maxExponentBits);
+
+	/**
+	 * base^e mod modulus for a secret exponent. Every window is multiplied in,
+	 * with an entry selected by CBigNum::sec_select, so the work done does not
+	 * depend on the exponent's digits.
+	 * @param e exponent
+	 */
+	CBigNum pow_mod(const CBigNum& e) const;
+
+	/**
+	 * base^e mod modulus for a public exponent. Skips zero windows and
+	 * indexes the table directly.
+	 * @param e exponent
+	 */
+	CBigNum pow_mod_public(const CBigNum& e) const;
+
+	/** Number of table entries */
+	size_t size() const { return rows.size() << FIXED_BASE_WINDOW; }
+
+private:
+	CBigNum base;
+	CBigNum modulus;
+	uint32_t nMaxBits;
+
+	/** rows[i][d] = base^((d + 1) * 2^(w*i)) */
+	std::vector<std::vector<CBigNum> > rows;
+
+	/** base^(2^(w*rows.size())), for the bits above the table */
+	CBigNum top;
+
+	/** base^-(sum of 2^(w*i)), removes the +1 every window adds in pow_mod */
+	CBigNum offsetInverse;
+};
+
+} /* namespace libzerocoin */
+
+#endif /* FIXEDBASETABLE_H_ */
@@ -13,6 +13,7 @@
 // Copyright (c) 2019 The Syndicate Ltd developers
 
 #include "Params.h"
+#include "Commitment.h"
 #include "ParamGeneration.h"
 
 namespace libzerocoin {
@@ -31,10 +32,50 @@ ZerocoinParams::ZerocoinParams(CBigNum N, uint32_t securityLevel) {
 	this->initialized = true;
 }
 
+void ZerocoinParams::precompute() {
+	// Commitment equality proofs between the serial number SoK group and the accumulator
+	// PoK group raise both generators to responses of this size
+	uint32_t commitmentProofBits = COMMITMENT_EQUALITY_CHALLENGE_SIZE + COMMITMENT_EQUALITY_SECMARGIN + 1 +
+	                               std::max(std::max(serialNumberSoKCommitmentGroup.modulus.bitSize(), accumulatorParams.accumulatorPoKCommitmentGroup.modulus.bitSize()),
+	                                        std::max(serialNumberSoKCommitmentGroup.groupOrder.bitSize(), accumulatorParams.accumulatorPoKCommitmentGroup.groupOrder.bitSize()));
+
+	// Coins commit to a serial and randomness below the group order
+	this->coinCommitmentGroup.precompute(this->coinCommitmentGroup.groupOrder.bitSize() + 1);
+
+	// The SoK responses reach twice the group order
+	this->serialNumberSoKCommitmentGroup.precompute(std::max(commitmentProofBits, 2 * (uint32_t)this->serialNumberSoKCommitmentGroup.groupOrder.bitSize() + 1));
+	this->accumulatorParams.precompute(commitmentProofBits);
+}
+
 AccumulatorAndProofParams::AccumulatorAndProofParams() {
 	this->initialized = false;
 }
 
+void AccumulatorAndProofParams::precompute(uint32_t pokExponentBits) {
+	this->accumulatorPoKCommitmentGroup.precompute(pokExponentBits);
+
+	// Accumulator proof exponents are ranged by N/4 * 2^(k' + k'')
+	uint32_t qrnExponentBits = this->accumulatorModulus.bitSize() + this->k_prime + this->k_dprime;
+	this->qrnGTable = std::make_shared<const FixedBaseTable>(this->accumulatorQRNCommitmentGroup.g, this->accumulatorModulus, qrnExponentBits);
+	this->qrnHTable = std::make_shared<const FixedBaseTable>(this->accumulatorQRNCommitmentGroup.h, this->accumulatorModulus, qrnExponentBits);
+}
+
+CBigNum AccumulatorAndProofParams::pow_qrn_g(const CBigNum& e) const {
+	return this->qrnGTable ? this->qrnGTable->pow_mod(e) : this->accumulatorQRNCommitmentGroup.g.pow_mod(e, this->accumulatorModulus);
+}
+
+CBigNum AccumulatorAndProofParams::pow_qrn_h(const CBigNum& e) const {
+	return this->qrnHTable ? this->qrnHTable->pow_mod(e) : this->accumulatorQRNCommitmentGroup.h.pow_mod(e, this->accumulatorModulus);
+}
+
+CBigNum AccumulatorAndProofParams::pow_qrn_g_public(const CBigNum& e) const {
+	return this->qrnGTable ? this->qrnGTable->pow_mod_public(e) : this->accumulatorQRNCommitmentGroup.g.pow_mod_public(e, this->accumulatorModulus);
+}
+
+CBigNum AccumulatorAndProofParams::pow_qrn_h_public(const CBigNum& e) const {
+	return this->qrnHTable ? this->qrnHTable->pow_mod_public(e) : this->accumulatorQRNCommitmentGroup.h.pow_mod_public(e, this->accumulatorModulus);
+}
+
 IntegerGroupParams::IntegerGroupParams() {
 	this->initialized = false;
 }
@@ -43,7 +84,28 @@ CBigNum IntegerGroupParams::randomElement() const {
 	// The generator of the group raised
 	// to a random number less than the order of the group
 	// provides us with a uniformly distributed random number.
-	return this->g.pow_mod(CBigNum::randBignum(this->groupOrder),this->modulus);
+	return pow_g(CBigNum::randBignum(this->groupOrder));
+}
+
+void IntegerGroupParams::precompute(uint32_t maxExponentBits) {
+	this->gTable = std::make_shared<const FixedBaseTable>(this->g, this->modulus, maxExponentBits);
+	this->hTable = std::make_shared<const FixedBaseTable>(this->h, this->modulus, maxExponentBits);
+}
+
+CBigNum IntegerGroupParams::pow_g(const CBigNum& e) const {
+	return this->gTable ? this->gTable->pow_mod(e) : this->g.pow_mod(e, this->modulus);
+}
+
+CBigNum IntegerGroupParams::pow_h(const CBigNum& e) const {
+	return this->hTable ? this->hTable->pow_mod(e) : this->h.pow_mod(e, this->modulus);
+}
+
+CBigNum IntegerGroupParams::pow_g_public(const CBigNum& e) const {
+	return this->gTable ? this->gTable->pow_mod_public(e) : this->g.pow_mod_public(e, this->modulus);
+}
+
+CBigNum IntegerGroupParams::pow_h_public(const CBigNum& e) const {
+	return this->hTable ? this->hTable->pow_mod_public(e) : this->h.pow_mod_public(e, this->modulus);
 }
 
 } /* namespace libzerocoin */
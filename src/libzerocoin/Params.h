@@ -16,8 +16,11 @@
 #define PARAMS_H_
 
 #include "bignum.h"
+#include "FixedBaseTable.h"
 #include "ZerocoinDefines.h"
 
+#include <memory>
+
 namespace libzerocoin {
 
 class IntegerGroupParams {
@@ -33,6 +36,25 @@ public:
 	 * @return a random element in the group.
 	 */
 	CBigNum randomElement() const;
+
+	/**
+	 * Builds fixed-base tables for g and h. Until then, and after the
+	 * parameters are deserialized again, the pow functions below use
+	 * plain modular exponentiation.
+	 * @param maxExponentBits the exponent size the tables cover
+	 */
+	void precompute(uint32_t maxExponentBits);
+	bool isPrecomputed() const { return gTable && hTable; }
+
+	/**
+	 * g^e and h^e mod modulus. The _public versions are for exponents
+	 * that are not secret, e.g. in proof verification.
+	 */
+	CBigNum pow_g(const CBigNum& e) const;
+	CBigNum pow_h(const CBigNum& e) const;
+	CBigNum pow_g_public(const CBigNum& e) const;
+	CBigNum pow_h_public(const CBigNum& e) const;
+
 	bool initialized;
 
 	/**
@@ -64,7 +86,16 @@ public:
 		    READWRITE(h);
 		    READWRITE(modulus);
 		    READWRITE(groupOrder);
+		    if (ser_action.ForRead()) {
+		        gTable.reset();
+		        hTable.reset();
+		    }
 	}	
+
+private:
+	// Shared, so copies of the parameters don't duplicate the tables
+	std::shared_ptr<const FixedBaseTable> gTable;
+	std::shared_ptr<const FixedBaseTable> hTable;
 };
 
 class AccumulatorAndProofParams {
@@ -140,6 +171,23 @@ public:
 	 * The statistical zero-knowledgeness of the accumulator proof.
 	 */
 	uint32_t k_dprime;
+
+	/**
+	 * Builds the fixed-base tables of the accumulator PoK group and of the
+	 * QRN generators, which live mod accumulatorModulus.
+	 * @param pokExponentBits the exponent size the PoK group tables cover
+	 */
+	void precompute(uint32_t pokExponentBits);
+
+	/**
+	 * g^e and h^e mod accumulatorModulus for the QRN commitment group.
+	 * The _public versions are for exponents that are not secret.
+	 */
+	CBigNum pow_qrn_g(const CBigNum& e) const;
+	CBigNum pow_qrn_h(const CBigNum& e) const;
+	CBigNum pow_qrn_g_public(const CBigNum& e) const;
+	CBigNum pow_qrn_h_public(const CBigNum& e) const;
+
 	ADD_SERIALIZE_METHODS;
   template <typename Stream, typename Operation>  inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
 	    READWRITE(initialized);
@@ -151,7 +199,15 @@ public:
 	    READWRITE(maxCoinValue);
 	    READWRITE(k_prime);
 	    READWRITE(k_dprime);
+	    if (ser_action.ForRead()) {
+	        qrnGTable.reset();
+	        qrnHTable.reset();
+	    }
   }
+
+private:
+	std::shared_ptr<const FixedBaseTable> qrnGTable;
+	std::shared_ptr<const FixedBaseTable> qrnHTable;
 };
 
 class ZerocoinParams {
@@ -204,6 +260,13 @@ public:
 	 * proofs.
 	 */
 	uint32_t zkp_hash_len;
+
+	/**
+	 * Builds the fixed-base tables of every group, sized for the exponents
+	 * the mint, spend and proof code raises their generators to.
+	 * Must not run while other threads use the parameters.
+	 */
+	void precompute();
 	
 	ADD_SERIALIZE_METHODS;
   template <typename Stream, typename Operation>  inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
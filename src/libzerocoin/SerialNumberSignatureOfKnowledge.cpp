@@ -14,6 +14,12 @@
 
 #include <streams.h>
 #include "SerialNumberSignatureOfKnowledge.h"
+#include "FixedBaseTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
 
 namespace libzerocoin {
 
@@ -49,11 +55,6 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
     if (params->coinCommitmentGroup.modulus != params->serialNumberSoKCommitmentGroup.groupOrder)
         throw std::runtime_error("Groups are not structured correctly.");
 
-    CBigNum a = params->coinCommitmentGroup.g;
-    CBigNum b = params->coinCommitmentGroup.h;
-    CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-    CBigNum h = params->serialNumberSoKCommitmentGroup.h;
-
     CHashWriter hasher(0,0);
     hasher << *params << commitmentToCoin.getCommitmentValue() << coin.getSerialNumber() << msghash;
 
@@ -81,7 +82,7 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
 
     for(uint32_t i=0; i < params->zkp_iterations; i++) {
         // compute g^{ {a^x b^r} h^v} mod p2
-        c[i] = challengeCalculation(coin.getSerialNumber(), r[i], v_expanded[i]);
+        c[i] = challengeCalculation(coin.getSerialNumber(), r[i], v_expanded[i], false);
     }
 
     // We can't hash data in parallel either
@@ -104,32 +105,27 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
         } else {
             s_notprime[i]       = r[i] - coin.getRandomness();
             sprime[i]           = v_expanded[i] - (commitmentToCoin.getRandomness() *
-                    b.pow_mod(r[i] - coin.getRandomness(), params->serialNumberSoKCommitmentGroup.groupOrder));
+                    params->coinCommitmentGroup.pow_h(r[i] - coin.getRandomness()));
         }
     }
 }
 
 inline CBigNum SerialNumberSignatureOfKnowledge::challengeCalculation(const CBigNum& a_exp,const CBigNum& b_exp,
-        const CBigNum& h_exp) const {
+        const CBigNum& h_exp, bool fPublic) const {
 
-    CBigNum a = params->coinCommitmentGroup.g;
-    CBigNum b = params->coinCommitmentGroup.h;
-    CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-    CBigNum h = params->serialNumberSoKCommitmentGroup.h;
+    // a, b live in coinCommitmentGroup, whose modulus is the order of the SoK group of g, h
+    const IntegerGroupParams& groupAB = params->coinCommitmentGroup;
+    const IntegerGroupParams& groupGH = params->serialNumberSoKCommitmentGroup;
 
-    CBigNum exponent = (a.pow_mod(a_exp, params->serialNumberSoKCommitmentGroup.groupOrder) *
-            b.pow_mod(b_exp, params->serialNumberSoKCommitmentGroup.groupOrder)) % params->serialNumberSoKCommitmentGroup.groupOrder;
+    CBigNum exponent = fPublic ? (groupAB.pow_g_public(a_exp) * groupAB.pow_h_public(b_exp)) % groupGH.groupOrder :
+                                 (groupAB.pow_g(a_exp) * groupAB.pow_h(b_exp)) % groupGH.groupOrder;
 
-    return (g.pow_mod(exponent, params->serialNumberSoKCommitmentGroup.modulus) * h.pow_mod(h_exp, params->serialNumberSoKCommitmentGroup.modulus)) % params->serialNumberSoKCommitmentGroup.modulus;
+    return fPublic ? (groupGH.pow_g_public(exponent) * groupGH.pow_h_public(h_exp)) % groupGH.modulus :
+                     (groupGH.pow_g(exponent) * groupGH.pow_h(h_exp)) % groupGH.modulus;
 }
 
 bool SerialNumberSignatureOfKnowledge::Verify(const CBigNum& coinSerialNumber, const CBigNum& valueOfCommitmentToCoin,
         const uint256 msghash, bool isInParamsValidationRange) const {
-    CBigNum a = params->coinCommitmentGroup.g;
-    CBigNum b = params->coinCommitmentGroup.h;
-    CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-    CBigNum h = params->serialNumberSoKCommitmentGroup.h;
-
     //// Params validation.
     if(isInParamsValidationRange) {
         // Check that the serial is within the max size
@@ -146,27 +142,9 @@ bool SerialNumberSignatureOfKnowledge::Verify(const CBigNum& coinSerialNumber, c
     hasher << *params << valueOfCommitmentToCoin << coinSerialNumber << msghash;
 
     std::vector<CBigNum> tprime(params->zkp_iterations);
-    unsigned char *hashbytes = (unsigned char*) &this->hash;
-
     try {
-        for (uint32_t i = 0; i < params->zkp_iterations; i++) {
-            int bit = i % 8;
-            int byte = i / 8;
-            bool challenge_bit = ((hashbytes[byte] >> bit) & 0x01);
-            if (challenge_bit) {
-                CBigNum bn = SeedTo1024(sprime[i].getuint256());
-                if (bn > params->serialNumberSoKCommitmentGroup.groupOrder && isInParamsValidationRange)
-                    return error("SoK Verify() :: sprime in pos %d not in valid range", i);
-                tprime[i] = challengeCalculation(coinSerialNumber, s_notprime[i], bn);
-            } else {
-                CBigNum exp = b.pow_mod(s_notprime[i], params->serialNumberSoKCommitmentGroup.groupOrder);
-                tprime[i] = ((valueOfCommitmentToCoin.pow_mod(exp, params->serialNumberSoKCommitmentGroup.modulus) %
-                              params->serialNumberSoKCommitmentGroup.modulus) *
-                             (h.pow_mod(sprime[i], params->serialNumberSoKCommitmentGroup.modulus) %
-                              params->serialNumberSoKCommitmentGroup.modulus)) %
-                            params->serialNumberSoKCommitmentGroup.modulus;
-            }
-        }
+        if (!computeTPrime(coinSerialNumber, valueOfCommitmentToCoin, isInParamsValidationRange, tprime))
+            return false;
         for (uint32_t i = 0; i < params->zkp_iterations; i++) {
             hasher << tprime[i];
         }
@@ -176,4 +154,94 @@ bool SerialNumberSignatureOfKnowledge::Verify(const CBigNum& coinSerialNumber, c
     }
 }
 
+bool SerialNumberSignatureOfKnowledge::computeTPrime(const CBigNum& coinSerialNumber, const CBigNum& valueOfCommitmentToCoin,
+        bool isInParamsValidationRange, std::vector<CBigNum>& tprime) const {
+    const IntegerGroupParams& groupAB = params->coinCommitmentGroup;
+    const IntegerGroupParams& groupGH = params->serialNumberSoKCommitmentGroup;
+    unsigned char *hashbytes = (unsigned char*) &this->hash;
+
+    // Roughly half of the iterations raise the commitment to the coin to a new exponent below the
+    // order of the SoK group. Past a handful of them a table for that base costs less than the
+    // squarings it saves.
+    uint32_t nCommitmentPowers = 0;
+    for (uint32_t i = 0; i < params->zkp_iterations; i++) {
+        if (!((hashbytes[i / 8] >> (i % 8)) & 0x01))
+            nCommitmentPowers++;
+    }
+    std::unique_ptr<FixedBaseTable> commitmentTable;
+    if (nCommitmentPowers >= SOK_COMMITMENT_TABLE_MIN)
+        commitmentTable.reset(new FixedBaseTable(valueOfCommitmentToCoin, groupGH.modulus, groupGH.groupOrder.bitSize()));
+
+    // a^serial is the same in every iteration that opens the challenge
+    const CBigNum aSerial = groupAB.pow_g_public(coinSerialNumber);
+
+    for (uint32_t i = 0; i < params->zkp_iterations; i++) {
+        int bit = i % 8;
+        int byte = i / 8;
+        bool challenge_bit = ((hashbytes[byte] >> bit) & 0x01);
+        if (challenge_bit) {
+            CBigNum bn = SeedTo1024(sprime[i].getuint256());
+            if (bn > groupGH.groupOrder && isInParamsValidationRange)
+                return error("SoK Verify() :: sprime in pos %d not in valid range", i);
+            CBigNum exponent = aSerial.mul_mod(groupAB.pow_h_public(s_notprime[i]), groupGH.groupOrder);
+            tprime[i] = groupGH.pow_g_public(exponent).mul_mod(groupGH.pow_h_public(bn), groupGH.modulus);
+        } else {
+            CBigNum exp = groupAB.pow_h_public(s_notprime[i]);
+            CBigNum commitmentPower = commitmentTable ? commitmentTable->pow_mod_public(exp) :
+                                                        valueOfCommitmentToCoin.pow_mod(exp, groupGH.modulus);
+            tprime[i] = commitmentPower.mul_mod(groupGH.pow_h_public(sprime[i]), groupGH.modulus);
+        }
+    }
+    return true;
+}
+
+size_t SerialNumberSoKBatch::Add(const SerialNumberSignatureOfKnowledge& sok, const CBigNum& coinSerialNumber,
+        const CBigNum& valueOfCommitmentToCoin, const uint256 msghash, bool isInParamsValidationRange) {
+    Entry entry;
+    entry.sok = sok;
+    entry.coinSerialNumber = coinSerialNumber;
+    entry.valueOfCommitmentToCoin = valueOfCommitmentToCoin;
+    entry.msghash = msghash;
+    entry.isInParamsValidationRange = isInParamsValidationRange;
+    vEntries.push_back(entry);
+    return vEntries.size() - 1;
+}
+
+bool SerialNumberSoKBatch::Verify(std::vector<size_t>* pvFailed, unsigned int nThreads) const {
+    if (vEntries.empty())
+        return true;
+
+    if (nThreads == 0)
+        nThreads = std::max(1u, std::thread::hardware_concurrency());
+    nThreads = std::min<size_t>(nThreads, vEntries.size());
+
+    // Workers claim proofs one at a time; every result is kept so the failing ones can be reported
+    std::vector<char> vValid(vEntries.size(), 0);
+    std::atomic<size_t> nNext(0);
+    auto worker = [&]() {
+        for (size_t i = nNext++; i < vEntries.size(); i = nNext++) {
+            const Entry& entry = vEntries[i];
+            vValid[i] = entry.sok.Verify(entry.coinSerialNumber, entry.valueOfCommitmentToCoin,
+                                         entry.msghash, entry.isInParamsValidationRange);
+        }
+    };
+
+    std::vector<std::thread> vThreads;
+    for (unsigned int i = 1; i < nThreads; i++)
+        vThreads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : vThreads)
+        thread.join();
+
+    bool fValid = true;
+    for (size_t i = 0; i < vValid.size(); i++) {
+        if (vValid[i])
+            continue;
+        fValid = false;
+        if (pvFailed)
+            pvFailed->push_back(i);
+    }
+    return fValid;
+}
+
 } /* namespace libzerocoin */
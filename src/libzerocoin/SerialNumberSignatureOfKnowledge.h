@@ -26,6 +26,9 @@
 #include "Accumulator.h"
 #include "hash.h"
 
+// Commitment powers a SoK must need before Verify builds a fixed-base table for the commitment
+#define SOK_COMMITMENT_TABLE_MIN   8
+
 namespace libzerocoin {
 
 /**A Signature of knowledge on the hash of metadata attesting that the signer knows the values
@@ -68,8 +71,48 @@ private:
     // define something named s and it conflicts
     std::vector<CBigNum> s_notprime;
     std::vector<CBigNum> sprime;
+    // fPublic: the exponents are public (verification) and need no constant time exponentiation
     inline CBigNum challengeCalculation(const CBigNum& a_exp, const CBigNum& b_exp,
-                                       const CBigNum& h_exp) const;
+                                       const CBigNum& h_exp, bool fPublic) const;
+    // recompute the t' values the challenge hash commits to, false if a response is out of range
+    bool computeTPrime(const CBigNum& coinSerialNumber, const CBigNum& valueOfCommitmentToCoin,
+                       bool isInParamsValidationRange, std::vector<CBigNum>& tprime) const;
+};
+
+/** Verifies the serial number signatures of many spends together, e.g. all the spends of a block.
+ *
+ * Each proof is still checked on its own, since the challenge hash commits to every t' value
+ * and those have to be rebuilt exactly; the batch spreads the proofs over several threads and
+ * records which ones failed, so a bad spend is pinpointed without a second pass.
+ */
+class SerialNumberSoKBatch {
+public:
+    SerialNumberSoKBatch() {};
+
+    /** Queue a proof and the public values it is checked against. Returns its index in the batch. */
+    size_t Add(const SerialNumberSignatureOfKnowledge& sok, const CBigNum& coinSerialNumber,
+               const CBigNum& valueOfCommitmentToCoin, const uint256 msghash, bool isInParamsValidationRange = true);
+
+    /** Verify every queued proof.
+     *
+     * @param pvFailed if not NULL, receives the indexes of the proofs that did not verify
+     * @param nThreads threads to verify on, 0 for one per core
+     * @return true if every proof verifies
+     */
+    bool Verify(std::vector<size_t>* pvFailed = NULL, unsigned int nThreads = 0) const;
+
+    size_t size() const { return vEntries.size(); }
+    void clear() { vEntries.clear(); }
+
+private:
+    struct Entry {
+        SerialNumberSignatureOfKnowledge sok;
+        CBigNum coinSerialNumber;
+        CBigNum valueOfCommitmentToCoin;
+        uint256 msghash;
+        bool isInParamsValidationRange;
+    };
+    std::vector<Entry> vEntries;
 };
 
 } /* namespace libzerocoin */
@@ -146,6 +146,30 @@ public:
      */
     CBigNum pow_mod(const CBigNum& e, const CBigNum& m) const;
 
+    /**
+     * modular exponentiation with a public exponent: this^e mod n
+     * Runs in variable time, so only use it when neither the base nor the exponent is secret.
+     * @param e exponent
+     * @param m modulus
+     */
+    CBigNum pow_mod_public(const CBigNum& e, const CBigNum& m) const;
+
+    /**
+     * Reads nCount (at most 32) consecutive bits starting at bit nPos, for windowed exponentiation.
+     * This must be non-negative.
+     * @param nPos position of the lowest bit
+     * @param nCount number of bits
+     */
+    unsigned int getbits(unsigned int nPos, unsigned int nCount) const;
+
+    /**
+     * Copies vTable[nIndex] while reading every entry of the table, so the memory access
+     * pattern does not depend on a secret index. The entries must be non-negative.
+     * @param vTable the table
+     * @param nIndex index of the entry to return
+     */
+    static CBigNum sec_select(const std::vector<CBigNum>& vTable, unsigned int nIndex);
+
     /**
     * Calculates the inverse of this element mod m.
     * i.e. i such this*i = 1 mod m
@@ -7,6 +7,8 @@
 
 #include "bignum.h"
 
+#include <algorithm>
+
 /** C++ wrapper for BIGNUM (Gmp bignum) */
 CBigNum::CBigNum()
 {
@@ -246,6 +248,56 @@ CBigNum CBigNum::pow_mod(const CBigNum& e, const CBigNum& m) const
     return ret;
 }
 
+/**
+ * modular exponentiation with a public exponent: this^e mod n
+ * @param e exponent
+ * @param m modulus
+ */
+CBigNum CBigNum::pow_mod_public(const CBigNum& e, const CBigNum& m) const
+{
+    CBigNum ret;
+    mpz_powm (ret.bn, bn, e.bn, m.bn);
+    return ret;
+}
+
+/**
+ * Reads nCount consecutive bits starting at bit nPos
+ * @param nPos position of the lowest bit
+ * @param nCount number of bits
+ */
+unsigned int CBigNum::getbits(unsigned int nPos, unsigned int nCount) const
+{
+    unsigned int ret = 0;
+    for (unsigned int i = 0; i < nCount; i++)
+        ret |= (unsigned int)mpz_tstbit(bn, nPos + i) << i;
+    return ret;
+}
+
+/**
+ * Copies vTable[nIndex] in constant time with respect to nIndex
+ * @param vTable the table
+ * @param nIndex index of the entry to return
+ */
+CBigNum CBigNum::sec_select(const std::vector<CBigNum>& vTable, unsigned int nIndex)
+{
+    // mpn_sec_tabselect reads every entry of a table of equally sized limb vectors
+    mp_size_t nLimbs = 1;
+    for (const CBigNum& entry : vTable)
+        nLimbs = std::max(nLimbs, (mp_size_t)mpz_size(entry.bn));
+
+    std::vector<mp_limb_t> vLimbs(nLimbs * vTable.size(), 0);
+    for (size_t i = 0; i < vTable.size(); i++) {
+        const mp_limb_t* pLimbs = mpz_limbs_read(vTable[i].bn);
+        std::copy(pLimbs, pLimbs + mpz_size(vTable[i].bn), vLimbs.begin() + i * nLimbs);
+    }
+
+    CBigNum ret;
+    mp_limb_t* pRet = mpz_limbs_write(ret.bn, nLimbs);
+    mpn_sec_tabselect(pRet, vLimbs.data(), nLimbs, vTable.size(), nIndex);
+    mpz_limbs_finish(ret.bn, nLimbs);
+    return ret;
+}
+
 /**
 * Calculates the inverse of this element mod m.
 * i.e. i such this*i = 1 mod m
@@ -7,6 +7,8 @@
 
 #include "bignum.h"
 
+#include <algorithm>
+
 CBigNum::CBigNum()
 {
     bn = BN_new();
@@ -374,6 +376,59 @@ CBigNum CBigNum::pow_mod(const CBigNum& e, const CBigNum& m) const
     return ret;
 }
 
+/**
+ * modular exponentiation with a public exponent: this^e mod n
+ * @param e exponent
+ * @param m modulus
+ */
+CBigNum CBigNum::pow_mod_public(const CBigNum& e, const CBigNum& m) const
+{
+    // BN_mod_exp only takes the constant time path for BN_FLG_CONSTTIME operands
+    return pow_mod(e, m);
+}
+
+/**
+ * Reads nCount consecutive bits starting at bit nPos
+ * @param nPos position of the lowest bit
+ * @param nCount number of bits
+ */
+unsigned int CBigNum::getbits(unsigned int nPos, unsigned int nCount) const
+{
+    unsigned int ret = 0;
+    for (unsigned int i = 0; i < nCount; i++)
+        ret |= (unsigned int)(BN_is_bit_set(bn, nPos + i) ? 1 : 0) << i;
+    return ret;
+}
+
+/**
+ * Copies vTable[nIndex] in constant time with respect to nIndex
+ * @param vTable the table
+ * @param nIndex index of the entry to return
+ */
+CBigNum CBigNum::sec_select(const std::vector<CBigNum>& vTable, unsigned int nIndex)
+{
+    int nBytes = 1;
+    for (const CBigNum& entry : vTable)
+        nBytes = std::max(nBytes, BN_num_bytes(entry.bn));
+
+    // Fold every entry into the result under a mask that is all ones only for the selected index
+    std::vector<unsigned char> vEntry(nBytes), vResult(nBytes, 0);
+    for (unsigned int i = 0; i < vTable.size(); i++) {
+        // left-pad to nBytes by hand, BN_bn2binpad needs OpenSSL 1.1.0
+        int nEntryBytes = BN_num_bytes(vTable[i].bn);
+        std::fill(vEntry.begin(), vEntry.end() - nEntryBytes, 0);
+        BN_bn2bin(vTable[i].bn, vEntry.data() + (nBytes - nEntryBytes));
+        unsigned char mask = (unsigned char)(((i ^ nIndex) - 1) >> (8 * sizeof(unsigned int) - 1)) * 0xff;
+        for (int j = 0; j < nBytes; j++)
+            vResult[j] |= vEntry[j] & mask;
+    }
+
+    CBigNum ret;
+    if (!BN_bin2bn(vResult.data(), nBytes, ret.bn))
+        throw bignum_error("CBigNum::sec_select : BN_bin2bn failed");
+    return ret;
+}
+
 /**
 * Calculates the inverse of this element mod m.
 * i.e. i such this*i = 1 mod m
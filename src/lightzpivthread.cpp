@@ -8,110 +8,290 @@
 #include "lightzpivthread.h"
 #include "main.h"
 
+bool CLightWorker::addWitWork(CGenWit wit) {
+    if (!isWorkerRunning) {
+        LogPrintf("%s not running trying to add wit work \n", "syndicate-light-thread");
+        return false;
+    }
+
+    CNode* pfrom = wit.getPfrom();
+    NodeId nodeId = pfrom ? pfrom->GetId() : -1;
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        // One peer can't fill the queue for everybody else
+        if (mapPeerRequests[nodeId] >= nMaxPeerRequests) {
+            stats.nPeerLimited++;
+            LogPrint("zpiv", "%s peer=%d already has %d requests pending\n", "syndicate-light-thread", nodeId, mapPeerRequests[nodeId]);
+            return false;
+        }
+        mapPeerRequests[nodeId]++;
+
+        CLightRequestStatus status;
+        status.nodeId = nodeId;
+        status.nRequestNum = wit.getRequestNum();
+        status.den = wit.getDen();
+        status.nStartingHeight = wit.getStartingHeight();
+        status.fRunning = false;
+        status.fSharedRange = false;
+        status.nTimeQueued = GetTimeMicros();
+        status.nTimeStarted = 0;
+        mapStatus[std::make_pair(nodeId, wit.getRequestNum())] = status;
+
+        // the response is pushed from a worker thread, keep the peer around until then
+        if (pfrom)
+            pfrom->AddRef();
+        requestsQueue.push_back(wit);
+    }
+    condWork.notify_one();
+    return true;
+}
+
+void CLightWorker::StartLightZpivThread(int nThreads, int nMaxPeerRequestsIn) {
+    nThreads = std::max(1, nThreads);
+    LogPrintf("%s thread start, %d threads\n", "syndicate-light-thread", nThreads);
+    nMaxPeerRequests = std::max(1, nMaxPeerRequestsIn);
+    stats.nThreads = nThreads;
+    isWorkerRunning = true;
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&CLightWorker::ThreadLightZPIVSimplified, this));
+}
+
+void CLightWorker::StopLightZpivThread() {
+    isWorkerRunning = false;
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    LogPrintf("%s thread interrupted\n", "syndicate-light-thread");
+
+    // Answer whatever is left so the peers are released
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (!requestsQueue.empty()) {
+        CGenWit wit = requestsQueue.front();
+        requestsQueue.pop_front();
+        if (wit.getPfrom())
+            wit.getPfrom()->Release();
+    }
+    mapPeerRequests.clear();
+    mapStatus.clear();
+    mapRanges.clear();
+    listRangeUse.clear();
+}
+
+CLightWorkerStats CLightWorker::GetStats() {
+    boost::unique_lock<boost::mutex> lock(cs);
+    CLightWorkerStats ret = stats;
+    ret.nQueued = requestsQueue.size();
+    ret.nRunning = mapStatus.size() - requestsQueue.size();
+    return ret;
+}
+
+std::vector<CLightRequestStatus> CLightWorker::GetRequests() {
+    boost::unique_lock<boost::mutex> lock(cs);
+    std::vector<CLightRequestStatus> ret;
+    for (const auto& it : mapStatus)
+        ret.push_back(it.second);
+    return ret;
+}
+
 /****** Thread ********/
 void CLightWorker::ThreadLightZPIVSimplified() {
     RenameThread("syndicate-light-thread");
-    isWorkerRunning = true;
     while (true) {
-        try {
+        CGenWit genWit;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            while (requestsQueue.empty())
+                condWork.wait(lock);
+            genWit = requestsQueue.front();
+            requestsQueue.pop_front();
 
-            // Take a breath between requests.. TODO: Add processor usage check here
-            MilliSleep(2000);
-
-            // TODO: Future: join several similar requests into one calculation if the filter and denom match..
-            CGenWit genWit = requestsQueue.pop();
-            LogPrintf("%s pop work for %s \n\n", "syndicate-light-thread", genWit.toString());
-
-            libzerocoin::ZerocoinParams *params = Params().Zerocoin_Params(false);
-            CBlockIndex *pIndex = chainActive[genWit.getStartingHeight()];
-            if (!pIndex) {
-                // Rejects only the failed height
-                rejectWork(genWit, genWit.getStartingHeight(), NON_DETERMINED);
-            } else {
-                LogPrintf("%s calculating work for %s \n\n", "syndicate-light-thread", genWit.toString());
-                int blockHeight = pIndex->nHeight;
-                if (blockHeight >= Params().Zerocoin_Block_V2_Start()) {
-
-                    // TODO: The protocol actually doesn't care about the Accumulator..
-                    libzerocoin::Accumulator accumulator(params, genWit.getDen(), genWit.getAccWitValue());
-                    libzerocoin::PublicCoin temp(params);
-                    libzerocoin::AccumulatorWitness witness(params, accumulator, temp);
-                    std::string strFailReason = "";
-                    int nMintsAdded = 0;
-                    CZerocoinSpendReceipt receipt;
-
-                    std::list<CBigNum> ret;
-                    int heightStop;
-
-                    bool res;
-                    try {
-
-                        res = CalculateAccumulatorWitnessFor(
-                                params,
-                                blockHeight,
-                                COMP_MAX_AMOUNT,
-                                genWit.getDen(),
-                                genWit.getFilter(),
-                                accumulator,
-                                witness,
-                                nMintsAdded,
-                                strFailReason,
-                                ret,
-                                heightStop
-                        );
-
-                    } catch (NotEnoughMintsException e) {
-                        LogPrintStr(std::string("ThreadLightZPIVSimplified: ") + e.message + "\n");
-                        rejectWork(genWit, blockHeight, NOT_ENOUGH_MINTS);
-                        continue;
-                    }
-
-                    if (!res) {
-                        // TODO: Check if the GenerateAccumulatorWitnessFor can fail for node's fault or it's just because the peer sent an illegal request..
-                        rejectWork(genWit, blockHeight, NON_DETERMINED);
-                    } else {
-                        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-                        ss.reserve(ret.size() * 32);
-
-                        ss << genWit.getRequestNum();
-                        ss << accumulator.getValue(); // TODO: ---> this accumulator value is not necessary. The light node should get it using the other message..
-                        ss << witness.getValue();
-                        uint32_t size = ret.size();
-                        ss << size;
-                        for (CBigNum bnValue : ret) {
-                            ss << bnValue;
-                        }
-                        ss << heightStop;
-                        if (genWit.getPfrom()) {
-                            LogPrintf("%s pushing message to %s \n", "syndicate-light-thread", genWit.getPfrom()->addrName);
-                            genWit.getPfrom()->PushMessage("pubcoins", ss);
-                        } else
-                            LogPrintf("%s NOT pushing message to %s \n", "syndicate-light-thread", genWit.getPfrom()->addrName);
-                    }
-                } else {
-                    // Rejects only the failed height
-                    rejectWork(genWit, blockHeight, NON_DETERMINED);
-                }
-            }
+            CLightRequestStatus& status = mapStatus[std::make_pair(genWit.getPfrom() ? genWit.getPfrom()->GetId() : -1, genWit.getRequestNum())];
+            status.fRunning = true;
+            status.nTimeStarted = GetTimeMicros();
+        }
+        LogPrint("zpiv", "%s pop work for %s \n\n", "syndicate-light-thread", genWit.toString());
+
+        try {
+            ProcessWitWork(genWit);
+        } catch (const boost::thread_interrupted&) {
+            FinishWork(genWit, true);
+            throw;
         } catch (std::exception& e) {
-            //std::cout << "exception in light loop, closing it. " << e.what() << std::endl;
             PrintExceptionContinue(&e, "lightzpivthread");
-            break;
+            FinishWork(genWit, true);
+        }
+    }
+}
+
+void CLightWorker::ProcessWitWork(CGenWit& genWit) {
+    libzerocoin::ZerocoinParams *params = Params().Zerocoin_Params(false);
+    int blockHeight = genWit.getStartingHeight();
+    bool fInChain;
+    {
+        LOCK(cs_main);
+        fInChain = chainActive[blockHeight] != nullptr;
+    }
+    if (!fInChain || blockHeight < Params().Zerocoin_Block_V2_Start()) {
+        // Rejects only the failed height
+        rejectWork(genWit, blockHeight, NON_DETERMINED);
+        return;
+    }
+
+    CLightRequestStatus status;
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        status = mapStatus[std::make_pair(genWit.getPfrom() ? genWit.getPfrom()->GetId() : -1, genWit.getRequestNum())];
+    }
+
+    std::shared_ptr<const CWitnessRange> range = GetRange(genWit, status);
+    if (!range) {
+        rejectWork(genWit, blockHeight, NON_DETERMINED);
+        return;
+    }
+
+    libzerocoin::Accumulator accumulator(params, genWit.getDen(), genWit.getAccWitValue());
+    libzerocoin::PublicCoin temp(params);
+    libzerocoin::AccumulatorWitness witness(params, accumulator, temp);
+    std::string strFailReason = "";
+    int nMintsAdded = 0;
+    std::list<CBigNum> ret;
+
+    try {
+        if (!CalculateAccumulatorWitnessFor(params, *range, genWit.getFilter(), accumulator, witness, nMintsAdded, strFailReason, ret)) {
+            rejectWork(genWit, blockHeight, NON_DETERMINED);
+            return;
+        }
+    } catch (const NotEnoughMintsException& e) {
+        LogPrintStr(std::string("ThreadLightZPIVSimplified: ") + e.message + "\n");
+        rejectWork(genWit, blockHeight, NOT_ENOUGH_MINTS);
+        return;
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss.reserve(ret.size() * 32);
+
+    ss << genWit.getRequestNum();
+    ss << accumulator.getValue(); // TODO: ---> this accumulator value is not necessary. The light node should get it using the other message..
+    ss << witness.getValue();
+    uint32_t size = ret.size();
+    ss << size;
+    for (CBigNum bnValue : ret) {
+        ss << bnValue;
+    }
+    ss << range->nHeightStop;
+    if (genWit.getPfrom()) {
+        LogPrint("zpiv", "%s pushing message to %s \n", "syndicate-light-thread", genWit.getPfrom()->addrName);
+        genWit.getPfrom()->PushMessage("pubcoins", ss);
+    }
+    FinishWork(genWit, false);
+}
+
+std::shared_ptr<const CWitnessRange> CLightWorker::GetRange(const CGenWit& genWit, CLightRequestStatus& status) {
+    RangeKey key;
+    key.den = genWit.getDen();
+    {
+        LOCK(cs_main);
+        GetWitnessRangeBounds(genWit.getStartingHeight(), COMP_MAX_AMOUNT, key.nHeightStart, key.nHeightStop);
+    }
+    const RequestId id = std::make_pair(status.nodeId, status.nRequestNum);
+
+    // The first request over a range computes it, any other one arriving meanwhile waits for that result
+    std::promise<std::shared_ptr<const CWitnessRange> > promise;
+    CachedRange cached;
+    bool fCompute = false;
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        auto it = mapRanges.find(key);
+        if (it == mapRanges.end()) {
+            fCompute = true;
+            cached.future = promise.get_future().share();
+            cached.progress = std::make_shared<CLightRangeProgress>(std::max(0, key.nHeightStop - key.nHeightStart));
+            mapRanges[key] = cached;
+            listRangeUse.push_back(key);
+            while (listRangeUse.size() > LIGHTZPIV_RANGE_CACHE_SIZE) {
+                mapRanges.erase(listRangeUse.front());
+                listRangeUse.pop_front();
+            }
+            stats.nRangeComputed++;
+        } else {
+            cached = it->second;
+            listRangeUse.remove(key);
+            listRangeUse.push_back(key);
+            stats.nRangeShared++;
+        }
+        auto itStatus = mapStatus.find(id);
+        if (itStatus != mapStatus.end()) {
+            itStatus->second.fSharedRange = !fCompute;
+            itStatus->second.progress = cached.progress;
         }
     }
 
+    if (fCompute) {
+        std::shared_ptr<CWitnessRange> range = std::make_shared<CWitnessRange>();
+        std::string strError;
+        bool fSuccess = false;
+        try {
+            fSuccess = CalculateWitnessRange(genWit.getStartingHeight(), COMP_MAX_AMOUNT, genWit.getDen(), *range, strError, &cached.progress->nBlocksDone);
+        } catch (...) {
+            promise.set_value(nullptr);
+            throw;
+        }
+        promise.set_value(fSuccess ? range : nullptr);
+    }
 
+    std::shared_ptr<const CWitnessRange> range = cached.future.get();
+    bool fStale = false;
+    if (range) {
+        LOCK(cs_main);
+        fStale = range->nHeightStop > chainActive.Height() || chainActive[range->nHeightStop]->GetBlockHash() != range->hashStop;
+    }
+    // Failed or reorganized away: drop it so the next request over these blocks starts over
+    if (!range || fStale) {
+        boost::unique_lock<boost::mutex> lock(cs);
+        auto it = mapRanges.find(key);
+        if (it != mapRanges.end() && it->second.progress == cached.progress) {
+            mapRanges.erase(it);
+            listRangeUse.remove(key);
+        }
+        return nullptr;
+    }
+    return range;
+}
+
+void CLightWorker::FinishWork(CGenWit& wit, bool fRejected) {
+    CNode* pfrom = wit.getPfrom();
+    NodeId nodeId = pfrom ? pfrom->GetId() : -1;
+    int64_t nLatency = 0;
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        auto it = mapStatus.find(std::make_pair(nodeId, wit.getRequestNum()));
+        if (it != mapStatus.end()) {
+            nLatency = GetTimeMicros() - it->second.nTimeQueued;
+            mapStatus.erase(it);
+        }
+        if (--mapPeerRequests[nodeId] <= 0)
+            mapPeerRequests.erase(nodeId);
+
+        if (fRejected)
+            stats.nRejected++;
+        else
+            stats.nCompleted++;
+        stats.nTotalLatency += nLatency;
+        stats.nMaxLatency = std::max(stats.nMaxLatency, nLatency);
+    }
+    LogPrint("zpiv", "%s request %d from peer=%d %s in %.2fms\n", "syndicate-light-thread", wit.getRequestNum(), nodeId,
+             fRejected ? "rejected" : "answered", 0.001 * nLatency);
+    if (pfrom)
+        pfrom->Release();
 }
 
 // TODO: Think more the peer misbehaving policy..
 void CLightWorker::rejectWork(CGenWit& wit, int blockHeight, uint32_t errorNumber) {
-    if (wit.getStartingHeight() == blockHeight){
-        LogPrintf("%s rejecting work %s , error code: %s\n", "syndicate-light-thread", wit.toString(), errorNumber);
+    LogPrint("zpiv", "%s rejecting work %s at height %d, error code: %s\n", "syndicate-light-thread", wit.toString(), blockHeight, errorNumber);
+    if (wit.getPfrom()) {
         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
         ss << wit.getRequestNum();
         ss << errorNumber;
         wit.getPfrom()->PushMessage("pubcoins", ss);
-    } else {
-        requestsQueue.push(wit);
     }
+    FinishWork(wit, true);
 }
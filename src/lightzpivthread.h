@@ -8,9 +8,14 @@
 #define SYNX_LIGHTZPIVTHREAD_H
 
 #include <atomic>
+#include <deque>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <tuple>
 #include "genwit.h"
 #include "zpiv/accumulators.h"
-#include "concurrentqueue.h"
 #include "chainparams.h"
 #include <boost/function.hpp>
 #include <boost/thread.hpp>
@@ -18,7 +23,47 @@
 extern CChain chainActive;
 // Max amount of computation for a single request
 const int COMP_MAX_AMOUNT = 60 * 24 * 60;
+// Default number of threads computing witnesses
+static const int DEFAULT_LIGHTZPIV_THREADS = 2;
+// Default number of requests one peer may have queued or in progress
+static const int DEFAULT_LIGHTZPIV_MAX_PEER_REQUESTS = 16;
+// Witness ranges kept for later requests over the same blocks
+static const size_t LIGHTZPIV_RANGE_CACHE_SIZE = 16;
+
+/** Progress of a witness range while its blocks are read */
+struct CLightRangeProgress {
+    std::atomic<int> nBlocksDone;
+    int nBlocksTotal;
+
+    CLightRangeProgress(int nBlocksTotalIn) : nBlocksDone(0), nBlocksTotal(nBlocksTotalIn) {}
+};
 
+/** A queued or running witness request, as reported by getlightzpivstatus */
+struct CLightRequestStatus {
+    NodeId nodeId;
+    int nRequestNum;
+    libzerocoin::CoinDenomination den;
+    int nStartingHeight;
+    bool fRunning;
+    bool fSharedRange;
+    int64_t nTimeQueued;
+    int64_t nTimeStarted;
+    std::shared_ptr<CLightRangeProgress> progress;
+};
+
+/** Totals since the worker started */
+struct CLightWorkerStats {
+    int nThreads;
+    size_t nQueued;
+    size_t nRunning;
+    uint64_t nCompleted;
+    uint64_t nRejected;
+    uint64_t nPeerLimited;
+    uint64_t nRangeComputed;
+    uint64_t nRangeShared;
+    int64_t nTotalLatency;
+    int64_t nMaxLatency;
+};
 
 /****** Thread ********/
 
@@ -26,14 +71,46 @@ class CLightWorker{
 
 private:
 
-    concurrentqueue<CGenWit> requestsQueue;
+    typedef std::pair<NodeId, int> RequestId;
+    typedef std::shared_future<std::shared_ptr<const CWitnessRange> > RangeFuture;
+
+    //! den, first block and checkpoint height identify the blocks a request accumulates
+    struct RangeKey {
+        libzerocoin::CoinDenomination den;
+        int nHeightStart;
+        int nHeightStop;
+        bool operator<(const RangeKey& other) const {
+            return std::tie(den, nHeightStart, nHeightStop) < std::tie(other.den, other.nHeightStart, other.nHeightStop);
+        }
+        bool operator==(const RangeKey& other) const {
+            return den == other.den && nHeightStart == other.nHeightStart && nHeightStop == other.nHeightStop;
+        }
+    };
+    struct CachedRange {
+        RangeFuture future;
+        std::shared_ptr<CLightRangeProgress> progress;
+    };
+
+    boost::mutex cs;
+    boost::condition_variable condWork;
+    std::deque<CGenWit> requestsQueue;
+    std::map<NodeId, int> mapPeerRequests;
+    std::map<RequestId, CLightRequestStatus> mapStatus;
+    std::map<RangeKey, CachedRange> mapRanges;
+    //! mapRanges keys, least recently used first
+    std::list<RangeKey> listRangeUse;
+    CLightWorkerStats stats;
+
     std::atomic<bool> isWorkerRunning;
-    boost::thread threadIns;
+    boost::thread_group threadGroup;
+    int nMaxPeerRequests;
 
 public:
 
     CLightWorker() {
         isWorkerRunning = false;
+        nMaxPeerRequests = DEFAULT_LIGHTZPIV_MAX_PEER_REQUESTS;
+        stats = CLightWorkerStats();
     }
 
     enum ERROR_CODES {
@@ -41,29 +118,28 @@ public:
         NON_DETERMINED = 1
     };
 
-    bool addWitWork(CGenWit wit) {
-        if (!isWorkerRunning) {
-            LogPrintf("%s not running trying to add wit work \n", "syndicate-light-thread");
-            return false;
-        }
-        requestsQueue.push(wit);
-        return true;
-    }
+    /** Queue a request. False when the worker is stopped or the peer has too many requests pending. */
+    bool addWitWork(CGenWit wit);
 
-    void StartLightZpivThread(boost::thread_group& threadGroup) {
-        LogPrintf("%s thread start\n", "syndicate-light-thread");
-        threadIns = boost::thread(boost::bind(&CLightWorker::ThreadLightZPIVSimplified, this));
-    }
+    void StartLightZpivThread(int nThreads = DEFAULT_LIGHTZPIV_THREADS, int nMaxPeerRequestsIn = DEFAULT_LIGHTZPIV_MAX_PEER_REQUESTS);
 
-    void StopLightZpivThread() {
-        threadIns.interrupt();
-        LogPrintf("%s thread interrupted\n", "syndicate-light-thread");
-    }
+    void StopLightZpivThread();
+
+    CLightWorkerStats GetStats();
+
+    std::vector<CLightRequestStatus> GetRequests();
 
 private:
 
     void ThreadLightZPIVSimplified();
 
+    void ProcessWitWork(CGenWit& genWit);
+
+    /** Range for a request, computed here or shared with any other request over the same blocks */
+    std::shared_ptr<const CWitnessRange> GetRange(const CGenWit& genWit, CLightRequestStatus& status);
+
+    void FinishWork(CGenWit& wit, bool fRejected);
+
     void rejectWork(CGenWit& wit, int blockHeight, uint32_t errorNumber);
 
 };
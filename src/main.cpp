@@ -12,6 +12,7 @@
 #include "zpiv/accumulatormap.h"
 #include "addrman.h"
 #include "alert.h"
+#include "blockencodings.h"
 #include "blocksignature.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -47,6 +48,8 @@
 #include <boost/thread.hpp>
 #include <boost/foreach.hpp>
 #include <atomic>
+#include <deque>
+#include <limits>
 #include <queue>
 
 
@@ -72,6 +75,7 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
+bool fZerocoinIndex = false;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -95,11 +99,20 @@ CTxMemPool mempool(::minRelayTxFee);
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
+    int64_t nTimeExpire;
+    unsigned int nTxSize;
 };
 std::map<uint256, COrphanTx> mapOrphanTransactions;
-std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+std::map<COutPoint, std::set<uint256> > mapOrphanTransactionsByPrev;
+/** Bytes of orphan transactions held, in total and for each peer that sent some */
+size_t nOrphanTxSize = 0;
+std::map<NodeId, size_t> mapOrphanTxSizeByPeer;
+/** Transactions of connected blocks whose outputs orphans may spend, tried again in batches */
+std::deque<uint256> queueOrphanWork;
 std::map<uint256, int64_t> mapRejectedBlocks;
 std::map<uint256, int64_t> mapZerocoinspends; //txid, time received
+/** Blocks served to bloom filtered peers, kept parsed for the next ones */
+CFilteredBlockCache filteredBlockCache(MAX_FILTERED_BLOCK_CACHE_SIZE);
 
 /***/
 CLightWorker lightWorker;
@@ -174,12 +187,34 @@ struct QueuedBlock {
     int64_t nTime;              //! Time of "getdata" request in microseconds.
     int nValidatedQueuedBefore; //! Number of blocks queued with validated headers (globally) at the time this one is requested.
     bool fValidatedHeaders;     //! Whether this block has validated headers at the time of request.
+    std::shared_ptr<PartiallyDownloadedBlock> partialBlock; //! Compact block waiting for its missing transactions.
 };
 std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
 /** Number of blocks in flight with validated headers. */
 int nQueuedValidatedHeaders = 0;
 
+/**
+ * Blocks downloaded while their parent is only known by its header, keyed by the parent's hash. They are
+ * accepted once the parent's data is in, so blocks still enter in chain order. Protected by cs_main.
+ */
+struct CBlockWaitingForParent {
+    std::shared_ptr<CBlock> block;
+    NodeId nodeid;
+    unsigned int nSize;
+};
+std::multimap<uint256, CBlockWaitingForParent> mapBlocksWaitingForParent;
+std::set<uint256> setBlocksWaitingForParent;
+size_t nBlocksWaitingForParentSize = 0;
+
+/**
+ * PoS headers accepted ahead of their blocks, with the peer that sent each. Past the last PoW block a header
+ * carries no proof, so these are bounded per peer and in total, stay out of the block tree database until
+ * their block is in, and are removed from mapBlockIndex if they fall too deep to reorganize to without it.
+ * Protected by cs_main.
+ */
+std::map<uint256, NodeId> mapPoSHeadersWithoutData;
+
 /** Number of preferable block download peers. */
 int nPreferredDownload = 0;
 
@@ -188,6 +223,14 @@ std::set<CBlockIndex*> setDirtyBlockIndex;
 
 /** Dirty block file entries. */
 std::set<int> setDirtyFileInfo;
+
+/**
+ * Filter for transactions that were recently rejected by AcceptToMemoryPool. These are not
+ * requested again until the chain tip changes, at which point the entire filter is reset.
+ * Protected by cs_main.
+ */
+std::unique_ptr<CRollingBloomFilter> recentRejects;
+uint256 hashRecentRejectsChainTip;
 } // anon namespace
 
 //////////////////////////////////////////////////////////////////////////////
@@ -313,6 +356,10 @@ struct CNodeState {
     int nBlocksInFlight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! PoS headers from this peer we keep without their block.
+    int nPoSHeadersWithoutData;
+    //! Whether we stopped accepting this peer's headers at a PoS limit, and ask again once there is room.
+    bool fPoSHeadersDeferred;
 
     CNodeBlocks nodeBlocks;
 
@@ -328,6 +375,8 @@ struct CNodeState {
         nStallingSince = 0;
         nBlocksInFlight = 0;
         fPreferredDownload = false;
+        nPoSHeadersWithoutData = 0;
+        fPoSHeadersDeferred = false;
     }
 };
 
@@ -343,6 +392,19 @@ CNodeState* State(NodeId pnode)
     return &it->second;
 }
 
+/** Stop counting a PoS header as kept without its block, once the block is in or the header is dropped. */
+void static ForgetPoSHeaderWithoutData(const uint256& hash)
+{
+    std::map<uint256, NodeId>::iterator it = mapPoSHeadersWithoutData.find(hash);
+    if (it == mapPoSHeadersWithoutData.end())
+        return;
+
+    CNodeState* state = State(it->second);
+    if (state)
+        state->nPoSHeadersWithoutData--;
+    mapPoSHeadersWithoutData.erase(it);
+}
+
 int GetHeight()
 {
     while (true) {
@@ -416,7 +478,7 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, CBlockIndex* pindex
     // Make sure it's not listed somewhere already.
     MarkBlockAsReceived(hash);
 
-    QueuedBlock newentry = {hash, pindex, GetTimeMicros(), nQueuedValidatedHeaders, pindex != NULL};
+    QueuedBlock newentry = {hash, pindex, GetTimeMicros(), nQueuedValidatedHeaders, pindex != NULL, nullptr};
     nQueuedValidatedHeaders += newentry.fValidatedHeaders;
     std::list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
     state->nBlocksInFlight++;
@@ -458,6 +520,12 @@ void UpdateBlockAvailability(NodeId nodeid, const uint256& hash)
     }
 }
 
+/** Whether blocks are synced with this peer through "getheaders" and parallel download, rather than "getblocks". */
+bool UseHeadersFirst(const CNode* pnode)
+{
+    return Params().HeadersFirstSyncingActive() && pnode->nVersion >= HEADERS_FIRST_VERSION;
+}
+
 /** Find the last common ancestor two blocks have.
  *  Both pa and pb must be non-NULL. */
 CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb)
@@ -540,6 +608,9 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
             if (pindex->nStatus & BLOCK_HAVE_DATA) {
                 if (pindex->nChainTx)
                     state->pindexLastCommonBlock = pindex;
+            } else if (setBlocksWaitingForParent.count(pindex->GetBlockHash())) {
+                // Already downloaded, only waiting for its parent.
+                continue;
             } else if (mapBlocksInFlight.count(pindex->GetBlockHash()) == 0) {
                 // The block is not already downloaded, and not yet in flight.
                 if (pindex->nHeight > nWindowEnd) {
@@ -587,6 +658,9 @@ void RegisterNodeSignals(CNodeSignals& nodeSignals)
     nodeSignals.SendMessages.connect(&SendMessages);
     nodeSignals.InitializeNode.connect(&InitializeNode);
     nodeSignals.FinalizeNode.connect(&FinalizeNode);
+
+    LOCK(cs_main);
+    recentRejects.reset(new CRollingBloomFilter(120000, 0.000001));
 }
 
 void UnregisterNodeSignals(CNodeSignals& nodeSignals)
@@ -596,6 +670,9 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals)
     nodeSignals.SendMessages.disconnect(&SendMessages);
     nodeSignals.InitializeNode.disconnect(&InitializeNode);
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
+
+    LOCK(cs_main);
+    recentRejects.reset();
 }
 
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator)
@@ -641,51 +718,92 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer)
         return false;
     }
 
-    mapOrphanTransactions[hash].tx = tx;
-    mapOrphanTransactions[hash].fromPeer = peer;
+    // A single peer only gets its share of the pool, so that flooding it cannot evict everybody else's orphans
+    std::map<NodeId, size_t>::iterator itPeer = mapOrphanTxSizeByPeer.find(peer);
+    if (itPeer != mapOrphanTxSizeByPeer.end() && itPeer->second + sz > MAX_ORPHAN_TRANSACTIONS_SIZE_PER_PEER) {
+        LogPrint("mempool", "ignoring orphan tx %s, peer=%d has %u bytes of orphans already\n", hash.ToString(), peer, itPeer->second);
+        return false;
+    }
+
+    COrphanTx& orphan = mapOrphanTransactions[hash];
+    orphan.tx = tx;
+    orphan.fromPeer = peer;
+    orphan.nTimeExpire = GetTime() + ORPHAN_TX_EXPIRE_TIME;
+    orphan.nTxSize = sz;
     for (const CTxIn& txin : tx.vin)
-        mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
+        mapOrphanTransactionsByPrev[txin.prevout].insert(hash);
+    nOrphanTxSize += sz;
+    mapOrphanTxSizeByPeer[peer] += sz;
 
-    LogPrint("mempool", "stored orphan tx %s (mapsz %u prevsz %u)\n", hash.ToString(),
-        mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
+    LogPrint("mempool", "stored orphan tx %s (mapsz %u prevsz %u bytes %u)\n", hash.ToString(),
+        mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size(), nOrphanTxSize);
     return true;
 }
 
-void static EraseOrphanTx(uint256 hash)
+int static EraseOrphanTx(uint256 hash)
 {
     std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
-        return;
+        return 0;
     for (const CTxIn& txin : it->second.tx.vin) {
-        std::map<uint256, std::set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
+        std::map<COutPoint, std::set<uint256> >::iterator itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
         if (itPrev == mapOrphanTransactionsByPrev.end())
             continue;
         itPrev->second.erase(hash);
         if (itPrev->second.empty())
             mapOrphanTransactionsByPrev.erase(itPrev);
     }
+    nOrphanTxSize -= it->second.nTxSize;
+    std::map<NodeId, size_t>::iterator itPeer = mapOrphanTxSizeByPeer.find(it->second.fromPeer);
+    if (itPeer != mapOrphanTxSizeByPeer.end()) {
+        itPeer->second -= it->second.nTxSize;
+        if (itPeer->second == 0)
+            mapOrphanTxSizeByPeer.erase(itPeer);
+    }
     mapOrphanTransactions.erase(it);
+    return 1;
 }
 
 void EraseOrphansFor(NodeId peer)
 {
+    // Most peers never sent an orphan, no need to go through the pool for them
+    if (!mapOrphanTxSizeByPeer.count(peer))
+        return;
     int nErased = 0;
     std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
     while (iter != mapOrphanTransactions.end()) {
         std::map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
         if (maybeErase->second.fromPeer == peer) {
-            EraseOrphanTx(maybeErase->second.tx.GetHash());
-            ++nErased;
+            nErased += EraseOrphanTx(maybeErase->second.tx.GetHash());
         }
     }
     if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer %d\n", nErased, peer);
 }
 
 
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
+unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans, size_t nMaxBytes)
 {
+    static int64_t nNextSweep;
+    int64_t nNow = GetTime();
+    if (nNextSweep <= nNow) {
+        // Sweep out expired orphan pool entries:
+        int nErased = 0;
+        int64_t nMinExpTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
+        std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
+        while (iter != mapOrphanTransactions.end()) {
+            std::map<uint256, COrphanTx>::iterator maybeErase = iter++;
+            if (maybeErase->second.nTimeExpire <= nNow) {
+                nErased += EraseOrphanTx(maybeErase->first);
+            } else {
+                nMinExpTime = std::min(maybeErase->second.nTimeExpire, nMinExpTime);
+            }
+        }
+        // Sweeping again 5 minutes after the next entry that expires in order to batch the linear scan.
+        nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
+        if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx due to expiration\n", nErased);
+    }
     unsigned int nEvicted = 0;
-    while (mapOrphanTransactions.size() > nMaxOrphans) {
+    while (mapOrphanTransactions.size() > nMaxOrphans || nOrphanTxSize > nMaxBytes) {
         // Evict a random orphan:
         uint256 randomhash = GetRandHash();
         std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
@@ -697,6 +815,101 @@ unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
     return nEvicted;
 }
 
+/**
+ * Try again the orphans spending outputs of the transactions in workQueue. The ones accepted are
+ * relayed and queued in turn, the ones still missing inputs stay in the pool and the others are
+ * dropped. Returns once the queue is empty or nMaxTried orphans were tried, leaving the rest of
+ * the queue for the next call.
+ */
+void ProcessOrphanTx(std::deque<uint256>& workQueue, unsigned int nMaxTried)
+{
+    AssertLockHeld(cs_main);
+    std::set<NodeId> setMisbehaving;
+    std::vector<uint256> vEraseQueue;
+    unsigned int nTried = 0;
+    while (!workQueue.empty() && nTried < nMaxTried) {
+        const uint256 hash = workQueue.front();
+        workQueue.pop_front();
+
+        // The index is ordered by outpoint, so all the outputs of the transaction are next to each other
+        std::set<uint256> setOrphans;
+        std::map<COutPoint, std::set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.lower_bound(COutPoint(hash, 0));
+        for (; itByPrev != mapOrphanTransactionsByPrev.end() && itByPrev->first.hash == hash; ++itByPrev)
+            setOrphans.insert(itByPrev->second.begin(), itByPrev->second.end());
+
+        for (const uint256& orphanHash : setOrphans) {
+            std::map<uint256, COrphanTx>::iterator itOrphan = mapOrphanTransactions.find(orphanHash);
+            if (itOrphan == mapOrphanTransactions.end())
+                continue;
+            const CTransaction& orphanTx = itOrphan->second.tx;
+            NodeId fromPeer = itOrphan->second.fromPeer;
+            bool fMissingInputs2 = false;
+            // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
+            // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+            // anyone relaying LegitTxX banned)
+            CValidationState stateDummy;
+
+            if (setMisbehaving.count(fromPeer))
+                continue;
+            nTried++;
+            if (AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2)) {
+                LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
+                RelayTransaction(orphanTx);
+                workQueue.push_back(orphanHash);
+                vEraseQueue.push_back(orphanHash);
+            } else if (!fMissingInputs2) {
+                int nDos = 0;
+                if (stateDummy.IsInvalid(nDos) && nDos > 0) {
+                    // Punish peer that gave us an invalid orphan tx
+                    Misbehaving(fromPeer, nDos);
+                    setMisbehaving.insert(fromPeer);
+                    LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
+                }
+                // Has inputs but not accepted to mempool
+                // Probably non-standard or insufficient fee/priority
+                LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
+                vEraseQueue.push_back(orphanHash);
+            }
+            mempool.check(pcoinsTip);
+        }
+    }
+
+    for (uint256 hash : vEraseQueue) EraseOrphanTx(hash);
+}
+
+/**
+ * Orphans that are in a newly connected block, or spend the same outputs as one of its
+ * transactions, can never get in the mempool anymore. The others that spend its outputs are
+ * queued to be tried again once the block is processed.
+ */
+void UpdateOrphansForBlock(const CBlock& block)
+{
+    AssertLockHeld(cs_main);
+    if (mapOrphanTransactions.empty())
+        return;
+
+    int nErased = 0;
+    for (const CTransaction& tx : block.vtx) {
+        nErased += EraseOrphanTx(tx.GetHash());
+        for (const CTxIn& txin : tx.vin) {
+            std::map<COutPoint, std::set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
+            if (itByPrev == mapOrphanTransactionsByPrev.end())
+                continue;
+            // Copied, erasing the orphans erases the entry
+            std::set<uint256> setConflicts = itByPrev->second;
+            for (const uint256& orphanHash : setConflicts)
+                nErased += EraseOrphanTx(orphanHash);
+        }
+    }
+    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx included or conflicted by block\n", nErased);
+
+    for (const CTransaction& tx : block.vtx) {
+        std::map<COutPoint, std::set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.lower_bound(COutPoint(tx.GetHash(), 0));
+        if (itByPrev != mapOrphanTransactionsByPrev.end() && itByPrev->first.hash == tx.GetHash())
+            queueOrphanWork.push_back(tx.GetHash());
+    }
+}
+
 bool IsStandardTx(const CTransaction& tx, std::string& reason)
 {
     AssertLockHeld(cs_main);
@@ -921,7 +1134,8 @@ int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
     if (nResult < 0) nResult = 0;
 
     if (nResult < 6) {
-        std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
+        LOCK(cs_swifttx);
+        TransactionLockMap::iterator i = mapTxLocks.find(nTXHash);
         if (i != mapTxLocks.end()) {
             sigs = (*i).second.CountSignatures();
         }
@@ -937,7 +1151,8 @@ int GetIXConfirmations(uint256 nTXHash)
 {
     int sigs = 0;
 
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(nTXHash);
+    LOCK(cs_swifttx);
+    TransactionLockMap::iterator i = mapTxLocks.find(nTXHash);
     if (i != mapTxLocks.end()) {
         sigs = (*i).second.CountSignatures();
     }
@@ -1083,7 +1298,7 @@ bool ContextualCheckZerocoinSpendNoSerialCheck(const CTransaction& tx, const lib
 }
 
 
-bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, bool fFakeSerialAttack)
+bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, bool fFakeSerialAttack, libzerocoin::SerialNumberSoKBatch* pSoKBatch)
 {
     //max needed non-mint outputs should be 2 - one for redemption address and a possible 2nd for change
     if (tx.vout.size() > 2) {
@@ -1107,45 +1322,40 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
     bool fValidated = false;
     std::set<CBigNum> serials;
     CAmount nTotalRedeemed = 0;
-    for (const CTxIn& txin : tx.vin) {
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        const CTxIn& txin = tx.vin[i];
 
         //only check txin that is a zcspend
         bool isPublicSpend = txin.IsZerocoinPublicSpend();
         if (!txin.IsZerocoinSpend() && !isPublicSpend)
             continue;
 
-        libzerocoin::CoinSpend newSpend;
-        CTxOut prevOut;
+        std::shared_ptr<const libzerocoin::CoinSpend> newSpend;
+        std::shared_ptr<const PublicCoinSpend> publicSpend;
         if (isPublicSpend) {
-            if(!GetOutput(txin.prevout.hash, txin.prevout.n, state, prevOut)){
-                return state.DoS(100, error("CheckZerocoinSpend(): public zerocoin spend prev output not found, prevTx %s, index %d", txin.prevout.hash.GetHex(), txin.prevout.n));
-            }
-            libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-            PublicCoinSpend publicSpend(params);
-            if (!ZPIVModule::parseCoinSpend(txin, tx, prevOut, publicSpend)){
+            if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend)){
                 return state.DoS(100, error("CheckZerocoinSpend(): public zerocoin spend parse failed"));
             }
             newSpend = publicSpend;
         }else {
-            newSpend = TxInToZerocoinSpend(txin);
+            newSpend = TxInToZerocoinSpend(tx, i);
         }
 
         //check that the denomination is valid
-        if (newSpend.getDenomination() == libzerocoin::ZQ_ERROR)
+        if (newSpend->getDenomination() == libzerocoin::ZQ_ERROR)
             return state.DoS(100, error("Zerocoinspend does not have the correct denomination"));
 
         //check that denomination is what it claims to be in nSequence
-        if (newSpend.getDenomination() != txin.nSequence)
+        if (newSpend->getDenomination() != txin.nSequence)
             return state.DoS(100, error("Zerocoinspend nSequence denomination does not match CoinSpend"));
 
         //make sure the txout has not changed
-        if (newSpend.getTxOutHash() != hashTxOut)
+        if (newSpend->getTxOutHash() != hashTxOut)
             return state.DoS(100, error("Zerocoinspend does not use the same txout that was used in the SoK"));
 
         if (isPublicSpend) {
-            libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-            PublicCoinSpend ret(params);
-            if (!ZPIVModule::validateInput(txin, prevOut, tx, ret)){
+            // The denomination checks above cover the nSequence/prev out value check of ZPIVModule::validateInput
+            if (!publicSpend->validate()){
                 return state.DoS(100, error("CheckZerocoinSpend(): public zerocoin spend did not verify"));
             }
         } else
@@ -1153,25 +1363,27 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
             if (fVerifySignature) {
                 //see if we have record of the accumulator used in the spend tx
                 CBigNum bnAccumulatorValue = 0;
-                if (!zerocoinDB->ReadAccumulatorValue(newSpend.getAccumulatorChecksum(), bnAccumulatorValue)) {
-                    uint32_t nChecksum = newSpend.getAccumulatorChecksum();
+                if (!zerocoinDB->ReadAccumulatorValue(newSpend->getAccumulatorChecksum(), bnAccumulatorValue)) {
+                    uint32_t nChecksum = newSpend->getAccumulatorChecksum();
                     return state.DoS(100, error("%s: Zerocoinspend could not find accumulator associated with checksum %s", __func__, HexStr(BEGIN(nChecksum), END(nChecksum))));
                 }
 
                 libzerocoin::Accumulator accumulator(Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start()),
-                                        newSpend.getDenomination(), bnAccumulatorValue);
+                                        newSpend->getDenomination(), bnAccumulatorValue);
 
-                //Check that the coin has been accumulated
-                if(!newSpend.Verify(accumulator, !fFakeSerialAttack))
+                //Check that the coin has been accumulated, the caller verifies a batched SoK
+                bool fVerified = pSoKBatch ? newSpend->VerifyBatched(accumulator, *pSoKBatch, !fFakeSerialAttack) :
+                                             newSpend->Verify(accumulator, !fFakeSerialAttack);
+                if (!fVerified)
                         return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
             }
 
-        if (serials.count(newSpend.getCoinSerialNumber()))
+        if (serials.count(newSpend->getCoinSerialNumber()))
             return state.DoS(100, error("Zerocoinspend serial is used twice in the same tx"));
-        serials.insert(newSpend.getCoinSerialNumber());
+        serials.insert(newSpend->getCoinSerialNumber());
 
         //make sure that there is no over redemption of coins
-        nTotalRedeemed += libzerocoin::ZerocoinDenominationToAmount(newSpend.getDenomination());
+        nTotalRedeemed += libzerocoin::ZerocoinDenominationToAmount(newSpend->getDenomination());
         fValidated = true;
     }
 
@@ -1183,7 +1395,7 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
     return fValidated;
 }
 
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, bool fFakeSerialAttack)
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, bool fFakeSerialAttack, libzerocoin::SerialNumberSoKBatch* pSoKBatch)
 {
     // Basic checks that don't depend on any context
     if (tx.vin.empty())
@@ -1253,7 +1465,7 @@ bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fReject
 
             // Do not require signature verification if this is initial sync and a block over 24 hours old
             bool fVerifySignature = !IsInitialBlockDownload() && (GetTime() - chainActive.Tip()->GetBlockTime() < (60*60*24));
-            if (!CheckZerocoinSpend(tx, fVerifySignature, state, fFakeSerialAttack))
+            if (!CheckZerocoinSpend(tx, fVerifySignature, state, fFakeSerialAttack, pSoKBatch))
                 return state.DoS(100, error("CheckTransaction() : invalid zerocoin spend"));
         }
     }
@@ -1389,12 +1601,15 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
     // ----------- swiftTX transaction scanning -----------
 
-    for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
+    {
+        LOCK(cs_swifttx);
+        for (const CTxIn& in : tx.vin) {
+            if (mapLockedInputs.count(in.prevout)) {
+                if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+                    return state.DoS(0,
+                        error("AcceptToMemoryPool : conflicts with existing transaction lock: %s", reason),
+                        REJECT_INVALID, "tx-lock-conflict");
+                }
             }
         }
     }
@@ -1427,7 +1642,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                                            tx.GetHash().GetHex(), nHeightTx), REJECT_DUPLICATE, "bad-txns-inputs-spent");
 
             //Check for double spending of serial #'s
-            for (const CTxIn& txIn : tx.vin) {
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                const CTxIn& txIn = tx.vin[i];
                 // Only allow for zc spends inputs
                 bool isPublicSpend = txIn.IsZerocoinPublicSpend();
                 bool isPrivZerocoinSpend = txIn.IsZerocoinSpend();
@@ -1443,17 +1659,16 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                 }
 
                 if (isPublicSpend) {
-                    libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-                    PublicCoinSpend publicSpend(params);
-                    if (!ZPIVModule::ParseZerocoinPublicSpend(txIn, tx, state, publicSpend)){
+                    std::shared_ptr<const PublicCoinSpend> publicSpend;
+                    if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend)){
                         return false;
                     }
-                    if (!ContextualCheckZerocoinSpend(tx, &publicSpend, chainActive.Tip(), 0))
+                    if (!ContextualCheckZerocoinSpend(tx, publicSpend.get(), chainActive.Tip(), 0))
                         return state.Invalid(error("%s: ContextualCheckZerocoinSpend failed for tx %s", __func__,
                                                    tx.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-zpiv");
                 } else {
-                    libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
-                    if (!ContextualCheckZerocoinSpend(tx, &spend, chainActive.Tip(), 0))
+                    std::shared_ptr<const libzerocoin::CoinSpend> spend = TxInToZerocoinSpend(tx, i);
+                    if (!ContextualCheckZerocoinSpend(tx, spend.get(), chainActive.Tip(), 0))
                         return state.Invalid(error("%s: ContextualCheckZerocoinSpend failed for tx %s", __func__,
                                                    tx.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-zpiv");
                 }
@@ -1670,12 +1885,15 @@ bool AcceptableInputs(CTxMemPool& pool, CValidationState& state, const CTransact
 
     // ----------- swiftTX transaction scanning -----------
 
-    for (const CTxIn& in : tx.vin) {
-        if (mapLockedInputs.count(in.prevout)) {
-            if (mapLockedInputs[in.prevout] != tx.GetHash()) {
-                return state.DoS(0,
-                    error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
-                    REJECT_INVALID, "tx-lock-conflict");
+    {
+        LOCK(cs_swifttx);
+        for (const CTxIn& in : tx.vin) {
+            if (mapLockedInputs.count(in.prevout)) {
+                if (mapLockedInputs[in.prevout] != tx.GetHash()) {
+                    return state.DoS(0,
+                        error("AcceptableInputs : conflicts with existing transaction lock: %s", reason),
+                        REJECT_INVALID, "tx-lock-conflict");
+                }
             }
         }
     }
@@ -2062,6 +2280,13 @@ int64_t GetBlockValue(int nHeight)
 }
 
 
+// the seesaw is evaluated with the same inputs for every payment check of a block, remember the last result
+static CCriticalSection cs_seesaw;
+static CAmount nSeeSawBlockValue = -1;
+static int nSeeSawMasternodeCount = -1;
+static int64_t nSeeSawMoneySupply = -1;
+static CAmount nSeeSawResult = 0;
+
 CAmount GetSeeSaw(const CAmount& blockValue, int nMasternodeCount, int nHeight)
 {
     int64_t ret = 0;
@@ -2077,6 +2302,10 @@ CAmount GetSeeSaw(const CAmount& blockValue, int nMasternodeCount, int nHeight)
                 nMasternodeCount = mnodeman.size();
         }
 
+        LOCK(cs_seesaw);
+        if (blockValue == nSeeSawBlockValue && nMasternodeCount == nSeeSawMasternodeCount && nMoneySupply == nSeeSawMoneySupply)
+            return nSeeSawResult;
+
         int64_t mNodeCoins = nMasternodeCount * 5000 * COIN; // 5000 it's OK
         if (mNodeCoins == 0) {
             ret = 0;
@@ -2340,22 +2569,26 @@ CAmount GetSeeSaw(const CAmount& blockValue, int nMasternodeCount, int nHeight)
                 ret = blockValue * .01;
             }
         }
+
+        nSeeSawBlockValue = blockValue;
+        nSeeSawMasternodeCount = nMasternodeCount;
+        nSeeSawMoneySupply = nMoneySupply;
+        nSeeSawResult = ret;
     }
     return ret;
 }
 
-int64_t GetMasternodePayment(int nHeight, int64_t blockValue, int nMasternodeCount, bool isZSYNXStake)
+bool IsSeeSawPaymentHeight(int nHeight)
 {
-    if (Params().NetworkID() == CBaseChainParams::TESTNET) {
-        if (nHeight < 600) {
-            return GetSeeSaw(blockValue, nMasternodeCount, nHeight);
-        }
-        else {
-            return blockValue * .70;
-        }
-    }
+    if (Params().NetworkID() == CBaseChainParams::TESTNET)
+        return nHeight < 600;
 
-    if (nHeight < 346000) {
+    return nHeight < 346000;
+}
+
+int64_t GetMasternodePayment(int nHeight, int64_t blockValue, int nMasternodeCount, bool isZSYNXStake)
+{
+    if (IsSeeSawPaymentHeight(nHeight)) {
         return GetSeeSaw(blockValue, nMasternodeCount, nHeight);
     }
     else {
@@ -2542,22 +2775,21 @@ void AddInvalidSpendsToMap(const CBlock& block)
             continue;
 
         //Check all zerocoinspends for bad serials
-        for (const CTxIn& in : tx.vin) {
+        for (unsigned int i = 0; i < tx.vin.size(); i++) {
+            const CTxIn& in = tx.vin[i];
             bool isPublicSpend = in.IsZerocoinPublicSpend();
             if (in.IsZerocoinSpend() || isPublicSpend) {
 
-                libzerocoin::CoinSpend* spend;
+                std::shared_ptr<const libzerocoin::CoinSpend> spend;
                 if (isPublicSpend) {
-                    libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-                    PublicCoinSpend publicSpend(params);
+                    std::shared_ptr<const PublicCoinSpend> publicSpend;
                     CValidationState state;
-                    if (!ZPIVModule::ParseZerocoinPublicSpend(in, tx, state, publicSpend)){
+                    if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend)){
                         throw std::runtime_error("Failed to parse public spend");
                     }
-                    spend = &publicSpend;
+                    spend = publicSpend;
                 } else {
-                    libzerocoin::CoinSpend spendObj = TxInToZerocoinSpend(in);
-                    spend = &spendObj;
+                    spend = TxInToZerocoinSpend(tx, i);
                 }
 
                 //If serial is not valid, mark all outputs as bad
@@ -2749,21 +2981,20 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
         if (tx.ContainsZerocoins()) {
             if (tx.HasZerocoinSpendInputs()) {
                 //erase all zerocoinspends in this transaction
-                for (const CTxIn &txin : tx.vin) {
+                for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                    const CTxIn& txin = tx.vin[i];
                     bool isPublicSpend = txin.IsZerocoinPublicSpend();
                     if (txin.scriptSig.IsZerocoinSpend() || isPublicSpend) {
                         CBigNum serial;
                         if (isPublicSpend) {
-                            libzerocoin::ZerocoinParams *params = Params().Zerocoin_Params(false);
-                            PublicCoinSpend publicSpend(params);
+                            std::shared_ptr<const PublicCoinSpend> publicSpend;
                             CValidationState state;
-                            if (!ZPIVModule::ParseZerocoinPublicSpend(txin, tx, state, publicSpend)) {
+                            if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend)) {
                                 return error("Failed to parse public spend");
                             }
-                            serial = publicSpend.getCoinSerialNumber();
+                            serial = publicSpend->getCoinSerialNumber();
                         } else {
-                            libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txin);
-                            serial = spend.getCoinSerialNumber();
+                            serial = TxInToZerocoinSpend(tx, i)->getCoinSerialNumber();
                         }
 
                         if (!zerocoinDB->EraseCoinSpend(serial))
@@ -2861,6 +3092,12 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
             if(!EraseAccumulatorValues(nCheckpoint, pindex->pprev->nAccumulatorCheckpoint))
                 return error("DisconnectBlock(): failed to erase checkpoint");
         }
+
+        if (!pindex->vMintDenominationsInBlock.empty() && !zerocoinDB->EraseBlockPubcoins(pindex->nHeight))
+            return error("DisconnectBlock(): failed to erase pubcoin index");
+
+        if (fZerocoinIndex && pindex->nHeight >= Params().Zerocoin_StartHeight() && !zerocoinDB->EraseZerocoinBlockIndex(pindex->nHeight))
+            return error("DisconnectBlock(): failed to erase zerocoin block index");
     }
 
     if (pfClean) {
@@ -3209,6 +3446,8 @@ static int64_t nTimeConnect = 0;
 static int64_t nTimeIndex = 0;
 static int64_t nTimeCallbacks = 0;
 static int64_t nTimeTotal = 0;
+static int64_t nTimePayments = 0;
+static int64_t nTimeAccumulators = 0;
 
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& view, bool fJustCheck, bool fAlreadyChecked)
 {
@@ -3315,7 +3554,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 
             //Check for double spending of serial #'s
             std::set<CBigNum> setSerials;
-            for (const CTxIn& txIn : tx.vin) {
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                const CTxIn& txIn = tx.vin[i];
                 bool isPublicSpend = txIn.IsZerocoinPublicSpend();
                 bool isPrivZerocoinSpend = txIn.IsZerocoinSpend();
                 if (!isPrivZerocoinSpend && !isPublicSpend)
@@ -3327,22 +3567,21 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                 }
 
                 if (isPublicSpend) {
-                    libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-                    PublicCoinSpend publicSpend(params);
-                    if (!ZPIVModule::ParseZerocoinPublicSpend(txIn, tx, state, publicSpend)){
+                    std::shared_ptr<const PublicCoinSpend> publicSpend;
+                    if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend)){
                         return false;
                     }
-                    nValueIn += publicSpend.getDenomination() * COIN;
+                    nValueIn += publicSpend->getDenomination() * COIN;
                     //queue for db write after the 'justcheck' section has concluded
-                    vSpends.emplace_back(std::make_pair(publicSpend, tx.GetHash()));
-                    if (!ContextualCheckZerocoinSpend(tx, &publicSpend, pindex, hashBlock))
+                    vSpends.emplace_back(std::make_pair(*publicSpend, tx.GetHash()));
+                    if (!ContextualCheckZerocoinSpend(tx, publicSpend.get(), pindex, hashBlock))
                         return state.DoS(100, error("%s: failed to add block %s with invalid public zc spend", __func__, tx.GetHash().GetHex()), REJECT_INVALID);
                 } else {
-                    libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
-                    nValueIn += spend.getDenomination() * COIN;
+                    std::shared_ptr<const libzerocoin::CoinSpend> spend = TxInToZerocoinSpend(tx, i);
+                    nValueIn += spend->getDenomination() * COIN;
                     //queue for db write after the 'justcheck' section has concluded
-                    vSpends.emplace_back(std::make_pair(spend, tx.GetHash()));
-                    if (!ContextualCheckZerocoinSpend(tx, &spend, pindex, hashBlock))
+                    vSpends.emplace_back(std::make_pair(*spend, tx.GetHash()));
+                    if (!ContextualCheckZerocoinSpend(tx, spend.get(), pindex, hashBlock))
                         return state.DoS(100, error("%s: failed to add block %s with invalid zerocoinspend", __func__, tx.GetHash().GetHex()), REJECT_INVALID);
                 }
             }
@@ -3454,6 +3693,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     int64_t nTime1 = GetTimeMicros();
     nTimeConnect += nTime1 - nTimeStart;
     LogPrint("bench", "      - Connect %u transactions: %.2fms (%.3fms/tx, %.3fms/txin) [%.2fs]\n", (unsigned)block.vtx.size(), 0.001 * (nTime1 - nTimeStart), 0.001 * (nTime1 - nTimeStart) / block.vtx.size(), nInputs <= 1 ? 0 : 0.001 * (nTime1 - nTimeStart) / (nInputs - 1), nTimeConnect * 0.000001);
+    if (!vSpends.empty())
+        LogPrint("bench", "      - Zerocoin spend cache: %u parses avoided, %u inputs parsed [since startup]\n", zerocoinSpendCache.GetHits(), zerocoinSpendCache.GetMisses());
 
     //Check that the block does not overmint
     if (!IsBlockValueValid(block, nExpectedMint, pindex->nMint)) {
@@ -3461,6 +3702,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
                                     FormatMoney(pindex->nMint), FormatMoney(nExpectedMint)),
                          REJECT_INVALID, "bad-cb-amount");
     }
+    int64_t nTimePaymentsEnd = GetTimeMicros();
+    nTimePayments += nTimePaymentsEnd - nTime1;
+    LogPrint("bench", "      - Block value check: %.2fms [%.2fs]\n", 0.001 * (nTimePaymentsEnd - nTime1), nTimePayments * 0.000001);
 
     // Ensure that accumulator checkpoints are valid and in the same state as this instance of the chain
     AccumulatorMap mapAccumulators(Params().Zerocoin_Params(pindex->nHeight < Params().Zerocoin_Block_V2_Start()));
@@ -3472,6 +3716,9 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         return error("%s: Failed to validate accumulator checkpoint for block=%s height=%d because wallet is shutting down", __func__,
                 block.GetHash().GetHex(), pindex->nHeight);
     }
+    int64_t nTimeAccumulatorsEnd = GetTimeMicros();
+    nTimeAccumulators += nTimeAccumulatorsEnd - nTimePaymentsEnd;
+    LogPrint("bench", "      - Accumulator checkpoint: %.2fms [%.2fs]\n", 0.001 * (nTimeAccumulatorsEnd - nTimePaymentsEnd), nTimeAccumulators * 0.000001);
 
     if (!control.Wait())
         return state.DoS(100, error("%s: CheckQueue failed", __func__), REJECT_INVALID, "block-validation-failed");
@@ -3533,6 +3780,8 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Flush spend/mint info to disk
     if (!zerocoinDB->WriteCoinSpendBatch(vSpends)) return state.Abort(("Failed to record coin serials to database"));
     if (!zerocoinDB->WriteCoinMintBatch(vMints)) return state.Abort(("Failed to record new mints to database"));
+    if (!IndexBlockPubcoins(block, pindex)) return state.Abort(("Failed to index block pubcoins"));
+    if (!IndexZerocoinBlock(block, pindex)) return state.Abort(("Failed to write zerocoin block index"));
 
     //Record accumulator checksums
     DatabaseChecksums(mapAccumulators);
@@ -3610,7 +3859,9 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
                 std::vector<const CBlockIndex*> vBlocks;
                 vBlocks.reserve(setDirtyBlockIndex.size());
                 for (std::set<CBlockIndex*>::iterator it = setDirtyBlockIndex.begin(); it != setDirtyBlockIndex.end(); ) {
-                    vBlocks.push_back(*it);
+                    // PoS headers without their block are kept in memory only, they are written once it is in
+                    if (!mapPoSHeadersWithoutData.count((*it)->GetBlockHash()))
+                        vBlocks.push_back(*it);
                     setDirtyBlockIndex.erase(it++);
                 }
                 if (!pblocktree->WriteBatchSync(vFiles, nLastBlockFile, vBlocks)) {
@@ -3803,6 +4054,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     for (const CTransaction& tx : pblock->vtx) {
         SyncWithWallets(tx, pblock);
     }
+    UpdateOrphansForBlock(*pblock);
 
     int64_t nTime6 = GetTimeMicros();
     nTimePostConnect += nTime6 - nTime5;
@@ -4178,6 +4430,46 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex)
     return true;
 }
 
+/** Fill in the stake fields of a block index entry. They need the block's transactions, so an entry made
+ *  from a header alone gets them once its block arrives, after its parent's. */
+void static SetBlockIndexStakeData(CBlockIndex* pindexNew, const CBlock& block)
+{
+    const uint256 hash = block.GetHash();
+    if (block.IsProofOfStake()) {
+        pindexNew->SetProofOfStake();
+        pindexNew->prevoutStake = block.vtx[1].vin[0].prevout;
+        pindexNew->nStakeTime = block.nTime;
+    }
+
+    // ppcoin: compute chain trust score
+    pindexNew->bnChainTrust = (pindexNew->pprev ? pindexNew->pprev->bnChainTrust : 0) + pindexNew->GetBlockTrust();
+
+    // ppcoin: compute stake entropy bit for stake modifier
+    if (!pindexNew->SetStakeEntropyBit(pindexNew->GetStakeEntropyBit()))
+        LogPrintf("AddToBlockIndex() : SetStakeEntropyBit() failed \n");
+
+    // ppcoin: record proof-of-stake hash value
+    if (pindexNew->IsProofOfStake()) {
+        if (!mapProofOfStake.count(hash))
+            LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
+        pindexNew->hashProofOfStake = mapProofOfStake[hash];
+    }
+
+    if (!Params().IsStakeModifierV2(pindexNew->nHeight)) {
+        uint64_t nStakeModifier = 0;
+        bool fGeneratedStakeModifier = false;
+        if (!ComputeNextStakeModifier(pindexNew->pprev, nStakeModifier, fGeneratedStakeModifier))
+            LogPrintf("AddToBlockIndex() : ComputeNextStakeModifier() failed \n");
+        pindexNew->SetStakeModifier(nStakeModifier, fGeneratedStakeModifier);
+        pindexNew->nStakeModifierChecksum = GetStakeModifierChecksum(pindexNew);
+        if (!CheckStakeModifierCheckpoints(pindexNew->nHeight, pindexNew->nStakeModifierChecksum))
+            LogPrintf("AddToBlockIndex() : Rejected by stake modifier checkpoint height=%d, modifier=%s \n", pindexNew->nHeight, std::to_string(nStakeModifier));
+    } else {
+        // compute v2 stake modifier
+        pindexNew->nStakeModifierV2 = ComputeStakeModifier(pindexNew->pprev, block.vtx[1].vin[0].prevout.hash);
+    }
+}
+
 CBlockIndex* AddToBlockIndex(const CBlock& block)
 {
     // Check for duplicate
@@ -4205,33 +4497,9 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         //update previous block pointer
         pindexNew->pprev->pnext = pindexNew;
 
-        // ppcoin: compute chain trust score
-        pindexNew->bnChainTrust = (pindexNew->pprev ? pindexNew->pprev->bnChainTrust : 0) + pindexNew->GetBlockTrust();
-
-        // ppcoin: compute stake entropy bit for stake modifier
-        if (!pindexNew->SetStakeEntropyBit(pindexNew->GetStakeEntropyBit()))
-            LogPrintf("AddToBlockIndex() : SetStakeEntropyBit() failed \n");
-
-        // ppcoin: record proof-of-stake hash value
-        if (pindexNew->IsProofOfStake()) {
-            if (!mapProofOfStake.count(hash))
-                LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
-            pindexNew->hashProofOfStake = mapProofOfStake[hash];
-        }
-
-        if (!Params().IsStakeModifierV2(pindexNew->nHeight)) {
-            uint64_t nStakeModifier = 0;
-            bool fGeneratedStakeModifier = false;
-            if (!ComputeNextStakeModifier(pindexNew->pprev, nStakeModifier, fGeneratedStakeModifier))
-                LogPrintf("AddToBlockIndex() : ComputeNextStakeModifier() failed \n");
-            pindexNew->SetStakeModifier(nStakeModifier, fGeneratedStakeModifier);
-            pindexNew->nStakeModifierChecksum = GetStakeModifierChecksum(pindexNew);
-            if (!CheckStakeModifierCheckpoints(pindexNew->nHeight, pindexNew->nStakeModifierChecksum))
-                LogPrintf("AddToBlockIndex() : Rejected by stake modifier checkpoint height=%d, modifier=%s \n", pindexNew->nHeight, std::to_string(nStakeModifier));
-        } else {
-            // compute v2 stake modifier
-            pindexNew->nStakeModifierV2 = ComputeStakeModifier(pindexNew->pprev, block.vtx[1].vin[0].prevout.hash);
-        }
+        // Headers-only entries get these in AcceptBlock
+        if (!block.vtx.empty())
+            SetBlockIndexStakeData(pindexNew, block);
     }
     pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
     pindexNew->RaiseValidity(BLOCK_VALID_TREE);
@@ -4250,6 +4518,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
 /** Mark a block as having its data received and checked (up to BLOCK_VALID_TRANSACTIONS). */
 bool ReceivedBlockTransactions(const CBlock& block, CValidationState& state, CBlockIndex* pindexNew, const CDiskBlockPos& pos)
 {
+    ForgetPoSHeaderWithoutData(pindexNew->GetBlockHash());
     if (block.IsProofOfStake())
         pindexNew->SetProofOfStake();
     pindexNew->nTx = block.vtx.size();
@@ -4461,6 +4730,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
 
     // ----------- swiftTX transaction scanning -----------
     if (IsSporkActive(SPORK_3_SWIFTTX_BLOCK_FILTERING)) {
+        LOCK(cs_swifttx);
         for (const CTransaction& tx : block.vtx) {
             if (!tx.IsCoinBase()) {
                 //only reject blocks when it's based on complete consensus
@@ -4500,11 +4770,14 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         // The case also exists that the sending peer could not have enough data to see
         // that this block is invalid, so don't issue an outright ban.
         if (nHeight != 0 && !IsInitialBlockDownload()) {
+            // Only timed here: the payee check is skipped during sync and reindex
+            int64_t nTimePayeeStart = GetTimeMicros();
             if (!IsBlockPayeeValid(block, nHeight)) {
                 mapRejectedBlocks.insert(std::make_pair(block.GetHash(), GetTime()));
                 return state.DoS(0, error("%s : Couldn't find masternode/budget payment", __func__),
                         REJECT_INVALID, "bad-cb-payee");
             }
+            LogPrint("bench", "  - Block payee check: %.2fms\n", 0.001 * (GetTimeMicros() - nTimePayeeStart));
         } else {
             if (fDebug)
                 LogPrintf("%s: Masternode payment check skipped on sync - skipping IsBlockPayeeValid()\n", __func__);
@@ -4516,42 +4789,56 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     std::vector<CBigNum> vBlockSerials;
     // TODO: Check if this is ok... blockHeight is always the tip or should we look for the prevHash and get the height?
     int blockHeight = chainActive.Height() + 1;
+    // Serial number SoKs of all the block's spends are verified together after the loop
+    libzerocoin::SerialNumberSoKBatch sokBatch;
+    std::vector<uint256> vSoKBatchTx;
     for (const CTransaction& tx : block.vtx) {
         if (!CheckTransaction(
                 tx,
                 fZerocoinActive,
                 blockHeight >= Params().Zerocoin_Block_EnforceSerialRange(),
                 state,
-                isBlockBetweenFakeSerialAttackRange(blockHeight)
+                isBlockBetweenFakeSerialAttackRange(blockHeight),
+                &sokBatch
         ))
             return error("%s : CheckTransaction failed", __func__);
+        vSoKBatchTx.resize(sokBatch.size(), tx.GetHash());
 
         // double check that there are no double spent zPIV spends in this block
         if (tx.HasZerocoinSpendInputs()) {
-            for (const CTxIn& txIn : tx.vin) {
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                const CTxIn& txIn = tx.vin[i];
                 bool isPublicSpend = txIn.IsZerocoinPublicSpend();
                 if (txIn.IsZerocoinSpend() || isPublicSpend) {
-                    libzerocoin::CoinSpend spend;
+                    std::shared_ptr<const libzerocoin::CoinSpend> spend;
                     if (isPublicSpend) {
-                        libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-                        PublicCoinSpend publicSpend(params);
-                        if (!ZPIVModule::ParseZerocoinPublicSpend(txIn, tx, state, publicSpend)){
+                        std::shared_ptr<const PublicCoinSpend> publicSpend;
+                        if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend)){
                             return false;
                         }
                         spend = publicSpend;
                     } else {
-                        spend = TxInToZerocoinSpend(txIn);
+                        spend = TxInToZerocoinSpend(tx, i);
                     }
-                    if (std::count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
+                    if (std::count(vBlockSerials.begin(), vBlockSerials.end(), spend->getCoinSerialNumber()))
                         return state.DoS(100, error("%s : Double spending of zPIV serial %s in block\n Block: %s",
-                                                    __func__, spend.getCoinSerialNumber().GetHex(), block.ToString()));
-                    vBlockSerials.emplace_back(spend.getCoinSerialNumber());
+                                                    __func__, spend->getCoinSerialNumber().GetHex(), block.ToString()));
+                    vBlockSerials.emplace_back(spend->getCoinSerialNumber());
                 }
             }
         }
     }
 
 
+    if (sokBatch.size()) {
+        int64_t nTimeSoKStart = GetTimeMicros();
+        std::vector<size_t> vFailed;
+        bool fSoKValid = sokBatch.Verify(&vFailed);
+        LogPrint("bench", "  - Verify %u zerocoin spend SoKs: %.2fms\n", sokBatch.size(), 0.001 * (GetTimeMicros() - nTimeSoKStart));
+        if (!fSoKValid)
+            return state.DoS(100, error("%s : zerocoin spend in tx %s did not verify", __func__, vSoKBatchTx[vFailed.front()].GetHex()));
+    }
+
     unsigned int nSigOps = 0;
     for (const CTransaction& tx : block.vtx) {
         nSigOps += GetLegacySigOpCount(tx);
@@ -4564,14 +4851,17 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     return true;
 }
 
-bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
+bool CheckWork(const CBlockHeader& block, CBlockIndex* const pindexPrev)
 {
     if (pindexPrev == NULL)
         return error("%s : null pindexPrev for block %s", __func__, block.GetHash().GetHex());
 
     unsigned int nBitsRequired = GetNextWorkRequired(pindexPrev, &block);
 
-    if ((Params().NetworkID() != CBaseChainParams::REGTEST) && block.IsProofOfWork() && (pindexPrev->nHeight + 1 <= 512)) {
+    // Blocks up to the last PoW block are PoW and all later ones PoS (enforced in ConnectBlock),
+    // so this only needs the header.
+    const bool fProofOfWork = pindexPrev->nHeight + 1 <= Params().LAST_POW_BLOCK();
+    if ((Params().NetworkID() != CBaseChainParams::REGTEST) && fProofOfWork && (pindexPrev->nHeight + 1 <= 512)) {
         double n1 = ConvertBitsToDouble(block.nBits);
         double n2 = ConvertBitsToDouble(nBitsRequired);
 
@@ -4605,10 +4895,17 @@ bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& sta
 
     int nHeight = pindexPrev->nHeight + 1;
 
-    if ((Params().NetworkID() == CBaseChainParams::REGTEST) && block.nBits != GetNextWorkRequired(pindexPrev, &block))
+    if (!CheckWork(block, pindexPrev))
         return state.DoS(100, error("%s : incorrect proof of work", __func__),
                 REJECT_INVALID, "bad-diffbits");
 
+    // Headers arrive well ahead of their blocks, so the future drift is checked here too
+    const bool fProofOfStake = nHeight > Params().LAST_POW_BLOCK();
+    if (Params().NetworkID() != CBaseChainParams::REGTEST &&
+            block.GetBlockTime() > Params().MaxFutureBlockTime(GetAdjustedTime(), fProofOfStake))
+        return state.Invalid(error("%s : block timestamp too far in the future", __func__),
+            REJECT_INVALID, "time-too-new");
+
 
     //If this is a reorg, check that it is not too deep
     int nMaxReorgDepth = GetArg("-maxreorg", Params().MaxReorganizationDepth());
@@ -4738,6 +5035,10 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex
 
     }
 
+    // Up to the last PoW block the header carries its own proof, later ones are checked against their stake with the block
+    if (pindexPrev && pindexPrev->nHeight + 1 <= Params().LAST_POW_BLOCK() && !CheckProofOfWork(hash, block.nBits))
+        return state.DoS(50, error("%s : proof of work failed", __func__), REJECT_INVALID, "high-hash");
+
     if (!ContextualCheckBlockHeader(block, state, pindexPrev))
         return false;
 
@@ -4799,6 +5100,9 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
             mapProofOfStake.insert(std::make_pair(hash, hashProofOfStake));
     }
 
+    // A header synced ahead of the block left an entry without stake data
+    const bool fHeaderKnown = mapBlockIndex.count(block.GetHash()) > 0;
+
     if (!AcceptBlockHeader(block, state, &pindex))
         return false;
 
@@ -4817,6 +5121,11 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
         return false;
     }
 
+    if (fHeaderKnown && pindex->pprev) {
+        SetBlockIndexStakeData(pindex, block);
+        setDirtyBlockIndex.insert(pindex);
+    }
+
     int nHeight = pindex->nHeight;
     int splitHeight = -1;
 
@@ -4849,7 +5158,8 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
 
         std::vector<CBigNum> inBlockSerials;
         for (const CTransaction& tx : block.vtx) {
-            for (const CTxIn& in: tx.vin) {
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                const CTxIn& in = tx.vin[i];
                 if(nHeight >= Params().Zerocoin_StartHeight()) {
                     bool isPublicSpend = in.IsZerocoinPublicSpend();
                     bool isPrivZerocoinSpend = in.IsZerocoinSpend();
@@ -4860,23 +5170,22 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
                             return false;
                         }
 
-                        libzerocoin::CoinSpend spend;
+                        std::shared_ptr<const libzerocoin::CoinSpend> spend;
                         if (isPublicSpend) {
-                            libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-                            PublicCoinSpend publicSpend(params);
-                            if (!ZPIVModule::ParseZerocoinPublicSpend(in, tx, state, publicSpend)){
+                            std::shared_ptr<const PublicCoinSpend> publicSpend;
+                            if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend)){
                                 return false;
                             }
                             spend = publicSpend;
                         } else {
-                            spend = TxInToZerocoinSpend(in);
+                            spend = TxInToZerocoinSpend(tx, i);
                         }
                         // Check for serials double spending in the same block
-                        if (std::find(inBlockSerials.begin(), inBlockSerials.end(), spend.getCoinSerialNumber()) !=
+                        if (std::find(inBlockSerials.begin(), inBlockSerials.end(), spend->getCoinSerialNumber()) !=
                             inBlockSerials.end()) {
                             return state.DoS(100, error("%s: serial double spent on the same block", __func__));
                         }
-                        inBlockSerials.push_back(spend.getCoinSerialNumber());
+                        inBlockSerials.push_back(spend->getCoinSerialNumber());
                     }
                 }
                 if(tx.IsCoinStake()) continue;
@@ -5113,7 +5422,10 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
         //if we get this far, check if the prev block is our prev block, if not then request sync and return false
         BlockMap::iterator mi = mapBlockIndex.find(pblock->hashPrevBlock);
         if (mi == mapBlockIndex.end()) {
-            pfrom->PushMessage("getblocks", chainActive.GetLocator(), uint256(0));
+            if (UseHeadersFirst(pfrom))
+                pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), pblock->GetHash());
+            else
+                pfrom->PushMessage("getblocks", chainActive.GetLocator(), uint256(0));
             return false;
         }
     }
@@ -5168,6 +5480,14 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
     if (!ActivateBestChain(state, pblock, checked))
         return error("%s : ActivateBestChain failed", __func__);
 
+    // Orphans waiting for the transactions of the new blocks, a batch per lock so that peers are not held up
+    bool fMoreOrphans = true;
+    while (fMoreOrphans) {
+        LOCK(cs_main);
+        ProcessOrphanTx(queueOrphanWork, ORPHAN_TX_REPROCESS_BATCH);
+        fMoreOrphans = !queueOrphanWork.empty();
+    }
+
     if (!fLiteMode) {
         if (masternodeSync.RequestedMasternodeAssets > MASTERNODE_SYNC_LIST) {
             obfuScationPool.NewBlock();
@@ -5192,6 +5512,161 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
     return true;
 }
 
+/** Keep a block whose parent is only known by its header until the parent's data is in, as accepting a block
+ *  needs its parent in place (stake input and modifier). Only blocks requested from nodeid, whose header was
+ *  accepted already and whose transactions match it, are kept. Returns false if the block can be processed now. */
+bool static HoldBlockForParent(NodeId nodeid, const CBlock& block)
+{
+    LOCK(cs_main);
+    BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+    if (mi == mapBlockIndex.end() || (mi->second->nStatus & (BLOCK_HAVE_DATA | BLOCK_FAILED_MASK)))
+        return false;
+
+    // Only downloads get this far ahead, anything else would take the room of the blocks asked for
+    const uint256 hash = block.GetHash();
+    std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != nodeid) {
+        LogPrint("net", "%s : unrequested block %s ahead of its parent from peer=%d\n", __func__, hash.GetHex(), nodeid);
+        Misbehaving(nodeid, 20);
+        return true;
+    }
+    BlockMap::iterator miBlock = mapBlockIndex.find(hash);
+    if (miBlock == mapBlockIndex.end() || (miBlock->second->nStatus & BLOCK_FAILED_MASK)) {
+        MarkBlockAsReceived(hash);
+        LogPrint("net", "%s : block %s from peer=%d has no accepted header\n", __func__, hash.GetHex(), nodeid);
+        return true;
+    }
+    bool fMutated = false;
+    if (block.BuildMerkleTree(&fMutated) != block.hashMerkleRoot || fMutated) {
+        // Stays in flight, the download times out if the peer doesn't send the real block
+        LogPrint("net", "%s : block %s from peer=%d does not match its header\n", __func__, hash.GetHex(), nodeid);
+        Misbehaving(nodeid, 20);
+        return true;
+    }
+
+    MarkBlockAsReceived(hash);
+    if (setBlocksWaitingForParent.count(hash))
+        return true;
+
+    unsigned int nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    if (nBlocksWaitingForParentSize + nSize > MAX_BLOCKS_WAITING_FOR_PARENT_SIZE) {
+        // Dropped, it is requested again once the blocks before it are in
+        LogPrint("net", "%s : no room for block %s from peer=%d, dropping it\n", __func__, hash.GetHex(), nodeid);
+        return true;
+    }
+
+    CBlockWaitingForParent entry;
+    entry.block = std::make_shared<CBlock>(block);
+    entry.nodeid = nodeid;
+    entry.nSize = nSize;
+    mapBlocksWaitingForParent.insert(std::make_pair(block.hashPrevBlock, entry));
+    setBlocksWaitingForParent.insert(hash);
+    nBlocksWaitingForParentSize += nSize;
+    LogPrint("net", "%s : block %s (%d) from peer=%d waits for its parent\n", __func__, hash.GetHex(), mi->second->nHeight + 1, nodeid);
+    return true;
+}
+
+/** Process the blocks that were waiting for this one, then the ones waiting for those. */
+void static ProcessBlocksWaitingFor(const uint256& hashParent)
+{
+    std::deque<uint256> queueParents;
+    queueParents.push_back(hashParent);
+    while (!queueParents.empty()) {
+        const uint256 hashPrev = queueParents.front();
+        queueParents.pop_front();
+
+        std::vector<CBlockWaitingForParent> vChildren;
+        {
+            LOCK(cs_main);
+            auto range = mapBlocksWaitingForParent.equal_range(hashPrev);
+            for (auto it = range.first; it != range.second; ++it) {
+                vChildren.push_back(it->second);
+                setBlocksWaitingForParent.erase(it->second.block->GetHash());
+                nBlocksWaitingForParentSize -= it->second.nSize;
+            }
+            mapBlocksWaitingForParent.erase(range.first, range.second);
+
+            // A parent that didn't make it takes its descendants with it, they are fetched again if still wanted
+            BlockMap::iterator mi = mapBlockIndex.find(hashPrev);
+            if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA) || (mi->second->nStatus & BLOCK_FAILED_MASK)) {
+                for (const CBlockWaitingForParent& child : vChildren)
+                    queueParents.push_back(child.block->GetHash());
+                continue;
+            }
+
+            for (const CBlockWaitingForParent& child : vChildren)
+                mapBlockSource[child.block->GetHash()] = child.nodeid;
+        }
+
+        for (const CBlockWaitingForParent& child : vChildren) {
+            CValidationState state;
+            ProcessNewBlock(state, nullptr, child.block.get());
+            int nDoS;
+            if (state.IsInvalid(nDoS) && nDoS > 0) {
+                LOCK(cs_main);
+                Misbehaving(child.nodeid, nDoS);
+            }
+            queueParents.push_back(child.block->GetHash());
+        }
+    }
+}
+
+/** Remove the PoS headers whose block never arrived and that are now too deep to reorganize to from the block
+ *  index, so headers without proof can't pile up in it. Only entries nothing else refers to are removed. */
+void static PrunePoSHeadersWithoutData()
+{
+    AssertLockHeld(cs_main);
+    const int nHeightStale = chainActive.Height() - GetArg("-maxreorg", Params().MaxReorganizationDepth());
+
+    std::map<CBlockIndex*, int> mapChildren;
+    std::vector<CBlockIndex*> vStale;
+    for (const std::pair<const uint256, NodeId>& entry : mapPoSHeadersWithoutData) {
+        BlockMap::iterator mi = mapBlockIndex.find(entry.first);
+        if (mi == mapBlockIndex.end())
+            continue;
+        mapChildren[mi->second->pprev]++;
+        if (mi->second->nHeight <= nHeightStale)
+            vStale.push_back(mi->second);
+    }
+    if (vStale.empty())
+        return;
+
+    // Children first, so each one removed is a leaf
+    std::sort(vStale.begin(), vStale.end(), [](const CBlockIndex* a, const CBlockIndex* b) { return a->nHeight > b->nHeight; });
+    int nPruned = 0;
+    for (CBlockIndex* pindex : vStale) {
+        const uint256 hash = pindex->GetBlockHash();
+        if (mapChildren.count(pindex) || (pindex->nStatus & BLOCK_HAVE_DATA) || mapBlocksInFlight.count(hash) ||
+                mapBlocksUnlinked.count(pindex) || mapBlocksWaitingForParent.count(hash))
+            continue;
+
+        for (std::pair<const NodeId, CNodeState>& item : mapNodeState) {
+            if (item.second.pindexBestKnownBlock == pindex)
+                item.second.pindexBestKnownBlock = pindex->pprev;
+            if (item.second.pindexLastCommonBlock == pindex)
+                item.second.pindexLastCommonBlock = pindex->pprev;
+        }
+        if (pindexBestHeader == pindex)
+            pindexBestHeader = pindex->pprev;
+        if (pindexBestInvalid == pindex)
+            pindexBestInvalid = NULL;
+        if (pindex->pprev->pnext == pindex)
+            pindex->pprev->pnext = NULL;
+        if (--mapChildren[pindex->pprev] == 0)
+            mapChildren.erase(pindex->pprev);
+
+        ForgetPoSHeaderWithoutData(hash);
+        setDirtyBlockIndex.erase(pindex);
+        mapBlockIndex.erase(hash);
+        delete pindex;
+        nPruned++;
+    }
+    if (pindexBestHeader->nChainWork < chainActive.Tip()->nChainWork)
+        pindexBestHeader = chainActive.Tip();
+
+    LogPrint("net", "%s : removed %d PoS headers without their block below height %d\n", __func__, nPruned, nHeightStale);
+}
+
 bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex* const pindexPrev, bool fCheckPOW, bool fCheckMerkleRoot)
 {
     AssertLockHeld(cs_main);
@@ -5505,6 +5980,10 @@ void UnloadBlockIndex()
     mempool.clear();
     mapOrphanTransactions.clear();
     mapOrphanTransactionsByPrev.clear();
+    nOrphanTxSize = 0;
+    mapOrphanTxSizeByPeer.clear();
+    queueOrphanWork.clear();
+    filteredBlockCache.Clear();
     nSyncStarted = 0;
     mapBlocksUnlinked.clear();
     vinfoBlockFile.clear();
@@ -5878,9 +6357,19 @@ bool static AlreadyHave(const CInv& inv)
 {
     switch (inv.type) {
     case MSG_TX: {
+        assert(recentRejects);
+        if (chainActive.Tip()->GetBlockHash() != hashRecentRejectsChainTip) {
+            // If the chain tip has changed previously rejected transactions
+            // might be now valid, e.g. due to a nLockTime'd tx becoming valid,
+            // or a double-spend. Reset the rejects filter and give those
+            // txs a second chance.
+            hashRecentRejectsChainTip = chainActive.Tip()->GetBlockHash();
+            recentRejects->reset();
+        }
+
         bool txInMap = false;
         txInMap = mempool.exists(inv.hash);
-        return txInMap || mapOrphanTransactions.count(inv.hash) ||
+        return recentRejects->contains(inv.hash) || txInMap || mapOrphanTransactions.count(inv.hash) ||
                pcoinsTip->HaveCoins(inv.hash);
     }
     case MSG_DSTX:
@@ -5888,11 +6377,15 @@ bool static AlreadyHave(const CInv& inv)
     case MSG_PUBCOINS:
     case MSG_BLOCK:
         return mapBlockIndex.count(inv.hash);
-    case MSG_TXLOCK_REQUEST:
+    case MSG_TXLOCK_REQUEST: {
+        LOCK(cs_swifttx);
         return mapTxLockReq.count(inv.hash) ||
                mapTxLockReqRejected.count(inv.hash);
-    case MSG_TXLOCK_VOTE:
+    }
+    case MSG_TXLOCK_VOTE: {
+        LOCK(cs_swifttx);
         return mapTxLockVote.count(inv.hash);
+    }
     case MSG_SPORK:
         return mapSporks.count(inv.hash);
     case MSG_MASTERNODE_WINNER:
@@ -5939,6 +6432,24 @@ bool static AlreadyHave(const CInv& inv)
 }
 
 
+/**
+ * Whether pfrom may have transactions matched against its bloom filter now. The allowance refills at
+ * MAX_FILTER_WORK_RATE up to MAX_FILTER_WORK_BURST, and a large request that takes it below zero is
+ * paid back before the next one is served. Whitelisted peers are not limited. Requires pfrom->cs_filter.
+ */
+static bool HasFilterWork(CNode* pfrom, int64_t nNow)
+{
+    if (pfrom->fWhitelisted)
+        return true;
+    // In steps of at least 10ms, so that rounding does not eat the allowance
+    int64_t nElapsed = std::min(nNow - pfrom->nFilterWorkTime, (int64_t)3600 * 1000000);
+    if (nElapsed >= 10000) {
+        pfrom->nFilterWorkTime = nNow;
+        pfrom->nFilterWork = std::min(pfrom->nFilterWork + MAX_FILTER_WORK_RATE * nElapsed / 1000000, MAX_FILTER_WORK_BURST);
+    }
+    return pfrom->nFilterWork > 0;
+}
+
 void static ProcessGetData(CNode* pfrom)
 {
     std::deque<CInv>::iterator it = pfrom->vRecvGetData.begin();
@@ -5948,16 +6459,27 @@ void static ProcessGetData(CNode* pfrom)
     LOCK(cs_main);
 
     while (it != pfrom->vRecvGetData.end()) {
-        // Don't bother if send buffer is too full to respond anyway
+        // Don't bother if send buffer is too full to respond anyway. The capped classes count here, the
+        // blocks asked for would pile up in them otherwise
         if (pfrom->nSendSize >= SendBufferSize())
             break;
 
+        // Filtered blocks wait for the filter work allowance of the peer to refill
+        if (it->type == MSG_FILTERED_BLOCK) {
+            LOCK(pfrom->cs_filter);
+            int64_t nNow = GetTimeMicros();
+            if (!HasFilterWork(pfrom, nNow)) {
+                pfrom->nNextGetDataTime = nNow + std::max((1 - pfrom->nFilterWork) * 1000000 / MAX_FILTER_WORK_RATE, (int64_t)10000);
+                break;
+            }
+        }
+
         const CInv& inv = *it;
         {
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) {
                 bool send = false;
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash);
                 if (mi != mapBlockIndex.end()) {
@@ -5976,17 +6498,35 @@ void static ProcessGetData(CNode* pfrom)
                 }
                 // Don't send not-validated blocks
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
-                    // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
-                        assert(!"cannot load block from disk");
+                    // Send block from disk, a filtered one from the blocks already parsed for the filters when it is there
+                    std::shared_ptr<const CFilteredBlock> pfilteredBlock;
+                    if (inv.type == MSG_FILTERED_BLOCK)
+                        pfilteredBlock = filteredBlockCache.Get(inv.hash);
+                    CBlock blockRead;
+                    if (!pfilteredBlock) {
+                        if (!ReadBlockFromDisk(blockRead, (*mi).second))
+                            assert(!"cannot load block from disk");
+                        if (inv.type == MSG_FILTERED_BLOCK)
+                            pfilteredBlock = filteredBlockCache.Add(blockRead);
+                    }
+                    const CBlock& block = pfilteredBlock ? pfilteredBlock->block : blockRead;
+                    const char* pszSent = "block";
                     if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    else if (inv.type == MSG_CMPCT_BLOCK) {
+                        // The peer would be missing most transactions of an older block
+                        if (mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+                            pfrom->PushMessage("cmpctblock", CBlockHeaderAndShortTxIDs(block));
+                            pszSent = "cmpctblock";
+                        } else
+                            pfrom->PushMessage("block", block);
+                    } else // MSG_FILTERED_BLOCK)
                     {
+                        pszSent = "merkleblock";
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
-                            CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+                            CMerkleBlock merkleBlock(*pfilteredBlock, *pfrom->pfilter);
+                            pfrom->nFilterWork -= block.vtx.size();
                             pfrom->PushMessage("merkleblock", merkleBlock);
                             // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
                             // This avoids hurting performance by pointlessly requiring a round-trip
@@ -5996,7 +6536,7 @@ void static ProcessGetData(CNode* pfrom)
                             // however we MUST always provide at least what the remote peer needs
                             typedef std::pair<unsigned int, uint256> PairType;
                             for (PairType& pair : merkleBlock.vMatchedTxn)
-                                if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
+                                if (!pfrom->filterInventoryKnown.contains(CInv(MSG_TX, pair.second)))
                                     pfrom->PushMessage("tx", block.vtx[pair.first]);
                         }
                         // else
@@ -6007,10 +6547,11 @@ void static ProcessGetData(CNode* pfrom)
                     if (inv.hash == pfrom->hashContinue) {
                         // Bypass PushInventory, this must send even if redundant,
                         // and we want it right after the last block so they don't
-                        // wait for other stuff first.
+                        // wait for other stuff first. Queued with the blocks, so it
+                        // does not overtake them.
                         std::vector<CInv> vInv;
                         vInv.push_back(CInv(MSG_BLOCK, chainActive.Tip()->GetBlockHash()));
-                        pfrom->PushMessage("inv", vInv);
+                        pfrom->PushSerializedMessage(MakeSerializedNetMsg("inv", vInv), GetSendPriority(pszSent));
                         pfrom->hashContinue = 0;
                     }
                 }
@@ -6019,9 +6560,9 @@ void static ProcessGetData(CNode* pfrom)
                 bool pushed = false;
                 {
                     LOCK(cs_mapRelay);
-                    std::map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
+                    std::map<CInv, CSerializedNetMsg>::iterator mi = mapRelay.find(inv);
                     if (mi != mapRelay.end()) {
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second);
+                        pfrom->PushSerializedMessage((*mi).second);
                         pushed = true;
                     }
                 }
@@ -6080,19 +6621,21 @@ void static ProcessGetData(CNode* pfrom)
                 }
 
                 if (!pushed && inv.type == MSG_TXLOCK_VOTE) {
+                    LOCK(cs_swifttx);
                     if (mapTxLockVote.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapTxLockVote[inv.hash];
+                        ss << mapTxLockVote.at(inv.hash);
                         pfrom->PushMessage("txlvote", ss);
                         pushed = true;
                     }
                 }
                 if (!pushed && inv.type == MSG_TXLOCK_REQUEST) {
+                    LOCK(cs_swifttx);
                     if (mapTxLockReq.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mapTxLockReq[inv.hash];
+                        ss << mapTxLockReq.at(inv.hash);
                         pfrom->PushMessage("ix", ss);
                         pushed = true;
                     }
@@ -6110,7 +6653,7 @@ void static ProcessGetData(CNode* pfrom)
                     if (masternodePayments.mapMasternodePayeeVotes.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << masternodePayments.mapMasternodePayeeVotes[inv.hash];
+                        ss << masternodePayments.mapMasternodePayeeVotes.at(inv.hash);
                         pfrom->PushMessage("mnw", ss);
                         pushed = true;
                     }
@@ -6119,7 +6662,7 @@ void static ProcessGetData(CNode* pfrom)
                     if (budget.mapSeenMasternodeBudgetVotes.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetVotes[inv.hash];
+                        ss << budget.mapSeenMasternodeBudgetVotes.at(inv.hash);
                         pfrom->PushMessage("mvote", ss);
                         pushed = true;
                     }
@@ -6129,7 +6672,7 @@ void static ProcessGetData(CNode* pfrom)
                     if (budget.mapSeenMasternodeBudgetProposals.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenMasternodeBudgetProposals[inv.hash];
+                        ss << budget.mapSeenMasternodeBudgetProposals.at(inv.hash);
                         pfrom->PushMessage("mprop", ss);
                         pushed = true;
                     }
@@ -6139,7 +6682,7 @@ void static ProcessGetData(CNode* pfrom)
                     if (budget.mapSeenFinalizedBudgetVotes.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgetVotes[inv.hash];
+                        ss << budget.mapSeenFinalizedBudgetVotes.at(inv.hash);
                         pfrom->PushMessage("fbvote", ss);
                         pushed = true;
                     }
@@ -6149,7 +6692,7 @@ void static ProcessGetData(CNode* pfrom)
                     if (budget.mapSeenFinalizedBudgets.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << budget.mapSeenFinalizedBudgets[inv.hash];
+                        ss << budget.mapSeenFinalizedBudgets.at(inv.hash);
                         pfrom->PushMessage("fbs", ss);
                         pushed = true;
                     }
@@ -6159,7 +6702,7 @@ void static ProcessGetData(CNode* pfrom)
                     if (mnodeman.mapSeenMasternodeBroadcast.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnodeman.mapSeenMasternodeBroadcast[inv.hash];
+                        ss << mnodeman.mapSeenMasternodeBroadcast.at(inv.hash);
                         pfrom->PushMessage("mnb", ss);
                         pushed = true;
                     }
@@ -6169,7 +6712,7 @@ void static ProcessGetData(CNode* pfrom)
                     if (mnodeman.mapSeenMasternodePing.count(inv.hash)) {
                         CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
                         ss.reserve(1000);
-                        ss << mnodeman.mapSeenMasternodePing[inv.hash];
+                        ss << mnodeman.mapSeenMasternodePing.at(inv.hash);
                         pfrom->PushMessage("mnp", ss);
                         pushed = true;
                     }
@@ -6195,7 +6738,7 @@ void static ProcessGetData(CNode* pfrom)
             // Track requests for our stuff.
             GetMainSignals().Inventory(inv.hash);
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK)
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK)
                 break;
         }
     }
@@ -6215,6 +6758,39 @@ void static ProcessGetData(CNode* pfrom)
 }
 
 bool fRequestedSporksIDB = false;
+/** Process a block from pfrom whose parent is known, sent in full or rebuilt from a compact block. */
+void static ProcessReceivedBlock(CNode* pfrom, CBlock& block)
+{
+    uint256 hashBlock = block.GetHash();
+    CInv inv(MSG_BLOCK, hashBlock);
+    pfrom->AddInventoryKnown(inv);
+
+    CValidationState state;
+    BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+    if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
+        // Downloaded ahead of its parent's data, kept until that is in
+        if (HoldBlockForParent(pfrom->GetId(), block))
+            return;
+        ProcessNewBlock(state, pfrom, &block);
+        ProcessBlocksWaitingFor(hashBlock);
+        int nDoS;
+        if(state.IsInvalid(nDoS)) {
+            pfrom->PushMessage("reject", std::string("block"), state.GetRejectCode(),
+                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
+            if(nDoS > 0) {
+                TRY_LOCK(cs_main, lockMain);
+                if(lockMain) Misbehaving(pfrom->GetId(), nDoS);
+            }
+        }
+        //disconnect this node if its old protocol version
+        pfrom->DisconnectOldProtocol(ActiveProtocol(), "block");
+    } else {
+        LOCK(cs_main);
+        MarkBlockAsReceived(hashBlock);
+        LogPrint("net", "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, block.GetHash().GetHex());
+    }
+}
+
 bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     RandAddSeedPerfmon();
@@ -6392,7 +6968,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 {
                     LOCK(cs_vNodes);
                     // Use deterministic randomness to send to the same nodes for 24 hours
-                    // at a time so the setAddrKnowns of the chosen nodes prevent repeats
+                    // at a time so the addrKnowns of the chosen nodes prevent repeats
                     static uint256 hashSalt;
                     if (hashSalt == 0)
                         hashSalt = GetRandHash();
@@ -6454,9 +7030,31 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
 
             if (inv.type == MSG_BLOCK) {
                 UpdateBlockAvailability(pfrom->GetId(), inv.hash);
-                if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
-                    // Add this to the list of blocks to request
-                    vToFetch.push_back(inv);
+                if (UseHeadersFirst(pfrom)) {
+                    if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
+                        // First request the headers preceding the announced block. In the normal fully-synced
+                        // case where a new block is announced that succeeds the current tip (no reorganization),
+                        // there are no such headers.
+                        // Secondly, and only when we are close to being synced, we request the announced block directly,
+                        // to avoid an extra round-trip. Note that we must *first* ask for the headers, so by the
+                        // time the block arrives, the header chain leading up to it is already validated. Not
+                        // doing this will result in the received block being rejected as an orphan in case it is
+                        // not a direct successor.
+                        pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), inv.hash);
+                        if (chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - Params().TargetSpacing() * 20) {
+                            // A new block is mostly made of transactions we already have
+                            vToFetch.push_back(CInv(pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION ? MSG_CMPCT_BLOCK : MSG_BLOCK, inv.hash));
+                            MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
+                        }
+                        LogPrint("net", "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+                    }
+                } else if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
+                    // Add this to the list of blocks to request, as a compact block when close to being synced
+                    if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION && chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - Params().TargetSpacing() * 20) {
+                        vToFetch.push_back(CInv(MSG_CMPCT_BLOCK, inv.hash));
+                        MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
+                    } else
+                        vToFetch.push_back(inv);
                     LogPrint("net", "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
                 }
             }
@@ -6464,9 +7062,9 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             // Track requests for our stuff
             GetMainSignals().Inventory(inv.hash);
 
-            if (pfrom->nSendSize > (SendBufferSize() * 2)) {
+            if (pfrom->GetUncappedSendSize() > (SendBufferSize() * 2)) {
                 Misbehaving(pfrom->GetId(), 50);
-                return error("send buffer size() = %u", pfrom->nSendSize);
+                return error("send buffer size() = %u", pfrom->GetUncappedSendSize());
             }
         }
 
@@ -6495,7 +7093,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
-    else if (strCommand == "getblocks" || strCommand == "getheaders") {
+    else if (strCommand == "getblocks" || (strCommand == "getheaders" && !UseHeadersFirst(pfrom))) {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -6527,16 +7125,14 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
     }
 
 
-    else if (strCommand == "headers" && Params().HeadersFirstSyncingActive()) {
+    else if (strCommand == "getheaders") {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
 
         LOCK(cs_main);
 
-        if (IsInitialBlockDownload())
-            return true;
-
+        // Whatever part of the chain we have is worth serving, even while syncing ourselves
         CBlockIndex* pindex = NULL;
         if (locator.IsNull()) {
             // If locator is null, return the hashStop block
@@ -6554,8 +7150,7 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         // we must use CBlocks, as CBlockHeaders won't include the 0x00 nTx count at the end
         std::vector<CBlock> vHeaders;
         int nLimit = MAX_HEADERS_RESULTS;
-        if (fDebug)
-            LogPrintf("getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
+        LogPrint("net", "getheaders %d to %s from peer=%d\n", (pindex ? pindex->nHeight : -1), hashStop.ToString(), pfrom->id);
         for (; pindex; pindex = chainActive.Next(pindex)) {
             vHeaders.push_back(pindex->GetBlockHeader());
             if (--nLimit <= 0 || pindex->GetBlockHash() == hashStop)
@@ -6566,8 +7161,6 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
 
 
     else if (strCommand == "tx" || strCommand == "dstx") {
-        std::vector<uint256> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
         CTransaction tx;
 
         //masternode signed transaction
@@ -6630,7 +7223,6 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         if (!tx.HasZerocoinSpendInputs() && AcceptToMemoryPool(mempool, state, tx, true, &fMissingInputs, false, ignoreFees)) {
             mempool.check(pcoinsTip);
             RelayTransaction(tx);
-            vWorkQueue.push_back(inv.hash);
 
             LogPrint("mempool", "AcceptToMemoryPool: peer=%d %s : accepted %s (poolsz %u)\n",
                      pfrom->id, pfrom->cleanSubVer,
@@ -6638,49 +7230,8 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                      mempool.mapTx.size());
 
             // Recursively process any orphan transactions that depended on this one
-            std::set<NodeId> setMisbehaving;
-            for(unsigned int i = 0; i < vWorkQueue.size(); i++) {
-                std::map<uint256, std::set<uint256> >::iterator itByPrev = mapOrphanTransactionsByPrev.find(vWorkQueue[i]);
-                if(itByPrev == mapOrphanTransactionsByPrev.end())
-                    continue;
-                for(std::set<uint256>::iterator mi = itByPrev->second.begin();
-                    mi != itByPrev->second.end();
-                    ++mi) {
-                    const uint256 &orphanHash = *mi;
-                    const CTransaction &orphanTx = mapOrphanTransactions[orphanHash].tx;
-                    NodeId fromPeer = mapOrphanTransactions[orphanHash].fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if(setMisbehaving.count(fromPeer))
-                        continue;
-                    if(AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2)) {
-                        LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash.ToString());
-                        RelayTransaction(orphanTx);
-                        vWorkQueue.push_back(orphanHash);
-                        vEraseQueue.push_back(orphanHash);
-                    } else if(!fMissingInputs2) {
-                        int nDos = 0;
-                        if(stateDummy.IsInvalid(nDos) && nDos > 0) {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos);
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash.ToString());
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint("mempool", "   removed orphan tx %s\n", orphanHash.ToString());
-                        vEraseQueue.push_back(orphanHash);
-                    }
-                    mempool.check(pcoinsTip);
-                }
-            }
-
-            for (uint256 hash : vEraseQueue) EraseOrphanTx(hash);
+            std::deque<uint256> workQueue(1, inv.hash);
+            ProcessOrphanTx(workQueue, std::numeric_limits<unsigned int>::max());
 
         } else if (tx.HasZerocoinSpendInputs() && AcceptToMemoryPool(mempool, state, tx, true, &fMissingZerocoinInputs, false, ignoreFees)) {
             //Presstab: ZCoin has a bunch of code commented out here. Is this something that should have more going on?
@@ -6695,15 +7246,24 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
 
             // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
             unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+            size_t nMaxOrphanTxSize = (size_t)std::max((int64_t)0, GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000;
+            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx, nMaxOrphanTxSize);
             if (nEvicted > 0)
                 LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
-        } else if (pfrom->fWhitelisted) {
-            // Always relay transactions received from whitelisted peers, even
-            // if they are already in the mempool (allowing the node to function
-            // as a gateway for nodes hidden behind it).
+        } else {
+            // Zerocoin spends missing their mints can be accepted once the mints are in
+            if (!fMissingZerocoinInputs) {
+                assert(recentRejects);
+                recentRejects->insert(tx.GetHash());
+            }
 
-            RelayTransaction(tx);
+            if (pfrom->fWhitelisted) {
+                // Always relay transactions received from whitelisted peers, even
+                // if they are already in the mempool (allowing the node to function
+                // as a gateway for nodes hidden behind it).
+
+                RelayTransaction(tx);
+            }
         }
 
         if (strCommand == "dstx") {
@@ -6747,7 +7307,12 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
             // Nothing interesting. Stop asking this peers for more headers.
             return true;
         }
+
+        PrunePoSHeadersWithoutData();
+
+        CNodeState* nodestate = State(pfrom->GetId());
         CBlockIndex* pindexLast = NULL;
+        bool fDeferred = false;
         for (const CBlockHeader& header : headers) {
             CValidationState state;
             if (pindexLast != NULL && header.hashPrevBlock != pindexLast->GetBlockHash()) {
@@ -6755,9 +7320,21 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 return error("non-continuous headers sequence");
             }
 
-            /*TODO: this has a CBlock cast on it so that it will compile. There should be a solution for this
-             * before headers are reimplemented on mainnet
-             */
+            // A PoS header has no proof of its own: only keep it close above our tip and within the limits
+            const uint256 hashHeader = header.GetHash();
+            BlockMap::iterator miPrev = mapBlockIndex.find(header.hashPrevBlock);
+            const bool fNewPoSHeader = !mapBlockIndex.count(hashHeader) && miPrev != mapBlockIndex.end() &&
+                    miPrev->second->nHeight + 1 > Params().LAST_POW_BLOCK();
+            if (fNewPoSHeader && (miPrev->second->nHeight + 1 > chainActive.Height() + MAX_POS_HEADERS_AHEAD ||
+                    nodestate->nPoSHeadersWithoutData >= MAX_POS_HEADERS_WITHOUT_DATA_PER_PEER ||
+                    mapPoSHeadersWithoutData.size() >= MAX_POS_HEADERS_WITHOUT_DATA)) {
+                LogPrint("net", "deferring PoS headers from height %d from peer=%d\n", miPrev->second->nHeight + 1, pfrom->id);
+                nodestate->fPoSHeadersDeferred = true;
+                fDeferred = true;
+                break;
+            }
+
+            // The block has no transactions yet, its stake data is filled in by AcceptBlock when it arrives
             if (!AcceptBlockHeader((CBlock)header, state, &pindexLast)) {
                 int nDoS;
                 if (state.IsInvalid(nDoS)) {
@@ -6767,12 +7344,17 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                     return error(strError.c_str());
                 }
             }
+
+            if (fNewPoSHeader && pindexLast && !(pindexLast->nStatus & BLOCK_HAVE_DATA)) {
+                mapPoSHeadersWithoutData[hashHeader] = pfrom->GetId();
+                nodestate->nPoSHeadersWithoutData++;
+            }
         }
 
         if (pindexLast)
             UpdateBlockAvailability(pfrom->GetId(), pindexLast->GetBlockHash());
 
-        if (nCount == MAX_HEADERS_RESULTS && pindexLast) {
+        if (nCount == MAX_HEADERS_RESULTS && pindexLast && !fDeferred) {
             // Headers message had its maximum size; the peer may have more headers.
             // TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
             // from there instead.
@@ -6792,7 +7374,13 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         LogPrint("net", "received block %s peer=%d\n", inv.hash.ToString(), pfrom->id);
 
         //sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
-        if (!mapBlockIndex.count(block.hashPrevBlock)) {
+        if (!mapBlockIndex.count(block.hashPrevBlock) && UseHeadersFirst(pfrom)) {
+            // Sync the headers up to it, the block itself is downloaded afterwards
+            LOCK(cs_main);
+            MarkBlockAsReceived(hashBlock);
+            UpdateBlockAvailability(pfrom->GetId(), hashBlock);
+            pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), hashBlock);
+        } else if (!mapBlockIndex.count(block.hashPrevBlock)) {
             if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
                 //we already asked for this block, so lets work backwards and ask for the previous block
                 pfrom->PushMessage("getblocks", chainActive.GetLocator(), block.hashPrevBlock);
@@ -6803,26 +7391,148 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
                 pfrom->vBlockRequested.push_back(hashBlock);
             }
         } else {
-            pfrom->AddInventoryKnown(inv);
+            ProcessReceivedBlock(pfrom, block);
+        }
+    }
 
-            CValidationState state;
-            if (!mapBlockIndex.count(block.GetHash())) {
-                ProcessNewBlock(state, pfrom, &block);
-                int nDoS;
-                if(state.IsInvalid(nDoS)) {
-                    pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
-                                       state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-                    if(nDoS > 0) {
-                        TRY_LOCK(cs_main, lockMain);
-                        if(lockMain) Misbehaving(pfrom->GetId(), nDoS);
-                    }
+    else if (strCommand == "cmpctblock" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+        uint256 hashBlock = cmpctblock.header.GetHash();
+        LogPrint("cmpctblock", "received cmpctblock %s peer=%d\n", hashBlock.ToString(), pfrom->id);
+
+        CBlock block;
+        bool fReconstructed = false;
+        {
+            LOCK(cs_main);
+            // Compact blocks are only sent in answer to a getdata, never pushed
+            std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hashBlock);
+            if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != pfrom->GetId()) {
+                LogPrint("cmpctblock", "unrequested cmpctblock %s peer=%d\n", hashBlock.ToString(), pfrom->id);
+                return true;
+            }
+
+            BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+            if (mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
+                MarkBlockAsReceived(hashBlock);
+                return true;
+            }
+
+            if (!mapBlockIndex.count(cmpctblock.header.hashPrevBlock)) {
+                // Sync the headers or the blocks up to it, the block itself is downloaded afterwards
+                MarkBlockAsReceived(hashBlock);
+                UpdateBlockAvailability(pfrom->GetId(), hashBlock);
+                if (UseHeadersFirst(pfrom))
+                    pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), hashBlock);
+                else
+                    pfrom->PushMessage("getblocks", chainActive.GetLocator(), uint256(0));
+                return true;
+            }
+
+            std::shared_ptr<PartiallyDownloadedBlock> partialBlock = std::make_shared<PartiallyDownloadedBlock>(&mempool);
+            ReadStatus status = partialBlock->InitData(cmpctblock);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(hashBlock);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("invalid cmpctblock %s received from peer=%d", hashBlock.ToString(), pfrom->id);
+            }
+
+            BlockTransactionsRequest req;
+            if (status == READ_STATUS_OK) {
+                for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                    if (!partialBlock->IsTxAvailable(i))
+                        req.indexes.push_back(i);
                 }
-                //disconnect this node if its old protocol version
-                pfrom->DisconnectOldProtocol(ActiveProtocol(), strCommand);
-            } else {
-                LogPrint("net", "%s : Already processed block %s, skipping ProcessNewBlock()\n", __func__, block.GetHash().GetHex());
+                if (req.indexes.empty()) {
+                    status = partialBlock->FillBlock(block, std::vector<CTransaction>());
+                    fReconstructed = status == READ_STATUS_OK;
+                }
+            }
+
+            if (status != READ_STATUS_OK) {
+                // Stays in flight from this peer, which now sends it in full
+                std::vector<CInv> vGetData(1, CInv(MSG_BLOCK, hashBlock));
+                pfrom->PushMessage("getdata", vGetData);
+                return true;
+            }
+
+            if (!fReconstructed) {
+                req.blockhash = hashBlock;
+                itInFlight->second.second->partialBlock = partialBlock;
+                pfrom->PushMessage("getblocktxn", req);
+            }
+        }
+
+        if (fReconstructed)
+            ProcessReceivedBlock(pfrom, block);
+    }
+
+    else if (strCommand == "getblocktxn")
+    {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+
+        BlockMap::iterator mi = mapBlockIndex.find(req.blockhash);
+        if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("cmpctblock", "peer=%d asked transactions of block %s we don't have\n", pfrom->id, req.blockhash.ToString());
+            return true;
+        }
+
+        if (mi->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+            // Too old to be relayed as a compact block, serve it in full
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+            ProcessGetData(pfrom);
+            return true;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, mi->second))
+            return error("getblocktxn : cannot load block %s from disk", req.blockhash.ToString());
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                return error("getblocktxn with out-of-bounds tx indexes from peer=%d", pfrom->id);
+            }
+            resp.txn[i] = block.vtx[req.indexes[i]];
+        }
+        pfrom->PushMessage("blocktxn", resp);
+    }
+
+    else if (strCommand == "blocktxn" && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block;
+        {
+            LOCK(cs_main);
+            std::map<uint256, std::pair<NodeId, std::list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(resp.blockhash);
+            if (itInFlight == mapBlocksInFlight.end() || itInFlight->second.first != pfrom->GetId() || !itInFlight->second.second->partialBlock) {
+                LogPrint("cmpctblock", "peer=%d sent transactions of block %s we weren't expecting\n", pfrom->id, resp.blockhash.ToString());
+                return true;
+            }
+
+            std::shared_ptr<PartiallyDownloadedBlock> partialBlock = itInFlight->second.second->partialBlock;
+            itInFlight->second.second->partialBlock.reset();
+            ReadStatus status = partialBlock->FillBlock(block, resp.txn);
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(resp.blockhash);
+                Misbehaving(pfrom->GetId(), 100);
+                return error("invalid blocktxn for block %s received from peer=%d", resp.blockhash.ToString(), pfrom->id);
+            } else if (status == READ_STATUS_FAILED) {
+                // A short id collision, stays in flight from this peer which now sends it in full
+                std::vector<CInv> vGetData(1, CInv(MSG_BLOCK, resp.blockhash));
+                pfrom->PushMessage("getdata", vGetData);
+                return true;
             }
         }
+
+        ProcessReceivedBlock(pfrom, block);
     }
 
     else if (strCommand == "accvalue"){
@@ -6896,7 +7606,12 @@ bool static ProcessMessage(CNode* pfrom, std::string strCommand, CDataStream& vR
         LOCK2(cs_main, pfrom->cs_filter);
 
         std::vector<uint256> vtxid;
-        mempool.queryHashes(vtxid);
+        // Every transaction of the pool goes through the filter of the peer, not more often than its allowance
+        if (HasFilterWork(pfrom, GetTimeMicros()))
+            mempool.queryHashes(vtxid);
+        else
+            LogPrint("net", "ignoring mempool request from peer=%d, filter work allowance used up\n", pfrom->id);
+        pfrom->nFilterWork -= vtxid.size();
         std::vector<CInv> vInv;
         for (uint256& hash : vtxid) {
             CInv inv(MSG_TX, hash);
@@ -7147,13 +7862,14 @@ bool ProcessMessages(CNode* pfrom)
     if (!pfrom->vRecvGetData.empty())
         ProcessGetData(pfrom);
 
-    // this maintains the order of responses
-    if (!pfrom->vRecvGetData.empty()) return fOk;
+    // this maintains the order of responses, but for the consensus and masternode messages whose
+    // answers go out ahead of the requested data anyway
+    bool fGetDataWaiting = !pfrom->vRecvGetData.empty();
 
     std::deque<CNetMessage>::iterator it = pfrom->vRecvMsg.begin();
     while (!pfrom->fDisconnect && it != pfrom->vRecvMsg.end()) {
         // Don't bother if send buffer is too full to respond anyway
-        if (pfrom->nSendSize >= SendBufferSize())
+        if (pfrom->GetUncappedSendSize() >= SendBufferSize())
             break;
 
         // get next message
@@ -7168,6 +7884,9 @@ bool ProcessMessages(CNode* pfrom)
         if (!msg.complete())
             break;
 
+        if (fGetDataWaiting && GetSendPriority(msg.hdr.GetCommand()) > SEND_PRIORITY_MASTERNODE)
+            break;
+
         // at this point, any failure means we can delete the current message
         it++;
 
@@ -7191,7 +7910,7 @@ bool ProcessMessages(CNode* pfrom)
 
         // Checksum
         CDataStream& vRecv = msg.vRecv;
-        uint256 hash = Hash(vRecv.begin(), vRecv.begin() + nMessageSize);
+        uint256 hash = msg.GetMessageHash();
         unsigned int nChecksum = 0;
         memcpy(&nChecksum, &hash, sizeof(nChecksum));
         if (nChecksum != hdr.nChecksum) {
@@ -7238,7 +7957,14 @@ bool ProcessMessages(CNode* pfrom)
 }
 
 
-bool SendMessages(CNode* pto, bool fSendTrickle)
+/** Send an inventory announcement, counted in the inv stats of getnettotals. */
+void static PushInventoryMessage(CNode* pto, const std::vector<CInv>& vInv)
+{
+    pto->PushMessage("inv", vInv);
+    CNode::RecordInvSent(vInv.size(), CMessageHeader::HEADER_SIZE + ::GetSerializeSize(vInv, SER_NETWORK, PROTOCOL_VERSION));
+}
+
+bool SendMessages(CNode* pto)
 {
     {
         // Don't send anything until we get their version message
@@ -7283,9 +8009,9 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         if (!IsInitialBlockDownload() && (GetTime() - nLastRebroadcast > 24 * 60 * 60)) {
             LOCK(cs_vNodes);
             for (CNode* pnode : vNodes) {
-                // Periodically clear setAddrKnown to allow refresh broadcasts
+                // Periodically clear addrKnown to allow refresh broadcasts
                 if (nLastRebroadcast)
-                    pnode->setAddrKnown.clear();
+                    pnode->addrKnown.reset();
 
                 // Rebroadcast our address
                 AdvertiseLocal(pnode);
@@ -7297,12 +8023,14 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         //
         // Message: addr
         //
-        if (fSendTrickle) {
+        int64_t nNow = GetTimeMicros();
+        if (pto->nNextAddrSend < nNow) {
+            pto->nNextAddrSend = PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
             std::vector<CAddress> vAddr;
             vAddr.reserve(pto->vAddrToSend.size());
             for (const CAddress& addr : pto->vAddrToSend) {
-                // returns true if wasn't already contained in the set
-                if (pto->setAddrKnown.insert(addr).second) {
+                if (!pto->addrKnown.contains(addr.GetKey())) {
+                    pto->addrKnown.insert(addr.GetKey());
                     vAddr.push_back(addr);
                     // receiver rejects addr messages larger than 1000
                     if (vAddr.size() >= 1000) {
@@ -7344,13 +8072,26 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
             if (nSyncStarted == 0 || pindexBestHeader->GetBlockTime() > GetAdjustedTime() - 6 * 60 * 60) { // NOTE: was "close to today" and 24h in Bitcoin
                 state.fSyncStarted = true;
                 nSyncStarted++;
-                //CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
-                //LogPrint("net", "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
-                //pto->PushMessage("getheaders", chainActive.GetLocator(pindexStart), uint256(0));
-                pto->PushMessage("getblocks", chainActive.GetLocator(chainActive.Tip()), uint256(0));
+                if (UseHeadersFirst(pto)) {
+                    // Start one back so the peer's answer has at least our best header, marking what it has
+                    CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
+                    LogPrint("net", "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
+                    pto->PushMessage("getheaders", chainActive.GetLocator(pindexStart), uint256(0));
+                } else
+                    pto->PushMessage("getblocks", chainActive.GetLocator(chainActive.Tip()), uint256(0));
             }
         }
 
+        // Ask again for the PoS headers we turned down, once enough of their blocks are in to make room
+        if (state.fPoSHeadersDeferred && !fImporting && !fReindex &&
+                pindexBestHeader->nHeight < chainActive.Height() + MAX_POS_HEADERS_AHEAD / 2 &&
+                mapPoSHeadersWithoutData.size() < MAX_POS_HEADERS_WITHOUT_DATA / 2 &&
+                state.nPoSHeadersWithoutData < MAX_POS_HEADERS_WITHOUT_DATA_PER_PEER / 2) {
+            state.fPoSHeadersDeferred = false;
+            LogPrint("net", "getheaders (%d) for deferred PoS headers to peer=%d\n", pindexBestHeader->nHeight, pto->id);
+            pto->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), uint256(0));
+        }
+
         // Resend wallet transactions that haven't gotten in a block yet
         // Except during reindex, importing and IBD, when old wallet
         // transactions become unconfirmed and spams other nodes.
@@ -7362,47 +8103,48 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         // Message: inventory
         //
         std::vector<CInv> vInv;
-        std::vector<CInv> vInvWait;
         {
             LOCK(pto->cs_inventory);
-            vInv.reserve(pto->vInventoryToSend.size());
-            vInvWait.reserve(pto->vInventoryToSend.size());
-            for (const CInv& inv : pto->vInventoryToSend) {
-                if (pto->setInventoryKnown.count(inv))
-                    continue;
-
-                // trickle out tx inv to protect privacy
-                if (inv.type == MSG_TX && !fSendTrickle) {
-                    // 1/4 of tx invs blast to all immediately
-                    static uint256 hashSalt;
-                    if (hashSalt == 0)
-                        hashSalt = GetRandHash();
-                    uint256 hashRand = inv.hash ^ hashSalt;
-                    hashRand = Hash(BEGIN(hashRand), END(hashRand));
-                    bool fTrickleWait = ((hashRand & 3) != 0);
+            // Transactions go out in one batch at a random time per peer, which hides where they
+            // come from and fills the inv messages. Outbound peers are served twice as often.
+            bool fSendTxs = !pto->setInventoryTxToSend.empty() && (pto->fWhitelisted || pto->nNextInvSend < nNow);
+            if (fSendTxs && !pto->fWhitelisted)
+                pto->nNextInvSend = PoissonNextSend(nNow, pto->fInbound ? INVENTORY_BROADCAST_INTERVAL : INVENTORY_BROADCAST_INTERVAL / 2);
+            vInv.reserve(std::min<size_t>(MAX_INV_SZ, pto->vInventoryToSend.size() + (fSendTxs ? pto->vInventoryTxToSend.size() : 0)));
 
-                    if (fTrickleWait) {
-                        vInvWait.push_back(inv);
-                        continue;
-                    }
-                }
-
-                // returns true if wasn't already contained in the set
-                if (pto->setInventoryKnown.insert(inv).second) {
+            for (const CInv& inv : pto->vInventoryToSend) {
+                if (!pto->filterInventoryKnown.contains(inv)) {
+                    pto->filterInventoryKnown.insert(inv);
                     vInv.push_back(inv);
-                    if (vInv.size() >= 1000) {
-                        pto->PushMessage("inv", vInv);
+                    if (vInv.size() == MAX_INV_SZ) {
+                        PushInventoryMessage(pto, vInv);
                         vInv.clear();
                     }
                 }
             }
-            pto->vInventoryToSend = vInvWait;
+            pto->vInventoryToSend.clear();
+
+            if (fSendTxs) {
+                // Kept in the order they were relayed, so a child is never announced ahead of its parent
+                for (const uint256& hash : pto->vInventoryTxToSend) {
+                    CInv inv(MSG_TX, hash);
+                    if (!pto->filterInventoryKnown.contains(inv)) {
+                        pto->filterInventoryKnown.insert(inv);
+                        vInv.push_back(inv);
+                        if (vInv.size() == MAX_INV_SZ) {
+                            PushInventoryMessage(pto, vInv);
+                            vInv.clear();
+                        }
+                    }
+                }
+                pto->vInventoryTxToSend.clear();
+                pto->setInventoryTxToSend.clear();
+            }
         }
         if (!vInv.empty())
-            pto->PushMessage("inv", vInv);
+            PushInventoryMessage(pto, vInv);
 
         // Detect whether we're stalling
-        int64_t nNow = GetTimeMicros();
         if (!pto->fDisconnect && state.nStallingSince && state.nStallingSince < nNow - 1000000 * BLOCK_STALLING_TIMEOUT) {
             // Stalling only triggers when the block download window cannot move. During normal steady state,
             // the download window should be much larger than the to-be-downloaded set of blocks, so disconnection
@@ -79,6 +79,16 @@ static const unsigned int MAX_TX_SIGOPS_CURRENT = MAX_BLOCK_SIGOPS_CURRENT / 5;
 static const unsigned int MAX_TX_SIGOPS_LEGACY = MAX_BLOCK_SIGOPS_LEGACY / 5;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxorphantxsize, maximum size in kilobytes of the orphan transactions kept in memory */
+static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE = 250;
+/** The maximum size in bytes of the orphan transactions kept from a single peer */
+static const unsigned int MAX_ORPHAN_TRANSACTIONS_SIZE_PER_PEER = 50000;
+/** Expiration time for orphan transactions in seconds */
+static const int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
+/** Minimum time between orphan transactions expire time checks in seconds */
+static const int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+/** Number of orphan transactions tried again per cs_main lock once a block is connected */
+static const unsigned int ORPHAN_TX_REPROCESS_BATCH = 100;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -101,6 +111,25 @@ static const unsigned int MAX_HEADERS_RESULTS = 2000;
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
  *  harder). We'll probably want to make this a per-peer adaptive value at some point. */
 static const unsigned int BLOCK_DOWNLOAD_WINDOW = 1024;
+/** Total size of the blocks downloaded ahead of their parent that are kept until the parent's data arrives. */
+static const unsigned int MAX_BLOCKS_WAITING_FOR_PARENT_SIZE = 64 * 1024 * 1024;
+/** How far above the active tip a PoS header, which carries no proof, is accepted ahead of its block. Kept below
+ *  the 144-block margin of IsInitialBlockDownload, so such headers can't put the node into initial download. */
+static const int MAX_POS_HEADERS_AHEAD = 128;
+/** PoS headers without their block kept for one peer. */
+static const int MAX_POS_HEADERS_WITHOUT_DATA_PER_PEER = 2 * MAX_POS_HEADERS_AHEAD;
+/** PoS headers without their block kept for all peers together. */
+static const unsigned int MAX_POS_HEADERS_WITHOUT_DATA = 1024;
+/** Maximum depth of a block that is still announced as a compact block, older ones go whole. */
+static const int MAX_CMPCTBLOCK_DEPTH = 5;
+/** Maximum depth of a block whose transactions are still served through "getblocktxn". */
+static const int MAX_BLOCKTXN_DEPTH = 10;
+/** Transactions per second a peer may have matched against its bloom filter, in filtered blocks and "mempool" requests. */
+static const int64_t MAX_FILTER_WORK_RATE = 10000;
+/** Transactions a peer may have matched against its bloom filter at once, before the rate applies. */
+static const int64_t MAX_FILTER_WORK_BURST = 50000;
+/** Memory used by the blocks kept parsed for the bloom filtered peers. */
+static const size_t MAX_FILTERED_BLOCK_CACHE_SIZE = 16 * 1024 * 1024;
 /** Time to wait (in seconds) between writing blockchain state to disk. */
 static const unsigned int DATABASE_WRITE_INTERVAL = 3600;
 /** Maximum length of reject messages. */
@@ -155,6 +184,7 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fZerocoinIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
 extern unsigned int nCoinCacheSize;
@@ -223,11 +253,11 @@ int ActiveProtocol();
 bool ProcessMessages(CNode* pfrom);
 /**
  * Send queued protocol messages to be sent to a give node.
+ * Transactions and addresses are announced at the peer's next scheduled time.
  *
  * @param[in]   pto             The node which we are sending messages to.
- * @param[in]   fSendTrickle    When true send the trickled data, otherwise trickle the data until true.
  */
-bool SendMessages(CNode* pto, bool fSendTrickle);
+bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
 
@@ -244,6 +274,8 @@ bool GetOutput(const uint256& hash, unsigned int index, CValidationState& state,
 // ***TODO***
 double ConvertBitsToDouble(unsigned int nBits);
 int64_t GetMasternodePayment(int nHeight, int64_t blockValue, int nMasternodeCount, bool isZPIVStake);
+/** Whether the masternode payment at this height still follows the seesaw and so depends on the masternode count */
+bool IsSeeSawPaymentHeight(int nHeight);
 unsigned int GetNextWorkRequired(const CBlockIndex* pindexLast, const CBlockHeader* pblock, bool fProofOfStake);
 
 bool ActivateBestChain(CValidationState& state, CBlock* pblock = NULL, bool fAlreadyChecked = false);
@@ -360,9 +392,10 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCache& inputs, CTxUndo& txundo, int nHeight);
 
 /** Context-independent validity checks */
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, bool fFakeSerialAttack = false);
+/** With pSoKBatch set, the serial number SoKs of zerocoin spends are queued on it instead of verified in place */
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, bool fFakeSerialAttack = false, libzerocoin::SerialNumberSoKBatch* pSoKBatch = NULL);
 bool CheckZerocoinMint(const uint256& txHash, const CTxOut& txout, CValidationState& state, bool fCheckOnly = false);
-bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, bool fFakeSerialAttack = false);
+bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, bool fFakeSerialAttack = false, libzerocoin::SerialNumberSoKBatch* pSoKBatch = NULL);
 bool ContextualCheckZerocoinSpend(const CTransaction& tx, const libzerocoin::CoinSpend* spend, CBlockIndex* pindex, const uint256& hashBlock);
 bool ContextualCheckZerocoinSpendNoSerialCheck(const CTransaction& tx, const libzerocoin::CoinSpend* spend, CBlockIndex* pindex, const uint256& hashBlock);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx);
@@ -474,7 +507,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true, bool fCheckSig = true);
-bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev);
+bool CheckWork(const CBlockHeader& block, CBlockIndex* const pindexPrev);
 
 /** Context-dependent validity checks */
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* pindexPrev);
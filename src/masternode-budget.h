@@ -8,6 +8,7 @@
 #define MASTERNODE_BUDGET_H
 
 #include "base58.h"
+#include "expiringmap.h"
 #include "init.h"
 #include "key.h"
 #include "main.h"
@@ -41,6 +42,7 @@ static const CAmount PROPOSAL_FEE_TX = (50 * COIN);
 static const CAmount BUDGET_FEE_TX_OLD = (50 * COIN);
 static const CAmount BUDGET_FEE_TX = (5 * COIN);
 static const int64_t BUDGET_VOTE_UPDATE_MIN = 60 * 60;
+static const int64_t BUDGET_ORPHAN_VOTE_EXPIRATION = 60 * 60 * 24;
 static std::map<uint256, int> mapPayment_History;
 
 extern std::vector<CBudgetProposalBroadcast> vecImmatureBudgetProposals;
@@ -175,6 +177,12 @@ public:
 //
 // Budget Manager : Contains all proposals for the budget
 //
+// seen budget objects are kept for as long as they may be served to peers, so only the orphan votes are time-expired
+typedef expiringmap<uint256, CBudgetProposalBroadcast, expiringmap_ntime<CBudgetProposalBroadcast>, BlockHasher> SeenBudgetProposalMap;
+typedef expiringmap<uint256, CFinalizedBudgetBroadcast, expiringmap_ntime<CFinalizedBudgetBroadcast>, BlockHasher> SeenFinalizedBudgetMap;
+typedef expiringmap<uint256, CBudgetVote, expiringmap_ntime<CBudgetVote>, BlockHasher> BudgetVoteMap;
+typedef expiringmap<uint256, CFinalizedBudgetVote, expiringmap_ntime<CFinalizedBudgetVote>, BlockHasher> FinalizedBudgetVoteMap;
+
 class CBudgetManager
 {
 private:
@@ -182,6 +190,13 @@ private:
     // XX42    std::map<uint256, CTransaction> mapCollateral;
     std::map<uint256, uint256> mapCollateralTxids;
 
+    // cached result of GetBudget() for the next superblock, rebuilt only when votes or validity change
+    std::vector<CBudgetProposal*> vecBudgetProjection;
+    int nProjectionBlockStart;
+    int nProjectionMnCount;
+    int64_t nProjectionExpiry;
+    bool fProjectionDirty;
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -190,17 +205,27 @@ public:
     std::map<uint256, CBudgetProposal> mapProposals;
     std::map<uint256, CFinalizedBudget> mapFinalizedBudgets;
 
-    std::map<uint256, CBudgetProposalBroadcast> mapSeenMasternodeBudgetProposals;
-    std::map<uint256, CBudgetVote> mapSeenMasternodeBudgetVotes;
-    std::map<uint256, CBudgetVote> mapOrphanMasternodeBudgetVotes;
-    std::map<uint256, CFinalizedBudgetBroadcast> mapSeenFinalizedBudgets;
-    std::map<uint256, CFinalizedBudgetVote> mapSeenFinalizedBudgetVotes;
-    std::map<uint256, CFinalizedBudgetVote> mapOrphanFinalizedBudgetVotes;
+    SeenBudgetProposalMap mapSeenMasternodeBudgetProposals;
+    BudgetVoteMap mapSeenMasternodeBudgetVotes;
+    BudgetVoteMap mapOrphanMasternodeBudgetVotes;
+    SeenFinalizedBudgetMap mapSeenFinalizedBudgets;
+    FinalizedBudgetVoteMap mapSeenFinalizedBudgetVotes;
+    FinalizedBudgetVoteMap mapOrphanFinalizedBudgetVotes;
 
     CBudgetManager()
     {
         mapProposals.clear();
         mapFinalizedBudgets.clear();
+        InvalidateBudgetProjection();
+    }
+
+    void InvalidateBudgetProjection()
+    {
+        vecBudgetProjection.clear();
+        nProjectionBlockStart = -1;
+        nProjectionMnCount = -1;
+        nProjectionExpiry = 0;
+        fProjectionDirty = true;
     }
 
     void ClearSeen()
@@ -256,6 +281,7 @@ public:
         mapSeenFinalizedBudgetVotes.clear();
         mapOrphanMasternodeBudgetVotes.clear();
         mapOrphanFinalizedBudgetVotes.clear();
+        InvalidateBudgetProjection();
     }
     void CheckAndRemove();
     std::string ToString() const;
@@ -275,6 +301,9 @@ public:
 
         READWRITE(mapProposals);
         READWRITE(mapFinalizedBudgets);
+
+        if (ser_action.ForRead())
+            InvalidateBudgetProjection();
     }
 };
 
@@ -462,6 +491,13 @@ private:
     mutable CCriticalSection cs;
     CAmount nAlloted;
 
+    // tallies of the valid votes in mapVotes, kept in sync by AddOrUpdateVote/CleanAndRemove
+    int nYeas;
+    int nNays;
+    int nAbstains;
+
+    void UpdateVoteTally(const CBudgetVote& vote, int nDelta);
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -506,14 +542,15 @@ public:
     int GetBlockCurrentCycle();
     int GetBlockEndCycle();
     double GetRatio();
-    int GetYeas() const;
-    int GetNays() const;
-    int GetAbstains() const;
+    int GetYeas() const { return nYeas; }
+    int GetNays() const { return nNays; }
+    int GetAbstains() const { return nAbstains; }
     CAmount GetAmount() { return nAmount; }
     void SetAllotted(CAmount nAllotedIn) { nAlloted = nAllotedIn; }
     CAmount GetAllotted() { return nAlloted; }
 
-    void CleanAndRemove(bool fSignatureCheck);
+    bool CleanAndRemove(bool fSignatureCheck);
+    void RecalculateVoteTally();
 
     uint256 GetHash() const
     {
@@ -547,6 +584,9 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+
+        if (ser_action.ForRead())
+            RecalculateVoteTally();
     }
 };
 
@@ -575,6 +615,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        first.RecalculateVoteTally();
+        second.RecalculateVoteTally();
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
@@ -471,8 +471,9 @@ bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasterno
 
 bool CMasternodePayments::GetBlockPayee(int nBlockHeight, CScript& payee)
 {
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetPayee(payee);
+    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it != mapMasternodeBlocks.end()) {
+        return it->second.GetPayee(payee);
     }
 
     return false;
@@ -523,7 +524,7 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
             return false;
         }
 
-        mapMasternodePayeeVotes[winnerIn.GetHash()] = winnerIn;
+        mapMasternodePayeeVotes.insert(std::make_pair(winnerIn.GetHash(), winnerIn));
 
         if (!mapMasternodeBlocks.count(winnerIn.nBlockHeight)) {
             CMasternodeBlockPayees blockPayees(winnerIn.nBlockHeight);
@@ -536,16 +537,18 @@ bool CMasternodePayments::AddWinningMasternode(CMasternodePaymentWinner& winnerI
     return true;
 }
 
-bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
+CAmount CMasternodeBlockPayees::GetRequiredPayment(const CTransaction& txNew)
 {
-    LOCK(cs_vecPayments);
-
-    int nMaxSignatures = 0;
-    int nMasternode_Drift_Count = 0;
+    CAmount nReward = GetBlockValue(nBlockHeight);
 
-    std::string strPayeesPossible = "";
+    // past the seesaw the payment only depends on the height, so it is computed once per block
+    if (!IsSeeSawPaymentHeight(nBlockHeight)) {
+        if (nRequiredPayment < 0)
+            nRequiredPayment = GetMasternodePayment(nBlockHeight, nReward, 0, false);
+        return nRequiredPayment;
+    }
 
-    CAmount nReward = GetBlockValue(nBlockHeight);
+    int nMasternode_Drift_Count = 0;
 
     if (IsSporkActive(SPORK_8_MASTERNODE_PAYMENT_ENFORCEMENT)) {
         // Get a stable number of masternodes by ignoring newly activated (< 8000 sec old) masternodes
@@ -558,19 +561,23 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
         nMasternode_Drift_Count = mnodeman.size() + Params().MasternodeCountDrift();
     }
 
-    CAmount requiredMasternodePayment = GetMasternodePayment(nBlockHeight, nReward, nMasternode_Drift_Count, txNew.HasZerocoinSpendInputs());
+    return GetMasternodePayment(nBlockHeight, nReward, nMasternode_Drift_Count, txNew.HasZerocoinSpendInputs());
+}
+
+bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
+{
+    LOCK(cs_vecPayments);
 
-    //require at least 6 signatures
-    for (CMasternodePayee& payee : vecPayments)
-        if (payee.nVotes >= nMaxSignatures && payee.nVotes >= MNPAYMENTS_SIGNATURES_REQUIRED)
-            nMaxSignatures = payee.nVotes;
+    std::string strPayeesPossible = "";
 
     // if we don't have at least 6 signatures on a payee, approve whichever is the longest chain
-    if (nMaxSignatures < MNPAYMENTS_SIGNATURES_REQUIRED) return true;
+    if (nMaxVotes < MNPAYMENTS_SIGNATURES_REQUIRED) return true;
+
+    CAmount requiredMasternodePayment = GetRequiredPayment(txNew);
 
     for (CMasternodePayee& payee : vecPayments) {
         bool found = false;
-        for (CTxOut out : txNew.vout) {
+        for (const CTxOut& out : txNew.vout) {
             if (payee.scriptPubKey == out.scriptPubKey) {
                 if(out.nValue >= requiredMasternodePayment)
                     found = true;
@@ -602,6 +609,9 @@ std::string CMasternodeBlockPayees::GetRequiredPaymentsString()
 {
     LOCK(cs_vecPayments);
 
+    if (!strRequiredPayments.empty())
+        return strRequiredPayments;
+
     std::string ret = "Unknown";
 
     for (CMasternodePayee& payee : vecPayments) {
@@ -616,6 +626,7 @@ std::string CMasternodeBlockPayees::GetRequiredPaymentsString()
         }
     }
 
+    strRequiredPayments = ret;
     return ret;
 }
 
@@ -623,8 +634,9 @@ std::string CMasternodePayments::GetRequiredPaymentsString(int nBlockHeight)
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].GetRequiredPaymentsString();
+    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it != mapMasternodeBlocks.end()) {
+        return it->second.GetRequiredPaymentsString();
     }
 
     return "Unknown";
@@ -634,8 +646,9 @@ bool CMasternodePayments::IsTransactionValid(const CTransaction& txNew, int nBlo
 {
     LOCK(cs_mapMasternodeBlocks);
 
-    if (mapMasternodeBlocks.count(nBlockHeight)) {
-        return mapMasternodeBlocks[nBlockHeight].IsTransactionValid(txNew);
+    std::map<int, CMasternodeBlockPayees>::iterator it = mapMasternodeBlocks.find(nBlockHeight);
+    if (it != mapMasternodeBlocks.end()) {
+        return it->second.IsTransactionValid(txNew);
     }
 
     return true;
@@ -655,18 +668,12 @@ void CMasternodePayments::CleanPaymentList()
     //keep up to five cycles for historical sake
     int nLimit = std::max(int(mnodeman.size() * 1.25), 1000);
 
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
-    while (it != mapMasternodePayeeVotes.end()) {
-        CMasternodePaymentWinner winner = (*it).second;
-
-        if (nHeight - winner.nBlockHeight > nLimit) {
-            LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", winner.nBlockHeight);
-            masternodeSync.mapSeenSyncMNW.erase((*it).first);
-            mapMasternodePayeeVotes.erase(it++);
-            mapMasternodeBlocks.erase(winner.nBlockHeight);
-        } else {
-            ++it;
-        }
+    std::vector<std::pair<uint256, CMasternodePaymentWinner> > vExpired;
+    mapMasternodePayeeVotes.expire(nHeight - nLimit, &vExpired);
+    for (const std::pair<uint256, CMasternodePaymentWinner>& item : vExpired) {
+        LogPrint("mnpayments", "CMasternodePayments::CleanPaymentList - Removing old Masternode payment - block %d\n", item.second.nBlockHeight);
+        masternodeSync.mapSeenSyncMNW.erase(item.first);
+        mapMasternodeBlocks.erase(item.second.nBlockHeight);
     }
 }
 
@@ -814,7 +821,7 @@ void CMasternodePayments::Sync(CNode* node, int nCountNeeded)
     if (nCountNeeded > nCount) nCountNeeded = nCount;
 
     int nInvCount = 0;
-    std::map<uint256, CMasternodePaymentWinner>::iterator it = mapMasternodePayeeVotes.begin();
+    MasternodePayeeVoteMap::iterator it = mapMasternodePayeeVotes.begin();
     while (it != mapMasternodePayeeVotes.end()) {
         CMasternodePaymentWinner winner = (*it).second;
         if (winner.nBlockHeight >= nHeight - nCountNeeded && winner.nBlockHeight <= nHeight + 20) {
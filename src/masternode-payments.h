@@ -7,6 +7,7 @@
 #ifndef MASTERNODE_PAYMENTS_H
 #define MASTERNODE_PAYMENTS_H
 
+#include "expiringmap.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
@@ -88,6 +89,29 @@ public:
 // Keep track of votes for payees from masternodes
 class CMasternodeBlockPayees
 {
+private:
+    // summary of vecPayments, refreshed whenever a vote arrives so block validation doesn't rescan it
+    int nBestPayee;
+    int nMaxVotes;
+    // required payment for heights where it depends only on the height, -1 until first needed
+    CAmount nRequiredPayment;
+    std::string strRequiredPayments;
+
+    void UpdatePayeeSummary()
+    {
+        nBestPayee = -1;
+        nMaxVotes = -1;
+        for (unsigned int i = 0; i < vecPayments.size(); i++) {
+            if (vecPayments[i].nVotes > nMaxVotes) {
+                nBestPayee = i;
+                nMaxVotes = vecPayments[i].nVotes;
+            }
+        }
+        strRequiredPayments.clear();
+    }
+
+    CAmount GetRequiredPayment(const CTransaction& txNew);
+
 public:
     int nBlockHeight;
     std::vector<CMasternodePayee> vecPayments;
@@ -96,47 +120,56 @@ public:
     {
         nBlockHeight = 0;
         vecPayments.clear();
+        nRequiredPayment = -1;
+        UpdatePayeeSummary();
     }
     CMasternodeBlockPayees(int nBlockHeightIn)
     {
         nBlockHeight = nBlockHeightIn;
         vecPayments.clear();
+        nRequiredPayment = -1;
+        UpdatePayeeSummary();
     }
 
     void AddPayee(CScript payeeIn, int nIncrement)
     {
         LOCK(cs_vecPayments);
 
+        bool fFound = false;
         for (CMasternodePayee& payee : vecPayments) {
             if (payee.scriptPubKey == payeeIn) {
                 payee.nVotes += nIncrement;
-                return;
+                fFound = true;
+                break;
             }
         }
 
-        CMasternodePayee c(payeeIn, nIncrement);
-        vecPayments.push_back(c);
+        if (!fFound) {
+            CMasternodePayee c(payeeIn, nIncrement);
+            vecPayments.push_back(c);
+        }
+
+        UpdatePayeeSummary();
     }
 
     bool GetPayee(CScript& payee)
     {
         LOCK(cs_vecPayments);
 
-        int nVotes = -1;
-        for (CMasternodePayee& p : vecPayments) {
-            if (p.nVotes > nVotes) {
-                payee = p.scriptPubKey;
-                nVotes = p.nVotes;
-            }
-        }
+        if (nBestPayee < 0)
+            return false;
 
-        return (nVotes > -1);
+        payee = vecPayments[nBestPayee].scriptPubKey;
+        return true;
     }
 
     bool HasPayeeWithVotes(CScript payee, int nVotesReq)
     {
         LOCK(cs_vecPayments);
 
+        if (nMaxVotes < nVotesReq)
+            return false;
+
         for (CMasternodePayee& p : vecPayments) {
             if (p.nVotes >= nVotesReq && p.scriptPubKey == payee) return true;
         }
@@ -154,6 +187,10 @@ public:
     {
         READWRITE(nBlockHeight);
         READWRITE(vecPayments);
+        if (ser_action.ForRead()) {
+            nRequiredPayment = -1;
+            UpdatePayeeSummary();
+        }
     }
 };
 
@@ -224,6 +261,13 @@ public:
     }
 };
 
+/** Payee votes are indexed by the height they vote for */
+struct CMasternodePaymentWinnerHeight {
+    int64_t operator()(const CMasternodePaymentWinner& winner) const { return winner.nBlockHeight; }
+};
+
+typedef expiringmap<uint256, CMasternodePaymentWinner, CMasternodePaymentWinnerHeight, BlockHasher> MasternodePayeeVoteMap;
+
 //
 // Masternode Payments Class
 // Keeps track of who should get paid for which blocks
@@ -236,7 +280,7 @@ private:
     int nLastBlockHeight;
 
 public:
-    std::map<uint256, CMasternodePaymentWinner> mapMasternodePayeeVotes;
+    MasternodePayeeVoteMap mapMasternodePayeeVotes;
     std::map<int, CMasternodeBlockPayees> mapMasternodeBlocks;
     std::map<uint256, int> mapMasternodesLastVote; //prevout.hash + prevout.n, nBlockHeight
 
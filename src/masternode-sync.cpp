@@ -79,6 +79,7 @@ void CMasternodeSync::Reset()
     countMasternodeWinner = 0;
     countBudgetItemProp = 0;
     countBudgetItemFin = 0;
+    countMasternodeListDiff = 0;
     RequestedMasternodeAssets = MASTERNODE_SYNC_INITIAL;
     RequestedMasternodeAttempt = 0;
     nAssetSyncStarted = GetTime();
@@ -97,6 +98,18 @@ void CMasternodeSync::AddedMasternodeList(uint256 hash)
     }
 }
 
+void CMasternodeSync::AddedMasternodeListDiff(int nCount, bool fComplete)
+{
+    if (RequestedMasternodeAssets != MASTERNODE_SYNC_LIST) return;
+
+    lastMasternodeList = GetTime();
+    sumMasternodeList += nCount;
+    if (fComplete) {
+        countMasternodeList++;
+        countMasternodeListDiff++;
+    }
+}
+
 void CMasternodeSync::AddedMasternodeWinner(uint256 hash)
 {
     if (masternodePayments.mapMasternodePayeeVotes.count(hash)) {
@@ -270,7 +283,7 @@ void CMasternodeSync::Process()
             if (RequestedMasternodeAttempt <= 2) {
                 pnode->PushMessage("getsporks"); //get current network sporks
             } else if (RequestedMasternodeAttempt < 4) {
-                mnodeman.DsegUpdate(pnode);
+                mnodeman.ListUpdate(pnode);
             } else if (RequestedMasternodeAttempt < 6) {
                 int nMnCount = mnodeman.CountEnabled();
                 pnode->PushMessage("mnget", nMnCount); //sync payees
@@ -298,6 +311,12 @@ void CMasternodeSync::Process()
         if (pnode->nVersion >= masternodePayments.GetMinMasternodePaymentsProto()) {
             if (RequestedMasternodeAssets == MASTERNODE_SYNC_LIST) {
                 LogPrint("masternode", "CMasternodeSync::Process() - lastMasternodeList %lld (GetTime() - MASTERNODE_SYNC_TIMEOUT) %lld\n", lastMasternodeList, GetTime() - MASTERNODE_SYNC_TIMEOUT);
+                // complete lists from enough peers, no need to wait for stray entries
+                if (countMasternodeListDiff >= MASTERNODE_SYNC_THRESHOLD) {
+                    GetNextAsset();
+                    return;
+                }
+
                 if (lastMasternodeList > 0 && lastMasternodeList < GetTime() - MASTERNODE_SYNC_TIMEOUT * 2 && RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD) { //hasn't received a new item in the last five seconds, so we'll move to the
                     GetNextAsset();
                     return;
@@ -323,7 +342,7 @@ void CMasternodeSync::Process()
 
                 if (RequestedMasternodeAttempt >= MASTERNODE_SYNC_THRESHOLD * 3) return;
 
-                mnodeman.DsegUpdate(pnode);
+                mnodeman.ListUpdate(pnode);
                 RequestedMasternodeAttempt++;
                 return;
             }
@@ -50,6 +50,8 @@ public:
     int countMasternodeWinner;
     int countBudgetItemProp;
     int countBudgetItemFin;
+    // peers that answered with a complete list snapshot or diff
+    int countMasternodeListDiff;
 
     // Count peers we've requested the list from
     int RequestedMasternodeAssets;
@@ -61,6 +63,7 @@ public:
     CMasternodeSync();
 
     void AddedMasternodeList(uint256 hash);
+    void AddedMasternodeListDiff(int nCount, bool fComplete);
     void AddedMasternodeWinner(uint256 hash);
     void AddedBudgetItem(uint256 hash);
     void GetNextAsset();
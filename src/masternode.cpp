@@ -906,8 +906,10 @@ bool CMasternodePing::CheckAndUpdate(int& nDos, bool fRequireEnabled, bool fChec
             //mnodeman.mapSeenMasternodeBroadcast.lastPing is probably outdated, so we'll update it
             CMasternodeBroadcast mnb(*pmn);
             uint256 hash = mnb.GetHash();
-            if (mnodeman.mapSeenMasternodeBroadcast.count(hash)) {
-                mnodeman.mapSeenMasternodeBroadcast[hash].lastPing = *this;
+            SeenMasternodeBroadcastMap::iterator it = mnodeman.mapSeenMasternodeBroadcast.find(hash);
+            if (it != mnodeman.mapSeenMasternodeBroadcast.end()) {
+                (*it).second.lastPing = *this;
+                mnodeman.mapSeenMasternodeBroadcast.update_time(hash, sigTime);
             }
 
             pmn->Check(true);
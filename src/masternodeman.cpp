@@ -193,7 +193,8 @@ void DumpMasternodes()
     LogPrint("masternode","Masternode dump finished  %dms\n", GetTimeMillis() - nStart);
 }
 
-CMasternodeMan::CMasternodeMan()
+CMasternodeMan::CMasternodeMan() : mapSeenMasternodeBroadcast(MASTERNODES_SEEN_MAX_USAGE),
+                                   mapSeenMasternodePing(MASTERNODES_SEEN_MAX_USAGE)
 {
     nDsqCount = 0;
 }
@@ -240,6 +241,14 @@ void CMasternodeMan::Check()
     }
 }
 
+void CMasternodeMan::GetSeenMapStats(expiringmap_stats& broadcasts, expiringmap_stats& pings) const
+{
+    LOCK(cs);
+
+    broadcasts = mapSeenMasternodeBroadcast.stats();
+    pings = mapSeenMasternodePing.stats();
+}
+
 void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
 {
     Check();
@@ -258,11 +267,11 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             //erase all of the broadcasts we've seen from this vin
             // -- if we missed a few pings and the node was removed, this will allow is to get it back without them
             //    sending a brand new mnb
-            std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
+            SeenMasternodeBroadcastMap::iterator it3 = mapSeenMasternodeBroadcast.begin();
             while (it3 != mapSeenMasternodeBroadcast.end()) {
                 if ((*it3).second.vin == (*it).vin) {
                     masternodeSync.mapSeenSyncMNB.erase((*it3).first);
-                    mapSeenMasternodeBroadcast.erase(it3++);
+                    it3 = mapSeenMasternodeBroadcast.erase(it3);
                 } else {
                     ++it3;
                 }
@@ -315,25 +324,13 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
     }
 
     // remove expired mapSeenMasternodeBroadcast
-    std::map<uint256, CMasternodeBroadcast>::iterator it3 = mapSeenMasternodeBroadcast.begin();
-    while (it3 != mapSeenMasternodeBroadcast.end()) {
-        if ((*it3).second.lastPing.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            mapSeenMasternodeBroadcast.erase(it3++);
-            masternodeSync.mapSeenSyncMNB.erase((*it3).second.GetHash());
-        } else {
-            ++it3;
-        }
-    }
+    std::vector<std::pair<uint256, CMasternodeBroadcast> > vExpired;
+    mapSeenMasternodeBroadcast.expire(GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2), &vExpired);
+    for (const std::pair<uint256, CMasternodeBroadcast>& item : vExpired)
+        masternodeSync.mapSeenSyncMNB.erase(item.first);
 
     // remove expired mapSeenMasternodePing
-    std::map<uint256, CMasternodePing>::iterator it4 = mapSeenMasternodePing.begin();
-    while (it4 != mapSeenMasternodePing.end()) {
-        if ((*it4).second.sigTime < GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2)) {
-            mapSeenMasternodePing.erase(it4++);
-        } else {
-            ++it4;
-        }
-    }
+    mapSeenMasternodePing.expire(GetTime() - (MASTERNODE_REMOVAL_SECONDS * 2));
 }
 
 void CMasternodeMan::Clear()
@@ -345,6 +342,7 @@ void CMasternodeMan::Clear()
     mWeAskedForMasternodeListEntry.clear();
     mapSeenMasternodeBroadcast.clear();
     mapSeenMasternodePing.clear();
+    dequeListSnapshots.clear();
     nDsqCount = 0;
 }
 
@@ -435,6 +433,179 @@ void CMasternodeMan::DsegUpdate(CNode* pnode)
     mWeAskedForMasternodeList[pnode->addr] = askAgain;
 }
 
+void CMasternodeMan::ListUpdate(CNode* pnode)
+{
+    if (pnode->nVersion < MNLIST_DIFF_VERSION) {
+        DsegUpdate(pnode);
+        return;
+    }
+
+    LOCK(cs);
+
+    if (Params().NetworkID() == CBaseChainParams::MAIN) {
+        if (!(pnode->addr.IsRFC1918() || pnode->addr.IsLocal())) {
+            std::map<CNetAddr, int64_t>::iterator it = mWeAskedForMasternodeList.find(pnode->addr);
+            if (it != mWeAskedForMasternodeList.end()) {
+                if (GetTime() < (*it).second) {
+                    LogPrint("masternode", "getmnlist - we already asked peer %i for the list; skipping...\n", pnode->GetId());
+                    return;
+                }
+            }
+        }
+    }
+
+    MasternodeListSnapshot snapshot;
+    pnode->PushMessage("getmnlist", GetListSnapshot(snapshot));
+    pnode->FulfilledRequest("getmnlist");
+    int64_t askAgain = GetTime() + MASTERNODES_DSEG_SECONDS;
+    mWeAskedForMasternodeList[pnode->addr] = askAgain;
+}
+
+uint256 CMasternodeMan::GetListSnapshot(MasternodeListSnapshot& snapshot)
+{
+    AssertLockHeld(cs);
+
+    snapshot.clear();
+    for (CMasternode& mn : vMasternodes) {
+        if (mn.addr.IsRFC1918() || !mn.IsEnabled()) continue;
+        CMasternodeBroadcast mnb(mn);
+        snapshot[mn.vin.prevout] = std::make_pair(mnb.GetHash(), mn.lastPing.GetHash());
+    }
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << snapshot;
+    return ss.GetHash();
+}
+
+uint256 CMasternodeMan::GetListHash()
+{
+    LOCK(cs);
+    MasternodeListSnapshot snapshot;
+    return GetListSnapshot(snapshot);
+}
+
+void CMasternodeMan::GetListDiff(const uint256& hashKnown, CMasternodeListDiff& diff)
+{
+    LOCK(cs);
+
+    diff.SetNull();
+    MasternodeListSnapshot snapshot;
+    diff.hashList = GetListSnapshot(snapshot);
+
+    // find the list the peer has; anything we don't remember gets a full snapshot
+    const MasternodeListSnapshot* pbase = NULL;
+    if (hashKnown == diff.hashList) {
+        pbase = &snapshot;
+    } else {
+        for (const std::pair<uint256, MasternodeListSnapshot>& item : dequeListSnapshots) {
+            if (item.first == hashKnown) {
+                pbase = &item.second;
+                break;
+            }
+        }
+    }
+    if (pbase != NULL) diff.hashBase = hashKnown;
+
+    if (pbase != &snapshot) {
+        for (CMasternode& mn : vMasternodes) {
+            MasternodeListSnapshot::const_iterator it = snapshot.find(mn.vin.prevout);
+            if (it == snapshot.end()) continue;
+
+            MasternodeListSnapshot::const_iterator itBase = pbase ? pbase->find(mn.vin.prevout) : snapshot.end();
+            if (pbase == NULL || itBase == pbase->end() || itBase->second.first != it->second.first) {
+                diff.vBroadcasts.push_back(CMasternodeBroadcast(mn));
+            } else if (itBase->second.second != it->second.second) {
+                diff.vPings.push_back(mn.lastPing);
+            }
+        }
+    }
+
+    // remember what we served, so the peer's next request can be answered with a diff
+    bool fKnown = false;
+    for (const std::pair<uint256, MasternodeListSnapshot>& item : dequeListSnapshots) {
+        if (item.first == diff.hashList) {
+            fKnown = true;
+            break;
+        }
+    }
+    if (!fKnown) {
+        dequeListSnapshots.push_back(std::make_pair(diff.hashList, snapshot));
+        if (dequeListSnapshots.size() > MASTERNODES_LIST_SNAPSHOTS) dequeListSnapshots.pop_front();
+    }
+}
+
+int CMasternodeMan::ApplyListDiff(CNode* pfrom, CMasternodeListDiff& diff)
+{
+    int nAccepted = 0;
+
+    // first pass: signatures and updates of entries we already have, without cs_main
+    std::vector<CMasternodeBroadcast> vNew;
+    for (CMasternodeBroadcast& mnb : diff.vBroadcasts) {
+        uint256 hash = mnb.GetHash();
+        if (mapSeenMasternodeBroadcast.count(hash)) { //seen
+            masternodeSync.AddedMasternodeList(hash);
+            continue;
+        }
+        mapSeenMasternodeBroadcast.insert(std::make_pair(hash, mnb));
+
+        int nDoS = 0;
+        if (!mnb.CheckAndUpdate(nDoS)) {
+            if (nDoS > 0) {
+                // one bad entry taints the whole batch
+                Misbehaving(pfrom->GetId(), nDoS);
+                return nAccepted;
+            }
+            continue;
+        }
+        vNew.push_back(mnb);
+    }
+
+    // second pass: collateral checks for the new entries under a single cs_main lock
+    {
+        LOCK(cs_main);
+        for (CMasternodeBroadcast& mnb : vNew) {
+            if (!obfuScationSigner.IsVinAssociatedWithPubkey(mnb.vin, mnb.pubKeyCollateralAddress)) {
+                LogPrintf("CMasternodeMan::ApplyListDiff() : mnlist - Got mismatched pubkey and vin\n");
+                Misbehaving(pfrom->GetId(), 33);
+                return nAccepted;
+            }
+
+            int nDoS = 0;
+            if (mnb.CheckInputsAndAdd(nDoS)) {
+                addrman.Add(CAddress(mnb.addr), pfrom->addr, 2 * 60 * 60);
+                masternodeSync.AddedMasternodeList(mnb.GetHash());
+                nAccepted++;
+            } else {
+                LogPrint("masternode", "mnlist - Rejected Masternode entry %s\n", mnb.vin.prevout.hash.ToString());
+                if (nDoS > 0) {
+                    Misbehaving(pfrom->GetId(), nDoS);
+                    return nAccepted;
+                }
+            }
+        }
+    }
+
+    for (CMasternodePing& mnp : diff.vPings) {
+        uint256 hash = mnp.GetHash();
+        if (mapSeenMasternodePing.count(hash)) continue; //seen
+        mapSeenMasternodePing.insert(std::make_pair(hash, mnp));
+
+        int nDoS = 0;
+        if (mnp.CheckAndUpdate(nDoS)) {
+            nAccepted++;
+            continue;
+        }
+        if (nDoS > 0) {
+            Misbehaving(pfrom->GetId(), nDoS);
+            return nAccepted;
+        }
+        // the peer thought we had this entry; ask for it if we don't
+        if (Find(mnp.vin) == NULL) AskForMN(pfrom, mnp.vin);
+    }
+
+    return nAccepted;
+}
+
 CMasternode* CMasternodeMan::Find(const CScript& payee)
 {
     LOCK(cs);
@@ -591,15 +762,16 @@ CMasternode* CMasternodeMan::GetCurrentMasterNode(int mod, int64_t nBlockHeight,
     return winner;
 }
 
-int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+bool CMasternodeMan::GetMasternodeScores(int64_t nBlockHeight, int minProtocol, bool fOnlyActive, std::vector<std::pair<int64_t, CTxIn> >& vecMasternodeScores)
 {
-    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
     int64_t nMasternode_Min_Age = MN_WINNER_MINIMUM_AGE;
     int64_t nMasternode_Age = 0;
 
+    vecMasternodeScores.clear();
+
     //make sure we know about this block
     uint256 hash = 0;
-    if (!GetBlockHash(hash, nBlockHeight)) return -1;
+    if (!GetBlockHash(hash, nBlockHeight)) return false;
 
     // scan for winner
     for (CMasternode& mn : vMasternodes) {
@@ -627,6 +799,14 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, in
 
     sort(vecMasternodeScores.rbegin(), vecMasternodeScores.rend(), CompareScoreTxIn());
 
+    return true;
+}
+
+int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol, bool fOnlyActive)
+{
+    std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
+    if (!GetMasternodeScores(nBlockHeight, minProtocol, fOnlyActive, vecMasternodeScores)) return -1;
+
     int rank = 0;
     for (PAIRTYPE(int64_t, CTxIn) & s : vecMasternodeScores) {
         rank++;
@@ -849,6 +1029,67 @@ void CMasternodeMan::ProcessMessage(CNode* pfrom, std::string& strCommand, CData
             LogPrint("masternode", "dseg - Sent %d Masternode entries to peer %i\n", nInvCount, pfrom->GetId());
         }
     }
+
+    else if (strCommand == "getmnlist") { //Get Masternode list as a snapshot or a diff
+        uint256 hashKnown;
+        vRecv >> hashKnown;
+
+        bool isLocal = (pfrom->addr.IsRFC1918() || pfrom->addr.IsLocal());
+        if (!isLocal && Params().NetworkID() == CBaseChainParams::MAIN) {
+            std::map<CNetAddr, int64_t>::iterator i = mAskedUsForMasternodeList.find(pfrom->addr);
+            if (i != mAskedUsForMasternodeList.end() && GetTime() < (*i).second) {
+                LogPrintf("CMasternodeMan::ProcessMessage() : getmnlist - peer already asked me for the list\n");
+                Misbehaving(pfrom->GetId(), 34);
+                return;
+            }
+            mAskedUsForMasternodeList[pfrom->addr] = GetTime() + MASTERNODES_DSEG_SECONDS;
+        }
+
+        CMasternodeListDiff diff;
+        GetListDiff(hashKnown, diff);
+
+        // keep every message well below MAX_PROTOCOL_MESSAGE_LENGTH
+        uint32_t nMessages = std::max((size_t)1, (diff.size() + MASTERNODES_LIST_DIFF_BATCH - 1) / MASTERNODES_LIST_DIFF_BATCH);
+        size_t nBroadcast = 0, nPing = 0;
+        for (uint32_t n = 0; n < nMessages; n++) {
+            CMasternodeListDiff part;
+            part.hashBase = diff.hashBase;
+            part.hashList = diff.hashList;
+            part.nRemaining = nMessages - n - 1;
+            while (part.size() < MASTERNODES_LIST_DIFF_BATCH && nBroadcast < diff.vBroadcasts.size())
+                part.vBroadcasts.push_back(diff.vBroadcasts[nBroadcast++]);
+            while (part.size() < MASTERNODES_LIST_DIFF_BATCH && nPing < diff.vPings.size())
+                part.vPings.push_back(diff.vPings[nPing++]);
+            pfrom->PushMessage("mnlist", part);
+        }
+
+        LogPrint("masternode", "getmnlist - Sent %s with %d broadcasts and %d pings in %d messages to peer %i\n",
+            diff.IsFull() ? "snapshot" : "diff", diff.vBroadcasts.size(), diff.vPings.size(), nMessages, pfrom->GetId());
+    }
+
+    else if (strCommand == "mnlist") { //Masternode list snapshot or diff
+        if (!pfrom->HasFulfilledRequest("getmnlist")) {
+            LogPrint("masternode", "mnlist - unrequested list from peer %i\n", pfrom->GetId());
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        CMasternodeListDiff diff;
+        vRecv >> diff;
+
+        if (diff.size() > MASTERNODES_LIST_DIFF_BATCH) {
+            Misbehaving(pfrom->GetId(), 20);
+            return;
+        }
+
+        int64_t nStart = GetTimeMicros();
+        int nAccepted = ApplyListDiff(pfrom, diff);
+        LogPrint("masternode", "mnlist - Accepted %d of %d entries from peer %i in %.2fms (%d more messages)\n",
+            nAccepted, diff.size(), pfrom->GetId(), 0.001 * (GetTimeMicros() - nStart), diff.nRemaining);
+
+        if (diff.nRemaining == 0) pfrom->ClearFulfilledRequest("getmnlist");
+        masternodeSync.AddedMasternodeListDiff(nAccepted, diff.nRemaining == 0);
+    }
     /*
      * IT'S SAFE TO REMOVE THIS IN FURTHER VERSIONS
      * AFTER MIGRATION TO V12 IS DONE
@@ -8,6 +8,7 @@
 #define MASTERNODEMAN_H
 
 #include "base58.h"
+#include "expiringmap.h"
 #include "key.h"
 #include "main.h"
 #include "masternode.h"
@@ -15,12 +16,77 @@
 #include "sync.h"
 #include "util.h"
 
+#include <deque>
+
 #define MASTERNODES_DUMP_SECONDS (15 * 60)
 #define MASTERNODES_DSEG_SECONDS (3 * 60 * 60)
+#define MASTERNODES_SEEN_MAX_USAGE (32 * 1024 * 1024)
+#define MASTERNODES_LIST_SNAPSHOTS 8
+#define MASTERNODES_LIST_DIFF_BATCH 1000
 
 
 class CMasternodeMan;
 
+/** Seen broadcasts are indexed by the time of their last ping */
+struct CMasternodeBroadcastPingTime {
+    int64_t operator()(const CMasternodeBroadcast& mnb) const { return mnb.lastPing.sigTime; }
+};
+
+struct CMasternodePingTime {
+    int64_t operator()(const CMasternodePing& mnp) const { return mnp.sigTime; }
+};
+
+typedef expiringmap<uint256, CMasternodeBroadcast, CMasternodeBroadcastPingTime, BlockHasher> SeenMasternodeBroadcastMap;
+typedef expiringmap<uint256, CMasternodePing, CMasternodePingTime, BlockHasher> SeenMasternodePingMap;
+
+/** Fingerprint of a masternode list: broadcast and last ping hash of every listed entry, by collateral */
+typedef std::map<COutPoint, std::pair<uint256, uint256> > MasternodeListSnapshot;
+
+/**
+ * Answer to a "getmnlist" request. Carries the masternode list as a diff against the list
+ * the peer reported (hashBase), or as a full snapshot when hashBase is 0. Entries whose
+ * broadcast the peer already has are sent as a bare ping. Large lists are split over
+ * several messages, nRemaining counts the ones still to come.
+ */
+class CMasternodeListDiff
+{
+public:
+    uint256 hashBase;
+    uint256 hashList;
+    uint32_t nRemaining;
+    std::vector<CMasternodeBroadcast> vBroadcasts;
+    std::vector<CMasternodePing> vPings;
+
+    CMasternodeListDiff()
+    {
+        SetNull();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hashBase);
+        READWRITE(hashList);
+        READWRITE(nRemaining);
+        READWRITE(vBroadcasts);
+        READWRITE(vPings);
+    }
+
+    void SetNull()
+    {
+        hashBase = 0;
+        hashList = 0;
+        nRemaining = 0;
+        vBroadcasts.clear();
+        vPings.clear();
+    }
+
+    bool IsFull() const { return hashBase == 0; }
+    size_t size() const { return vBroadcasts.size() + vPings.size(); }
+};
+
 extern CMasternodeMan mnodeman;
 void DumpMasternodes();
 
@@ -65,12 +131,17 @@ private:
     std::map<CNetAddr, int64_t> mWeAskedForMasternodeList;
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
+    // the last few lists we served, so peers that have one of them only get a diff
+    std::deque<std::pair<uint256, MasternodeListSnapshot> > dequeListSnapshots;
+
+    /// Fingerprint of the enabled, publicly reachable entries (cs must be held)
+    uint256 GetListSnapshot(MasternodeListSnapshot& snapshot);
 
 public:
     // Keep track of all broadcasts I've seen
-    std::map<uint256, CMasternodeBroadcast> mapSeenMasternodeBroadcast;
+    SeenMasternodeBroadcastMap mapSeenMasternodeBroadcast;
     // Keep track of all pings I've seen
-    std::map<uint256, CMasternodePing> mapSeenMasternodePing;
+    SeenMasternodePingMap mapSeenMasternodePing;
 
     // keep track of dsq count to prevent masternodes from gaming obfuscation queue
     int64_t nDsqCount;
@@ -103,6 +174,9 @@ public:
     /// Check all Masternodes
     void Check();
 
+    /// Size and memory usage of the seen broadcast and ping maps
+    void GetSeenMapStats(expiringmap_stats& broadcasts, expiringmap_stats& pings) const;
+
     /// Check all Masternodes and remove inactive
     void CheckAndRemove(bool forceExpiredRemoval = false);
 
@@ -115,6 +189,18 @@ public:
 
     void DsegUpdate(CNode* pnode);
 
+    /// Ask pnode for the masternode list, as a diff against ours when the peer supports it
+    void ListUpdate(CNode* pnode);
+
+    /// Hash of the enabled, publicly reachable part of the list, as exchanged in "getmnlist"
+    uint256 GetListHash();
+
+    /// Build the answer to a "getmnlist" for a peer whose list hashes to hashKnown
+    void GetListDiff(const uint256& hashKnown, CMasternodeListDiff& diff);
+
+    /// Verify and add the entries of a received list diff; returns the number of entries accepted
+    int ApplyListDiff(CNode* pfrom, CMasternodeListDiff& diff);
+
     /// Find an entry
     CMasternode* Find(const CScript& payee);
     CMasternode* Find(const CTxIn& vin);
@@ -137,6 +223,8 @@ public:
 
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int64_t nBlockHeight, int minProtocol = 0);
     int GetMasternodeRank(const CTxIn& vin, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
+    /// Scores of the masternodes eligible at nBlockHeight, best first; false if the block is unknown
+    bool GetMasternodeScores(int64_t nBlockHeight, int minProtocol, bool fOnlyActive, std::vector<std::pair<int64_t, CTxIn> >& vecMasternodeScores);
     CMasternode* GetMasternodeByRank(int nRank, int64_t nBlockHeight, int minProtocol = 0, bool fOnlyActive = true);
 
     void ProcessMasternodeConnections();
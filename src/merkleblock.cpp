@@ -10,6 +10,7 @@
 #include "hash.h"
 #include "primitives/block.h" // for MAX_BLOCK_SIZE
 #include "utilstrencodings.h"
+#include "version.h"
 
 
 CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
@@ -35,6 +36,116 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
     txn = CPartialMerkleTree(vHashes, vMatch);
 }
 
+CMerkleBlock::CMerkleBlock(const CFilteredBlock& block, CBloomFilter& filter)
+{
+    header = block.block.GetBlockHeader();
+
+    std::vector<bool> vMatch;
+    std::vector<uint256> vHashes;
+
+    vMatch.reserve(block.vtx.size());
+    vHashes.reserve(block.vtx.size());
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const uint256& hash = block.vtx[i].hash;
+        if (filter.IsRelevantAndUpdate(block.vtx[i])) {
+            vMatch.push_back(true);
+            vMatchedTxn.push_back(std::make_pair(i, hash));
+        } else
+            vMatch.push_back(false);
+        vHashes.push_back(hash);
+    }
+
+    txn = CPartialMerkleTree(vHashes, vMatch);
+}
+
+CFilteredBlock::CFilteredBlock(const CBlock& blockIn) : block(blockIn)
+{
+    // The block is counted at its serialized size, the transactions take about as much in memory
+    nMemoryUsage = sizeof(*this) + ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    vtx.reserve(block.vtx.size());
+    for (const CTransaction& tx : block.vtx) {
+        vtx.push_back(CBloomTxElements(tx));
+        nMemoryUsage += vtx.back().GetMemoryUsage();
+    }
+}
+
+CFilteredBlockCache::CFilteredBlockCache(size_t nMaxMemoryUsageIn) : nMaxMemoryUsage(nMaxMemoryUsageIn),
+                                                                     nMemoryUsage(0),
+                                                                     nHits(0),
+                                                                     nMisses(0)
+{
+}
+
+std::shared_ptr<const CFilteredBlock> CFilteredBlockCache::Get(const uint256& hash)
+{
+    LOCK(cs);
+    std::map<uint256, BlockList::iterator>::iterator it = mapBlocks.find(hash);
+    if (it == mapBlocks.end()) {
+        nMisses++;
+        return std::shared_ptr<const CFilteredBlock>();
+    }
+    nHits++;
+    listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+    return *it->second;
+}
+
+std::shared_ptr<const CFilteredBlock> CFilteredBlockCache::Add(const CBlock& block)
+{
+    // Parsed outside the lock, peers served from the cache meanwhile do not wait for it
+    std::shared_ptr<const CFilteredBlock> pblock = std::make_shared<const CFilteredBlock>(block);
+    const uint256 hash = block.GetHash();
+
+    LOCK(cs);
+    std::map<uint256, BlockList::iterator>::iterator it = mapBlocks.find(hash);
+    if (it != mapBlocks.end())
+        return *it->second;
+    listBlocks.push_front(pblock);
+    mapBlocks.insert(std::make_pair(hash, listBlocks.begin()));
+    nMemoryUsage += pblock->GetMemoryUsage();
+
+    // A block over the limit on its own is still kept until the next one comes
+    while (nMemoryUsage > nMaxMemoryUsage && listBlocks.size() > 1) {
+        const CFilteredBlock& evicted = *listBlocks.back();
+        nMemoryUsage -= evicted.GetMemoryUsage();
+        mapBlocks.erase(evicted.block.GetHash());
+        listBlocks.pop_back();
+    }
+    return pblock;
+}
+
+void CFilteredBlockCache::Clear()
+{
+    LOCK(cs);
+    mapBlocks.clear();
+    listBlocks.clear();
+    nMemoryUsage = 0;
+}
+
+size_t CFilteredBlockCache::GetMemoryUsage() const
+{
+    LOCK(cs);
+    return nMemoryUsage;
+}
+
+size_t CFilteredBlockCache::GetCount() const
+{
+    LOCK(cs);
+    return listBlocks.size();
+}
+
+uint64_t CFilteredBlockCache::GetHits() const
+{
+    LOCK(cs);
+    return nHits;
+}
+
+uint64_t CFilteredBlockCache::GetMisses() const
+{
+    LOCK(cs);
+    return nMisses;
+}
+
 uint256 CPartialMerkleTree::CalcHash(int height, unsigned int pos, const std::vector<uint256>& vTxid)
 {
     if (height == 0) {
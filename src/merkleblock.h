@@ -11,8 +11,12 @@
 #include "bloom.h"
 #include "primitives/block.h"
 #include "serialize.h"
+#include "sync.h"
 #include "uint256.h"
 
+#include <list>
+#include <map>
+#include <memory>
 #include <vector>
 
 /** Data structure that represents a partial merkle tree.
@@ -120,6 +124,54 @@ public:
 };
 
 
+/** A block along with the bloom filter elements of its transactions, extracted once for all the peers it is served to */
+class CFilteredBlock
+{
+public:
+    CBlock block;
+    std::vector<CBloomTxElements> vtx;
+
+    explicit CFilteredBlock(const CBlock& blockIn);
+
+    size_t GetMemoryUsage() const { return nMemoryUsage; }
+
+private:
+    size_t nMemoryUsage;
+};
+
+/**
+ * The blocks most recently served to bloom filtered peers, so that light clients syncing
+ * the same stretch of the chain do not each have the block read from disk and its scripts
+ * parsed again. Bounded by the memory the blocks use, the least recently served go first.
+ */
+class CFilteredBlockCache
+{
+private:
+    typedef std::list<std::shared_ptr<const CFilteredBlock> > BlockList;
+
+    mutable CCriticalSection cs;
+    BlockList listBlocks; // most recently served first
+    std::map<uint256, BlockList::iterator> mapBlocks;
+    size_t nMaxMemoryUsage;
+    size_t nMemoryUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+
+public:
+    explicit CFilteredBlockCache(size_t nMaxMemoryUsageIn);
+
+    /** The block with this hash if it is cached, null otherwise */
+    std::shared_ptr<const CFilteredBlock> Get(const uint256& hash);
+    /** Cache a block read from disk, evicting the least recently served ones beyond the memory limit */
+    std::shared_ptr<const CFilteredBlock> Add(const CBlock& block);
+    void Clear();
+
+    size_t GetMemoryUsage() const;
+    size_t GetCount() const;
+    uint64_t GetHits() const;
+    uint64_t GetMisses() const;
+};
+
 /**
  * Used to relay blocks as header + vector<merkle branch>
  * to filtered nodes.
@@ -142,6 +194,9 @@ public:
      */
     CMerkleBlock(const CBlock& block, CBloomFilter& filter);
 
+    /** Same as above, matching the elements of the transactions extracted beforehand */
+    CMerkleBlock(const CFilteredBlock& block, CBloomFilter& filter);
+
     ADD_SERIALIZE_METHODS;
 
     template <typename Stream, typename Operation>
@@ -374,21 +374,20 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
                     continue;
 
                 bool fDoubleSerial = false;
-                for (const CTxIn& txIn : tx.vin) {
+                for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                    const CTxIn& txIn = tx.vin[i];
                     bool isPublicSpend = txIn.IsZerocoinPublicSpend();
                     if (txIn.IsZerocoinSpend() || isPublicSpend) {
-                        libzerocoin::CoinSpend* spend;
+                        std::shared_ptr<const libzerocoin::CoinSpend> spend;
                         if (isPublicSpend) {
-                            libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-                            PublicCoinSpend publicSpend(params);
+                            std::shared_ptr<const PublicCoinSpend> publicSpend;
                             CValidationState state;
-                            if (!ZPIVModule::ParseZerocoinPublicSpend(txIn, tx, state, publicSpend)){
+                            if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend)){
                                 throw std::runtime_error("Invalid public spend parse");
                             }
-                            spend = &publicSpend;
+                            spend = publicSpend;
                         } else {
-                            libzerocoin::CoinSpend spendObj = TxInToZerocoinSpend(txIn);
-                            spend = &spendObj;
+                            spend = TxInToZerocoinSpend(tx, i);
                         }
 
                         bool fUseV1Params = libzerocoin::ExtractVersionFromSerial(spend->getCoinSerialNumber()) < libzerocoin::PrivateCoin::PUBKEY_VERSION;
@@ -25,6 +25,7 @@
 #include <string.h>
 #else
 #include <fcntl.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef USE_UPNP
@@ -34,6 +35,10 @@
 #include <miniupnpc/upnperrors.h>
 #endif
 
+#include <cmath>
+#include <limits>
+#include <memory>
+
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
@@ -44,6 +49,9 @@
 #define MSG_NOSIGNAL 0
 #endif
 
+// Most queued messages handed to the socket by a single sendmsg() call
+#define MAX_SEND_IOVECS 64
+
 // Fix for ancient MinGW versions, that don't have defined these in ws2tcpip.h.
 // Todo: Can be removed when our pull-tester is upgraded to a modern MinGW version.
 #ifdef WIN32
@@ -82,12 +90,14 @@ uint64_t nLocalHostNonce = 0;
 static std::vector<ListenSocket> vhListenSocket;
 CAddrMan addrman;
 int nMaxConnections = 125;
+int64_t nMaxSendRate[SEND_PRIORITY_MAX] = {};
 bool fAddressesInitialized = false;
 std::string strSubVersion;
 
 std::vector<CNode*> vNodes;
 CCriticalSection cs_vNodes;
-std::map<CInv, CDataStream> mapRelay;
+std::map<CInv, CSerializedNetMsg> mapRelay;
+CNetMessageBufferPool netMessageBufferPool;
 std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 CCriticalSection cs_mapRelay;
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
@@ -338,9 +348,104 @@ void AddressCurrentlyConnected(const CService& addr)
 
 uint64_t CNode::nTotalBytesRecv = 0;
 uint64_t CNode::nTotalBytesSent = 0;
+mapMsgCmdSize CNode::mapTotalBytesRecvPerMsgCmd;
+mapMsgCmdSize CNode::mapTotalBytesSentPerMsgCmd;
+uint64_t CNode::nTotalInvMessagesSent = 0;
+uint64_t CNode::nTotalInvsSent = 0;
+uint64_t CNode::nTotalInvBytesSent = 0;
+int64_t CNode::nInvStatsStartMillis = GetTimeMillis();
 CCriticalSection CNode::cs_totalBytesRecv;
 CCriticalSection CNode::cs_totalBytesSent;
 
+/** Key the bytes of the messages with a command we do not know are counted under */
+static const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
+
+static const char* ppszSendPriorityName[SEND_PRIORITY_MAX] = {"consensus", "masternode", "inventory", "bulk"};
+
+/** Send priority class of the commands we know */
+static const std::map<std::string, int> mapMsgCmdPriority = {
+    {"version", SEND_PRIORITY_CONSENSUS},
+    {"verack", SEND_PRIORITY_CONSENSUS},
+    {"ping", SEND_PRIORITY_CONSENSUS},
+    {"pong", SEND_PRIORITY_CONSENSUS},
+    {"reject", SEND_PRIORITY_CONSENSUS},
+    {"alert", SEND_PRIORITY_CONSENSUS},
+    {"spork", SEND_PRIORITY_CONSENSUS},
+    {"getsporks", SEND_PRIORITY_CONSENSUS},
+    {"getheaders", SEND_PRIORITY_CONSENSUS},
+    {"headers", SEND_PRIORITY_CONSENSUS},
+    {"cmpctblock", SEND_PRIORITY_CONSENSUS},
+    {"getblocktxn", SEND_PRIORITY_CONSENSUS},
+    {"blocktxn", SEND_PRIORITY_CONSENSUS},
+    {"mnb", SEND_PRIORITY_MASTERNODE},
+    {"mnp", SEND_PRIORITY_MASTERNODE},
+    {"mnw", SEND_PRIORITY_MASTERNODE},
+    {"mnget", SEND_PRIORITY_MASTERNODE},
+    {"mnvs", SEND_PRIORITY_MASTERNODE},
+    {"dseg", SEND_PRIORITY_MASTERNODE},
+    {"dsee", SEND_PRIORITY_MASTERNODE},
+    {"dseep", SEND_PRIORITY_MASTERNODE},
+    {"getmnlist", SEND_PRIORITY_MASTERNODE},
+    {"mnlist", SEND_PRIORITY_MASTERNODE},
+    {"mprop", SEND_PRIORITY_MASTERNODE},
+    {"mvote", SEND_PRIORITY_MASTERNODE},
+    {"fbs", SEND_PRIORITY_MASTERNODE},
+    {"fbvote", SEND_PRIORITY_MASTERNODE},
+    {"ssc", SEND_PRIORITY_MASTERNODE},
+    {"ix", SEND_PRIORITY_MASTERNODE},
+    {"txlvote", SEND_PRIORITY_MASTERNODE},
+    {"dstx", SEND_PRIORITY_MASTERNODE},
+    {"dsa", SEND_PRIORITY_MASTERNODE},
+    {"dsc", SEND_PRIORITY_MASTERNODE},
+    {"dsf", SEND_PRIORITY_MASTERNODE},
+    {"dsi", SEND_PRIORITY_MASTERNODE},
+    {"dsq", SEND_PRIORITY_MASTERNODE},
+    {"dsr", SEND_PRIORITY_MASTERNODE},
+    {"dss", SEND_PRIORITY_MASTERNODE},
+    {"dssu", SEND_PRIORITY_MASTERNODE},
+    {"inv", SEND_PRIORITY_INVENTORY},
+    {"getdata", SEND_PRIORITY_INVENTORY},
+    {"notfound", SEND_PRIORITY_INVENTORY},
+    {"getblocks", SEND_PRIORITY_INVENTORY},
+    {"mempool", SEND_PRIORITY_INVENTORY},
+    {"tx", SEND_PRIORITY_INVENTORY},
+    {"addr", SEND_PRIORITY_INVENTORY},
+    {"getaddr", SEND_PRIORITY_INVENTORY},
+    {"filterload", SEND_PRIORITY_INVENTORY},
+    {"filteradd", SEND_PRIORITY_INVENTORY},
+    {"filterclear", SEND_PRIORITY_INVENTORY},
+    // The transactions matching a filter follow their merkleblock, both are kept in the same queue
+    {"merkleblock", SEND_PRIORITY_INVENTORY},
+    {"block", SEND_PRIORITY_BULK},
+    {"pubcoins", SEND_PRIORITY_BULK},
+    {"genwit", SEND_PRIORITY_BULK},
+    {"accvalue", SEND_PRIORITY_BULK},
+    {"accvalueresponse", SEND_PRIORITY_BULK},
+};
+
+int GetSendPriority(const std::string& strCommand)
+{
+    std::map<std::string, int>::const_iterator it = mapMsgCmdPriority.find(strCommand);
+    return it == mapMsgCmdPriority.end() ? SEND_PRIORITY_INVENTORY : it->second;
+}
+
+std::string GetSendPriorityName(int nPriority)
+{
+    assert(nPriority >= 0 && nPriority < SEND_PRIORITY_MAX);
+    return ppszSendPriorityName[nPriority];
+}
+
+bool ParseSendPriority(const std::string& strName, int& nPriority)
+{
+    for (int i = 0; i < SEND_PRIORITY_MAX; i++) {
+        if (strName == ppszSendPriorityName[i]) {
+            nPriority = i;
+            return true;
+        }
+    }
+    return false;
+}
+
 CNode* FindNode(const CNetAddr& ip)
 {
     LOCK(cs_vNodes);
@@ -700,6 +805,17 @@ void CNode::copyStats(CNodeStats& stats)
 
     // Leave string empty if addrLocal invalid (not filled in yet)
     stats.addrLocal = addrLocal.IsValid() ? addrLocal.ToString() : "";
+
+    stats.nKnownFilterBytes = addrKnown.GetMemoryUsage() + filterInventoryKnown.GetMemoryUsage();
+
+    {
+        LOCK(cs_totalBytesSent);
+        X(mapSendBytesPerMsgCmd);
+    }
+    {
+        LOCK(cs_totalBytesRecv);
+        X(mapRecvBytesPerMsgCmd);
+    }
 }
 #undef X
 
@@ -710,7 +826,7 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
         // get current incomplete message, or create a new one
         if (vRecvMsg.empty() ||
             vRecvMsg.back().complete())
-            vRecvMsg.push_back(CNetMessage(SER_NETWORK, nRecvVersion));
+            vRecvMsg.emplace_back(SER_NETWORK, nRecvVersion);
 
         CNetMessage& msg = vRecvMsg.back();
 
@@ -734,6 +850,11 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
 
         if (msg.complete()) {
             msg.nTime = GetTimeMicros();
+            // Peers can make up commands, those are counted together
+            std::string strCommand = msg.hdr.GetCommand();
+            if (!mapMsgCmdPriority.count(strCommand))
+                strCommand = NET_MESSAGE_COMMAND_OTHER;
+            RecordMsgCmdBytesRecv(strCommand, msg.hdr.nMessageSize + CMessageHeader::HEADER_SIZE);
             messageHandlerCondition.notify_one();
         }
     }
@@ -744,22 +865,21 @@ bool CNode::ReceiveMsgBytes(const char* pch, unsigned int nBytes)
 int CNetMessage::readHeader(const char* pch, unsigned int nBytes)
 {
     // copy data to temporary parsing buffer
-    unsigned int nRemaining = 24 - nHdrPos;
+    unsigned int nRemaining = CMessageHeader::HEADER_SIZE - nHdrPos;
     unsigned int nCopy = std::min(nRemaining, nBytes);
 
     memcpy(&hdrbuf[nHdrPos], pch, nCopy);
     nHdrPos += nCopy;
 
     // if header incomplete, exit
-    if (nHdrPos < 24)
+    if (nHdrPos < CMessageHeader::HEADER_SIZE)
         return nCopy;
 
-    // deserialize to CMessageHeader
-    try {
-        hdrbuf >> hdr;
-    } catch (const std::exception&) {
-        return -1;
-    }
+    // deserialize to CMessageHeader, the way EndMessage lays it out
+    memcpy(hdr.pchMessageStart, &hdrbuf[0], MESSAGE_START_SIZE);
+    memcpy(hdr.pchCommand, &hdrbuf[MESSAGE_START_SIZE], CMessageHeader::COMMAND_SIZE);
+    memcpy(&hdr.nMessageSize, &hdrbuf[CMessageHeader::MESSAGE_SIZE_OFFSET], sizeof(hdr.nMessageSize));
+    memcpy(&hdr.nChecksum, &hdrbuf[CMessageHeader::CHECKSUM_OFFSET], sizeof(hdr.nChecksum));
 
     // reject messages larger than MAX_SIZE
     if (hdr.nMessageSize > MAX_SIZE)
@@ -767,6 +887,7 @@ int CNetMessage::readHeader(const char* pch, unsigned int nBytes)
 
     // switch state to reading message data
     in_data = true;
+    netMessageBufferPool.Get(vRecv, hdr.nMessageSize);
 
     return nCopy;
 }
@@ -782,31 +903,152 @@ int CNetMessage::readData(const char* pch, unsigned int nBytes)
     }
 
     memcpy(&vRecv[nDataPos], pch, nCopy);
+    hasher.Write((const unsigned char*)pch, nCopy);
     nDataPos += nCopy;
 
     return nCopy;
 }
 
+uint256 CNetMessage::GetMessageHash()
+{
+    assert(complete());
+    uint256 hash;
+    hasher.Finalize((unsigned char*)&hash);
+    return hash;
+}
+
+void CNetMessageBufferPool::Get(CDataStream& stream, unsigned int nSize)
+{
+    assert(stream.empty());
+    if (nSize <= MAX_EXACT_SIZE) {
+        stream.reserve(nSize);
+        return;
+    }
+    {
+        LOCK(cs);
+        if (nSize > BUFFER_SIZE) {
+            // Grown by readData as the data arrives
+            nAllocations++;
+            return;
+        }
+        if (!vBuffers.empty()) {
+            stream.swap(vBuffers.back());
+            vBuffers.pop_back();
+            nReuses++;
+            return;
+        }
+        nAllocations++;
+    }
+    stream.reserve(BUFFER_SIZE);
+}
+
+void CNetMessageBufferPool::Release(CDataStream& stream)
+{
+    CSerializeData data;
+    stream.clear();
+    stream.swap(data);
+    // Only the buffers of the fixed size are kept, the others are freed with data
+    if (data.capacity() < BUFFER_SIZE || data.capacity() > 2 * BUFFER_SIZE)
+        return;
+
+    LOCK(cs);
+    if (vBuffers.size() < MAX_POOLED_BUFFERS)
+        vBuffers.push_back(std::move(data));
+}
+
+uint64_t CNetMessageBufferPool::GetAllocations()
+{
+    LOCK(cs);
+    return nAllocations;
+}
+
+uint64_t CNetMessageBufferPool::GetReuses()
+{
+    LOCK(cs);
+    return nReuses;
+}
+
+
+int64_t PoissonNextSend(int64_t nNow, int nAverageInterval)
+{
+    // Exponentially distributed delay, from a uniform number in [0, 1) with 48 bits of precision
+    return nNow + (int64_t)(log1p(GetRand(1ULL << 48) * -0.0000000000000035527136788 /* -1/2^48 */) * nAverageInterval * -1000000.0 + 0.5);
+}
 
 // requires LOCK(cs_vSend)
 void SocketSendData(CNode* pnode)
 {
-    std::deque<CSerializeData>::iterator it = pnode->vSendMsg.begin();
+    pnode->RefillSendAllowance(GetTimeMicros());
 
-    while (it != pnode->vSendMsg.end()) {
-        const CSerializeData& data = *it;
-        assert(data.size() > pnode->nSendOffset);
+    while (true) {
+        // The rest of the message partly sent goes first, then the queues of the classes under their rate cap by priority
+        std::pair<int, const CSerializeData*> vMsgs[MAX_SEND_IOVECS];
+        size_t nMsgs = 0;
+        if (pnode->nSendOffset != 0)
+            vMsgs[nMsgs++] = std::make_pair(pnode->nSendPriority, pnode->vSendMsg[pnode->nSendPriority].front().get());
+        for (int nPriority = 0; nPriority < SEND_PRIORITY_MAX && nMsgs < MAX_SEND_IOVECS; nPriority++) {
+            if (!pnode->CanSend(nPriority))
+                continue;
+            const std::deque<CSerializedNetMsg>& queue = pnode->vSendMsg[nPriority];
+            // No more of a capped class than its allowance covers, give or take a message
+            bool fCapped = nMaxSendRate[nPriority] > 0;
+            int64_t nAllowance = pnode->nSendAllowance[nPriority];
+            size_t i = 0;
+            if (pnode->nSendOffset != 0 && nPriority == pnode->nSendPriority) {
+                nAllowance -= queue[0]->size() - pnode->nSendOffset;
+                i = 1;
+            }
+            for (; i < queue.size() && nMsgs < MAX_SEND_IOVECS && (!fCapped || nAllowance > 0); i++) {
+                vMsgs[nMsgs++] = std::make_pair(nPriority, queue[i].get());
+                nAllowance -= queue[i]->size();
+            }
+        }
+        if (nMsgs == 0)
+            break;
+
+        assert(vMsgs[0].second->size() > pnode->nSendOffset);
+#ifdef WIN32
+        const CSerializeData& data = *vMsgs[0].second;
         int nBytes = send(pnode->hSocket, &data[pnode->nSendOffset], data.size() - pnode->nSendOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+        // Hand the queued messages to the socket straight from their shared buffers, several at a time
+        struct iovec vIov[MAX_SEND_IOVECS];
+        for (size_t i = 0; i < nMsgs; i++) {
+            size_t nOffset = i == 0 ? pnode->nSendOffset : 0;
+            vIov[i].iov_base = (void*)&(*vMsgs[i].second)[nOffset];
+            vIov[i].iov_len = vMsgs[i].second->size() - nOffset;
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vIov;
+        msg.msg_iovlen = nMsgs;
+        ssize_t nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         if (nBytes > 0) {
             pnode->nLastSend = GetTime();
             pnode->nSendBytes += nBytes;
-            pnode->nSendOffset += nBytes;
             pnode->RecordBytesSent(nBytes);
-            if (pnode->nSendOffset == data.size()) {
+            // Messages sent in full leave their queue, the one cut short stays first in its own
+            size_t nSent = nBytes;
+            for (size_t i = 0; nSent > 0; i++) {
+                int nPriority = vMsgs[i].first;
+                size_t nSize = vMsgs[i].second->size();
+                size_t nLeft = nSize - pnode->nSendOffset;
+                assert(pnode->vSendMsg[nPriority].front().get() == vMsgs[i].second);
+                if (nMaxSendRate[nPriority] > 0)
+                    pnode->nSendAllowance[nPriority] -= (int64_t)std::min(nSent, nLeft);
+                if (nSent < nLeft) {
+                    pnode->nSendOffset += nSent;
+                    pnode->nSendPriority = nPriority;
+                    break;
+                }
+                nSent -= nLeft;
                 pnode->nSendOffset = 0;
-                pnode->nSendSize -= data.size();
-                it++;
-            } else {
+                pnode->nSendSize -= nSize;
+                pnode->nSendSizeByPriority[nPriority] -= nSize;
+                pnode->vSendMsg[nPriority].pop_front();
+            }
+            if (pnode->nSendOffset != 0) {
                 // could not send full message; stop sending more
                 break;
             }
@@ -824,11 +1066,7 @@ void SocketSendData(CNode* pnode)
         }
     }
 
-    if (it == pnode->vSendMsg.end()) {
-        assert(pnode->nSendOffset == 0);
-        assert(pnode->nSendSize == 0);
-    }
-    pnode->vSendMsg.erase(pnode->vSendMsg.begin(), it);
+    assert(pnode->nSendSize > 0 || pnode->nSendOffset == 0);
 }
 
 static std::list<CNode*> vNodesDisconnected;
@@ -946,9 +1184,13 @@ void ThreadSocketHandler()
                 // * We process a message in the buffer (message handler thread).
                 {
                     TRY_LOCK(pnode->cs_vSend, lockSend);
-                    if (lockSend && !pnode->vSendMsg.empty()) {
-                        FD_SET(pnode->hSocket, &fdsetSend);
-                        continue;
+                    if (lockSend && pnode->nSendSize > 0) {
+                        // Classes over their rate cap wait for the next round
+                        pnode->RefillSendAllowance(GetTimeMicros());
+                        if (pnode->HasSendableMessages()) {
+                            FD_SET(pnode->hSocket, &fdsetSend);
+                            continue;
+                        }
                     }
                 }
                 {
@@ -1267,10 +1509,19 @@ void ThreadDNSAddressSeed()
 
 void DumpAddresses()
 {
+    // Changes are batched until the next flush, and nothing is written when there are none
+    static uint64_t nChangesWritten = std::numeric_limits<uint64_t>::max();
+    uint64_t nChanges = addrman.GetChanges();
+    if (nChanges == nChangesWritten) {
+        LogPrint("net", "No changes to the %d addresses in peers.dat\n", addrman.size());
+        return;
+    }
+
     int64_t nStart = GetTimeMillis();
 
     CAddrDB adb;
-    adb.Write(addrman);
+    if (adb.Write(addrman))
+        nChangesWritten = nChanges;
 
     LogPrint("net", "Flushed %d addresses to peers.dat  %dms\n",
         addrman.size(), GetTimeMillis() - nStart);
@@ -1507,10 +1758,6 @@ void ThreadMessageHandler()
         }
 
         // Poll the connected nodes for messages
-        CNode* pnodeTrickle = NULL;
-        if (!vNodesCopy.empty())
-            pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
-
         bool fSleep = true;
 
         for (CNode* pnode : vNodesCopy) {
@@ -1524,11 +1771,13 @@ void ThreadMessageHandler()
                     if (!g_signals.ProcessMessages(pnode))
                         pnode->CloseSocketDisconnect();
 
-                    if (pnode->nSendSize < SendBufferSize()) {
-                        if (!pnode->vRecvGetData.empty() || (!pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete())) {
-                            fSleep = false;
-                        }
-                    }
+                    // Requests wait for room in the send buffer and for the filter work allowance to refill, the
+                    // messages behind them only if their answers would not overtake the requested data anyway
+                    bool fGetData = !pnode->vRecvGetData.empty() && pnode->nSendSize < SendBufferSize() && pnode->nNextGetDataTime <= GetTimeMicros();
+                    bool fMessage = !pnode->vRecvMsg.empty() && pnode->vRecvMsg[0].complete() && pnode->GetUncappedSendSize() < SendBufferSize() &&
+                                    (pnode->vRecvGetData.empty() || GetSendPriority(pnode->vRecvMsg[0].hdr.GetCommand()) <= SEND_PRIORITY_MASTERNODE);
+                    if (fGetData || fMessage)
+                        fSleep = false;
                 }
             }
             boost::this_thread::interruption_point();
@@ -1537,7 +1786,7 @@ void ThreadMessageHandler()
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
-                    g_signals.SendMessages(pnode, pnode == pnodeTrickle || pnode->fWhitelisted);
+                    g_signals.SendMessages(pnode);
             }
             boost::this_thread::interruption_point();
         }
@@ -1815,13 +2064,10 @@ void CExplicitNetCleanup::callCleanup()
 
 void RelayTransaction(const CTransaction& tx)
 {
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss.reserve(10000);
-    ss << tx;
-    RelayTransaction(tx, ss);
+    RelayTransaction(tx, MakeSerializedNetMsg("tx", tx));
 }
 
-void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
+void RelayTransaction(const CTransaction& tx, const CSerializedNetMsg& msg)
 {
     CInv inv(MSG_TX, tx.GetHash());
     {
@@ -1832,17 +2078,21 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
             vRelayExpiration.pop_front();
         }
 
-        // Save original serialized message so newer versions are preserved
-        mapRelay.insert(std::make_pair(inv, ss));
+        // Save original serialized message so newer versions are preserved, every getdata is answered with it
+        mapRelay.insert(std::make_pair(inv, msg));
         vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv));
     }
+    // The scripts of tx are parsed once, for the first filter that needs them
+    std::unique_ptr<CBloomTxElements> ptxElements;
     LOCK(cs_vNodes);
     for (CNode* pnode : vNodes) {
         if (!pnode->fRelayTxes)
             continue;
         LOCK(pnode->cs_filter);
         if (pnode->pfilter) {
-            if (pnode->pfilter->IsRelevantAndUpdate(tx))
+            if (!ptxElements && !pnode->pfilter->IsFullOrEmpty())
+                ptxElements.reset(new CBloomTxElements(tx));
+            if (ptxElements ? pnode->pfilter->IsRelevantAndUpdate(*ptxElements) : pnode->pfilter->IsRelevantAndUpdate(tx))
                 pnode->PushInventory(inv);
         } else
             pnode->PushInventory(inv);
@@ -1851,7 +2101,7 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
 
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll)
 {
-    CInv inv(MSG_TXLOCK_REQUEST, tx.GetHash());
+    CSerializedNetMsg msg = MakeSerializedNetMsg("ix", tx);
 
     //broadcast the new lock
     LOCK(cs_vNodes);
@@ -1859,7 +2109,7 @@ void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll)
         if (!relayToAll && !pnode->fRelayTxes)
             continue;
 
-        pnode->PushMessage("ix", tx);
+        pnode->PushSerializedMessage(msg);
     }
 }
 
@@ -1897,6 +2147,47 @@ uint64_t CNode::GetTotalBytesSent()
     return nTotalBytesSent;
 }
 
+void CNode::RecordMsgCmdBytesRecv(const std::string& strCommand, uint64_t nBytes)
+{
+    LOCK(cs_totalBytesRecv);
+    mapRecvBytesPerMsgCmd[strCommand] += nBytes;
+    mapTotalBytesRecvPerMsgCmd[strCommand] += nBytes;
+}
+
+void CNode::RecordMsgCmdBytesSent(const std::string& strCommand, uint64_t nBytes)
+{
+    LOCK(cs_totalBytesSent);
+    mapSendBytesPerMsgCmd[strCommand] += nBytes;
+    mapTotalBytesSentPerMsgCmd[strCommand] += nBytes;
+}
+
+void CNode::GetTotalBytesPerMsgCmd(mapMsgCmdSize& mapRecv, mapMsgCmdSize& mapSent)
+{
+    {
+        LOCK(cs_totalBytesRecv);
+        mapRecv = mapTotalBytesRecvPerMsgCmd;
+    }
+    LOCK(cs_totalBytesSent);
+    mapSent = mapTotalBytesSentPerMsgCmd;
+}
+
+void CNode::RecordInvSent(uint64_t nInvs, uint64_t nBytes)
+{
+    LOCK(cs_totalBytesSent);
+    nTotalInvMessagesSent++;
+    nTotalInvsSent += nInvs;
+    nTotalInvBytesSent += nBytes;
+}
+
+void CNode::GetTotalInvSent(uint64_t& nMessages, uint64_t& nInvs, uint64_t& nBytes, int64_t& nSinceMillis)
+{
+    LOCK(cs_totalBytesSent);
+    nMessages = nTotalInvMessagesSent;
+    nInvs = nTotalInvsSent;
+    nBytes = nTotalInvBytesSent;
+    nSinceMillis = nInvStatsStartMillis;
+}
+
 void CNode::Fuzz(int nChance)
 {
     if (!fSuccessfullyConnected) return; // Don't fuzz initial handshake
@@ -1954,12 +2245,12 @@ bool CAddrDB::Write(const CAddrMan& addr)
     uint256 hash = Hash(ssPeers.begin(), ssPeers.end());
     ssPeers << hash;
 
-    // open output file, and associate with CAutoFile
-    boost::filesystem::path pathAddr = GetDataDir() / "peers.dat";
-    FILE* file = fopen(pathAddr.string().c_str(), "wb");
+    // open temp output file, and associate with CAutoFile
+    boost::filesystem::path pathTmp = GetDataDir() / tmpfn;
+    FILE* file = fopen(pathTmp.string().c_str(), "wb");
     CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathAddr.string());
+        return error("%s : Failed to open file %s", __func__, pathTmp.string());
 
     // Write and commit header, data
     try {
@@ -1970,6 +2261,10 @@ bool CAddrDB::Write(const CAddrMan& addr)
     FileCommit(fileout.Get());
     fileout.fclose();
 
+    // replace existing peers.dat, if any, with new peers.dat.XXXX
+    if (!RenameOver(pathTmp, pathAddr))
+        return error("%s : Rename-into-place failed", __func__);
+
     return true;
 }
 
@@ -2028,7 +2323,7 @@ bool CAddrDB::Read(CAddrMan& addr)
 unsigned int ReceiveFloodSize() { return 1000 * GetArg("-maxreceivebuffer", 5 * 1000); }
 unsigned int SendBufferSize() { return 1000 * GetArg("-maxsendbuffer", 1 * 1000); }
 
-CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fInboundIn) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), setAddrKnown(5000)
+CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fInboundIn) : ssSend(SER_NETWORK, INIT_PROTO_VERSION), addrKnown(5000, 0.001), filterInventoryKnown(std::max(SendBufferSize() / 1000, 1U), 0.000001)
 {
     nServices = 0;
     hSocket = hSocketIn;
@@ -2053,12 +2348,22 @@ CNode::CNode(SOCKET hSocketIn, CAddress addrIn, std::string addrNameIn, bool fIn
     nRefCount = 0;
     nSendSize = 0;
     nSendOffset = 0;
+    nSendPriority = 0;
+    for (int nPriority = 0; nPriority < SEND_PRIORITY_MAX; nPriority++) {
+        nSendSizeByPriority[nPriority] = 0;
+        nSendAllowance[nPriority] = 0;
+    }
+    nSendAllowanceTime = 0;
     hashContinue = 0;
     nStartingHeight = -1;
     fGetAddr = false;
     fRelayTxes = false;
-    setInventoryKnown.max_size(SendBufferSize() / 1000);
+    nNextAddrSend = 0;
+    nNextInvSend = 0;
     pfilter = new CBloomFilter();
+    nFilterWork = 0;
+    nFilterWorkTime = 0;
+    nNextGetDataTime = 0;
     nPingNonceSent = 0;
     nPingUsecStart = 0;
     nPingUsecTime = 0;
@@ -2139,6 +2444,74 @@ void CNode::AbortMessage() UNLOCK_FUNCTION(cs_vSend)
     LogPrint("net", "(aborted)\n");
 }
 
+/** Fill in the payload size and checksum of the header the message ss holds starts with. */
+static unsigned int SetMessageSizeAndChecksum(CDataStream& ss)
+{
+    // Set the size
+    unsigned int nSize = ss.size() - CMessageHeader::HEADER_SIZE;
+    memcpy((char*)&ss[CMessageHeader::MESSAGE_SIZE_OFFSET], &nSize, sizeof(nSize));
+
+    // Set the checksum
+    uint256 hash = Hash(ss.begin() + CMessageHeader::HEADER_SIZE, ss.end());
+    unsigned int nChecksum = 0;
+    memcpy(&nChecksum, &hash, sizeof(nChecksum));
+    assert(ss.size() >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
+    memcpy((char*)&ss[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
+
+    return nSize;
+}
+
+CSerializedNetMsg FinalizeSerializedNetMsg(CDataStream& ss)
+{
+    SetMessageSizeAndChecksum(ss);
+    std::shared_ptr<CSerializeData> msg = std::make_shared<CSerializeData>();
+    ss.GetAndClear(*msg);
+    return msg;
+}
+
+void CNode::PushSerializedMessage(const CSerializedNetMsg& msg, int nPriority)
+{
+    const char* pchCommand = &(*msg)[MESSAGE_START_SIZE];
+    std::string strCommand(pchCommand, strnlen(pchCommand, CMessageHeader::COMMAND_SIZE));
+    if (nPriority < 0)
+        nPriority = GetSendPriority(strCommand);
+    assert(nPriority < SEND_PRIORITY_MAX);
+
+    LOCK(cs_vSend);
+    RecordMsgCmdBytesSent(strCommand, msg->size());
+    vSendMsg[nPriority].push_back(msg);
+    nSendSize += msg->size();
+    nSendSizeByPriority[nPriority] += msg->size();
+
+    // If write queue empty, attempt "optimistic write"
+    if (nSendSize == msg->size())
+        SocketSendData(this);
+}
+
+void CNode::RefillSendAllowance(int64_t nNow)
+{
+    // In steps of at least 10ms, so that rounding does not eat the allowance of the slow rates
+    int64_t nElapsed = std::min(nNow - nSendAllowanceTime, (int64_t)1000000);
+    if (nElapsed < 10000)
+        return;
+    nSendAllowanceTime = nNow;
+    for (int nPriority = 0; nPriority < SEND_PRIORITY_MAX; nPriority++) {
+        if (nMaxSendRate[nPriority] > 0)
+            nSendAllowance[nPriority] = std::min(nSendAllowance[nPriority] + nMaxSendRate[nPriority] * nElapsed / 1000000, nMaxSendRate[nPriority]);
+    }
+}
+
+bool CNode::HasSendableMessages() const
+{
+    if (nSendOffset != 0)
+        return true;
+    for (int nPriority = 0; nPriority < SEND_PRIORITY_MAX; nPriority++) {
+        if (!vSendMsg[nPriority].empty() && CanSend(nPriority))
+            return true;
+    }
+    return false;
+}
+
 void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
 {
     // The -*messagestest options are intentionally not documented in the help message,
@@ -2157,26 +2530,12 @@ void CNode::EndMessage() UNLOCK_FUNCTION(cs_vSend)
         return;
     }
 
-    // Set the size
-    unsigned int nSize = ssSend.size() - CMessageHeader::HEADER_SIZE;
-    memcpy((char*)&ssSend[CMessageHeader::MESSAGE_SIZE_OFFSET], &nSize, sizeof(nSize));
-
-    // Set the checksum
-    uint256 hash = Hash(ssSend.begin() + CMessageHeader::HEADER_SIZE, ssSend.end());
-    unsigned int nChecksum = 0;
-    memcpy(&nChecksum, &hash, sizeof(nChecksum));
-    assert(ssSend.size() >= CMessageHeader::CHECKSUM_OFFSET + sizeof(nChecksum));
-    memcpy((char*)&ssSend[CMessageHeader::CHECKSUM_OFFSET], &nChecksum, sizeof(nChecksum));
-
+    unsigned int nSize = SetMessageSizeAndChecksum(ssSend);
     LogPrint("net", "(%d bytes) peer=%d\n", nSize, id);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
-
-    // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
-        SocketSendData(this);
+    std::shared_ptr<CSerializeData> msg = std::make_shared<CSerializeData>();
+    ssSend.GetAndClear(*msg);
+    PushSerializedMessage(msg);
 
     LEAVE_CRITICAL_SECTION(cs_vSend);
 }
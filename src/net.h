@@ -12,7 +12,6 @@
 #include "compat.h"
 #include "hash.h"
 #include "limitedmap.h"
-#include "mruset.h"
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
@@ -22,6 +21,7 @@
 #include "utilstrencodings.h"
 
 #include <deque>
+#include <memory>
 #include <stdint.h>
 
 #ifndef WIN32
@@ -45,6 +45,10 @@ class thread_group;
 static const int PING_INTERVAL = 2 * 60;
 /** Time after which to disconnect, after waiting for a ping response (or inactivity). */
 static const int TIMEOUT_INTERVAL = 20 * 60;
+/** Average delay between the transaction announcements to an inbound peer (in seconds), halved for outbound peers. */
+static const int INVENTORY_BROADCAST_INTERVAL = 5;
+/** Average delay between the address announcements to a peer (in seconds). */
+static const int AVG_ADDRESS_BROADCAST_INTERVAL = 30;
 /** The maximum number of entries in an 'inv' protocol message */
 static const unsigned int MAX_INV_SZ = 50000;
 /** The maximum number of new addresses to accumulate before announcing. */
@@ -64,6 +68,26 @@ static const bool DEFAULT_UPNP = false;
 /** The maximum number of entries in mapAskFor */
 static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
 
+/** Classes of outgoing messages. Each peer has a send queue per class, and sends the first ones first. */
+enum SendPriority {
+    SEND_PRIORITY_CONSENSUS,  // handshake, pings, sporks, headers and compact blocks
+    SEND_PRIORITY_MASTERNODE, // masternode, budget, obfuscation and swiftx messages
+    SEND_PRIORITY_INVENTORY,  // inventory, transactions, addresses and any message not listed
+    SEND_PRIORITY_BULK,       // full blocks and light wallet data
+
+    SEND_PRIORITY_MAX
+};
+
+/** Send priority class of the messages with command strCommand */
+int GetSendPriority(const std::string& strCommand);
+/** Name of a send priority class, as taken by -maxsendrate */
+std::string GetSendPriorityName(int nPriority);
+/** Send priority class named strName, returns false if there is none */
+bool ParseSendPriority(const std::string& strName, int& nPriority);
+
+/** Upload rate cap of each send priority class, in bytes per second and per peer (0 for none) */
+extern int64_t nMaxSendRate[SEND_PRIORITY_MAX];
+
 unsigned int ReceiveFloodSize();
 unsigned int SendBufferSize();
 
@@ -82,14 +106,34 @@ bool BindListenPort(const CService& bindAddr, std::string& strError, bool fWhite
 void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler);
 bool StopNode();
 void SocketSendData(CNode* pnode);
+/** Time (in microseconds) of the next event of a Poisson process averaging one per nAverageInterval seconds. */
+int64_t PoissonNextSend(int64_t nNow, int nAverageInterval);
+
+/** A message serialized once, header included, and queued as is to any number of peers. */
+typedef std::shared_ptr<const CSerializeData> CSerializedNetMsg;
+
+/** Fill in the size and checksum of the message ss holds, and hand its buffer over to a CSerializedNetMsg. */
+CSerializedNetMsg FinalizeSerializedNetMsg(CDataStream& ss);
+
+/** Serialize the message pszCommand carrying obj, to send it to several peers with CNode::PushSerializedMessage. */
+template <typename T>
+CSerializedNetMsg MakeSerializedNetMsg(const char* pszCommand, const T& obj)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << CMessageHeader(pszCommand, 0) << obj;
+    return FinalizeSerializedNetMsg(ss);
+}
 
 typedef int NodeId;
 
+/** Bytes of network traffic, by message command */
+typedef std::map<std::string, uint64_t> mapMsgCmdSize;
+
 // Signals for message handling
 struct CNodeSignals {
     boost::signals2::signal<int()> GetHeight;
     boost::signals2::signal<bool(CNode*)> ProcessMessages;
-    boost::signals2::signal<bool(CNode*, bool)> SendMessages;
+    boost::signals2::signal<bool(CNode*)> SendMessages;
     boost::signals2::signal<void(NodeId, const CNode*)> InitializeNode;
     boost::signals2::signal<void(NodeId)> FinalizeNode;
 };
@@ -133,7 +177,7 @@ extern int nMaxConnections;
 
 extern std::vector<CNode*> vNodes;
 extern CCriticalSection cs_vNodes;
-extern std::map<CInv, CDataStream> mapRelay;
+extern std::map<CInv, CSerializedNetMsg> mapRelay;
 extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration;
 extern CCriticalSection cs_mapRelay;
 extern limitedmap<CInv, int64_t> mapAlreadyAskedFor;
@@ -175,32 +219,70 @@ public:
     double dPingTime;
     double dPingWait;
     std::string addrLocal;
+    size_t nKnownFilterBytes;
+    mapMsgCmdSize mapSendBytesPerMsgCmd;
+    mapMsgCmdSize mapRecvBytesPerMsgCmd;
 };
 
 
+/** Data buffers of received messages, recycled so that a steady flow of messages does not allocate. */
+class CNetMessageBufferPool
+{
+private:
+    CCriticalSection cs;
+    std::vector<CSerializeData> vBuffers;
+    uint64_t nAllocations; // messages above MAX_EXACT_SIZE that got a new buffer
+    uint64_t nReuses;      // messages above MAX_EXACT_SIZE that got a pooled buffer
+
+public:
+    //! Capacity of the pooled buffers, larger messages get a buffer of their own
+    static const size_t BUFFER_SIZE = 64 * 1024;
+    //! Messages up to this size get a buffer of their exact size, so a flood of small ones can't pin pooled buffers
+    static const size_t MAX_EXACT_SIZE = 4 * 1024;
+    //! Most buffers kept for reuse
+    static const size_t MAX_POOLED_BUFFERS = 64;
+
+    CNetMessageBufferPool() : nAllocations(0), nReuses(0) {}
+
+    /** Give the empty stream a buffer for a message of nSize bytes. */
+    void Get(CDataStream& stream, unsigned int nSize);
+    /** Take back the buffer of stream, which is left empty. */
+    void Release(CDataStream& stream);
+
+    uint64_t GetAllocations();
+    uint64_t GetReuses();
+};
+
+extern CNetMessageBufferPool netMessageBufferPool;
+
 class CNetMessage
 {
 public:
     bool in_data; // parsing header (false) or data (true)
 
-    CDataStream hdrbuf; // partially received header
+    char hdrbuf[CMessageHeader::HEADER_SIZE]; // partially received header
     CMessageHeader hdr; // complete header
     unsigned int nHdrPos;
 
-    CDataStream vRecv; // received message data
+    CDataStream vRecv; // received message data, in a buffer of netMessageBufferPool
     unsigned int nDataPos;
+    CHash256 hasher; // checksum of the data, computed as it arrives
 
     int64_t nTime; // time (in microseconds) of message receipt.
 
-    CNetMessage(int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), vRecv(nTypeIn, nVersionIn)
+    CNetMessage(int nTypeIn, int nVersionIn) : vRecv(nTypeIn, nVersionIn)
     {
-        hdrbuf.resize(24);
         in_data = false;
         nHdrPos = 0;
         nDataPos = 0;
         nTime = 0;
     }
 
+    ~CNetMessage()
+    {
+        netMessageBufferPool.Release(vRecv);
+    }
+
     bool complete() const
     {
         if (!in_data)
@@ -210,12 +292,14 @@ public:
 
     void SetVersion(int nVersionIn)
     {
-        hdrbuf.SetVersion(nVersionIn);
         vRecv.SetVersion(nVersionIn);
     }
 
     int readHeader(const char* pch, unsigned int nBytes);
     int readData(const char* pch, unsigned int nBytes);
+
+    /** Double SHA256 of the complete message data, the first 4 bytes of which are its checksum. Call once. */
+    uint256 GetMessageHash();
 };
 
 
@@ -290,15 +374,22 @@ public:
     SOCKET hSocket;
     CDataStream ssSend;
     size_t nSendSize;   // total size of all vSendMsg entries
-    size_t nSendOffset; // offset inside the first vSendMsg already sent
+    size_t nSendSizeByPriority[SEND_PRIORITY_MAX]; // total size of the vSendMsg entries of each class
+    size_t nSendOffset; // offset inside the message partly sent, the first one of vSendMsg[nSendPriority]
+    int nSendPriority;  // class of the message partly sent, meaningful while nSendOffset is not 0
     uint64_t nSendBytes;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<CSerializedNetMsg> vSendMsg[SEND_PRIORITY_MAX]; // queued messages, by send priority class
+    int64_t nSendAllowance[SEND_PRIORITY_MAX];                 // bytes the classes with a rate cap may still send
+    int64_t nSendAllowanceTime;                                // time of the last refill of nSendAllowance, in usec
+    mapMsgCmdSize mapSendBytesPerMsgCmd;                       // bytes queued, by command (guarded by cs_totalBytesSent)
     CCriticalSection cs_vSend;
 
     std::deque<CInv> vRecvGetData;
+    int64_t nNextGetDataTime; // vRecvGetData waits for the filter work allowance to refill until then, in usec
     std::deque<CNetMessage> vRecvMsg;
     CCriticalSection cs_vRecvMsg;
     uint64_t nRecvBytes;
+    mapMsgCmdSize mapRecvBytesPerMsgCmd; // bytes of the complete messages received, by command (guarded by cs_totalBytesRecv)
     int nRecvVersion;
 
     int64_t nLastSend;
@@ -335,6 +426,8 @@ public:
     CSemaphoreGrant grantOutbound;
     CCriticalSection cs_filter;
     CBloomFilter* pfilter;
+    int64_t nFilterWork;     // transactions this peer may still have matched against its filter, negative after a large request (guarded by cs_filter)
+    int64_t nFilterWorkTime; // time of the last refill of nFilterWork, in usec
     int nRefCount;
     NodeId id;
 
@@ -361,13 +454,17 @@ public:
 
     // flood relay
     std::vector<CAddress> vAddrToSend;
-    mruset<CAddress> setAddrKnown;
+    CRollingBloomFilter addrKnown;
     bool fGetAddr;
     std::set<uint256> setKnown;
+    int64_t nNextAddrSend;
 
     // inventory based relay
-    mruset<CInv> setInventoryKnown;
-    std::vector<CInv> vInventoryToSend;
+    CRollingBloomFilter filterInventoryKnown; // last SendBufferSize() / 1000 items, by type and hash, at 1e-6, about 14 KB by default
+    std::vector<CInv> vInventoryToSend;     // announced at the next SendMessages
+    std::vector<uint256> vInventoryTxToSend; // transactions, announced together at nNextInvSend in relay order, parents first
+    std::set<uint256> setInventoryTxToSend;  // the same transactions, to merge duplicates
+    int64_t nNextInvSend;
     CCriticalSection cs_inventory;
     std::multimap<int64_t, CInv> mapAskFor;
     std::vector<uint256> vBlockRequested;
@@ -391,6 +488,13 @@ private:
     static CCriticalSection cs_totalBytesSent;
     static uint64_t nTotalBytesRecv;
     static uint64_t nTotalBytesSent;
+    static mapMsgCmdSize mapTotalBytesRecvPerMsgCmd;
+    static mapMsgCmdSize mapTotalBytesSentPerMsgCmd;
+    // Inventory announcements totals, since nInvStatsStartMillis
+    static uint64_t nTotalInvMessagesSent;
+    static uint64_t nTotalInvsSent;
+    static uint64_t nTotalInvBytesSent;
+    static int64_t nInvStatsStartMillis;
 
     CNode(const CNode&);
     void operator=(const CNode&);
@@ -410,15 +514,44 @@ public:
     // requires LOCK(cs_vRecvMsg)
     unsigned int GetTotalRecvSize()
     {
+        // Memory held rather than bytes received, buffers are reserved ahead of the data
         unsigned int total = 0;
         for (const CNetMessage& msg : vRecvMsg)
-            total += msg.vRecv.size() + 24;
+            total += msg.vRecv.capacity() + sizeof(CNetMessage);
         return total;
     }
 
     // requires LOCK(cs_vRecvMsg)
     bool ReceiveMsgBytes(const char* pch, unsigned int nBytes);
 
+    // requires LOCK(cs_vSend)
+    /** Give the classes with a rate cap the allowance they earned since the last refill, up to a second of it. */
+    void RefillSendAllowance(int64_t nNow);
+
+    // requires LOCK(cs_vSend)
+    bool CanSend(int nPriority) const
+    {
+        return nMaxSendRate[nPriority] == 0 || nSendAllowance[nPriority] > 0;
+    }
+
+    // requires LOCK(cs_vSend)
+    /** Whether some queued message can be sent now: the one partly sent, or one in a class under its rate cap. */
+    bool HasSendableMessages() const;
+
+    /**
+     * Bytes queued in the classes without a rate cap. A capped class drains at its own pace whatever the
+     * peer sends, so its backlog is left out of the send buffer checks that hold up the peer's messages.
+     */
+    size_t GetUncappedSendSize() const
+    {
+        size_t nSize = 0;
+        for (int nPriority = 0; nPriority < SEND_PRIORITY_MAX; nPriority++) {
+            if (nMaxSendRate[nPriority] == 0)
+                nSize += nSendSizeByPriority[nPriority];
+        }
+        return nSize;
+    }
+
     // requires LOCK(cs_vRecvMsg)
     void SetRecvVersion(int nVersionIn)
     {
@@ -441,7 +574,7 @@ public:
 
     void AddAddressKnown(const CAddress& addr)
     {
-        setAddrKnown.insert(addr);
+        addrKnown.insert(addr.GetKey());
     }
 
     void PushAddress(const CAddress& addr)
@@ -449,7 +582,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
-        if (addr.IsValid() && !setAddrKnown.count(addr)) {
+        if (addr.IsValid() && !addrKnown.contains(addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand() % vAddrToSend.size()] = addr;
             } else {
@@ -463,17 +596,21 @@ public:
     {
         {
             LOCK(cs_inventory);
-            setInventoryKnown.insert(inv);
+            filterInventoryKnown.insert(inv);
         }
     }
 
     void PushInventory(const CInv& inv)
     {
-        {
-            LOCK(cs_inventory);
-            if (!setInventoryKnown.count(inv))
-                vInventoryToSend.push_back(inv);
-        }
+        LOCK(cs_inventory);
+        if (filterInventoryKnown.contains(inv))
+            return;
+        // Transactions wait for the next scheduled announcement, where duplicates are merged
+        if (inv.type == MSG_TX) {
+            if (setInventoryTxToSend.insert(inv.hash).second)
+                vInventoryTxToSend.push_back(inv.hash);
+        } else
+            vInventoryToSend.push_back(inv);
     }
 
     void AskFor(const CInv& inv);
@@ -489,6 +626,9 @@ public:
 
     void PushVersion();
 
+    /** Queue a message that may be shared with other peers, without copying it, in the queue of nPriority or else of its command. */
+    void PushSerializedMessage(const CSerializedNetMsg& msg, int nPriority = -1);
+
 
     void PushMessage(const char* pszCommand)
     {
@@ -731,6 +871,15 @@ public:
 
     static uint64_t GetTotalBytesRecv();
     static uint64_t GetTotalBytesSent();
+
+    // Network stats by message command
+    void RecordMsgCmdBytesRecv(const std::string& strCommand, uint64_t nBytes);
+    void RecordMsgCmdBytesSent(const std::string& strCommand, uint64_t nBytes);
+    static void GetTotalBytesPerMsgCmd(mapMsgCmdSize& mapRecv, mapMsgCmdSize& mapSent);
+
+    // Inventory announcement stats
+    static void RecordInvSent(uint64_t nInvs, uint64_t nBytes);
+    static void GetTotalInvSent(uint64_t& nMessages, uint64_t& nInvs, uint64_t& nBytes, int64_t& nSinceMillis);
 };
 
 class CExplicitNetCleanup
@@ -741,7 +890,7 @@ public:
 
 class CTransaction;
 void RelayTransaction(const CTransaction& tx);
-void RelayTransaction(const CTransaction& tx, const CDataStream& ss);
+void RelayTransaction(const CTransaction& tx, const CSerializedNetMsg& msg);
 void RelayTransactionLockReq(const CTransaction& tx, bool relayToAll = false);
 void RelayInv(CInv& inv);
 
@@ -999,6 +999,14 @@ uint64_t CNetAddr::GetHash() const
     return nRet;
 }
 
+uint64_t CNetAddr::GetSipHash(uint64_t k0, uint64_t k1) const
+{
+    uint64_t nLow, nHigh;
+    memcpy(&nLow, &ip[0], sizeof(nLow));
+    memcpy(&nHigh, &ip[8], sizeof(nHigh));
+    return CSipHasher(k0, k1).Write(nLow).Write(nHigh).Finalize();
+}
+
 // private extensions to enum Network, only returned by GetExtNetwork,
 // and only used in GetReachabilityFrom
 static const int NET_UNKNOWN = NET_MAX + 0;
@@ -86,6 +86,7 @@ public:
     std::string ToStringIP() const;
     unsigned int GetByte(int n) const;
     uint64_t GetHash() const;
+    uint64_t GetSipHash(uint64_t k0, uint64_t k1) const; // keyed hash, cheap enough for hash tables
     bool GetInAddr(struct in_addr* pipv4Addr) const;
     std::vector<unsigned char> GetGroup() const;
     int GetReachabilityFrom(const CNetAddr* paddrPartner = NULL) const;
@@ -37,7 +37,8 @@ static const char* ppszTypeName[] =
         "dstx",
         "pubcoins",
         "genwit",
-        "accvalue"
+        "accvalue",
+        "compact block"
     };
 
 CMessageHeader::CMessageHeader()
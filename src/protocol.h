@@ -178,7 +178,9 @@ enum {
     MSG_DSTX,
     MSG_PUBCOINS,
     MSG_GENWIT,
-    MSG_ACC_VALUE
+    MSG_ACC_VALUE,
+    // Only used in getdata, answered with "cmpctblock" (or "block" for an old block)
+    MSG_CMPCT_BLOCK
 };
 
 #endif // BITCOIN_PROTOCOL_H
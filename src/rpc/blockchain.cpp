@@ -1366,6 +1366,7 @@ UniValue getserials(const UniValue& params, bool fHelp) {
         throw std::runtime_error(
             "getserials height range ( fVerbose )\n"
             "\nLook the inputs of any tx in a range of blocks and returns the serial numbers for any coinspend.\n"
+            "With -zerocoinindex the serials are read from the zerocoin block index instead of the blocks.\n"
 
             "\nArguments:\n"
             "1. starting_height   (numeric, required) the height of the first block to check\n"
@@ -1393,76 +1394,49 @@ UniValue getserials(const UniValue& params, bool fHelp) {
     if (!pblockindex)
         throw JSONRPCError(RPC_INVALID_PARAMETER, "invalid block height");
 
-    UniValue serialsObj(UniValue::VOBJ);    // for fVerbose
     UniValue serialsArr(UniValue::VARR);
+    int64_t nTimeStart = GetTimeMicros();
 
     while (true) {
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pblockindex))
-                throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        // with -zerocoinindex the spends come from the index instead of the block body
+        CZerocoinBlockIndex zerocoinIndex;
+        if (!GetZerocoinBlockIndex(pblockindex, zerocoinIndex))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, strprintf("Can't read zerocoin data of block %d", pblockindex->nHeight));
+
+        for (const CZerocoinIndexEntry& spend : zerocoinIndex.vSpends) {
+            std::string serial_str = spend.bnValue.ToString(16);
+            if (!fVerbose) {
+                serialsArr.push_back(serial_str);
+                continue;
+            }
 
-        // loop through each tx in the block
-        for (const CTransaction& tx : block.vtx) {
-            std::string txid = tx.GetHash().GetHex();
-            // collect the destination (first output) if fVerbose
+            // collect the destination (first output)
             std::string spentTo = "";
-            if (fVerbose) {
-                if (tx.vout[0].IsZerocoinMint()) {
-                    spentTo = "Zerocoin Mint";
-                } else if (tx.vout[0].IsEmpty()) {
-                    spentTo = "Zerocoin Stake";
+            if (spend.txoutFirst.IsZerocoinMint()) {
+                spentTo = "Zerocoin Mint";
+            } else if (spend.txoutFirst.IsEmpty()) {
+                spentTo = "Zerocoin Stake";
+            } else {
+                txnouttype type;
+                std::vector<CTxDestination> addresses;
+                int nRequired;
+                if (!ExtractDestinations(spend.txoutFirst.scriptPubKey, type, addresses, nRequired)) {
+                    spentTo = strprintf("type: %d", GetTxnOutputType(type));
                 } else {
-                    txnouttype type;
-                    std::vector<CTxDestination> addresses;
-                    int nRequired;
-                    if (!ExtractDestinations(tx.vout[0].scriptPubKey, type, addresses, nRequired)) {
-                        spentTo = strprintf("type: %d", GetTxnOutputType(type));
-                    } else {
-                        spentTo = CBitcoinAddress(addresses[0]).ToString();
-                    }
+                    spentTo = CBitcoinAddress(addresses[0]).ToString();
                 }
             }
-            // loop through each input
-            for (const CTxIn& txin : tx.vin) {
-                bool isPublicSpend =  txin.IsZerocoinPublicSpend();
-                if (txin.IsZerocoinSpend() || isPublicSpend) {
-                    std::string serial_str;
-                    int denom;
-                    if (isPublicSpend) {
-                        CTxOut prevOut;
-                        CValidationState state;
-                        if(!GetOutput(txin.prevout.hash, txin.prevout.n, state, prevOut)){
-                            throw JSONRPCError(RPC_INTERNAL_ERROR, "public zerocoin spend prev output not found");
-                        }
-                        libzerocoin::ZerocoinParams *params = Params().Zerocoin_Params(false);
-                        PublicCoinSpend publicSpend(params);
-                        if (!ZPIVModule::parseCoinSpend(txin, tx, prevOut, publicSpend)) {
-                            throw JSONRPCError(RPC_INTERNAL_ERROR, "public zerocoin spend parse failed");
-                        }
-                        serial_str = publicSpend.getCoinSerialNumber().ToString(16);
-                        denom = libzerocoin::ZerocoinDenominationToInt(publicSpend.getDenomination());
-                    } else {
-                        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txin);
-                        serial_str = spend.getCoinSerialNumber().ToString(16);
-                        denom = libzerocoin::ZerocoinDenominationToInt(spend.getDenomination());
-                    }
-                    if (!fVerbose) {
-                        serialsArr.push_back(serial_str);
-                    } else {
-                        UniValue s(UniValue::VOBJ);
-                        s.push_back(Pair("serial", serial_str));
-                        s.push_back(Pair("denom", denom));
-                        s.push_back(Pair("bitsize", (int)serial_str.size()*4));
-                        s.push_back(Pair("spentTo", spentTo));
-                        s.push_back(Pair("txid", txid));
-                        s.push_back(Pair("blocknum", pblockindex->nHeight));
-                        s.push_back(Pair("blocktime", block.GetBlockTime()));
-                        serialsArr.push_back(s);
-                    }
-                }
 
-            } // end for vin in tx
-        } // end for tx in block
+            UniValue s(UniValue::VOBJ);
+            s.push_back(Pair("serial", serial_str));
+            s.push_back(Pair("denom", libzerocoin::ZerocoinDenominationToInt(spend.denom)));
+            s.push_back(Pair("bitsize", (int)serial_str.size()*4));
+            s.push_back(Pair("spentTo", spentTo));
+            s.push_back(Pair("txid", spend.txid.GetHex()));
+            s.push_back(Pair("blocknum", pblockindex->nHeight));
+            s.push_back(Pair("blocktime", pblockindex->GetBlockTime()));
+            serialsArr.push_back(s);
+        }
 
         if (pblockindex->nHeight < heightEnd) {
             LOCK(cs_main);
@@ -1473,6 +1447,9 @@ UniValue getserials(const UniValue& params, bool fHelp) {
 
     } // end for blocks
 
+    LogPrint("bench", "getserials: %d blocks in %.2fms (zerocoin index %s)\n", heightEnd - heightStart + 1,
+             0.001 * (GetTimeMicros() - nTimeStart), fZerocoinIndex ? "on" : "off");
+
     return serialsArr;
 
 }
@@ -1655,3 +1632,77 @@ UniValue getblockindexstats(const UniValue& params, bool fHelp) {
 
 }
 
+
+UniValue getlightzpivstatus(const UniValue& params, bool fHelp) {
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+                "getlightzpivstatus\n"
+                "\nReturns the state of the witness requests served to zerocoin light nodes.\n"
+
+                "\nResult:\n"
+                "{\n"
+                "  \"threads\": n                (numeric) Threads computing witnesses\n"
+                "  \"queued\": n                 (numeric) Requests waiting for a thread\n"
+                "  \"running\": n                (numeric) Requests being computed\n"
+                "  \"completed\": n              (numeric) Requests answered with a witness\n"
+                "  \"rejected\": n               (numeric) Requests answered with an error\n"
+                "  \"peerlimited\": n            (numeric) Requests refused because the peer had too many pending\n"
+                "  \"rangecomputed\": n          (numeric) Block ranges read from disk\n"
+                "  \"rangeshared\": n            (numeric) Requests served from a range computed for another request\n"
+                "  \"avglatency_ms\": n.nn       (numeric) Average time from queueing to answer\n"
+                "  \"maxlatency_ms\": n.nn       (numeric) Longest time from queueing to answer\n"
+                "  \"requests\": [\n"
+                "    {\n"
+                "      \"peer\": n               (numeric) Peer id\n"
+                "      \"requestnum\": n         (numeric) Request number given by the peer\n"
+                "      \"denomination\": n       (numeric) Coin denomination\n"
+                "      \"startheight\": n        (numeric) Height the witness starts from\n"
+                "      \"state\": \"xxxx\"         (string) \"queued\" or \"running\"\n"
+                "      \"sharedrange\": true|false (boolean) Waiting on a range computed for another request\n"
+                "      \"blocksdone\": n         (numeric) Blocks of the range read so far\n"
+                "      \"blockstotal\": n        (numeric) Blocks in the range\n"
+                "      \"waiting_ms\": n.nn      (numeric) Time since the request was queued\n"
+                "    }, ...\n"
+                "  ]\n"
+                "}\n"
+
+                "\nExamples:\n" +
+                HelpExampleCli("getlightzpivstatus", "") +
+                HelpExampleRpc("getlightzpivstatus", ""));
+
+    CLightWorkerStats stats = lightWorker.GetStats();
+    uint64_t nAnswered = stats.nCompleted + stats.nRejected;
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("threads", stats.nThreads));
+    ret.push_back(Pair("queued", (int64_t)stats.nQueued));
+    ret.push_back(Pair("running", (int64_t)stats.nRunning));
+    ret.push_back(Pair("completed", (int64_t)stats.nCompleted));
+    ret.push_back(Pair("rejected", (int64_t)stats.nRejected));
+    ret.push_back(Pair("peerlimited", (int64_t)stats.nPeerLimited));
+    ret.push_back(Pair("rangecomputed", (int64_t)stats.nRangeComputed));
+    ret.push_back(Pair("rangeshared", (int64_t)stats.nRangeShared));
+    ret.push_back(Pair("avglatency_ms", nAnswered ? 0.001 * stats.nTotalLatency / nAnswered : 0.0));
+    ret.push_back(Pair("maxlatency_ms", 0.001 * stats.nMaxLatency));
+
+    int64_t nNow = GetTimeMicros();
+    UniValue requests(UniValue::VARR);
+    for (const CLightRequestStatus& status : lightWorker.GetRequests()) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("peer", (int64_t)status.nodeId));
+        obj.push_back(Pair("requestnum", status.nRequestNum));
+        obj.push_back(Pair("denomination", libzerocoin::ZerocoinDenominationToInt(status.den)));
+        obj.push_back(Pair("startheight", status.nStartingHeight));
+        obj.push_back(Pair("state", status.fRunning ? "running" : "queued"));
+        obj.push_back(Pair("sharedrange", status.fSharedRange));
+        if (status.progress) {
+            obj.push_back(Pair("blocksdone", status.progress->nBlocksDone.load()));
+            obj.push_back(Pair("blockstotal", status.progress->nBlocksTotal));
+        }
+        obj.push_back(Pair("waiting_ms", 0.001 * (nNow - status.nTimeQueued)));
+        requests.push_back(obj);
+    }
+    ret.push_back(Pair("requests", requests));
+
+    return ret;
+}
@@ -10,11 +10,15 @@
 #include "clientversion.h"
 #include "init.h"
 #include "main.h"
+#include "masternode-budget.h"
+#include "masternode-payments.h"
 #include "masternode-sync.h"
+#include "masternodeman.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
 #include "spork.h"
+#include "swifttx.h"
 #include "timedata.h"
 #include "util.h"
 #ifdef ENABLE_WALLET
@@ -181,6 +185,7 @@ UniValue mnsync(const UniValue& params, bool fHelp)
             "  \"countMasternodeWinner\": n,    (numeric) Number of MN winner messages (local)\n"
             "  \"countBudgetItemProp\": n,      (numeric) Number of MN budget messages (local)\n"
             "  \"countBudgetItemFin\": n,       (numeric) Number of MN budget finalization messages (local)\n"
+            "  \"countMasternodeListDiff\": n,  (numeric) Number of complete MN list snapshots or diffs (local)\n"
             "  \"RequestedMasternodeAssets\": n, (numeric) Status code of last sync phase\n"
             "  \"RequestedMasternodeAttempt\": n, (numeric) Status code of last sync attempt\n"
             "}\n"
@@ -209,6 +214,7 @@ UniValue mnsync(const UniValue& params, bool fHelp)
         obj.push_back(Pair("countMasternodeWinner", masternodeSync.countMasternodeWinner));
         obj.push_back(Pair("countBudgetItemProp", masternodeSync.countBudgetItemProp));
         obj.push_back(Pair("countBudgetItemFin", masternodeSync.countBudgetItemFin));
+        obj.push_back(Pair("countMasternodeListDiff", masternodeSync.countMasternodeListDiff));
         obj.push_back(Pair("RequestedMasternodeAssets", masternodeSync.RequestedMasternodeAssets));
         obj.push_back(Pair("RequestedMasternodeAttempt", masternodeSync.RequestedMasternodeAttempt));
 
@@ -331,6 +337,95 @@ UniValue spork(const UniValue& params, bool fHelp)
         HelpExampleCli("spork", "show") + HelpExampleRpc("spork", "show"));
 }
 
+static UniValue MemoryInfoToJSON(const expiringmap_stats& stats)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("size", (uint64_t)stats.nSize));
+    obj.push_back(Pair("usage", (uint64_t)stats.nUsage));
+    obj.push_back(Pair("max_usage", (uint64_t)stats.nMaxUsage));
+    return obj;
+}
+
+UniValue getmemoryinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw std::runtime_error(
+            "getmemoryinfo\n"
+            "\nReturns the number of entries and approximate memory usage of the masternode, budget and SwiftX message maps.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"masternodes\": {             (object) masternode manager maps\n"
+            "    \"seenbroadcasts\": {        (object) seen masternode broadcasts\n"
+            "      \"size\": n,               (numeric) number of entries\n"
+            "      \"usage\": n,              (numeric) approximate memory usage in bytes\n"
+            "      \"max_usage\": n           (numeric) memory cap in bytes, 0 if unbounded\n"
+            "    },\n"
+            "    \"seenpings\": {...}         (object) seen masternode pings\n"
+            "  },\n"
+            "  \"mnpayments\": {\n"
+            "    \"payeevotes\": {...}        (object) masternode payment winner votes\n"
+            "  },\n"
+            "  \"budget\": {\n"
+            "    \"seenproposals\": {...},\n"
+            "    \"seenproposalvotes\": {...},\n"
+            "    \"orphanproposalvotes\": {...},\n"
+            "    \"seenfinalizedbudgets\": {...},\n"
+            "    \"seenfinalizedbudgetvotes\": {...},\n"
+            "    \"orphanfinalizedbudgetvotes\": {...}\n"
+            "  },\n"
+            "  \"swifttx\": {\n"
+            "    \"lockrequests\": {...},\n"
+            "    \"lockvotes\": {...},\n"
+            "    \"locks\": {...}\n"
+            "  }\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getmemoryinfo", "") + HelpExampleRpc("getmemoryinfo", ""));
+
+    UniValue ret(UniValue::VOBJ);
+
+    {
+        expiringmap_stats broadcasts, pings;
+        mnodeman.GetSeenMapStats(broadcasts, pings);
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("seenbroadcasts", MemoryInfoToJSON(broadcasts)));
+        obj.push_back(Pair("seenpings", MemoryInfoToJSON(pings)));
+        ret.push_back(Pair("masternodes", obj));
+    }
+
+    {
+        LOCK(cs_mapMasternodePayeeVotes);
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("payeevotes", MemoryInfoToJSON(masternodePayments.mapMasternodePayeeVotes.stats())));
+        ret.push_back(Pair("mnpayments", obj));
+    }
+
+    {
+        LOCK(budget.cs);
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("seenproposals", MemoryInfoToJSON(budget.mapSeenMasternodeBudgetProposals.stats())));
+        obj.push_back(Pair("seenproposalvotes", MemoryInfoToJSON(budget.mapSeenMasternodeBudgetVotes.stats())));
+        obj.push_back(Pair("orphanproposalvotes", MemoryInfoToJSON(budget.mapOrphanMasternodeBudgetVotes.stats())));
+        obj.push_back(Pair("seenfinalizedbudgets", MemoryInfoToJSON(budget.mapSeenFinalizedBudgets.stats())));
+        obj.push_back(Pair("seenfinalizedbudgetvotes", MemoryInfoToJSON(budget.mapSeenFinalizedBudgetVotes.stats())));
+        obj.push_back(Pair("orphanfinalizedbudgetvotes", MemoryInfoToJSON(budget.mapOrphanFinalizedBudgetVotes.stats())));
+        ret.push_back(Pair("budget", obj));
+    }
+
+    {
+        LOCK(cs_swifttx);
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("lockrequests", MemoryInfoToJSON(mapTxLockReq.stats())));
+        obj.push_back(Pair("lockvotes", MemoryInfoToJSON(mapTxLockVote.stats())));
+        obj.push_back(Pair("locks", MemoryInfoToJSON(mapTxLocks.stats())));
+        ret.push_back(Pair("swifttx", obj));
+    }
+
+    return ret;
+}
+
 UniValue validateaddress(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
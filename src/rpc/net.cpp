@@ -75,6 +75,16 @@ static void CopyNodeStats(std::vector<CNodeStats>& vstats)
     }
 }
 
+static UniValue MsgCmdSizeToJSON(const mapMsgCmdSize& mapBytes)
+{
+    UniValue obj(UniValue::VOBJ);
+    for (const mapMsgCmdSize::value_type& item : mapBytes) {
+        if (item.second > 0)
+            obj.push_back(Pair(item.first, item.second));
+    }
+    return obj;
+}
+
 UniValue getpeerinfo(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -101,13 +111,22 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"subver\": \"/Syndicate Core:x.x.x.x/\",  (string) The string version\n"
             "    \"inbound\": true|false,     (boolean) Inbound (true) or Outbound (false)\n"
             "    \"startingheight\": n,       (numeric) The starting height (block) of the peer\n"
+            "    \"knownfilterbytes\": n,     (numeric) Memory used to remember the inventory and addresses the peer knows\n"
             "    \"banscore\": n,             (numeric) The ban score\n"
             "    \"synced_headers\": n,       (numeric) The last header we have in common with this peer\n"
             "    \"synced_blocks\": n,        (numeric) The last block we have in common with this peer\n"
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"bytessent_per_msg\": {\n"
+            "       \"addr\": n,             (numeric) The total bytes sent aggregated by message type\n"
+            "       ...\n"
+            "    },\n"
+            "    \"bytesrecv_per_msg\": {\n"
+            "       \"addr\": n,             (numeric) The total bytes received aggregated by message type\n"
+            "       ...\n"
+            "    }\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -147,6 +166,7 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
         obj.push_back(Pair("subver", stats.cleanSubVer));
         obj.push_back(Pair("inbound", stats.fInbound));
         obj.push_back(Pair("startingheight", stats.nStartingHeight));
+        obj.push_back(Pair("knownfilterbytes", (uint64_t)stats.nKnownFilterBytes));
         if (fStateStats) {
             obj.push_back(Pair("banscore", statestats.nMisbehavior));
             obj.push_back(Pair("synced_headers", statestats.nSyncHeight));
@@ -158,6 +178,8 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             obj.push_back(Pair("inflight", heights));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
+        obj.push_back(Pair("bytessent_per_msg", MsgCmdSizeToJSON(stats.mapSendBytesPerMsgCmd)));
+        obj.push_back(Pair("bytesrecv_per_msg", MsgCmdSizeToJSON(stats.mapRecvBytesPerMsgCmd)));
 
         ret.push_back(obj);
     }
@@ -353,7 +375,22 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
             "{\n"
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
-            "  \"timemillis\": t        (numeric) Total cpu time\n"
+            "  \"timemillis\": t,       (numeric) Total cpu time\n"
+            "  \"invsent\": {           (json object) Inventory announcements sent\n"
+            "    \"messages\": n,       (numeric) Number of inv messages\n"
+            "    \"invs\": n,           (numeric) Number of entries in them\n"
+            "    \"bytes\": n,          (numeric) Their total size\n"
+            "    \"messagespersec\": x, (numeric) Average number of inv messages per second\n"
+            "    \"bytespersec\": x     (numeric) Average inv bytes per second\n"
+            "  },\n"
+            "  \"bytessent_per_msg\": {  (json object) Total bytes sent aggregated by message type\n"
+            "    \"addr\": n,\n"
+            "    ...\n"
+            "  },\n"
+            "  \"bytesrecv_per_msg\": {  (json object) Total bytes received aggregated by message type\n"
+            "    \"addr\": n,\n"
+            "    ...\n"
+            "  }\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -363,6 +400,23 @@ UniValue getnettotals(const UniValue& params, bool fHelp)
     obj.push_back(Pair("totalbytesrecv", CNode::GetTotalBytesRecv()));
     obj.push_back(Pair("totalbytessent", CNode::GetTotalBytesSent()));
     obj.push_back(Pair("timemillis", GetTimeMillis()));
+
+    uint64_t nInvMessages, nInvs, nInvBytes;
+    int64_t nSinceMillis;
+    CNode::GetTotalInvSent(nInvMessages, nInvs, nInvBytes, nSinceMillis);
+    double dSeconds = std::max<int64_t>(GetTimeMillis() - nSinceMillis, 1) / 1000.0;
+    UniValue invSent(UniValue::VOBJ);
+    invSent.push_back(Pair("messages", nInvMessages));
+    invSent.push_back(Pair("invs", nInvs));
+    invSent.push_back(Pair("bytes", nInvBytes));
+    invSent.push_back(Pair("messagespersec", nInvMessages / dSeconds));
+    invSent.push_back(Pair("bytespersec", nInvBytes / dSeconds));
+    obj.push_back(Pair("invsent", invSent));
+
+    mapMsgCmdSize mapRecv, mapSent;
+    CNode::GetTotalBytesPerMsgCmd(mapRecv, mapSent);
+    obj.push_back(Pair("bytessent_per_msg", MsgCmdSizeToJSON(mapSent)));
+    obj.push_back(Pair("bytesrecv_per_msg", MsgCmdSizeToJSON(mapRecv)));
     return obj;
 }
 
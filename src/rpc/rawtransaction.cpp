@@ -844,7 +844,10 @@ UniValue sendrawtransaction(const UniValue& params, bool fHelp)
     if (!fHaveMempool && !fHaveChain) {
         // push to local node and sync with wallets
         if (fSwiftX) {
-            mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+            {
+                LOCK(cs_swifttx);
+                mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+            }
             CreateNewLock(tx);
             RelayTransactionLockReq(tx, true);
         }
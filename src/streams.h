@@ -119,6 +119,13 @@ public:
     bool empty() const { return vch.size() == nReadPos; }
     void resize(size_type n, value_type c = 0) { vch.resize(n + nReadPos, c); }
     void reserve(size_type n) { vch.reserve(n + nReadPos); }
+    size_type capacity() const { return vch.capacity() - nReadPos; }
+    // Exchange buffers with other, reading starts over at its beginning
+    void swap(vector_type& other)
+    {
+        vch.swap(other);
+        nReadPos = 0;
+    }
     const_reference operator[](size_type pos) const { return vch[pos + nReadPos]; }
     reference operator[](size_type pos) { return vch[pos + nReadPos]; }
     void clear()
@@ -291,7 +298,11 @@ public:
 
     void GetAndClear(CSerializeData& data)
     {
-        data.insert(data.end(), begin(), end());
+        if (data.empty() && nReadPos == 0) {
+            // Nothing to append to, hand the buffer over instead of copying it
+            vch.swap(data);
+        } else
+            data.insert(data.end(), begin(), end());
         clear();
     }
 };
@@ -20,13 +20,15 @@
 #include <boost/foreach.hpp>
 
 
-std::map<uint256, CTransaction> mapTxLockReq;
+CCriticalSection cs_swifttx;
+TransactionLockRequestMap mapTxLockReq;
 std::map<uint256, CTransaction> mapTxLockReqRejected;
-std::map<uint256, CConsensusVote> mapTxLockVote;
-std::map<uint256, CTransactionLock> mapTxLocks;
+ConsensusVoteMap mapTxLockVote;
+TransactionLockMap mapTxLocks;
 std::map<COutPoint, uint256> mapLockedInputs;
 std::map<uint256, int64_t> mapUnknownVotes; //track votes with no tx for DOS
 int nCompleteTXLocks;
+CSwiftTXRankCache swifttxRanks;
 
 //txlock - Locks transaction
 //
@@ -43,7 +45,6 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 
     if (strCommand == "ix") {
         //LogPrintf("ProcessMessageSwiftTX::ix\n");
-        CDataStream vMsg(vRecv);
         CTransaction tx;
         vRecv >> tx;
 
@@ -51,8 +52,11 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         pfrom->AddInventoryKnown(inv);
         GetMainSignals().Inventory(inv.hash);
 
-        if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
-            return;
+        {
+            LOCK(cs_swifttx);
+            if (mapTxLockReq.count(tx.GetHash()) || mapTxLockReqRejected.count(tx.GetHash())) {
+                return;
+            }
         }
 
         if (!IsIXTXValid(tx)) {
@@ -83,7 +87,10 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
 
             DoConsensusVote(tx, nBlockHeight);
 
-            mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+            {
+                LOCK(cs_swifttx);
+                mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+            }
 
             LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : accepted %s\n",
                 pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
@@ -96,35 +103,42 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
             return;
 
         } else {
-            mapTxLockReqRejected.insert(std::make_pair(tx.GetHash(), tx));
+            bool fReprocess = false;
+            {
+                LOCK(cs_swifttx);
+                mapTxLockReqRejected.insert(std::make_pair(tx.GetHash(), tx));
 
-            // can we get the conflicting transaction as proof?
+                // can we get the conflicting transaction as proof?
 
-            LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : rejected %s\n",
-                pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
-                tx.GetHash().ToString().c_str());
+                LogPrintf("ProcessMessageSwiftTX::ix - Transaction Lock Request: %s %s : rejected %s\n",
+                    pfrom->addr.ToString().c_str(), pfrom->cleanSubVer.c_str(),
+                    tx.GetHash().ToString().c_str());
 
-            for (const CTxIn& in : tx.vin) {
-                if (!mapLockedInputs.count(in.prevout)) {
-                    mapLockedInputs.insert(std::make_pair(in.prevout, tx.GetHash()));
+                for (const CTxIn& in : tx.vin) {
+                    if (!mapLockedInputs.count(in.prevout)) {
+                        mapLockedInputs.insert(std::make_pair(in.prevout, tx.GetHash()));
+                    }
                 }
-            }
 
-            // resolve conflicts
-            std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(tx.GetHash());
-            if (i != mapTxLocks.end()) {
-                //we only care if we have a complete tx lock
-                if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
-                    if (!CheckForConflictingLocks(tx)) {
-                        LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
-
-                        //reprocess the last 15 blocks
-                        ReprocessBlocks(15);
-                        mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+                // resolve conflicts
+                TransactionLockMap::iterator i = mapTxLocks.find(tx.GetHash());
+                if (i != mapTxLocks.end()) {
+                    //we only care if we have a complete tx lock
+                    if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
+                        if (!CheckForConflictingLocks(tx)) {
+                            LogPrintf("ProcessMessageSwiftTX::ix - Found Existing Complete IX Lock\n");
+
+                            fReprocess = true;
+                            mapTxLockReq.insert(std::make_pair(tx.GetHash(), tx));
+                        }
                     }
                 }
             }
 
+            //reprocess the last 15 blocks
+            if (fReprocess)
+                ReprocessBlocks(15);
+
             return;
         }
     } else if (strCommand == "txlvote") // SwiftX Lock Consensus Votes
@@ -135,11 +149,14 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
         CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
         pfrom->AddInventoryKnown(inv);
 
-        if (mapTxLockVote.count(ctx.GetHash())) {
-            return;
-        }
+        {
+            LOCK(cs_swifttx);
+            if (mapTxLockVote.count(ctx.GetHash())) {
+                return;
+            }
 
-        mapTxLockVote.insert(std::make_pair(ctx.GetHash(), ctx));
+            mapTxLockVote.insert(std::make_pair(ctx.GetHash(), ctx));
+        }
 
         if (ProcessConsensusVote(pfrom, ctx)) {
             //Spam/Dos protection
@@ -148,26 +165,36 @@ void ProcessMessageSwiftTX(CNode* pfrom, std::string& strCommand, CDataStream& v
                 This tracks those messages and allows it at the same rate of the rest of the network, if
                 a peer violates it, it will simply be ignored
             */
-            if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
-                if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
-                }
+            {
+                LOCK(cs_swifttx);
+                if (!mapTxLockReq.count(ctx.txHash) && !mapTxLockReqRejected.count(ctx.txHash)) {
+                    if (!mapUnknownVotes.count(ctx.vinMasternode.prevout.hash)) {
+                        mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
+                    }
 
-                if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
-                    LogPrintf("ProcessMessageSwiftTX::ix - masternode is spamming transaction votes: %s %s\n",
-                        ctx.vinMasternode.ToString().c_str(),
-                        ctx.txHash.ToString().c_str());
-                    return;
-                } else {
-                    mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
+                    if (mapUnknownVotes[ctx.vinMasternode.prevout.hash] > GetTime() &&
+                        mapUnknownVotes[ctx.vinMasternode.prevout.hash] - GetAverageVoteTime() > 60 * 10) {
+                        LogPrintf("ProcessMessageSwiftTX::ix - masternode is spamming transaction votes: %s %s\n",
+                            ctx.vinMasternode.ToString().c_str(),
+                            ctx.txHash.ToString().c_str());
+                        return;
+                    } else {
+                        mapUnknownVotes[ctx.vinMasternode.prevout.hash] = GetTime() + (60 * 10);
+                    }
                 }
             }
             RelayInv(inv);
         }
 
-        if (mapTxLockReq.count(ctx.txHash) && GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
-            GetMainSignals().NotifyTransactionLock(mapTxLockReq[ctx.txHash]);
+        if (GetTransactionLockSignatures(ctx.txHash) == SWIFTTX_SIGNATURES_REQUIRED) {
+            CTransaction tx;
+            {
+                LOCK(cs_swifttx);
+                if (!mapTxLockReq.count(ctx.txHash))
+                    return;
+                tx = mapTxLockReq.at(ctx.txHash);
+            }
+            GetMainSignals().NotifyTransactionLock(tx);
         }
 
         return;
@@ -240,6 +267,8 @@ int64_t CreateNewLock(CTransaction tx)
     */
     int nBlockHeight = (chainActive.Tip()->nHeight - nTxAge) + 4;
 
+    LOCK(cs_swifttx);
+
     if (!mapTxLocks.count(tx.GetHash())) {
         LogPrintf("CreateNewLock - New Transaction Lock %s !\n", tx.GetHash().ToString().c_str());
 
@@ -250,7 +279,7 @@ int64_t CreateNewLock(CTransaction tx)
         newLock.txHash = tx.GetHash();
         mapTxLocks.insert(std::make_pair(tx.GetHash(), newLock));
     } else {
-        mapTxLocks[tx.GetHash()].nBlockHeight = nBlockHeight;
+        mapTxLocks.at(tx.GetHash()).nBlockHeight = nBlockHeight;
         LogPrint("swiftx", "CreateNewLock - Transaction Lock Exists %s !\n", tx.GetHash().ToString().c_str());
     }
 
@@ -263,7 +292,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 {
     if (!fMasterNode) return;
 
-    int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    int n = swifttxRanks.GetRank(activeMasternode.vin, nBlockHeight);
 
     if (n == -1) {
         LogPrint("swiftx", "SwiftX::DoConsensusVote - Unknown Masternode\n");
@@ -293,7 +322,10 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
         return;
     }
 
-    mapTxLockVote[ctx.GetHash()] = ctx;
+    {
+        LOCK(cs_swifttx);
+        mapTxLockVote.update(ctx.GetHash(), ctx, GetTime());
+    }
 
     CInv inv(MSG_TXLOCK_VOTE, ctx.GetHash());
     RelayInv(inv);
@@ -302,7 +334,7 @@ void DoConsensusVote(CTransaction& tx, int64_t nBlockHeight)
 //received a consensus vote
 bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
 {
-    int n = mnodeman.GetMasternodeRank(ctx.vinMasternode, ctx.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+    int n = swifttxRanks.GetRank(ctx.vinMasternode, ctx.nBlockHeight);
 
     CMasternode* pmn = mnodeman.Find(ctx.vinMasternode);
     if (pmn != NULL)
@@ -327,46 +359,45 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
         return false;
     }
 
-    if (!mapTxLocks.count(ctx.txHash)) {
-        LogPrintf("SwiftX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
+    // the vote is accumulated under cs_swifttx, the wallet and block processing are only notified once it is released
+    bool fComplete = false;
+    bool fConflict = false;
+    bool fRejected = false;
+    {
+        LOCK(cs_swifttx);
+
+        if (!mapTxLocks.count(ctx.txHash)) {
+            LogPrintf("SwiftX::ProcessConsensusVote - New Transaction Lock %s !\n", ctx.txHash.ToString().c_str());
+
+            CTransactionLock newLock;
+            newLock.nBlockHeight = 0;
+            newLock.nExpiration = GetTime() + (60 * 60);
+            newLock.nTimeout = GetTime() + (60 * 5);
+            newLock.txHash = ctx.txHash;
+            mapTxLocks.insert(std::make_pair(ctx.txHash, newLock));
+        } else
+            LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
+
+        //compile consessus vote
+        TransactionLockMap::iterator i = mapTxLocks.find(ctx.txHash);
+        if (i == mapTxLocks.end())
+            return false;
 
-        CTransactionLock newLock;
-        newLock.nBlockHeight = 0;
-        newLock.nExpiration = GetTime() + (60 * 60);
-        newLock.nTimeout = GetTime() + (60 * 5);
-        newLock.txHash = ctx.txHash;
-        mapTxLocks.insert(std::make_pair(ctx.txHash, newLock));
-    } else
-        LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Exists %s !\n", ctx.txHash.ToString().c_str());
-
-    //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(ctx.txHash);
-    if (i != mapTxLocks.end()) {
         (*i).second.AddSignature(ctx);
+        mapTxLocks.update_time(ctx.txHash, (*i).second.nExpiration);
 
-#ifdef ENABLE_WALLET
-        if (pwalletMain) {
-            //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
-            if (pwalletMain->mapRequestCount.count(ctx.txHash))
-                pwalletMain->mapRequestCount[ctx.txHash]++;
-        }
-#endif
-
-        LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", (*i).second.CountSignatures(), ctx.GetHash().ToString().c_str());
+        int nSignatures = (*i).second.CountSignatures();
+        LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Votes %d - %s !\n", nSignatures, ctx.GetHash().ToString().c_str());
 
-        if ((*i).second.CountSignatures() >= SWIFTTX_SIGNATURES_REQUIRED) {
+        if (nSignatures >= SWIFTTX_SIGNATURES_REQUIRED) {
             LogPrint("swiftx", "SwiftX::ProcessConsensusVote - Transaction Lock Is Complete %s !\n", (*i).second.GetHash().ToString().c_str());
+            fComplete = true;
 
-            CTransaction& tx = mapTxLockReq[ctx.txHash];
-            if (!CheckForConflictingLocks(tx)) {
-#ifdef ENABLE_WALLET
-                if (pwalletMain) {
-                    if (pwalletMain->UpdatedTransaction((*i).second.txHash)) {
-                        nCompleteTXLocks++;
-                    }
-                }
-#endif
-
+            CTransaction tx;
+            if (mapTxLockReq.count(ctx.txHash))
+                tx = mapTxLockReq.at(ctx.txHash);
+            fConflict = CheckForConflictingLocks(tx);
+            if (!fConflict) {
                 if (mapTxLockReq.count(ctx.txHash)) {
                     for (const CTxIn& in : tx.vin) {
                         if (!mapLockedInputs.count(in.prevout)) {
@@ -376,23 +407,53 @@ bool ProcessConsensusVote(CNode* pnode, CConsensusVote& ctx)
                 }
 
                 // resolve conflicts
+                fRejected = mapTxLockReqRejected.count(ctx.txHash);
+            }
+        }
+    }
 
-                //if this tx lock was rejected, we need to remove the conflicting blocks
-                if (mapTxLockReqRejected.count((*i).second.txHash)) {
-                    //reprocess the last 15 blocks
-                    ReprocessBlocks(15);
-                }
+#ifdef ENABLE_WALLET
+    if (pwalletMain) {
+        LOCK(pwalletMain->cs_wallet);
+        //when we get back signatures, we'll count them as requests. Otherwise the client will think it didn't propagate.
+        if (pwalletMain->mapRequestCount.count(ctx.txHash))
+            pwalletMain->mapRequestCount[ctx.txHash]++;
+    }
+#endif
+
+    if (fComplete && !fConflict) {
+#ifdef ENABLE_WALLET
+        if (pwalletMain) {
+            if (pwalletMain->UpdatedTransaction(ctx.txHash)) {
+                nCompleteTXLocks++;
             }
         }
-        return true;
+#endif
+
+        //if this tx lock was rejected, we need to remove the conflicting blocks
+        if (fRejected) {
+            //reprocess the last 15 blocks
+            ReprocessBlocks(15);
+        }
     }
 
+    return true;
+}
 
-    return false;
+static void ExpireTransactionLock(const uint256& txHash)
+{
+    TransactionLockMap::iterator it = mapTxLocks.find(txHash);
+    if (it == mapTxLocks.end())
+        return;
+
+    it->second.nExpiration = GetTime();
+    mapTxLocks.update_time(txHash, it->second.nExpiration);
 }
 
 bool CheckForConflictingLocks(CTransaction& tx)
 {
+    AssertLockHeld(cs_swifttx);
+
     /*
         It's possible (very unlikely though) to get 2 conflicting transaction locks approved by the network.
         In that case, they will cancel each other out.
@@ -404,8 +465,8 @@ bool CheckForConflictingLocks(CTransaction& tx)
         if (mapLockedInputs.count(in.prevout)) {
             if (mapLockedInputs[in.prevout] != tx.GetHash()) {
                 LogPrintf("SwiftX::CheckForConflictingLocks - found two complete conflicting locks - removing both. %s %s", tx.GetHash().ToString().c_str(), mapLockedInputs[in.prevout].ToString().c_str());
-                if (mapTxLocks.count(tx.GetHash())) mapTxLocks[tx.GetHash()].nExpiration = GetTime();
-                if (mapTxLocks.count(mapLockedInputs[in.prevout])) mapTxLocks[mapLockedInputs[in.prevout]].nExpiration = GetTime();
+                ExpireTransactionLock(tx.GetHash());
+                ExpireTransactionLock(mapLockedInputs[in.prevout]);
                 return true;
             }
         }
@@ -433,30 +494,36 @@ void CleanTransactionLocksList()
 {
     if (chainActive.Tip() == NULL) return;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.begin();
+    swifttxRanks.Clean();
 
-    while (it != mapTxLocks.end()) {
-        if (GetTime() > it->second.nExpiration) { //keep them for an hour
-            LogPrintf("Removing old transaction lock %s\n", it->second.txHash.ToString().c_str());
+    LOCK(cs_swifttx);
 
-            if (mapTxLockReq.count(it->second.txHash)) {
-                CTransaction& tx = mapTxLockReq[it->second.txHash];
+    // locks are kept for an hour, only the expired ones are visited
+    std::vector<std::pair<uint256, CTransactionLock> > vExpired;
+    mapTxLocks.expire(GetTime(), &vExpired);
 
-                for (const CTxIn& in : tx.vin)
-                    mapLockedInputs.erase(in.prevout);
+    for (const std::pair<uint256, CTransactionLock>& expired : vExpired) {
+        const CTransactionLock& lock = expired.second;
+        LogPrintf("Removing old transaction lock %s\n", lock.txHash.ToString().c_str());
 
-                mapTxLockReq.erase(it->second.txHash);
-                mapTxLockReqRejected.erase(it->second.txHash);
+        if (mapTxLockReq.count(lock.txHash)) {
+            const CTransaction& tx = mapTxLockReq.at(lock.txHash);
 
-                for (CConsensusVote& v : it->second.vecConsensusVotes)
-                    mapTxLockVote.erase(v.GetHash());
-            }
+            for (const CTxIn& in : tx.vin)
+                mapLockedInputs.erase(in.prevout);
 
-            mapTxLocks.erase(it++);
-        } else {
-            it++;
+            mapTxLockReq.erase(lock.txHash);
+            mapTxLockReqRejected.erase(lock.txHash);
+
+            for (const CConsensusVote& v : lock.vecConsensusVotes)
+                mapTxLockVote.erase(v.GetHash());
         }
     }
+
+    // requests and votes whose lock never formed would otherwise stay forever
+    int64_t nOrphanLimit = GetTime() - SWIFTTX_ORPHAN_EXPIRATION;
+    mapTxLockReq.expire(nOrphanLimit);
+    mapTxLockVote.expire(nOrphanLimit);
 }
 
 int GetTransactionLockSignatures(uint256 txHash)
@@ -464,7 +531,8 @@ int GetTransactionLockSignatures(uint256 txHash)
     if(fLargeWorkForkFound || fLargeWorkInvalidChainFound) return -2;
     if (!IsSporkActive(SPORK_2_SWIFTTX)) return -1;
 
-    std::map<uint256, CTransactionLock>::iterator it = mapTxLocks.find(txHash);
+    LOCK(cs_swifttx);
+    TransactionLockMap::iterator it = mapTxLocks.find(txHash);
     if(it != mapTxLocks.end()) return it->second.CountSignatures();
 
     return -1;
@@ -529,7 +597,7 @@ bool CConsensusVote::Sign()
 bool CTransactionLock::SignaturesValid()
 {
     for (CConsensusVote vote : vecConsensusVotes) {
-        int n = mnodeman.GetMasternodeRank(vote.vinMasternode, vote.nBlockHeight, MIN_SWIFTTX_PROTO_VERSION);
+        int n = swifttxRanks.GetRank(vote.vinMasternode, vote.nBlockHeight);
 
         if (n == -1) {
             LogPrintf("CTransactionLock::SignaturesValid() - Unknown Masternode\n");
@@ -550,12 +618,29 @@ bool CTransactionLock::SignaturesValid()
     return true;
 }
 
-void CTransactionLock::AddSignature(CConsensusVote& cv)
+bool CTransactionLock::AddSignature(const CConsensusVote& cv)
 {
+    // one vote per masternode, the first one counts
+    if (!mapVoteHeights.insert(std::make_pair(cv.vinMasternode.prevout, cv.nBlockHeight)).second)
+        return false;
+
     vecConsensusVotes.push_back(cv);
+    mapHeightVotes[cv.nBlockHeight]++;
+    return true;
 }
 
-int CTransactionLock::CountSignatures()
+void CTransactionLock::UpdateVoteCounts()
+{
+    std::vector<CConsensusVote> vecVotes;
+    vecVotes.swap(vecConsensusVotes);
+    mapVoteHeights.clear();
+    mapHeightVotes.clear();
+
+    for (const CConsensusVote& cv : vecVotes)
+        AddSignature(cv);
+}
+
+int CTransactionLock::CountSignatures() const
 {
     /*
         Only count signatures where the BlockHeight matches the transaction's blockheight.
@@ -564,11 +649,54 @@ int CTransactionLock::CountSignatures()
 
     if (nBlockHeight == 0) return -1;
 
-    int n = 0;
-    for (CConsensusVote v : vecConsensusVotes) {
-        if (v.nBlockHeight == nBlockHeight) {
-            n++;
+    std::map<int, int>::const_iterator it = mapHeightVotes.find(nBlockHeight);
+    return it == mapHeightVotes.end() ? 0 : it->second;
+}
+
+int CSwiftTXRankCache::GetRank(const CTxIn& vin, int64_t nBlockHeight)
+{
+    LOCK(cs);
+
+    std::map<int64_t, CRankTable>::iterator it = mapTables.find(nBlockHeight);
+    if (it == mapTables.end() || GetTime() - it->second.nTimeBuilt > SWIFTTX_RANK_CACHE_SECONDS) {
+        std::vector<std::pair<int64_t, CTxIn> > vecMasternodeScores;
+        if (!mnodeman.GetMasternodeScores(nBlockHeight, MIN_SWIFTTX_PROTO_VERSION, true, vecMasternodeScores)) {
+            // an unknown block may show up any moment, only remember real rankings
+            if (it != mapTables.end())
+                mapTables.erase(it);
+            return -1;
         }
+
+        CRankTable& table = mapTables[nBlockHeight];
+        table.nTimeBuilt = GetTime();
+        table.mapRanks.clear();
+
+        int rank = 0;
+        for (const std::pair<int64_t, CTxIn>& s : vecMasternodeScores)
+            table.mapRanks.insert(std::make_pair(s.second.prevout, ++rank));
+
+        it = mapTables.find(nBlockHeight);
+    }
+
+    std::map<COutPoint, int>::const_iterator itRank = it->second.mapRanks.find(vin.prevout);
+    return itRank == it->second.mapRanks.end() ? -1 : itRank->second;
+}
+
+void CSwiftTXRankCache::Clean()
+{
+    LOCK(cs);
+
+    std::map<int64_t, CRankTable>::iterator it = mapTables.begin();
+    while (it != mapTables.end()) {
+        if (GetTime() - it->second.nTimeBuilt > SWIFTTX_RANK_CACHE_SECONDS)
+            mapTables.erase(it++);
+        else
+            ++it;
     }
-    return n;
+}
+
+void CSwiftTXRankCache::Clear()
+{
+    LOCK(cs);
+    mapTables.clear();
 }
@@ -8,6 +8,7 @@
 #define SWIFTTX_H
 
 #include "base58.h"
+#include "expiringmap.h"
 #include "key.h"
 #include "main.h"
 #include "net.h"
@@ -34,10 +35,16 @@ class CTransactionLock;
 
 static const int MIN_SWIFTTX_PROTO_VERSION = 70103;
 
-extern std::map<uint256, CTransaction> mapTxLockReq;
+// requests and votes that never got attached to an expiring lock are dropped after this long
+static const int64_t SWIFTTX_ORPHAN_EXPIRATION = 2 * 60 * 60;
+// masternode ranks computed for a height are reused for this long
+static const int64_t SWIFTTX_RANK_CACHE_SECONDS = 60;
+
+// protects the SwiftX maps below. Always taken after cs_main and cs_wallet, and never
+// held while calling into the wallet, the mempool or block processing.
+extern CCriticalSection cs_swifttx;
+
 extern std::map<uint256, CTransaction> mapTxLockReqRejected;
-extern std::map<uint256, CConsensusVote> mapTxLockVote;
-extern std::map<uint256, CTransactionLock> mapTxLocks;
 extern std::map<COutPoint, uint256> mapLockedInputs;
 extern int nCompleteTXLocks;
 
@@ -92,6 +99,13 @@ public:
 
 class CTransactionLock
 {
+private:
+    // vote accumulators: the height each masternode voted for, and the number of votes per height
+    std::map<COutPoint, int> mapVoteHeights;
+    std::map<int, int> mapHeightVotes;
+
+    void UpdateVoteCounts();
+
 public:
     int nBlockHeight;
     uint256 txHash;
@@ -100,14 +114,72 @@ public:
     int nTimeout;
 
     bool SignaturesValid();
-    int CountSignatures();
-    void AddSignature(CConsensusVote& cv);
+    int CountSignatures() const;
+    /**
+     * Each masternode is counted once per lock: only its first vote is kept, later votes
+     * from the same masternode are rejected even when they name another block height.
+     */
+    bool AddSignature(const CConsensusVote& cv);
 
     uint256 GetHash()
     {
         return txHash;
     }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nBlockHeight);
+        READWRITE(txHash);
+        READWRITE(vecConsensusVotes);
+        READWRITE(nExpiration);
+        READWRITE(nTimeout);
+        if (ser_action.ForRead())
+            UpdateVoteCounts();
+    }
 };
 
+/** Masternode ranks per block height, so each vote is checked with a lookup instead of a full rank computation */
+class CSwiftTXRankCache
+{
+private:
+    struct CRankTable {
+        int64_t nTimeBuilt;
+        std::map<COutPoint, int> mapRanks;
+    };
+
+    CCriticalSection cs;
+    std::map<int64_t, CRankTable> mapTables;
+
+public:
+    /** Same result as CMasternodeMan::GetMasternodeRank with the SwiftX protocol minimum */
+    int GetRank(const CTxIn& vin, int64_t nBlockHeight);
+    void Clean();
+    void Clear();
+};
+
+extern CSwiftTXRankCache swifttxRanks;
+
+/** Requests and votes are indexed by the time we first saw them */
+template <typename V>
+struct CSwiftTXArrivalTime {
+    int64_t operator()(const V& v) const { return GetTime(); }
+};
+
+/** Locks are indexed by their expiration time */
+struct CTransactionLockExpiration {
+    int64_t operator()(const CTransactionLock& lock) const { return lock.nExpiration; }
+};
+
+typedef expiringmap<uint256, CTransaction, CSwiftTXArrivalTime<CTransaction>, BlockHasher> TransactionLockRequestMap;
+typedef expiringmap<uint256, CConsensusVote, CSwiftTXArrivalTime<CConsensusVote>, BlockHasher> ConsensusVoteMap;
+typedef expiringmap<uint256, CTransactionLock, CTransactionLockExpiration, BlockHasher> TransactionLockMap;
+
+extern TransactionLockRequestMap mapTxLockReq;
+extern ConsensusVoteMap mapTxLockVote;
+extern TransactionLockMap mapTxLocks;
+
 
 #endif
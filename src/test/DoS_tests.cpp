@@ -18,6 +18,7 @@
 
 #include "test/test_syndicate.h"
 
+#include <limits>
 #include <stdint.h>
 
 #include <boost/assign/list_of.hpp> // for 'map_list_of()'
@@ -27,13 +28,20 @@
 // Tests this internal-to-main.cpp method:
 extern bool AddOrphanTx(const CTransaction& tx, NodeId peer);
 extern void EraseOrphansFor(NodeId peer);
-extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
+extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans, size_t nMaxBytes);
+extern void UpdateOrphansForBlock(const CBlock& block);
+extern void ProcessOrphanTx(std::deque<uint256>& workQueue, unsigned int nMaxTried);
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
+    int64_t nTimeExpire;
+    unsigned int nTxSize;
 };
 extern std::map<uint256, COrphanTx> mapOrphanTransactions;
-extern std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+extern std::map<COutPoint, std::set<uint256> > mapOrphanTransactionsByPrev;
+extern size_t nOrphanTxSize;
+extern std::map<NodeId, size_t> mapOrphanTxSizeByPeer;
+extern std::deque<uint256> queueOrphanWork;
 
 CService ip(uint32_t i)
 {
@@ -51,7 +59,7 @@ BOOST_AUTO_TEST_CASE(DoS_banning)
     CNode dummyNode1(INVALID_SOCKET, addr1, "", true);
     dummyNode1.nVersion = 1;
     Misbehaving(dummyNode1.GetId(), 100); // Should get banned
-    SendMessages(&dummyNode1, false);
+    SendMessages(&dummyNode1);
     BOOST_CHECK(CNode::IsBanned(addr1));
     BOOST_CHECK(!CNode::IsBanned(ip(0xa0b0c001|0x0000ff00))); // Different IP, not banned
 
@@ -59,11 +67,11 @@ BOOST_AUTO_TEST_CASE(DoS_banning)
     CNode dummyNode2(INVALID_SOCKET, addr2, "", true);
     dummyNode2.nVersion = 1;
     Misbehaving(dummyNode2.GetId(), 50);
-    SendMessages(&dummyNode2, false);
+    SendMessages(&dummyNode2);
     BOOST_CHECK(!CNode::IsBanned(addr2)); // 2 not banned yet...
     BOOST_CHECK(CNode::IsBanned(addr1));  // ... but 1 still should be
     Misbehaving(dummyNode2.GetId(), 50);
-    SendMessages(&dummyNode2, false);
+    SendMessages(&dummyNode2);
     BOOST_CHECK(CNode::IsBanned(addr2));
 }
 
@@ -75,13 +83,13 @@ BOOST_AUTO_TEST_CASE(DoS_banscore)
     CNode dummyNode1(INVALID_SOCKET, addr1, "", true);
     dummyNode1.nVersion = 1;
     Misbehaving(dummyNode1.GetId(), 100);
-    SendMessages(&dummyNode1, false);
+    SendMessages(&dummyNode1);
     BOOST_CHECK(!CNode::IsBanned(addr1));
     Misbehaving(dummyNode1.GetId(), 10);
-    SendMessages(&dummyNode1, false);
+    SendMessages(&dummyNode1);
     BOOST_CHECK(!CNode::IsBanned(addr1));
     Misbehaving(dummyNode1.GetId(), 1);
-    SendMessages(&dummyNode1, false);
+    SendMessages(&dummyNode1);
     BOOST_CHECK(CNode::IsBanned(addr1));
     mapArgs.erase("-banscore");
 }
@@ -97,7 +105,7 @@ BOOST_AUTO_TEST_CASE(DoS_bantime)
     dummyNode.nVersion = 1;
 
     Misbehaving(dummyNode.GetId(), 100);
-    SendMessages(&dummyNode, false);
+    SendMessages(&dummyNode);
     BOOST_CHECK(CNode::IsBanned(addr));
 
     SetMockTime(nStartTime+60*60);
@@ -188,13 +196,164 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     }
 
     // Test LimitOrphanTxSize() function:
-    LimitOrphanTxSize(40);
+    const size_t nMaxBytes = DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE * 1000;
+    LimitOrphanTxSize(40, nMaxBytes);
     BOOST_CHECK(mapOrphanTransactions.size() <= 40);
-    LimitOrphanTxSize(10);
+    LimitOrphanTxSize(10, nMaxBytes);
     BOOST_CHECK(mapOrphanTransactions.size() <= 10);
-    LimitOrphanTxSize(0);
+    LimitOrphanTxSize(0, nMaxBytes);
     BOOST_CHECK(mapOrphanTransactions.empty());
     BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
+    BOOST_CHECK_EQUAL(nOrphanTxSize, 0);
+    BOOST_CHECK(mapOrphanTxSizeByPeer.empty());
+}
+
+BOOST_AUTO_TEST_CASE(DoS_orphanFlood)
+{
+    // Peers sending orphans as fast as they can, each one handled the way the tx message is
+    const int nOrphans = 20000;
+    const NodeId nPeers = 8;
+    const size_t nMaxBytes = DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE * 1000;
+    int64_t nStartTime = GetTime();
+    SetMockTime(nStartTime);
+
+    int64_t nMaxHold = 0;
+    int64_t nTotalHold = 0;
+    int nAdded = 0;
+    for (int i = 0; i < nOrphans; i++)
+    {
+        CMutableTransaction tx;
+        tx.vin.resize(1 + i % 10);
+        for (unsigned int j = 0; j < tx.vin.size(); j++)
+        {
+            tx.vin[j].prevout.n = j;
+            tx.vin[j].prevout.hash = GetRandHash();
+            tx.vin[j].scriptSig = CScript() << std::vector<unsigned char>(72, 0x42);
+        }
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1*CENT;
+        tx.vout[0].scriptPubKey = CScript() << OP_1;
+
+        int64_t nStart = GetTimeMicros();
+        {
+            LOCK(cs_main);
+            if (AddOrphanTx(tx, i % nPeers))
+                nAdded++;
+            LimitOrphanTxSize(std::numeric_limits<unsigned int>::max(), nMaxBytes);
+        }
+        int64_t nHold = GetTimeMicros() - nStart;
+        nMaxHold = std::max(nMaxHold, nHold);
+        nTotalHold += nHold;
+
+        BOOST_CHECK(nOrphanTxSize <= nMaxBytes);
+    }
+    BOOST_TEST_MESSAGE(strprintf("%d orphans from %d peers, %d stored: cs_main held %dus at most, %.2fus on average, pool at %u orphans and %u bytes",
+        nOrphans, nPeers, nAdded, nMaxHold, (double)nTotalHold / nOrphans, mapOrphanTransactions.size(), nOrphanTxSize));
+
+    // Every peer kept to its quota, and the accounting matches the pool
+    size_t nBytes = 0;
+    for (const auto& item : mapOrphanTransactions)
+        nBytes += item.second.nTxSize;
+    BOOST_CHECK_EQUAL(nBytes, nOrphanTxSize);
+    BOOST_CHECK_EQUAL(mapOrphanTxSizeByPeer.size(), nPeers);
+    for (const auto& item : mapOrphanTxSizeByPeer)
+        BOOST_CHECK(item.second <= MAX_ORPHAN_TRANSACTIONS_SIZE_PER_PEER);
+
+    // Disconnected peers take their orphans along
+    EraseOrphansFor(0);
+    BOOST_CHECK(!mapOrphanTxSizeByPeer.count(0));
+    for (const auto& item : mapOrphanTransactions)
+        BOOST_CHECK(item.second.fromPeer != 0);
+
+    // The others expire
+    SetMockTime(nStartTime + ORPHAN_TX_EXPIRE_TIME + ORPHAN_TX_EXPIRE_INTERVAL);
+    LimitOrphanTxSize(std::numeric_limits<unsigned int>::max(), nMaxBytes);
+    BOOST_CHECK(mapOrphanTransactions.empty());
+    BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
+    BOOST_CHECK_EQUAL(nOrphanTxSize, 0);
+    BOOST_CHECK(mapOrphanTxSizeByPeer.empty());
+
+    SetMockTime(0);
+}
+
+static CMutableTransaction OrphanSpending(const std::vector<COutPoint>& vPrevouts, const CScript& scriptPubKey)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(vPrevouts.size());
+    for (unsigned int i = 0; i < vPrevouts.size(); i++) {
+        tx.vin[i].prevout = vPrevouts[i];
+        tx.vin[i].scriptSig = CScript() << std::vector<unsigned char>(72, 0x42);
+    }
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1*CENT;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(DoS_orphanBlock)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+    const int nParents = 250;
+
+    LOCK(cs_main);
+    queueOrphanWork.clear();
+
+    // An orphan the block includes, and one spending an output a transaction of the block spends too
+    CMutableTransaction txIncluded = OrphanSpending({COutPoint(GetRandHash(), 0)}, scriptPubKey);
+    BOOST_CHECK(AddOrphanTx(txIncluded, 0));
+    COutPoint prevoutConflict(GetRandHash(), 0);
+    CMutableTransaction txConflict = OrphanSpending({prevoutConflict}, scriptPubKey);
+    BOOST_CHECK(AddOrphanTx(OrphanSpending({prevoutConflict, COutPoint(GetRandHash(), 1)}, scriptPubKey), 1));
+
+    // Transactions of the block with an orphan each: one in ten is invalid, the others still miss an input
+    CBlock block;
+    block.vtx.push_back(txIncluded);
+    block.vtx.push_back(txConflict);
+    std::set<uint256> setInvalid;
+    for (int i = 0; i < nParents; i++) {
+        CMutableTransaction txParent = OrphanSpending({COutPoint(GetRandHash(), 0)}, scriptPubKey);
+        block.vtx.push_back(txParent);
+        CMutableTransaction txChild = OrphanSpending({COutPoint(txParent.GetHash(), 0), COutPoint(GetRandHash(), 0)}, scriptPubKey);
+        // From peers of their own, the rest of a misbehaving peer's orphans are skipped for the batch
+        NodeId peer = 2 + i % 6;
+        if (i % 10 == 0) {
+            txChild.vout[0].nValue = -1;
+            setInvalid.insert(txChild.GetHash());
+            peer = 100 + i;
+        }
+        BOOST_CHECK(AddOrphanTx(txChild, peer));
+    }
+    BOOST_CHECK_EQUAL(mapOrphanTransactions.size(), nParents + 2);
+
+    // Connecting the block drops what it includes or conflicts with, and queues its transactions orphans wait for
+    UpdateOrphansForBlock(block);
+    BOOST_CHECK_EQUAL(mapOrphanTransactions.size(), nParents);
+    BOOST_CHECK(!mapOrphanTransactions.count(txIncluded.GetHash()));
+    BOOST_CHECK(!mapOrphanTxSizeByPeer.count(0));
+    BOOST_CHECK(!mapOrphanTxSizeByPeer.count(1));
+    BOOST_CHECK(!mapOrphanTransactionsByPrev.count(prevoutConflict));
+    BOOST_CHECK_EQUAL(queueOrphanWork.size(), nParents);
+
+    // Worked through a batch at a time, the way ProcessNewBlock does
+    int nBatches = 0;
+    while (!queueOrphanWork.empty()) {
+        size_t nQueued = queueOrphanWork.size();
+        ProcessOrphanTx(queueOrphanWork, ORPHAN_TX_REPROCESS_BATCH);
+        nBatches++;
+        BOOST_CHECK_EQUAL(nQueued - queueOrphanWork.size(), std::min(nQueued, (size_t)ORPHAN_TX_REPROCESS_BATCH));
+    }
+    BOOST_CHECK_EQUAL(nBatches, (nParents + ORPHAN_TX_REPROCESS_BATCH - 1) / ORPHAN_TX_REPROCESS_BATCH);
+
+    // The invalid orphans are dropped, the others wait for their missing input
+    BOOST_CHECK_EQUAL(mapOrphanTransactions.size(), nParents - setInvalid.size());
+    for (const uint256& hash : setInvalid)
+        BOOST_CHECK(!mapOrphanTransactions.count(hash));
+
+    LimitOrphanTxSize(0, 0);
+    BOOST_CHECK(mapOrphanTransactions.empty());
+    BOOST_CHECK_EQUAL(nOrphanTxSize, 0);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
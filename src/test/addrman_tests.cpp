@@ -7,8 +7,11 @@
 #include <boost/test/unit_test.hpp>
 #include <crypto/common.h> // for ReadLE64
 
+#include "clientversion.h"
 #include "hash.h"
 #include "random.h"
+#include "streams.h"
+#include "utiltime.h"
 
 class CAddrManTest : public CAddrMan
 {
@@ -395,6 +398,92 @@ BOOST_AUTO_TEST_CASE(addrman_getaddr)
 }
 
 
+BOOST_AUTO_TEST_CASE(addrman_reuse_and_serialize)
+{
+    CAddrManTest addrman;
+
+    // Set addrman addr placement to be deterministic.
+    addrman.MakeDeterministic();
+
+    CAddress addr1 = CAddress(CService("250.1.2.1", 8333));
+    CAddress addr2 = CAddress(CService("250.1.2.2", 8333));
+    CNetAddr source1 = CNetAddr("250.1.2.1");
+
+    // The slot of a deleted entry is given to the next one
+    {
+        CAddrManTest addrmanReuse;
+        int nId1, nId2;
+        addrmanReuse.Create(addr1, source1, &nId1);
+        addrmanReuse.Delete(nId1);
+        BOOST_CHECK(addrmanReuse.Find(addr1) == NULL);
+        addrmanReuse.Create(addr2, source1, &nId2);
+        BOOST_CHECK_EQUAL(nId1, nId2);
+        BOOST_CHECK(addrmanReuse.Find(addr2) != NULL);
+    }
+
+    // Only what is written to peers.dat counts as a change
+    uint64_t nChanges = addrman.GetChanges();
+    for (int i = 1; i <= 100; i++) {
+        CAddress addr = CAddress(CService("250.1." + boost::to_string(i) + ".1", 8333));
+        addr.nTime = GetAdjustedTime();
+        addrman.Add(addr, CNetAddr("250." + boost::to_string(i) + ".1.1"));
+        if (i % 10 == 0)
+            addrman.Good(addr);
+    }
+    BOOST_CHECK(addrman.GetChanges() > nChanges);
+    nChanges = addrman.GetChanges();
+    addrman.Select();
+    addrman.GetAddr();
+    BOOST_CHECK_EQUAL(addrman.GetChanges(), nChanges);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << addrman;
+    CAddrMan addrman2;
+    ss >> addrman2;
+    BOOST_CHECK_EQUAL(addrman2.size(), addrman.size());
+    BOOST_CHECK_EQUAL(addrman2.GetChanges(), 0);
+    std::vector<CAddress> vAddr = addrman2.GetAddr();
+    for (const CAddress& addr : vAddr)
+        BOOST_CHECK(addrman.Find(addr) != NULL);
+}
+
+BOOST_AUTO_TEST_CASE(addrman_benchmark)
+{
+    CAddrMan addrman;
+    const int nAddresses = 1000000;
+
+    // Addresses arrive in addr messages of 1000, each from its own source
+    int64_t nStart = GetTimeMicros();
+    std::vector<CAddress> vAddr;
+    vAddr.reserve(1000);
+    for (int i = 0; i < nAddresses; i++) {
+        struct in_addr ip;
+        ip.s_addr = htonl(0x01000000 + i);
+        CAddress addr(CService(CNetAddr(ip), 8333));
+        addr.nTime = GetAdjustedTime() - 60 * 60;
+        vAddr.push_back(addr);
+        if (vAddr.size() == 1000) {
+            addrman.Add(vAddr, CNetAddr("250." + boost::to_string(i / 1000 % 250) + "." + boost::to_string(i / 250000) + ".1"));
+            vAddr.clear();
+        }
+    }
+    int64_t nAddTime = GetTimeMicros() - nStart;
+    BOOST_CHECK(addrman.size() > 0);
+    BOOST_CHECK(addrman.size() <= ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE);
+
+    nStart = GetTimeMicros();
+    int nUnroutable = 0;
+    for (int i = 0; i < nAddresses; i++) {
+        if (!addrman.Select().IsRoutable())
+            nUnroutable++;
+    }
+    int64_t nSelectTime = GetTimeMicros() - nStart;
+    BOOST_CHECK_EQUAL(nUnroutable, 0);
+
+    BOOST_TEST_MESSAGE(strprintf("%d addresses added in %dms (%.2fus each), %d kept; %d selected in %dms (%.2fus each)",
+        nAddresses, nAddTime / 1000, (double)nAddTime / nAddresses, addrman.size(), nAddresses, nSelectTime / 1000, (double)nSelectTime / nAddresses));
+}
+
 BOOST_AUTO_TEST_CASE(caddrinfo_get_tried_bucket)
 {
     CAddrManTest addrman;
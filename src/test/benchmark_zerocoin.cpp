@@ -34,6 +34,7 @@
 #define COLOR_STR_RED     "\033[31m"
 
 #define TESTS_COINS_TO_ACCUMULATE   50
+#define TESTS_COINS_TO_BATCH        10000
 
 // Global test counters
 uint32_t    ggNumTests        = 0;
@@ -280,6 +281,45 @@ Testb_Accumulator()
     return true;
 }
 
+bool
+Testb_BatchAccumulate()
+{
+    // Random values from the coin space; the accumulator math doesn't need real mints
+    std::vector<CBigNum> vValues;
+    for (uint32_t i = 0; i < TESTS_COINS_TO_BATCH; i++) {
+        vValues.push_back(CBigNum::randBignum(gg_Params->coinCommitmentGroup.modulus));
+    }
+
+    try {
+        libzerocoin::Accumulator accOne(&gg_Params->accumulatorParams,libzerocoin::CoinDenomination::ZQ_ONE);
+        libzerocoin::Accumulator accBatch(&gg_Params->accumulatorParams,libzerocoin::CoinDenomination::ZQ_ONE);
+
+        timer.start();
+        for (const CBigNum& bnValue : vValues) {
+            accOne.increment(bnValue);
+        }
+        timer.stop();
+        int nDurationOne = timer.duration();
+
+        timer.start();
+        accBatch.increment(vValues);
+        timer.stop();
+        int nDurationBatch = timer.duration();
+
+        std::cout << "\tACCUMULATE " << TESTS_COINS_TO_BATCH << " COINS ELAPSED TIME:\n\t\tOne by one: " << nDurationOne << " ms\n\t\tBatch: " << nDurationBatch << " ms" << std::endl;
+
+        if (accOne.getValue() != accBatch.getValue()) {
+            std::cout << "Batch accumulation doesn't match" << std::endl;
+            return false;
+        }
+    } catch (std::runtime_error e) {
+        std::cout << e.what() << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 bool
 Testb_MintCoin()
 {
@@ -369,6 +409,52 @@ Testb_MintAndSpend()
     return false;
 }
 
+bool
+Testb_FixedBaseSpend()
+{
+    try {
+        if (ggCoins[0] == NULL)
+            return false;
+
+        libzerocoin::Accumulator acc(&gg_Params->accumulatorParams, libzerocoin::CoinDenomination::ZQ_ONE);
+        libzerocoin::AccumulatorWitness wAcc(gg_Params, acc, ggCoins[0]->getPublicCoin());
+        for (uint32_t i = 0; i < TESTS_COINS_TO_ACCUMULATE; i++) {
+            acc += ggCoins[i]->getPublicCoin();
+            wAcc += ggCoins[i]->getPublicCoin();
+        }
+
+        timer.start();
+        gg_Params->precompute();
+        timer.stop();
+
+        std::cout << "\tPRECOMPUTE ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << std::endl;
+
+        // Same spend as Testb_MintAndSpend, now running on the tables
+        timer.start();
+        libzerocoin::CoinSpend spend(gg_Params, gg_Params, *(ggCoins[0]), acc, 0, wAcc, 0, libzerocoin::SpendType::SPEND);
+        timer.stop();
+
+        std::cout << "\tSPEND WITH TABLES ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << std::endl;
+
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << spend;
+        libzerocoin::CoinSpend newSpend(gg_Params, gg_Params, ss);
+
+        timer.start();
+        bool ret = newSpend.Verify(acc);
+        timer.stop();
+
+        std::cout << "\tSPEND VERIFY WITH TABLES ELAPSED TIME: " << timer.duration() << " ms\t" << timer.duration()*0.001 << " s" << std::endl;
+
+        return ret;
+    } catch (std::runtime_error &e) {
+        std::cout << e.what() << std::endl;
+        return false;
+    }
+
+    return false;
+}
+
 void
 Testb_RunAllTests()
 {
@@ -387,7 +473,9 @@ Testb_RunAllTests()
     gLogTestResult("parameter generation is correct", Testb_ParamGen);
     gLogTestResult("coins can be minted", Testb_MintCoin);
     gLogTestResult("the accumulator works", Testb_Accumulator);
+    gLogTestResult("a batch of coins can be accumulated at once", Testb_BatchAccumulate);
     gLogTestResult("a minted coin can be spent", Testb_MintAndSpend);
+    gLogTestResult("a spend using precomputed tables verifies", Testb_FixedBaseSpend);
 
     // Summarize test results
     if (ggSuccessfulTests < ggNumTests) {
@@ -0,0 +1,182 @@
+// Copyright (c) 2011-2016 The Bitcoin Core developers
+// Copyright (c) 2019 The Syndicate Ltd developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockencodings.h"
+#include "streams.h"
+#include "txmempool.h"
+#include "version.h"
+#include "test/test_syndicate.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockencodings_tests, BasicTestingSetup)
+
+/** A proof-of-stake block: coinbase, coinstake, then three spends of the coinstake outputs. */
+static CBlock BuildBlockTestCase()
+{
+    CBlock block;
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << OP_11;
+    tx.vout.resize(1);
+    tx.vout[0].SetEmpty();
+    block.vtx.push_back(tx);
+
+    CMutableTransaction coinstake;
+    coinstake.vin.resize(1);
+    coinstake.vin[0].prevout.hash = uint256S("0xfaded");
+    coinstake.vin[0].prevout.n = 0;
+    coinstake.vout.resize(4);
+    coinstake.vout[0].SetEmpty();
+    for (int i = 1; i < 4; i++) {
+        coinstake.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        coinstake.vout[i].nValue = 42;
+    }
+    block.vtx.push_back(coinstake);
+
+    for (int i = 1; i < 4; i++) {
+        tx.vin[0].prevout.hash = block.vtx[1].GetHash();
+        tx.vin[0].prevout.n = i;
+        tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+        tx.vout[0].nValue = 42 - i;
+        block.vtx.push_back(tx);
+    }
+
+    block.nVersion = 4;
+    block.hashPrevBlock = uint256S("0xbeef");
+    block.nBits = 0x207fffff;
+    block.nTime = 1546300800;
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    block.vchBlockSig = std::vector<unsigned char>(70, 0x42);
+    return block;
+}
+
+static void AddToPool(CTxMemPool& pool, const CTransaction& tx)
+{
+    pool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, 0, 0, 0.0, 1));
+}
+
+BOOST_AUTO_TEST_CASE(SimpleRoundTripTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block = BuildBlockTestCase();
+    BOOST_CHECK(block.IsProofOfStake());
+
+    // The last spend is not relayed yet
+    AddToPool(pool, block.vtx[2]);
+    AddToPool(pool, block.vtx[3]);
+
+    CBlockHeaderAndShortTxIDs shortIDs(block);
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << shortIDs;
+
+    CBlockHeaderAndShortTxIDs shortIDs2;
+    stream >> shortIDs2;
+    BOOST_CHECK_EQUAL(shortIDs2.BlockTxCount(), block.vtx.size());
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs2) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(partialBlock.GetPrefilledCount(), 2);
+    BOOST_CHECK_EQUAL(partialBlock.GetMempoolCount(), 2);
+    for (size_t i = 0; i < 4; i++)
+        BOOST_CHECK(partialBlock.IsTxAvailable(i));
+    BOOST_CHECK(!partialBlock.IsTxAvailable(4));
+
+    // The getblocktxn asking for the missing transaction survives the trip too
+    BlockTransactionsRequest req;
+    req.blockhash = block.GetHash();
+    req.indexes.push_back(4);
+    stream << req;
+    BlockTransactionsRequest req2;
+    stream >> req2;
+    BOOST_CHECK(req2.blockhash == block.GetHash());
+    BOOST_CHECK_EQUAL(req2.indexes.size(), 1);
+    BOOST_CHECK_EQUAL(req2.indexes[0], 4);
+
+    BlockTransactions resp(req2);
+    resp.txn[0] = block.vtx[4];
+
+    CBlock block2;
+    PartiallyDownloadedBlock partialBlockCopy = partialBlock;
+    BOOST_CHECK(partialBlock.FillBlock(block2, std::vector<CTransaction>()) == READ_STATUS_INVALID);
+
+    CBlock block3;
+    BOOST_CHECK(partialBlockCopy.FillBlock(block3, resp.txn) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block3.GetHash().ToString(), block.GetHash().ToString());
+    BOOST_CHECK_EQUAL(block3.hashMerkleRoot.ToString(), block.BuildMerkleTree().ToString());
+    BOOST_CHECK(block3.vchBlockSig == block.vchBlockSig);
+}
+
+BOOST_AUTO_TEST_CASE(WrongTransactionTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CBlock block = BuildBlockTestCase();
+    AddToPool(pool, block.vtx[2]);
+    AddToPool(pool, block.vtx[3]);
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(CBlockHeaderAndShortTxIDs(block)) == READ_STATUS_OK);
+
+    // A transaction that is not the one of the block breaks the merkle root: fall back to the full block
+    CBlock block2;
+    std::vector<CTransaction> vtx_missing(1, block.vtx[2]);
+    BOOST_CHECK(partialBlock.FillBlock(block2, vtx_missing) == READ_STATUS_FAILED);
+}
+
+BOOST_AUTO_TEST_CASE(EmptyBlockRoundTripTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].scriptSig = CScript() << OP_11;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].nValue = 42;
+
+    CBlock block;
+    block.vtx.push_back(coinbase);
+    block.nVersion = 4;
+    block.hashPrevBlock = uint256S("0xbeef");
+    block.nBits = 0x207fffff;
+    block.hashMerkleRoot = block.BuildMerkleTree();
+
+    CBlockHeaderAndShortTxIDs shortIDs(block);
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << shortIDs;
+    CBlockHeaderAndShortTxIDs shortIDs2;
+    stream >> shortIDs2;
+
+    PartiallyDownloadedBlock partialBlock(&pool);
+    BOOST_CHECK(partialBlock.InitData(shortIDs2) == READ_STATUS_OK);
+    BOOST_CHECK(partialBlock.IsTxAvailable(0));
+
+    CBlock block2;
+    BOOST_CHECK(partialBlock.FillBlock(block2, std::vector<CTransaction>()) == READ_STATUS_OK);
+    BOOST_CHECK_EQUAL(block2.GetHash().ToString(), block.GetHash().ToString());
+}
+
+BOOST_AUTO_TEST_CASE(TransactionsRequestSerializationTest)
+{
+    BlockTransactionsRequest req1;
+    req1.blockhash = uint256S("0xbeef");
+    req1.indexes.resize(4);
+    req1.indexes[0] = 0;
+    req1.indexes[1] = 1;
+    req1.indexes[2] = 3;
+    req1.indexes[3] = 4;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << req1;
+
+    BlockTransactionsRequest req2;
+    stream >> req2;
+
+    BOOST_CHECK_EQUAL(req1.blockhash.ToString(), req2.blockhash.ToString());
+    BOOST_CHECK_EQUAL(req1.indexes.size(), req2.indexes.size());
+    for (size_t i = 0; i < req1.indexes.size(); i++)
+        BOOST_CHECK_EQUAL(req1.indexes[i], req2.indexes[i]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
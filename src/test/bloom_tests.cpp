@@ -9,7 +9,9 @@
 #include "base58.h"
 #include "clientversion.h"
 #include "key.h"
+#include "main.h"
 #include "merkleblock.h"
+#include "random.h"
 #include "serialize.h"
 #include "streams.h"
 #include "uint256.h"
@@ -17,6 +19,7 @@
 #include "utilstrencodings.h"
 #include "test/test_syndicate.h"
 
+#include <limits>
 #include <vector>
 
 #include <boost/test/unit_test.hpp>
@@ -460,4 +463,195 @@ BOOST_AUTO_TEST_CASE(merkle_block_4_test_update_none)
     BOOST_CHECK(!filter.contains(COutPoint(uint256("0x02981fa052f0481dbc5868f4fc2166035a10f27a03cfd2de67326471df5bc041"), 0)));
 }
 
+static std::vector<unsigned char> RandomData()
+{
+    uint256 r = GetRandHash();
+    return std::vector<unsigned char>(r.begin(), r.end());
+}
+
+/**
+ * A block of nTxs transactions, each spending the first output of the previous one. The first
+ * output pays to the hash vKeyIDs[i], the second one to the public key vPubKeys[i].
+ */
+static CBlock BuildFilteredTestBlock(int nTxs, std::vector<std::vector<unsigned char> >& vKeyIDs, std::vector<std::vector<unsigned char> >& vPubKeys)
+{
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = GetRandHash();
+    block.nTime = GetRand(std::numeric_limits<unsigned int>::max());
+    uint256 hashPrev = GetRandHash();
+    for (int i = 0; i < nTxs; i++) {
+        std::vector<unsigned char> vchSig(72), vchPubKey(33);
+        GetRandBytes(&vchSig[0], vchSig.size());
+        GetRandBytes(&vchPubKey[0], vchPubKey.size());
+        vKeyIDs.push_back(std::vector<unsigned char>(vchPubKey.begin(), vchPubKey.begin() + 20));
+        GetRandBytes(&vchPubKey[0], vchPubKey.size());
+        vchPubKey[0] = 0x02;
+        vPubKeys.push_back(vchPubKey);
+
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(hashPrev, 0);
+        tx.vin[0].scriptSig = CScript() << vchSig << vchPubKey;
+        tx.vout.resize(2);
+        tx.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << vKeyIDs.back() << OP_EQUALVERIFY << OP_CHECKSIG;
+        tx.vout[0].nValue = 1 + i;
+        tx.vout[1].scriptPubKey = CScript() << vPubKeys.back() << OP_CHECKSIG;
+        tx.vout[1].nValue = 1;
+        block.vtx.push_back(tx);
+        hashPrev = block.vtx.back().GetHash();
+    }
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+BOOST_AUTO_TEST_CASE(merkle_block_from_filtered_block)
+{
+    std::vector<std::vector<unsigned char> > vKeyIDs, vPubKeys;
+    CBlock block = BuildFilteredTestBlock(50, vKeyIDs, vPubKeys);
+    CFilteredBlock filteredBlock(block);
+    BOOST_CHECK_EQUAL(filteredBlock.vtx.size(), block.vtx.size());
+
+    const unsigned char flags[] = {BLOOM_UPDATE_ALL, BLOOM_UPDATE_P2PUBKEY_ONLY, BLOOM_UPDATE_NONE};
+    for (unsigned char nFlags : flags) {
+        CBloomFilter filter(10, 0.000001, 0, nFlags);
+        // The hash output of the 11th transaction, the public key output of the 21st
+        filter.insert(vKeyIDs[10]);
+        filter.insert(vPubKeys[20]);
+        CBloomFilter filter2 = filter;
+
+        // Matching the parsed block gives the same merkle block, and updates the filter the same way
+        CMerkleBlock merkleBlock(block, filter);
+        CMerkleBlock merkleBlock2(filteredBlock, filter2);
+        BOOST_CHECK(merkleBlock.vMatchedTxn == merkleBlock2.vMatchedTxn);
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION), ss2(SER_NETWORK, PROTOCOL_VERSION);
+        ss << merkleBlock << filter;
+        ss2 << merkleBlock2 << filter2;
+        BOOST_CHECK(ss.str() == ss2.str());
+
+        // With BLOOM_UPDATE_ALL the 12th transaction, which spends the matched output of the 11th, matches too
+        BOOST_CHECK_EQUAL(merkleBlock2.vMatchedTxn.size(), nFlags == BLOOM_UPDATE_ALL ? 3 : 2);
+        BOOST_CHECK_EQUAL(merkleBlock2.vMatchedTxn[0].first, 10);
+        BOOST_CHECK(filter2.contains(COutPoint(block.vtx[20].GetHash(), 1)) == (nFlags != BLOOM_UPDATE_NONE));
+        std::vector<uint256> vMatched;
+        BOOST_CHECK(merkleBlock2.txn.ExtractMatches(vMatched) == block.hashMerkleRoot);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(filtered_block_cache)
+{
+    std::vector<std::vector<unsigned char> > vKeyIDs, vPubKeys;
+    std::vector<CBlock> vBlocks;
+    for (int i = 0; i < 4; i++)
+        vBlocks.push_back(BuildFilteredTestBlock(20, vKeyIDs, vPubKeys));
+    size_t nBlockUsage = CFilteredBlock(vBlocks[0]).GetMemoryUsage();
+
+    // Room for three blocks, with some slack since their sizes differ a little
+    CFilteredBlockCache cache(nBlockUsage * 3 + nBlockUsage / 2);
+    BOOST_CHECK(!cache.Get(vBlocks[0].GetHash()));
+    for (int i = 0; i < 3; i++)
+        BOOST_CHECK(cache.Add(vBlocks[i])->block.GetHash() == vBlocks[i].GetHash());
+    BOOST_CHECK_EQUAL(cache.GetCount(), 3);
+
+    // Served again, the first block is kept and the second, now the least recently served, makes room for the fourth
+    std::shared_ptr<const CFilteredBlock> pblock = cache.Get(vBlocks[0].GetHash());
+    BOOST_CHECK(pblock && pblock->vtx.size() == vBlocks[0].vtx.size());
+    cache.Add(vBlocks[3]);
+    BOOST_CHECK_EQUAL(cache.GetCount(), 3);
+    BOOST_CHECK(cache.Get(vBlocks[0].GetHash()));
+    BOOST_CHECK(!cache.Get(vBlocks[1].GetHash()));
+    BOOST_CHECK(cache.Get(vBlocks[2].GetHash()));
+    BOOST_CHECK(cache.Get(vBlocks[3].GetHash()));
+    BOOST_CHECK(cache.GetMemoryUsage() <= nBlockUsage * 3 + nBlockUsage / 2);
+    BOOST_CHECK_EQUAL(cache.GetHits(), 4);
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 2);
+
+    // Adding a block again keeps the one cached
+    BOOST_CHECK(cache.Add(vBlocks[3]) == cache.Get(vBlocks[3].GetHash()));
+    BOOST_CHECK_EQUAL(cache.GetCount(), 3);
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.GetCount(), 0);
+    BOOST_CHECK_EQUAL(cache.GetMemoryUsage(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(rolling_bloom)
+{
+    // last-100-entry, 1% false positive:
+    CRollingBloomFilter rb1(100, 0.01);
+    size_t nMemoryUsage = rb1.GetMemoryUsage();
+
+    // Overfill:
+    static const int DATASIZE = 399;
+    std::vector<unsigned char> data[DATASIZE];
+    for (int i = 0; i < DATASIZE; i++) {
+        data[i] = RandomData();
+        rb1.insert(data[i]);
+    }
+    // Last 100 guaranteed to be remembered:
+    for (int i = 299; i < DATASIZE; i++) {
+        BOOST_CHECK(rb1.contains(data[i]));
+    }
+    // ... without taking any more memory
+    BOOST_CHECK_EQUAL(rb1.GetMemoryUsage(), nMemoryUsage);
+
+    // false positive rate is 1%, so we should get about 100 hits if
+    // testing 10,000 random keys. We get worst-case false positive
+    // behavior when the filter is as full as possible, which is
+    // when we've inserted one minus an integer multiple of nElement*2.
+    unsigned int nHits = 0;
+    for (int i = 0; i < 10000; i++) {
+        if (rb1.contains(RandomData()))
+            ++nHits;
+    }
+    // Run test_syndicate with --log_level=message to see BOOST_TEST_MESSAGEs:
+    BOOST_TEST_MESSAGE("RollingBloomFilter got " << nHits << " false positives (~100 expected)");
+
+    // Insanely unlikely to get a fp count outside this range:
+    BOOST_CHECK(nHits > 25);
+    BOOST_CHECK(nHits < 175);
+
+    BOOST_CHECK(rb1.contains(data[DATASIZE - 1]));
+    rb1.reset();
+    BOOST_CHECK(!rb1.contains(data[DATASIZE - 1]));
+
+    // Now roll through data, make sure last 100 entries
+    // are always remembered:
+    for (int i = 0; i < DATASIZE; i++) {
+        if (i >= 100)
+            BOOST_CHECK(rb1.contains(data[i - 100]));
+        rb1.insert(data[i]);
+    }
+
+    // Insert 999 more random entries:
+    for (int i = 0; i < 999; i++) {
+        rb1.insert(RandomData());
+    }
+    // Sanity check to make sure the filter isn't just filling up:
+    nHits = 0;
+    for (int i = 0; i < DATASIZE; i++) {
+        if (rb1.contains(data[i]))
+            ++nHits;
+    }
+    // Expect about 5 false positives, more than 100 means
+    // something is definitely broken.
+    BOOST_TEST_MESSAGE("RollingBloomFilter got " << nHits << " false positives (~5 expected)");
+    BOOST_CHECK(nHits < 100);
+
+    // last-1000-entry, 0.01% false positive:
+    CRollingBloomFilter rb2(1000, 0.001);
+    for (int i = 0; i < DATASIZE; i++) {
+        rb2.insert(data[i]);
+    }
+    // ... room for all of them:
+    for (int i = 0; i < DATASIZE; i++) {
+        BOOST_CHECK(rb2.contains(data[i]));
+    }
+
+    // A peer's known inventory with the default -maxsendbuffer: two halves of about 7.2 KB
+    CRollingBloomFilter rbInventory(1000, 0.000001);
+    BOOST_CHECK(rbInventory.GetMemoryUsage() > 14000);
+    BOOST_CHECK(rbInventory.GetMemoryUsage() < 14500);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -30,4 +30,96 @@ BOOST_AUTO_TEST_CASE(budget_value)
     CheckBudgetValue(nHeightTest, "mainnet", 43200*COIN);
 }
 
+static CBudgetVote MakeVote(const uint256& nProposalHash, unsigned int nMasternode, int nVote)
+{
+    CBudgetVote vote(CTxIn(COutPoint(Hash(BEGIN(nMasternode), END(nMasternode)), 0)), nProposalHash, nVote);
+    vote.nTime = GetTime();
+    vote.fValid = true;
+    return vote;
+}
+
+BOOST_AUTO_TEST_CASE(budget_vote_tally)
+{
+    CBudgetProposal proposal("test", "http://test", 0, 43200, CScript() << OP_TRUE, 100 * COIN, 0);
+    std::string strError;
+
+    for (unsigned int i = 0; i < 10; i++) {
+        CBudgetVote vote = MakeVote(proposal.GetHash(), i, i < 6 ? VOTE_YES : (i < 9 ? VOTE_NO : VOTE_ABSTAIN));
+        BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+    }
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 6);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 3);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 1);
+
+    // changing a vote moves it between tallies
+    CBudgetVote vote = MakeVote(proposal.GetHash(), 0, VOTE_NO);
+    vote.nTime += BUDGET_VOTE_UPDATE_MIN;
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote, strError));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 5);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 4);
+
+    // copies and a full recount agree with the incremental tallies
+    CBudgetProposal copy(proposal);
+    copy.RecalculateVoteTally();
+    BOOST_CHECK_EQUAL(copy.GetYeas(), proposal.GetYeas());
+    BOOST_CHECK_EQUAL(copy.GetNays(), proposal.GetNays());
+    BOOST_CHECK_EQUAL(copy.GetAbstains(), proposal.GetAbstains());
+
+    // none of the voters are known masternodes, so every vote becomes invalid
+    BOOST_CHECK(proposal.CleanAndRemove(false));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 0);
+    BOOST_CHECK(!proposal.CleanAndRemove(false));
+}
+
+#define BENCHMARK_PROPOSALS     500
+#define BENCHMARK_MASTERNODES   5000
+#define BENCHMARK_TALLY_ROUNDS  100
+
+BOOST_AUTO_TEST_CASE(budget_tally_benchmark)
+{
+    // Every masternode votes on one in ten proposals, which keeps the
+    // vote set (250k votes) representative without exhausting memory.
+    std::vector<CBudgetProposal> vProposals;
+    for (unsigned int i = 0; i < BENCHMARK_PROPOSALS; i++)
+        vProposals.push_back(CBudgetProposal(strprintf("prop%d", i), "http://test", 0, 43200, CScript() << OP_TRUE, 100 * COIN, 0));
+
+    std::string strError;
+    int64_t nStart = GetTimeMicros();
+    for (unsigned int nMasternode = 0; nMasternode < BENCHMARK_MASTERNODES; nMasternode++) {
+        for (unsigned int i = nMasternode % 10; i < BENCHMARK_PROPOSALS; i += 10) {
+            CBudgetVote vote = MakeVote(vProposals[i].GetHash(), nMasternode, (nMasternode + i) % 3);
+            BOOST_CHECK(vProposals[i].AddOrUpdateVote(vote, strError));
+        }
+    }
+    int64_t nAddTime = GetTimeMicros() - nStart;
+
+    int64_t nTotal = 0;
+    nStart = GetTimeMicros();
+    for (int n = 0; n < BENCHMARK_TALLY_ROUNDS; n++) {
+        for (const CBudgetProposal& proposal : vProposals)
+            nTotal += proposal.GetYeas() - proposal.GetNays();
+    }
+    int64_t nTallyTime = GetTimeMicros() - nStart;
+
+    // the full recount is what every tally used to cost
+    int64_t nRecountTotal = 0;
+    nStart = GetTimeMicros();
+    for (int n = 0; n < BENCHMARK_TALLY_ROUNDS; n++) {
+        for (CBudgetProposal& proposal : vProposals) {
+            proposal.RecalculateVoteTally();
+            nRecountTotal += proposal.GetYeas() - proposal.GetNays();
+        }
+    }
+    int64_t nRecountTime = GetTimeMicros() - nStart;
+
+    BOOST_CHECK_EQUAL(nTotal, nRecountTotal);
+
+    std::cout << "    Budget tallies for " << BENCHMARK_PROPOSALS << " proposals / " << BENCHMARK_MASTERNODES << " masternodes" << std::endl;
+    std::cout << "    Adding votes: " << nAddTime / 1000 << "ms" << std::endl;
+    std::cout << "    Incremental tallies (" << BENCHMARK_TALLY_ROUNDS << " rounds): " << nTallyTime << "us" << std::endl;
+    std::cout << "    Full recount (" << BENCHMARK_TALLY_ROUNDS << " rounds): " << nRecountTime / 1000 << "ms" << std::endl;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
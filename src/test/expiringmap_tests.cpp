@@ -0,0 +1,122 @@
+// Copyright (c) 2019 The Syndicate Ltd developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "expiringmap.h"
+
+#include "streams.h"
+#include "test/test_syndicate.h"
+
+#include <boost/test/unit_test.hpp>
+
+struct timedvalue {
+    int64_t nTime;
+    int nValue;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nTime);
+        READWRITE(nValue);
+    }
+};
+
+static timedvalue MakeValue(int64_t nTime, int nValue)
+{
+    timedvalue v;
+    v.nTime = nTime;
+    v.nValue = nValue;
+    return v;
+}
+
+typedef expiringmap<int, timedvalue, expiringmap_ntime<timedvalue> > timedmap;
+
+BOOST_FIXTURE_TEST_SUITE(expiringmap_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(expiringmap_expire)
+{
+    timedmap map;
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(map.insert(std::make_pair(i, MakeValue(1000 + i, i))));
+
+    // insert does not overwrite
+    BOOST_CHECK(!map.insert(std::make_pair(5, MakeValue(0, -1))));
+    BOOST_CHECK_EQUAL(map.at(5).nValue, 5);
+    BOOST_CHECK_EQUAL(map.size(), 100U);
+
+    std::vector<std::pair<int, timedvalue> > vExpired;
+    BOOST_CHECK_EQUAL(map.expire(1010, &vExpired), 10U);
+    BOOST_CHECK_EQUAL(vExpired.size(), 10U);
+    BOOST_CHECK_EQUAL(vExpired.front().first, 0);
+    BOOST_CHECK_EQUAL(vExpired.back().first, 9);
+    BOOST_CHECK_EQUAL(map.size(), 90U);
+    BOOST_CHECK(!map.count(9));
+    BOOST_CHECK(map.count(10));
+
+    // moving an entry forward in time keeps it from expiring
+    map.update_time(10, 5000);
+    BOOST_CHECK_EQUAL(map.get_time(10), 5000);
+    map.expire(1020);
+    BOOST_CHECK(map.count(10));
+    BOOST_CHECK(!map.count(11));
+
+    // erasing through an iterator keeps the time index consistent
+    for (timedmap::iterator it = map.begin(); it != map.end();) {
+        if (it->first % 2)
+            it = map.erase(it);
+        else
+            ++it;
+    }
+    map.expire(5001);
+    BOOST_CHECK(map.empty());
+    BOOST_CHECK_EQUAL(map.usage(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(expiringmap_usage_cap)
+{
+    timedmap map;
+    map.insert(std::make_pair(0, MakeValue(0, 0)));
+    size_t nEntryUsage = map.usage();
+    BOOST_CHECK(nEntryUsage > 0);
+
+    // the cap evicts the oldest entries first
+    map.max_usage(nEntryUsage * 10);
+    for (int i = 1; i < 100; i++)
+        map.insert(std::make_pair(i, MakeValue(i, i)));
+    BOOST_CHECK_EQUAL(map.size(), 10U);
+    BOOST_CHECK(map.usage() <= map.max_usage());
+    BOOST_CHECK(!map.count(89));
+    BOOST_CHECK(map.count(90));
+    BOOST_CHECK(map.count(99));
+}
+
+BOOST_AUTO_TEST_CASE(expiringmap_serialize)
+{
+    timedmap map;
+    std::map<int, timedvalue> stdmap;
+    for (int i = 0; i < 20; i++) {
+        map.insert(std::make_pair(i, MakeValue(100 - i, i)));
+        stdmap.insert(std::make_pair(i, MakeValue(100 - i, i)));
+    }
+
+    // the format is interchangeable with std::map
+    CDataStream ss(SER_DISK, PROTOCOL_VERSION);
+    ss << stdmap;
+    BOOST_CHECK_EQUAL(map.GetSerializeSize(SER_DISK, PROTOCOL_VERSION), ss.size());
+
+    timedmap loaded;
+    ss >> loaded;
+    BOOST_CHECK_EQUAL(loaded.size(), 20U);
+    BOOST_CHECK_EQUAL(loaded.usage(), map.usage());
+
+    // times are restored from the values
+    BOOST_CHECK_EQUAL(loaded.get_time(3), 97);
+    loaded.expire(90);
+    BOOST_CHECK_EQUAL(loaded.size(), 11U);
+    BOOST_CHECK(loaded.count(0));
+    BOOST_CHECK(!loaded.count(11));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
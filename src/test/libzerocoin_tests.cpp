@@ -34,6 +34,7 @@
 
 #define TESTS_COINS_TO_ACCUMULATE   10
 #define NON_PRIME_TESTS                100
+#define TESTS_SPENDS_TO_BATCH          3
 
 // Global test counters
 uint32_t    gNumTests        = 0;
@@ -444,6 +445,55 @@ Test_MintAndSpend()
     return false;
 }
 
+bool
+Test_BatchVerifySoK()
+{
+    try {
+        if (gCoins[0] == NULL)
+            return false;
+
+        libzerocoin::Accumulator acc(&g_Params->accumulatorParams, libzerocoin::CoinDenomination::ZQ_ONE);
+        for (uint32_t i = 0; i < TESTS_COINS_TO_ACCUMULATE; i++)
+            acc += gCoins[i]->getPublicCoin();
+
+        // Spend the first few coins, each against its own witness
+        std::vector<libzerocoin::CoinSpend> vSpends;
+        for (uint32_t n = 0; n < TESTS_SPENDS_TO_BATCH; n++) {
+            libzerocoin::Accumulator accWit(&g_Params->accumulatorParams, libzerocoin::CoinDenomination::ZQ_ONE);
+            libzerocoin::AccumulatorWitness wAcc(g_Params, accWit, gCoins[n]->getPublicCoin());
+            for (uint32_t i = 0; i < TESTS_COINS_TO_ACCUMULATE; i++) {
+                if (i != n)
+                    wAcc += gCoins[i]->getPublicCoin();
+            }
+            vSpends.push_back(libzerocoin::CoinSpend(g_Params, g_Params, *gCoins[n], acc, 0, wAcc, 0, libzerocoin::SpendType::SPEND));
+        }
+
+        libzerocoin::SerialNumberSoKBatch batch;
+        for (const libzerocoin::CoinSpend& spend : vSpends) {
+            if (!spend.VerifyBatched(acc, batch))
+                return false;
+        }
+        std::vector<size_t> vFailed;
+        if (batch.size() != TESTS_SPENDS_TO_BATCH || !batch.Verify(&vFailed) || !vFailed.empty())
+            return false;
+
+        // Changing the signed txout hash breaks only that spend's SoK, which the batch must single out
+        vSpends[1].setTxOutHash(uint256(1));
+        batch.clear();
+        for (const libzerocoin::CoinSpend& spend : vSpends) {
+            if (!spend.VerifyBatched(acc, batch))
+                return false;
+        }
+        if (batch.Verify(&vFailed, 2))
+            return false;
+
+        return vFailed.size() == 1 && vFailed[0] == 1 && !vSpends[1].Verify(acc);
+    } catch (std::runtime_error &e) {
+        std::cout << e.what() << std::endl;
+        return false;
+    }
+}
+
 void
 Test_RunAllTests()
 {
@@ -465,6 +515,7 @@ Test_RunAllTests()
     LogTestResult("the accumulator works", Test_Accumulator);
     LogTestResult("the commitment equality PoK works", Test_EqualityPoK);
     LogTestResult("a minted coin can be spent", Test_MintAndSpend);
+    LogTestResult("a batch of spend SoKs verifies and singles out a bad one", Test_BatchVerifySoK);
 
     std::cout << std::endl << "Average coin size is " << gCoinSize << " bytes." << std::endl;
     std::cout << "Serial number size is " << gSerialNumberSize << " bytes." << std::endl;
@@ -0,0 +1,254 @@
+// Copyright (c) 2019 The Syndicate Ltd developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "lightzpivthread.h"
+#include "main.h"
+#include "net.h"
+#include "txdb.h"
+#include "zpiv/accumulatormap.h"
+#include "utiltime.h"
+#include "test/test_syndicate.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(lightzpiv_tests, TestingSetup)
+
+// Waits until every accepted request was answered
+static bool WaitForLightWorker(CLightWorker& worker, uint64_t nAccepted)
+{
+    for (int i = 0; i < 1000; i++) {
+        CLightWorkerStats stats = worker.GetStats();
+        if (stats.nCompleted + stats.nRejected == nAccepted && stats.nQueued == 0 && stats.nRunning == 0)
+            return true;
+        MilliSleep(10);
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(witness_range_test)
+{
+    libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
+    const libzerocoin::CoinDenomination den = libzerocoin::CoinDenomination::ZQ_ONE;
+
+    CWitnessRange range;
+    range.den = den;
+    for (int i = 0; i < 6; i++)
+        range.vPubcoins.emplace_back(CBigNum(1000003 + 2 * i));
+    range.bnProduct = libzerocoin::ProductTree(range.vPubcoins, 0, range.vPubcoins.size());
+
+    const CBigNum bnClientValue = params->accumulatorParams.accumulatorBase;
+    libzerocoin::Accumulator accFull(params, den, bnClientValue);
+    for (const CBigNum& bnValue : range.vPubcoins)
+        accFull.increment(bnValue);
+    range.bnAccValue = accFull.getValue();
+
+    // The client's coin is handed back and left out of the witness
+    CBloomFilter filter(10, 0.0001, 0, BLOOM_UPDATE_NONE);
+    filter.insert(range.vPubcoins[2].getvch());
+
+    libzerocoin::Accumulator accExpected(params, den, bnClientValue);
+    for (unsigned int i = 0; i < range.vPubcoins.size(); i++) {
+        if (i != 2)
+            accExpected.increment(range.vPubcoins[i]);
+    }
+
+    libzerocoin::Accumulator accumulator(params, den, bnClientValue);
+    libzerocoin::PublicCoin temp(params);
+    libzerocoin::AccumulatorWitness witness(params, accumulator, temp);
+    std::string strError;
+    int nMintsAdded = 0;
+    std::list<CBigNum> ret;
+    BOOST_CHECK(CalculateAccumulatorWitnessFor(params, range, filter, accumulator, witness, nMintsAdded, strError, ret));
+    BOOST_CHECK_EQUAL(nMintsAdded, 5);
+    BOOST_CHECK_EQUAL(ret.size(), 1);
+    BOOST_CHECK(ret.front() == range.vPubcoins[2]);
+    BOOST_CHECK(witness.getValue() == accExpected.getValue());
+    BOOST_CHECK(accumulator.getValue() == range.bnAccValue);
+
+    // A checkpoint value in the range replaces the one sent by the client
+    range.bnWitnessBase = bnClientValue;
+    libzerocoin::Accumulator accumulator2(params, den, CBigNum(3));
+    libzerocoin::AccumulatorWitness witness2(params, accumulator2, temp);
+    ret.clear();
+    BOOST_CHECK(CalculateAccumulatorWitnessFor(params, range, filter, accumulator2, witness2, nMintsAdded, strError, ret));
+    BOOST_CHECK(witness2.getValue() == accExpected.getValue());
+
+    // Nothing but the client's own coin
+    CWitnessRange rangeOwn;
+    rangeOwn.den = den;
+    rangeOwn.vPubcoins.push_back(range.vPubcoins[2]);
+    rangeOwn.bnProduct = range.vPubcoins[2];
+    ret.clear();
+    BOOST_CHECK_THROW(CalculateAccumulatorWitnessFor(params, rangeOwn, filter, accumulator, witness, nMintsAdded, strError, ret), NotEnoughMintsException);
+}
+
+/**
+ * Active chain of nHeight blocks on top of genesis. Blocks at the heights in setMintHeights
+ * are written to disk with one ZQ_ONE mint, and the checkpoint at nHeightCheckpoint holds
+ * the accumulator over all of them.
+ */
+struct LightWorkerChain {
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vBlocks;
+    std::vector<CBigNum> vPubcoins;
+    CBlockIndex* pindexGenesis;
+    CZerocoinDB* pzerocoinDBPrev;
+    int nBlockZerocoinV2Prev;
+
+    LightWorkerChain(int nHeight, const std::set<int>& setMintHeights, int nHeightCheckpoint)
+    {
+        nBlockZerocoinV2Prev = Params().Zerocoin_Block_V2_Start();
+        ModifiableParams()->setSkipProofOfWorkCheck(true);
+        ModifiableParams()->setZerocoinBlockV2Start(1);
+        pzerocoinDBPrev = zerocoinDB;
+        zerocoinDB = new CZerocoinDB(0, true);
+
+        LOCK(cs_main);
+        pindexGenesis = chainActive.Genesis();
+        vHashes.resize(nHeight + 1);
+        vBlocks.resize(nHeight + 1);
+        CDiskBlockPos pos(1, 0);
+        for (int i = 1; i <= nHeight; i++) {
+            CBlockIndex& index = vBlocks[i];
+            index.pprev = i == 1 ? pindexGenesis : &vBlocks[i - 1];
+            index.nHeight = i;
+            vHashes[i] = Hash(BEGIN(i), END(i));
+
+            if (setMintHeights.count(i)) {
+                // pubcoins are 128 bytes, the size mint scripts are parsed for
+                CBigNum bnPubcoin = CBigNum(2).pow(1016) + 2 * i + 1;
+                CMutableTransaction tx;
+                tx.vin.resize(1);
+                tx.vin[0].prevout = COutPoint(vHashes[i], 0);
+                CScript scriptMint = CScript() << OP_ZEROCOINMINT << bnPubcoin.getvch().size() << bnPubcoin.getvch();
+                tx.vout.push_back(CTxOut(libzerocoin::ZerocoinDenominationToAmount(libzerocoin::ZQ_ONE), scriptMint));
+
+                CBlock block;
+                block.nTime = i;
+                block.hashPrevBlock = index.pprev->GetBlockHash();
+                block.vtx.push_back(CTransaction(tx));
+                BOOST_REQUIRE(WriteBlockToDisk(block, pos));
+                index.nFile = pos.nFile;
+                index.nDataPos = pos.nPos;
+                index.nStatus |= BLOCK_HAVE_DATA;
+                index.vMintDenominationsInBlock.push_back(libzerocoin::ZQ_ONE);
+                pos.nPos += ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+                vHashes[i] = block.GetHash();
+                vPubcoins.push_back(bnPubcoin);
+            }
+            index.phashBlock = &vHashes[i];
+            index.BuildSkip();
+        }
+        chainActive.SetTip(&vBlocks[nHeight]);
+
+        AccumulatorMap mapAccumulators(Params().Zerocoin_Params(false));
+        for (const CBigNum& bnPubcoin : vPubcoins)
+            mapAccumulators.Accumulate(libzerocoin::PublicCoin(Params().Zerocoin_Params(false), bnPubcoin, libzerocoin::ZQ_ONE), true);
+        DatabaseChecksums(mapAccumulators);
+        vBlocks[nHeightCheckpoint].nAccumulatorCheckpoint = mapAccumulators.GetCheckpoint();
+    }
+
+    ~LightWorkerChain()
+    {
+        {
+            LOCK(cs_main);
+            chainActive.SetTip(pindexGenesis);
+        }
+        delete zerocoinDB;
+        zerocoinDB = pzerocoinDBPrev;
+        ModifiableParams()->setZerocoinBlockV2Start(nBlockZerocoinV2Prev);
+        ModifiableParams()->setSkipProofOfWorkCheck(false);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(worker_load_test)
+{
+    // Requests starting at 31-39 accumulate blocks 30-79, the ones starting at 41-49 blocks 40-79.
+    // Both ranges stop at the checkpoint taken 20 blocks below the tip.
+    std::set<int> setMintHeights;
+    for (int i = 30; i < 80; i += 5)
+        setMintHeights.insert(i);
+    LightWorkerChain chain(100, setMintHeights, 90);
+    const int nRanges = 2;
+
+    const int nPeers = 8;
+    const int nMaxPeerRequests = 16;
+    std::vector<std::unique_ptr<CNode> > vNodes;
+    for (int i = 0; i < nPeers; i++) {
+        CAddress addr(CService(CNetAddr(strprintf("10.0.0.%d", i + 1)), 25992));
+        vNodes.emplace_back(new CNode(INVALID_SOCKET, addr, "", true));
+    }
+
+    // Every client holds the coin minted at height 45, which is handed back instead of accumulated
+    CBloomFilter filter(10, 0.0001, 0, BLOOM_UPDATE_NONE);
+    filter.insert(chain.vPubcoins[3].getvch());
+    const CBigNum bnWitness = Params().Zerocoin_Params(false)->accumulatorParams.accumulatorBase;
+
+    CLightWorker worker;
+    worker.StartLightZpivThread(4, nMaxPeerRequests);
+    BOOST_CHECK_EQUAL(worker.GetStats().nThreads, 4);
+
+    uint64_t nAccepted = 0;
+    uint64_t nRefused = 0;
+    {
+        // Workers can't get past their chain lookup, so nothing is answered while the queue fills
+        LOCK(cs_main);
+        for (int i = 0; i < nPeers; i++) {
+            for (int j = 0; j < nMaxPeerRequests + 4; j++) {
+                int nStartingHeight = 31 + (j % nRanges) * 10 + (i + j) % 9;
+                CGenWit wit(filter, nStartingHeight, libzerocoin::CoinDenomination::ZQ_ONE, j, bnWitness);
+                wit.setPfrom(vNodes[i].get());
+                if (worker.addWitWork(wit))
+                    nAccepted++;
+                else
+                    nRefused++;
+            }
+        }
+        BOOST_CHECK_EQUAL(worker.GetRequests().size(), nPeers * nMaxPeerRequests);
+    }
+    BOOST_CHECK_EQUAL(nAccepted, nPeers * nMaxPeerRequests);
+    BOOST_CHECK_EQUAL(nRefused, nPeers * 4);
+
+    BOOST_CHECK(WaitForLightWorker(worker, nAccepted));
+    CLightWorkerStats stats = worker.GetStats();
+    BOOST_CHECK_EQUAL(stats.nCompleted, nAccepted);
+    BOOST_CHECK_EQUAL(stats.nRejected, 0);
+    BOOST_CHECK_EQUAL(stats.nPeerLimited, nRefused);
+    // Each range was read once and shared by every other request over the same blocks
+    BOOST_CHECK_EQUAL(stats.nRangeComputed, nRanges);
+    BOOST_CHECK_EQUAL(stats.nRangeShared, nAccepted - nRanges);
+    BOOST_CHECK(worker.GetRequests().empty());
+    // Every request got its answer and released its peer
+    for (const auto& pnode : vNodes) {
+        BOOST_CHECK_EQUAL(pnode->GetRefCount(), 0);
+        BOOST_CHECK(!pnode->vSendMsg[SEND_PRIORITY_BULK].empty());
+    }
+
+    // The shared range matches one read for a single request
+    CWitnessRange range;
+    std::string strError;
+    BOOST_CHECK(CalculateWitnessRange(35, COMP_MAX_AMOUNT, libzerocoin::ZQ_ONE, range, strError));
+    BOOST_CHECK_EQUAL(range.nHeightStart, 30);
+    BOOST_CHECK_EQUAL(range.nHeightStop, 80);
+    BOOST_CHECK_EQUAL(range.vPubcoins.size(), chain.vPubcoins.size());
+    BOOST_CHECK(range.bnAccValue != 0);
+
+    // Answered requests free the peer's slots, and heights before zerocoin V2 are still rejected
+    CGenWit wit(filter, 35, libzerocoin::CoinDenomination::ZQ_ONE, 0, bnWitness);
+    wit.setPfrom(vNodes[0].get());
+    BOOST_CHECK(worker.addWitWork(wit));
+    CGenWit witEarly(filter, 0, libzerocoin::CoinDenomination::ZQ_ONE, 1, bnWitness);
+    witEarly.setPfrom(vNodes[0].get());
+    BOOST_CHECK(worker.addWitWork(witEarly));
+    BOOST_CHECK(WaitForLightWorker(worker, nAccepted + 2));
+    stats = worker.GetStats();
+    BOOST_CHECK_EQUAL(stats.nCompleted, nAccepted + 1);
+    BOOST_CHECK_EQUAL(stats.nRejected, 1);
+    BOOST_CHECK_EQUAL(stats.nRangeShared, nAccepted - nRanges + 1);
+
+    worker.StopLightZpivThread();
+    BOOST_CHECK(!worker.addWitWork(wit));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -50,4 +50,18 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+BOOST_AUTO_TEST_CASE(masternode_payment_after_seesaw)
+{
+    BOOST_CHECK(IsSeeSawPaymentHeight(345999));
+    BOOST_CHECK(!IsSeeSawPaymentHeight(346000));
+
+    // past the seesaw the payment does not depend on the masternode count
+    for (int nHeight = 346000; nHeight < 800000; nHeight += 1000) {
+        CAmount nValue = GetBlockValue(nHeight);
+        CAmount nPayment = GetMasternodePayment(nHeight, nValue, 0, false);
+        BOOST_CHECK_EQUAL(nPayment, (CAmount)(nValue * .70));
+        BOOST_CHECK_EQUAL(GetMasternodePayment(nHeight, nValue, 5000, true), nPayment);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
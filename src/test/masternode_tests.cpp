@@ -0,0 +1,91 @@
+// Copyright (c) 2019 The Syndicate Ltd developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternodeman.h"
+#include "streams.h"
+#include "test_syndicate.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternode_tests, TestingSetup)
+
+static CMasternode MakeMasternode(unsigned int n)
+{
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(Hash(BEGIN(n), END(n)), 0));
+    mn.sigTime = 1000000 + n;
+    mn.lastPing.vin = mn.vin;
+    mn.lastPing.sigTime = mn.sigTime + 60;
+    return mn;
+}
+
+/** Apply a diff to a list without the signature and collateral checks of ApplyListDiff */
+static void ApplyUnchecked(CMasternodeMan& man, const CMasternodeListDiff& diff)
+{
+    for (const CMasternodeBroadcast& mnb : diff.vBroadcasts) {
+        CMasternode* pmn = man.Find(mnb.vin);
+        if (pmn != NULL) {
+            pmn->sigTime = mnb.sigTime;
+            pmn->lastPing = mnb.lastPing;
+        } else {
+            CMasternode mn(mnb);
+            man.Add(mn);
+        }
+    }
+    for (const CMasternodePing& mnp : diff.vPings) {
+        CMasternode* pmn = man.Find(mnp.vin);
+        BOOST_REQUIRE(pmn != NULL);
+        pmn->lastPing = mnp;
+    }
+}
+
+BOOST_AUTO_TEST_CASE(masternode_list_diff)
+{
+    CMasternodeMan server;
+    CMasternodeMan client;
+    for (unsigned int n = 0; n < 10; n++) {
+        CMasternode mn = MakeMasternode(n);
+        server.Add(mn);
+    }
+
+    // an unknown list gets a full snapshot
+    CMasternodeListDiff diff;
+    server.GetListDiff(client.GetListHash(), diff);
+    BOOST_CHECK(diff.IsFull());
+    BOOST_CHECK_EQUAL(diff.vBroadcasts.size(), 10);
+    BOOST_CHECK(diff.vPings.empty());
+
+    // the snapshot survives the wire and brings the client in sync
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << diff;
+    CMasternodeListDiff diffRecv;
+    ss >> diffRecv;
+    BOOST_CHECK(diffRecv.hashList == diff.hashList);
+    BOOST_CHECK_EQUAL(diffRecv.size(), diff.size());
+    ApplyUnchecked(client, diffRecv);
+    uint256 hashSynced = client.GetListHash();
+    BOOST_CHECK(hashSynced == server.GetListHash());
+
+    // an up to date peer gets an empty diff
+    server.GetListDiff(hashSynced, diff);
+    BOOST_CHECK(diff.hashBase == hashSynced);
+    BOOST_CHECK_EQUAL(diff.size(), 0);
+
+    // a new ping travels alone, a new masternode as a broadcast
+    server.Find(MakeMasternode(3).vin)->lastPing.sigTime += 60;
+    CMasternode mnNew = MakeMasternode(10);
+    server.Add(mnNew);
+    server.GetListDiff(hashSynced, diff);
+    BOOST_CHECK(diff.hashBase == hashSynced);
+    BOOST_CHECK_EQUAL(diff.vBroadcasts.size(), 1);
+    BOOST_CHECK_EQUAL(diff.vPings.size(), 1);
+    ApplyUnchecked(client, diff);
+    BOOST_CHECK(client.GetListHash() == server.GetListHash());
+
+    // a disabled masternode drops out of the served list
+    server.Find(mnNew.vin)->activeState = CMasternode::MASTERNODE_EXPIRED;
+    BOOST_CHECK(server.GetListHash() != client.GetListHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,489 @@
+// Copyright (c) 2019 The Syndicate Ltd developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "main.h"
+#include "net.h"
+#include "primitives/transaction.h"
+#include "utiltime.h"
+#include "test/test_syndicate.h"
+
+#include <set>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(net_tests, TestingSetup)
+
+// Bytes held by the distinct buffers the peers' last queued messages live in
+static size_t CountQueuedBytes(const std::vector<std::unique_ptr<CNode> >& vNodes)
+{
+    std::set<const CSerializeData*> setBuffers;
+    size_t nBytes = 0;
+    for (const auto& pnode : vNodes) {
+        if (setBuffers.insert(pnode->vSendMsg[SEND_PRIORITY_INVENTORY].back().get()).second)
+            nBytes += pnode->vSendMsg[SEND_PRIORITY_INVENTORY].back()->size();
+    }
+    return nBytes;
+}
+
+BOOST_AUTO_TEST_CASE(relay_copy_benchmark)
+{
+    const int nPeers = 125;
+    std::vector<std::unique_ptr<CNode> > vNodes;
+    for (int i = 0; i < nPeers; i++) {
+        CAddress addr(CService(CNetAddr(strprintf("10.0.%d.%d", i / 250, i % 250 + 1)), 25992));
+        vNodes.emplace_back(new CNode(INVALID_SOCKET, addr, "", true));
+    }
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].scriptSig = CScript() << OP_11;
+    mtx.vout.resize(300);
+    for (size_t i = 0; i < mtx.vout.size(); i++) {
+        mtx.vout[i].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        mtx.vout[i].nValue = i;
+    }
+    CTransaction tx(mtx);
+
+    // Serialized again for every peer
+    int64_t nStart = GetTimeMicros();
+    for (const auto& pnode : vNodes)
+        pnode->PushMessage("tx", tx);
+    int64_t nPerPeerTime = GetTimeMicros() - nStart;
+    size_t nPerPeerBytes = CountQueuedBytes(vNodes);
+    CSerializedNetMsg msgPerPeer = vNodes[0]->vSendMsg[SEND_PRIORITY_INVENTORY].back();
+
+    // Serialized once and shared
+    nStart = GetTimeMicros();
+    CSerializedNetMsg msg = MakeSerializedNetMsg("tx", tx);
+    for (const auto& pnode : vNodes)
+        pnode->PushSerializedMessage(msg);
+    int64_t nSharedTime = GetTimeMicros() - nStart;
+    size_t nSharedBytes = CountQueuedBytes(vNodes);
+
+    BOOST_TEST_MESSAGE(strprintf("relay of a %u byte message to %d peers: %u bytes serialized in %dus per peer, %u bytes in %dus shared",
+        msg->size(), nPeers, nPerPeerBytes, nPerPeerTime, nSharedBytes, nSharedTime));
+    BOOST_CHECK(*msg == *msgPerPeer);
+    BOOST_CHECK_EQUAL(nPerPeerBytes, msg->size() * nPeers);
+    BOOST_CHECK_EQUAL(nSharedBytes, msg->size());
+    BOOST_CHECK_EQUAL(msg.use_count(), nPeers + 1);
+    for (const auto& pnode : vNodes)
+        BOOST_CHECK_EQUAL(pnode->nSendSize, 2 * msg->size());
+}
+
+BOOST_AUTO_TEST_CASE(receive_pooled_buffers)
+{
+    CAddress addr(CService(CNetAddr("10.0.0.1"), 25992));
+    CNode node(INVALID_SOCKET, addr, "", true);
+
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].scriptSig = CScript() << OP_11;
+    mtx.vout.resize(2);
+    CTransaction tx(mtx);
+    // Above the exact size limit, so it takes a pooled buffer
+    mtx.vout.resize(600);
+    CTransaction txLarge(mtx);
+    BOOST_REQUIRE(txLarge.GetSerializeSize(SER_NETWORK, PROTOCOL_VERSION) > CNetMessageBufferPool::MAX_EXACT_SIZE);
+
+    // What a peer relaying transactions sends, with a large message now and then
+    std::vector<CSerializedNetMsg> vMsgs;
+    int nLarge = 0;
+    for (int i = 0; i < 1000; i++) {
+        if (i % 100 == 99) {
+            vMsgs.push_back(MakeSerializedNetMsg("block", std::vector<unsigned char>(CNetMessageBufferPool::BUFFER_SIZE + i, (unsigned char)i)));
+            nLarge++;
+        } else if (i % 3 == 0)
+            vMsgs.push_back(MakeSerializedNetMsg("inv", std::vector<CInv>(1 + i % 7, CInv(MSG_TX, tx.GetHash()))));
+        else if (i % 3 == 1)
+            vMsgs.push_back(MakeSerializedNetMsg("tx", i % 2 ? tx : txLarge));
+        else
+            vMsgs.push_back(MakeSerializedNetMsg("ping", (uint64_t)i));
+    }
+    CSerializeData stream;
+    size_t nPooled = 0;
+    for (const CSerializedNetMsg& msg : vMsgs) {
+        stream.insert(stream.end(), msg->begin(), msg->end());
+        if (msg->size() - CMessageHeader::HEADER_SIZE > CNetMessageBufferPool::MAX_EXACT_SIZE)
+            nPooled++;
+    }
+
+    uint64_t nAllocationsBefore = netMessageBufferPool.GetAllocations();
+    uint64_t nReusesBefore = netMessageBufferPool.GetReuses();
+
+    // Fed in pieces that split headers and data, each message handled as soon as it is complete
+    size_t nReceived = 0;
+    size_t nPos = 0;
+    while (nPos < stream.size()) {
+        unsigned int nBytes = std::min(stream.size() - nPos, (size_t)1000 + nPos % 3001);
+        LOCK(node.cs_vRecvMsg);
+        BOOST_REQUIRE(node.ReceiveMsgBytes(&stream[nPos], nBytes));
+        nPos += nBytes;
+        while (!node.vRecvMsg.empty() && node.vRecvMsg.front().complete()) {
+            CNetMessage& msg = node.vRecvMsg.front();
+            const CSerializeData& sent = *vMsgs[nReceived];
+            BOOST_CHECK_EQUAL(msg.hdr.GetCommand(), std::string(&sent[MESSAGE_START_SIZE]));
+            uint256 hash = msg.GetMessageHash();
+            BOOST_CHECK_EQUAL(msg.hdr.nChecksum, hash.Get64(0) & 0xffffffff);
+            BOOST_CHECK(std::equal(msg.vRecv.begin(), msg.vRecv.end(), sent.begin() + CMessageHeader::HEADER_SIZE));
+            if (msg.hdr.nMessageSize <= CNetMessageBufferPool::MAX_EXACT_SIZE)
+                BOOST_CHECK_EQUAL(msg.vRecv.capacity(), msg.hdr.nMessageSize);
+            node.vRecvMsg.pop_front();
+            nReceived++;
+        }
+    }
+    BOOST_CHECK_EQUAL(nReceived, vMsgs.size());
+
+    uint64_t nAllocations = netMessageBufferPool.GetAllocations() - nAllocationsBefore;
+    uint64_t nReuses = netMessageBufferPool.GetReuses() - nReusesBefore;
+    BOOST_TEST_MESSAGE(strprintf("%u messages (%u bytes, %u pooled) received with %u buffer allocations (%.3f per pooled message), %u reused buffers",
+        nReceived, stream.size(), nPooled, nAllocations, (double)nAllocations / nPooled, nReuses));
+    // Only the large messages and at most the first pooled one need a buffer of their own
+    BOOST_CHECK(nAllocations <= (uint64_t)nLarge + 1);
+    BOOST_CHECK_EQUAL(nAllocations + nReuses, nPooled);
+}
+
+BOOST_AUTO_TEST_CASE(receive_empty_messages_bounded)
+{
+    CAddress addr(CService(CNetAddr("10.0.0.1"), 25992));
+    CNode node(INVALID_SOCKET, addr, "", true);
+
+    // One full read of back to back headers without data
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << CMessageHeader("verack", 0);
+    CSerializedNetMsg msg = FinalizeSerializedNetMsg(ss);
+    BOOST_REQUIRE_EQUAL(msg->size(), (size_t)CMessageHeader::HEADER_SIZE);
+    CSerializeData stream;
+    while (stream.size() + msg->size() <= 64 * 1024)
+        stream.insert(stream.end(), msg->begin(), msg->end());
+    size_t nMessages = stream.size() / msg->size();
+
+    uint64_t nAllocationsBefore = netMessageBufferPool.GetAllocations();
+    uint64_t nReusesBefore = netMessageBufferPool.GetReuses();
+
+    LOCK(node.cs_vRecvMsg);
+    BOOST_REQUIRE(node.ReceiveMsgBytes(&stream[0], stream.size()));
+    BOOST_CHECK_EQUAL(node.vRecvMsg.size(), nMessages);
+
+    // No buffer reserved for any of them, and what is held is counted against the flood limit
+    size_t nReserved = 0;
+    for (const CNetMessage& msgRecv : node.vRecvMsg) {
+        BOOST_CHECK(msgRecv.complete());
+        nReserved += msgRecv.vRecv.capacity();
+    }
+    BOOST_CHECK_EQUAL(nReserved, 0U);
+    BOOST_CHECK_EQUAL(netMessageBufferPool.GetAllocations(), nAllocationsBefore);
+    BOOST_CHECK_EQUAL(netMessageBufferPool.GetReuses(), nReusesBefore);
+    BOOST_CHECK_EQUAL(node.GetTotalRecvSize(), nMessages * sizeof(CNetMessage));
+    BOOST_CHECK(node.GetTotalRecvSize() < 64 * stream.size());
+}
+
+BOOST_AUTO_TEST_CASE(poisson_next_send)
+{
+    // Exponentially distributed delays: they average the interval, and 1/e of them are longer
+    const int nSamples = 10000;
+    const int64_t nNow = GetTimeMicros();
+    double dTotal = 0;
+    int nLonger = 0;
+    for (int i = 0; i < nSamples; i++) {
+        int64_t nDelay = PoissonNextSend(nNow, INVENTORY_BROADCAST_INTERVAL) - nNow;
+        BOOST_CHECK(nDelay >= 0);
+        dTotal += nDelay;
+        if (nDelay > INVENTORY_BROADCAST_INTERVAL * 1000000LL)
+            nLonger++;
+    }
+    double dMean = dTotal / nSamples / 1000000;
+    BOOST_CHECK(dMean > INVENTORY_BROADCAST_INTERVAL * 0.9 && dMean < INVENTORY_BROADCAST_INTERVAL * 1.1);
+    BOOST_CHECK(nLonger > nSamples * 0.33 && nLonger < nSamples * 0.40);
+}
+
+BOOST_AUTO_TEST_CASE(inventory_batching)
+{
+    CAddress addr(CService(CNetAddr("10.0.0.1"), 25992));
+    CNode node(INVALID_SOCKET, addr, "", true);
+    node.nVersion = PROTOCOL_VERSION;
+
+    // Announced twice before they are sent, queued once
+    for (int i = 0; i < 3000; i++) {
+        node.PushInventory(CInv(MSG_TX, uint256(i + 1)));
+        node.PushInventory(CInv(MSG_TX, uint256(i + 1)));
+    }
+    node.PushInventory(CInv(MSG_BLOCK, uint256(1)));
+    BOOST_CHECK_EQUAL(node.setInventoryTxToSend.size(), 3000);
+
+    uint64_t nMessagesBefore, nInvsBefore, nBytesBefore, nMessages, nInvs, nBytes;
+    int64_t nSince;
+    CNode::GetTotalInvSent(nMessagesBefore, nInvsBefore, nBytesBefore, nSince);
+
+    // The block goes out right away, the transactions wait for their time
+    node.nNextInvSend = GetTimeMicros() + 60 * 1000000LL;
+    SendMessages(&node);
+    CNode::GetTotalInvSent(nMessages, nInvs, nBytes, nSince);
+    BOOST_CHECK_EQUAL(nMessages - nMessagesBefore, 1);
+    BOOST_CHECK_EQUAL(nInvs - nInvsBefore, 1);
+    BOOST_CHECK_EQUAL(node.setInventoryTxToSend.size(), 3000);
+
+    // Then all of them in a single message
+    node.nNextInvSend = 0;
+    SendMessages(&node);
+    CNode::GetTotalInvSent(nMessages, nInvs, nBytes, nSince);
+    BOOST_CHECK_EQUAL(nMessages - nMessagesBefore, 2);
+    BOOST_CHECK_EQUAL(nInvs - nInvsBefore, 3001);
+    BOOST_CHECK_EQUAL(nBytes - nBytesBefore, 2 * CMessageHeader::HEADER_SIZE + 1 + 3 + 3001 * 36);
+    BOOST_CHECK(node.setInventoryTxToSend.empty());
+    BOOST_CHECK(node.nNextInvSend > GetTimeMicros());
+
+    // Known from now on, not announced again
+    node.PushInventory(CInv(MSG_TX, uint256(1)));
+    BOOST_CHECK(node.setInventoryTxToSend.empty());
+
+    // But its lock request is another item
+    node.PushInventory(CInv(MSG_TXLOCK_REQUEST, uint256(1)));
+    BOOST_CHECK_EQUAL(node.vInventoryToSend.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(inventory_relay_order)
+{
+    CAddress addr(CService(CNetAddr("10.0.0.1"), 25992));
+    CNode node(INVALID_SOCKET, addr, "", true);
+    node.nVersion = PROTOCOL_VERSION;
+
+    // A chain relayed parent first, with hashes that sort the other way round
+    std::vector<uint256> vHashes;
+    for (int i = 0; i < 50; i++)
+        vHashes.push_back(uint256(1000 - i));
+    for (const uint256& hash : vHashes)
+        node.PushInventory(CInv(MSG_TX, hash));
+    node.PushInventory(CInv(MSG_TX, vHashes[0]));
+    BOOST_CHECK_EQUAL(node.vInventoryTxToSend.size(), vHashes.size());
+
+    node.nNextInvSend = 0;
+    SendMessages(&node);
+    BOOST_CHECK(node.vInventoryTxToSend.empty());
+
+    // Announced in the order they were relayed
+    BOOST_REQUIRE(!node.vSendMsg[SEND_PRIORITY_INVENTORY].empty());
+    const CSerializeData& sent = *node.vSendMsg[SEND_PRIORITY_INVENTORY].back();
+    BOOST_CHECK_EQUAL(std::string(&sent[MESSAGE_START_SIZE]), "inv");
+    CDataStream ss(sent.begin() + CMessageHeader::HEADER_SIZE, sent.end(), SER_NETWORK, PROTOCOL_VERSION);
+    std::vector<CInv> vInv;
+    ss >> vInv;
+    BOOST_REQUIRE_EQUAL(vInv.size(), vHashes.size());
+    for (size_t i = 0; i < vInv.size(); i++)
+        BOOST_CHECK(vInv[i].hash == vHashes[i]);
+}
+
+#ifndef WIN32
+BOOST_AUTO_TEST_CASE(send_queued_messages)
+{
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    CAddress addr(CService(CNetAddr("10.0.0.1"), 25992));
+    CNode node(fds[0], addr, "", true);
+
+    // More than the socket takes at once, so messages are left queued and partly sent
+    CSerializeData expected;
+    for (int i = 0; i < 200; i++) {
+        CSerializedNetMsg msg = MakeSerializedNetMsg("ping", std::vector<unsigned char>(10000 + i, (unsigned char)i));
+        expected.insert(expected.end(), msg->begin(), msg->end());
+        node.PushSerializedMessage(msg);
+    }
+    BOOST_CHECK(!node.vSendMsg[SEND_PRIORITY_CONSENSUS].empty());
+
+    CSerializeData received;
+    std::vector<char> vBuf(65536);
+    for (int i = 0; i < 100000 && received.size() < expected.size(); i++) {
+        ssize_t nBytes = recv(fds[1], &vBuf[0], vBuf.size(), MSG_DONTWAIT);
+        if (nBytes > 0)
+            received.insert(received.end(), vBuf.begin(), vBuf.begin() + nBytes);
+        LOCK(node.cs_vSend);
+        SocketSendData(&node);
+    }
+
+    BOOST_CHECK(received == expected);
+    BOOST_CHECK(node.vSendMsg[SEND_PRIORITY_CONSENSUS].empty());
+    BOOST_CHECK_EQUAL(node.nSendSize, 0);
+    BOOST_CHECK_EQUAL(node.nSendOffset, 0);
+    BOOST_CHECK_EQUAL(node.nSendBytes, expected.size());
+    close(fds[1]);
+}
+
+// The other end of the socket pair: what the node sent, read into a peer that parses it into messages
+static size_t ReceiveFromSocket(int fd, CNode& peer)
+{
+    std::vector<char> vBuf(65536);
+    size_t nTotal = 0;
+    ssize_t nBytes;
+    while ((nBytes = recv(fd, &vBuf[0], vBuf.size(), MSG_DONTWAIT)) > 0) {
+        LOCK(peer.cs_vRecvMsg);
+        BOOST_REQUIRE(peer.ReceiveMsgBytes(&vBuf[0], nBytes));
+        nTotal += nBytes;
+    }
+    return nTotal;
+}
+
+BOOST_AUTO_TEST_CASE(send_priorities)
+{
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    CAddress addr(CService(CNetAddr("10.0.0.1"), 25992));
+    CNode node(fds[0], addr, "", true);
+    CNode peer(INVALID_SOCKET, addr, "", true);
+
+    // A peer downloading blocks, more than the socket takes at once
+    const int nBlocks = 50;
+    CSerializedNetMsg block = MakeSerializedNetMsg("block", std::vector<unsigned char>(100000, 0x42));
+    for (int i = 0; i < nBlocks; i++)
+        node.PushSerializedMessage(block);
+    size_t nBlocksStarted = (node.nSendBytes + block->size() - 1) / block->size();
+    BOOST_CHECK(nBlocksStarted < (size_t)nBlocks);
+
+    // Then masternode winners, a ping and a message nobody knows
+    CSerializedNetMsg mnw = MakeSerializedNetMsg("mnw", std::vector<unsigned char>(200, 0x01));
+    for (int i = 0; i < 3; i++)
+        node.PushSerializedMessage(mnw);
+    CSerializedNetMsg ping = MakeSerializedNetMsg("ping", (uint64_t)42);
+    node.PushSerializedMessage(ping);
+    CSerializedNetMsg other = MakeSerializedNetMsg("madeup", (uint64_t)42);
+    node.PushSerializedMessage(other);
+    const size_t nTotal = nBlocks * block->size() + 3 * mnw->size() + ping->size() + other->size();
+
+    size_t nReceived = 0;
+    for (int i = 0; i < 100000 && nReceived < nTotal; i++) {
+        nReceived += ReceiveFromSocket(fds[1], peer);
+        LOCK(node.cs_vSend);
+        SocketSendData(&node);
+    }
+    BOOST_CHECK_EQUAL(nReceived, nTotal);
+    BOOST_CHECK_EQUAL(node.nSendSize, 0);
+
+    // The block being sent is finished, then the ping and the winners overtake the other blocks
+    std::vector<std::string> vCommands;
+    for (const CNetMessage& msg : peer.vRecvMsg)
+        vCommands.push_back(msg.hdr.GetCommand());
+    std::vector<std::string> vExpected(nBlocksStarted, "block");
+    vExpected.push_back("ping");
+    vExpected.insert(vExpected.end(), 3, "mnw");
+    vExpected.push_back("madeup");
+    vExpected.insert(vExpected.end(), nBlocks - nBlocksStarted, "block");
+    BOOST_CHECK(vCommands == vExpected);
+
+    // Both ends counted the bytes by command, the receiving one lumping together the commands it does not know
+    CNodeStats stats, peerStats;
+    node.copyStats(stats);
+    peer.copyStats(peerStats);
+    BOOST_CHECK_EQUAL(stats.mapSendBytesPerMsgCmd["block"], nBlocks * block->size());
+    BOOST_CHECK_EQUAL(stats.mapSendBytesPerMsgCmd["mnw"], 3 * mnw->size());
+    BOOST_CHECK_EQUAL(stats.mapSendBytesPerMsgCmd["madeup"], other->size());
+    BOOST_CHECK_EQUAL(peerStats.mapRecvBytesPerMsgCmd["block"], nBlocks * block->size());
+    BOOST_CHECK_EQUAL(peerStats.mapRecvBytesPerMsgCmd["mnw"], 3 * mnw->size());
+    BOOST_CHECK_EQUAL(peerStats.mapRecvBytesPerMsgCmd["ping"], ping->size());
+    BOOST_CHECK_EQUAL(peerStats.mapRecvBytesPerMsgCmd["*other*"], other->size());
+    BOOST_CHECK(!peerStats.mapRecvBytesPerMsgCmd.count("madeup"));
+    close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(send_rate_cap)
+{
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    CAddress addr(CService(CNetAddr("10.0.0.1"), 25992));
+    CNode node(fds[0], addr, "", true);
+    CNode peer(INVALID_SOCKET, addr, "", true);
+
+    const int64_t nRate = 200000;
+    nMaxSendRate[SEND_PRIORITY_BULK] = nRate;
+    int64_t nStart = GetTimeMicros();
+
+    CSerializedNetMsg block = MakeSerializedNetMsg("block", std::vector<unsigned char>(100000, 0x42));
+    for (int i = 0; i < 10; i++)
+        node.PushSerializedMessage(block);
+
+    // Blocks go at the capped rate, a transaction queued meanwhile goes right away
+    CSerializedNetMsg tx = MakeSerializedNetMsg("tx", std::vector<unsigned char>(250, 0x01));
+    bool fTxQueued = false;
+    while (GetTimeMicros() - nStart < 500000) {
+        ReceiveFromSocket(fds[1], peer);
+        if (!fTxQueued && GetTimeMicros() - nStart > 250000) {
+            node.PushSerializedMessage(tx);
+            fTxQueued = true;
+        }
+        {
+            LOCK(node.cs_vSend);
+            SocketSendData(&node);
+        }
+        MilliSleep(1);
+    }
+    ReceiveFromSocket(fds[1], peer);
+    int64_t nElapsed = GetTimeMicros() - nStart;
+
+    // A second of allowance to start with, what it earned since, and the block it was sending
+    uint64_t nBlockBytes = node.nSendBytes - tx->size();
+    BOOST_TEST_MESSAGE(strprintf("%u block bytes sent in %dus at a cap of %d bytes per second", nBlockBytes, nElapsed, nRate));
+    BOOST_CHECK(nBlockBytes <= nRate + nRate * nElapsed / 1000000 + block->size());
+    BOOST_CHECK(nBlockBytes >= (uint64_t)nRate / 2);
+    BOOST_CHECK(!node.vSendMsg[SEND_PRIORITY_BULK].empty());
+
+    CNodeStats peerStats;
+    peer.copyStats(peerStats);
+    BOOST_CHECK_EQUAL(peerStats.mapRecvBytesPerMsgCmd["tx"], tx->size());
+
+    nMaxSendRate[SEND_PRIORITY_BULK] = 0;
+    close(fds[1]);
+}
+
+BOOST_AUTO_TEST_CASE(send_rate_cap_backlog)
+{
+    int fds[2];
+    BOOST_REQUIRE_EQUAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    CAddress addr(CService(CNetAddr("10.0.0.1"), 25992));
+    CNode node(fds[0], addr, "", true);
+    CNode peer(INVALID_SOCKET, addr, "", true);
+    node.nVersion = PROTOCOL_VERSION;
+
+    // More blocks queued than the send buffer holds, draining at a slow cap, and a block asked for behind them
+    nMaxSendRate[SEND_PRIORITY_BULK] = 1000;
+    CSerializedNetMsg block = MakeSerializedNetMsg("block", std::vector<unsigned char>(100000, 0x42));
+    while (node.nSendSize < 2 * SendBufferSize())
+        node.PushSerializedMessage(block);
+    node.vRecvGetData.push_back(CInv(MSG_BLOCK, uint256(1)));
+    BOOST_CHECK_EQUAL(node.GetUncappedSendSize(), 0U);
+
+    // A ping, then a message whose answer would overtake the block asked for
+    CSerializeData stream;
+    CSerializedNetMsg ping = MakeSerializedNetMsg("ping", (uint64_t)42);
+    CSerializedNetMsg getaddr = MakeSerializedNetMsg("getaddr", std::vector<unsigned char>());
+    stream.insert(stream.end(), ping->begin(), ping->end());
+    stream.insert(stream.end(), getaddr->begin(), getaddr->end());
+    {
+        LOCK(node.cs_vRecvMsg);
+        BOOST_REQUIRE(node.ReceiveMsgBytes(&stream[0], stream.size()));
+        BOOST_CHECK(ProcessMessages(&node));
+        BOOST_CHECK(ProcessMessages(&node));
+
+        // The ping is answered, the request and the other message wait for the backlog
+        BOOST_CHECK_EQUAL(node.vRecvGetData.size(), 1U);
+        BOOST_REQUIRE_EQUAL(node.vRecvMsg.size(), 1U);
+        BOOST_CHECK_EQUAL(node.vRecvMsg.front().hdr.GetCommand(), "getaddr");
+    }
+    BOOST_CHECK(!node.fDisconnect);
+
+    // And the pong goes out ahead of the blocks
+    CNodeStats peerStats;
+    for (int i = 0; i < 100 && !peerStats.mapRecvBytesPerMsgCmd.count("pong"); i++) {
+        {
+            LOCK(node.cs_vSend);
+            SocketSendData(&node);
+        }
+        ReceiveFromSocket(fds[1], peer);
+        peer.copyStats(peerStats);
+    }
+    BOOST_CHECK(peerStats.mapRecvBytesPerMsgCmd.count("pong"));
+    BOOST_CHECK(!node.vSendMsg[SEND_PRIORITY_BULK].empty());
+
+    nMaxSendRate[SEND_PRIORITY_BULK] = 0;
+    close(fds[1]);
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
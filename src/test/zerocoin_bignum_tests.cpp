@@ -10,6 +10,7 @@
 #include "libzerocoin/Denominations.h"
 #include "libzerocoin/CoinSpend.h"
 #include "libzerocoin/Accumulator.h"
+#include "libzerocoin/FixedBaseTable.h"
 #include "zpiv/zerocoin.h"
 
 
@@ -88,4 +89,31 @@ BOOST_AUTO_TEST_CASE(bignum_random_generation_tests)
     }
 }
 
+BOOST_AUTO_TEST_CASE(bignum_fixed_base_table_tests)
+{
+    CBigNum modulus;
+    modulus.SetHex(strHexModulus);
+    CBigNum base = CBigNum::randBignum(modulus);
+    const uint32_t nTableBits = 258;
+    libzerocoin::FixedBaseTable table(base, modulus, nTableBits);
+
+    // Zero, exponents inside the table, exponents that spill over it, and negative exponents
+    std::vector<CBigNum> vExponents = {CBigNum(0), CBigNum(1), CBigNum(16), CBigNum(2).pow(nTableBits)};
+    for (int i = 0; i < 20; i++) {
+        vExponents.push_back(CBigNum::randKBitBignum(nTableBits));
+        vExponents.push_back(CBigNum::randKBitBignum(3 * nTableBits));
+        vExponents.push_back(-CBigNum::randKBitBignum(nTableBits));
+    }
+
+    for (const CBigNum& e : vExponents) {
+        CBigNum expected = base.pow_mod(e, modulus);
+        BOOST_CHECK_MESSAGE(table.pow_mod(e) == expected, strprintf("FixedBaseTable::pow_mod failed with e=%s", e.ToString()));
+        BOOST_CHECK_MESSAGE(table.pow_mod_public(e) == expected, strprintf("FixedBaseTable::pow_mod_public failed with e=%s", e.ToString()));
+    }
+
+    std::vector<CBigNum> vTable = {CBigNum(7), modulus, CBigNum(0), base};
+    for (unsigned int i = 0; i < vTable.size(); i++)
+        BOOST_CHECK(CBigNum::sec_select(vTable, i) == vTable[i]);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -13,6 +13,7 @@
 #include "wallet/walletdb.h"
 #include "txdb.h"
 #include "zpiv/zpivmodule.h"
+#include "zpivchain.h"
 #include "test/test_syndicate.h"
 #include <boost/test/unit_test.hpp>
 #include <iostream>
@@ -117,4 +118,37 @@ BOOST_AUTO_TEST_CASE(zerocoin_public_spend_test)
 
 }
 
+BOOST_AUTO_TEST_CASE(zerocoin_spend_cache_test)
+{
+    libzerocoin::ZerocoinParams *ZCParams = Params().Zerocoin_Params(false);
+    libzerocoin::ZerocoinParams *ZCParamsV1 = Params().Zerocoin_Params(true);
+    CZerocoinSpendCache cache;
+
+    const CZerocoinSpendCache::SpendKey key(GetRandHash(), 0);
+    BOOST_CHECK(!cache.Get(key, ZCParams));
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 1);
+
+    std::shared_ptr<const libzerocoin::CoinSpend> spend = std::make_shared<const PublicCoinSpend>(ZCParams);
+    cache.Set(key, ZCParams, spend);
+    BOOST_CHECK(cache.Get(key, ZCParams) == spend);
+    BOOST_CHECK(cache.Get(CZerocoinSpendCache::SpendKey(key.first, 1), ZCParams) == nullptr);
+    // Parsed with other params, has to be parsed again
+    BOOST_CHECK(cache.Get(key, ZCParamsV1) == nullptr);
+    BOOST_CHECK_EQUAL(cache.GetHits(), 1);
+    BOOST_CHECK_EQUAL(cache.GetMisses(), 3);
+
+    // Bounded by -maxzcspendcachesize
+    mapArgs["-maxzcspendcachesize"] = "4";
+    for (unsigned int i = 0; i < 10; i++)
+        cache.Set(CZerocoinSpendCache::SpendKey(GetRandHash(), i), ZCParams, spend);
+    BOOST_CHECK_EQUAL(cache.Size(), 4);
+    mapArgs["-maxzcspendcachesize"] = "0";
+    cache.Set(key, ZCParams, spend);
+    BOOST_CHECK_EQUAL(cache.Size(), 4);
+    mapArgs.erase("-maxzcspendcachesize");
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.Size(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -311,6 +311,16 @@ bool CZerocoinDB::WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::Pu
     return WriteBatch(batch, true);
 }
 
+bool CZerocoinDB::WriteCoinMintBatch(const std::vector<std::pair<CBigNum, uint256> >& mintInfo)
+{
+    CLevelDBBatch batch;
+    for (const std::pair<CBigNum, uint256>& mint : mintInfo)
+        batch.Write(std::make_pair('m', GetPubCoinHash(mint.first)), mint.second);
+
+    LogPrint("zero", "Writing %u coin mints to db.\n", (unsigned int)mintInfo.size());
+    return WriteBatch(batch, true);
+}
+
 bool CZerocoinDB::ReadCoinMint(const CBigNum& bnPubcoin, uint256& hashTx)
 {
     return ReadCoinMint(GetPubCoinHash(bnPubcoin), hashTx);
@@ -344,6 +354,19 @@ bool CZerocoinDB::WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::C
     return WriteBatch(batch, true);
 }
 
+bool CZerocoinDB::WriteCoinSpendBatch(const std::vector<std::pair<CBigNum, uint256> >& spendInfo)
+{
+    CLevelDBBatch batch;
+    for (const std::pair<CBigNum, uint256>& spend : spendInfo) {
+        CDataStream ss(SER_GETHASH, 0);
+        ss << spend.first;
+        batch.Write(std::make_pair('s', Hash(ss.begin(), ss.end())), spend.second);
+    }
+
+    LogPrint("zero", "Writing %u coin spends to db.\n", (unsigned int)spendInfo.size());
+    return WriteBatch(batch, true);
+}
+
 bool CZerocoinDB::ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash)
 {
     CDataStream ss(SER_GETHASH, 0);
@@ -426,3 +449,57 @@ bool CZerocoinDB::EraseAccumulatorValue(const uint32_t& nChecksum)
     LogPrint("zero", "%s : checksum:%d\n", __func__, nChecksum);
     return Erase(std::make_pair('2', nChecksum));
 }
+
+bool CZerocoinDB::WriteBlockPubcoins(int nHeight, const uint256& hashBlock, const std::list<libzerocoin::PublicCoin>& listPubcoins)
+{
+    std::vector<std::pair<CBigNum, int> > vPubcoins;
+    vPubcoins.reserve(listPubcoins.size());
+    for (const libzerocoin::PublicCoin& pubcoin : listPubcoins)
+        vPubcoins.emplace_back(pubcoin.getValue(), (int)pubcoin.getDenomination());
+
+    LogPrint("zero", "%s : height:%d pubcoins:%d\n", __func__, nHeight, vPubcoins.size());
+    return Write(std::make_pair('p', nHeight), std::make_pair(hashBlock, vPubcoins));
+}
+
+bool CZerocoinDB::ReadBlockPubcoins(int nHeight, uint256& hashBlock, std::list<libzerocoin::PublicCoin>& listPubcoins)
+{
+    std::pair<uint256, std::vector<std::pair<CBigNum, int> > > entry;
+    if (!Read(std::make_pair('p', nHeight), entry))
+        return false;
+
+    hashBlock = entry.first;
+    listPubcoins.clear();
+    for (const std::pair<CBigNum, int>& pubcoin : entry.second)
+        listPubcoins.emplace_back(Params().Zerocoin_Params(false), pubcoin.first, (libzerocoin::CoinDenomination)pubcoin.second);
+    return true;
+}
+
+bool CZerocoinDB::EraseBlockPubcoins(int nHeight)
+{
+    return Erase(std::make_pair('p', nHeight));
+}
+
+bool CZerocoinDB::WriteZerocoinBlockIndex(int nHeight, const CZerocoinBlockIndex& zerocoinIndex)
+{
+    return Write(std::make_pair('z', nHeight), zerocoinIndex);
+}
+
+bool CZerocoinDB::WriteZerocoinBlockIndexBatch(const std::vector<std::pair<int, CZerocoinBlockIndex> >& vIndexes)
+{
+    CLevelDBBatch batch;
+    for (const std::pair<int, CZerocoinBlockIndex>& index : vIndexes)
+        batch.Write(std::make_pair('z', index.first), index.second);
+
+    LogPrint("zero", "Writing %u zerocoin block indexes to db.\n", (unsigned int)vIndexes.size());
+    return WriteBatch(batch);
+}
+
+bool CZerocoinDB::ReadZerocoinBlockIndex(int nHeight, CZerocoinBlockIndex& zerocoinIndex)
+{
+    return Read(std::make_pair('z', nHeight), zerocoinIndex);
+}
+
+bool CZerocoinDB::EraseZerocoinBlockIndex(int nHeight)
+{
+    return Erase(std::make_pair('z', nHeight));
+}
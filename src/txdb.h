@@ -69,6 +69,83 @@ public:
     bool LoadBlockIndexGuts();
 };
 
+/** A zerocoin mint or spend recorded by -zerocoinindex */
+class CZerocoinIndexEntry
+{
+public:
+    CBigNum bnValue; //! pubcoin value of a mint, serial number of a spend
+    libzerocoin::CoinDenomination denom;
+    uint256 txid;
+    uint32_t nTxPos; //! position of the transaction in the block
+    uint32_t nIndex; //! output index of a mint, input index of a spend
+    bool fValid; //! false if the consensus filters drop it (invalid outpoint or serial)
+    bool fPublicSpend;
+    CTxOut txoutFirst; //! first output of a spending transaction, for getserials
+
+    CZerocoinIndexEntry()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        bnValue = 0;
+        denom = libzerocoin::ZQ_ERROR;
+        txid = 0;
+        nTxPos = 0;
+        nIndex = 0;
+        fValid = true;
+        fPublicSpend = false;
+        txoutFirst.SetNull();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(bnValue);
+        READWRITE(denom);
+        READWRITE(txid);
+        READWRITE(nTxPos);
+        READWRITE(nIndex);
+        READWRITE(fValid);
+        READWRITE(fPublicSpend);
+        READWRITE(txoutFirst);
+    }
+};
+
+/** The zerocoin mints and spends of one block, in block order */
+class CZerocoinBlockIndex
+{
+public:
+    uint256 hashBlock;
+    std::vector<CZerocoinIndexEntry> vMints;
+    std::vector<CZerocoinIndexEntry> vSpends;
+
+    CZerocoinBlockIndex()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        hashBlock = 0;
+        vMints.clear();
+        vSpends.clear();
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(hashBlock);
+        READWRITE(vMints);
+        READWRITE(vSpends);
+    }
+};
+
 /** Zerocoin database (zerocoin/) */
 class CZerocoinDB : public CLevelDBWrapper
 {
@@ -82,10 +159,12 @@ private:
 public:
     /** Write zPIV mints to the zerocoinDB in a batch */
     bool WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo);
+    bool WriteCoinMintBatch(const std::vector<std::pair<CBigNum, uint256> >& mintInfo);
     bool ReadCoinMint(const CBigNum& bnPubcoin, uint256& txHash);
     bool ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx);
     /** Write zPIV spends to the zerocoinDB in a batch */
     bool WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo);
+    bool WriteCoinSpendBatch(const std::vector<std::pair<CBigNum, uint256> >& spendInfo);
     bool ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash);
     bool ReadCoinSpend(const uint256& hashSerial, uint256 &txHash);
     bool EraseCoinMint(const CBigNum& bnPubcoin);
@@ -94,6 +173,15 @@ public:
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
     bool EraseAccumulatorValue(const uint32_t& nChecksum);
+    /** Accumulable pubcoins of the block at a height, so accumulator checkpoints don't re-read block bodies */
+    bool WriteBlockPubcoins(int nHeight, const uint256& hashBlock, const std::list<libzerocoin::PublicCoin>& listPubcoins);
+    bool ReadBlockPubcoins(int nHeight, uint256& hashBlock, std::list<libzerocoin::PublicCoin>& listPubcoins);
+    bool EraseBlockPubcoins(int nHeight);
+    /** Mints and spends of the block at a height, kept when -zerocoinindex is set */
+    bool WriteZerocoinBlockIndex(int nHeight, const CZerocoinBlockIndex& zerocoinIndex);
+    bool WriteZerocoinBlockIndexBatch(const std::vector<std::pair<int, CZerocoinBlockIndex> >& vIndexes);
+    bool ReadZerocoinBlockIndex(int nHeight, CZerocoinBlockIndex& zerocoinIndex);
+    bool EraseZerocoinBlockIndex(int nHeight);
 };
 
 #endif // BITCOIN_TXDB_H
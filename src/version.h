@@ -12,7 +12,7 @@
  * network protocol versioning
  */
 
-static const int PROTOCOL_VERSION = 70921;
+static const int PROTOCOL_VERSION = 70924;
 
 //! initial proto version, to be increased after version/verack negotiation
 static const int INIT_PROTO_VERSION = 211;
@@ -27,6 +27,15 @@ static const int MIN_PEER_PROTO_VERSION_AFTER_ENFORCEMENT = 70921;
 //! masternodes older than this proto version use old strMessage format for mnannounce
 static const int MIN_PEER_MNANNOUNCE = 70918;
 
+//! "getmnlist"/"mnlist" masternode list snapshots and diffs start with this version
+static const int MNLIST_DIFF_VERSION = 70922;
+
+//! "getheaders" is answered with headers, and blocks are synced headers-first, starting with this version
+static const int HEADERS_FIRST_VERSION = 70923;
+
+//! "cmpctblock", "getblocktxn" and "blocktxn" compact block relay starts with this version
+static const int SHORT_IDS_BLOCKS_VERSION = 70924;
+
 //! nTime field added to CAddress, starting with this version;
 //! if possible, avoid requesting addresses nodes older than this
 static const int CADDR_TIME_VERSION = 70912;
@@ -24,6 +24,7 @@
 
 #include "libzerocoin/Coin.h"
 #include "spork.h"
+#include "zpiv/accumulators.h"
 #include "zpiv/deterministicmint.h"
 #include <boost/assign/list_of.hpp>
 #include <boost/thread/thread.hpp>
@@ -3580,9 +3581,19 @@ UniValue dzpivstate(const UniValue& params, bool fHelp) {
     if (fHelp || params.size() != 0)
         throw std::runtime_error(
                 "dzpivstate\n"
-                        "\nThe current state of the mintpool of the deterministic zPIV wallet.\n" +
+                        "\nThe current state of the mintpool of the deterministic zPIV wallet, and of its spend witness cache.\n" +
                 HelpRequiringPassphrase() + "\n"
 
+                        "\nResult:\n"
+                        "{\n"
+                        "  \"dzpiv_count\": n,            (numeric) Number of deterministic mints generated\n"
+                        "  \"mintpool_count\": n,         (numeric) Count of the last mint used\n"
+                        "  \"witness_cache_count\": n,    (numeric) Number of mints with a precomputed witness\n"
+                        "  \"witness_cache_fresh\": n,    (numeric) Number of those witnesses accumulated up to witness_target_height\n"
+                        "  \"witness_cache_height\": n,   (numeric) Height the least advanced witness is accumulated to\n"
+                        "  \"witness_target_height\": n   (numeric) Height the precompute thread keeps the witnesses at\n"
+                        "}\n"
+
                         "\nExamples\n" +
                 HelpExampleCli("mintpoolstatus", "") + HelpExampleRpc("mintpoolstatus", ""));
 
@@ -3593,40 +3604,26 @@ UniValue dzpivstate(const UniValue& params, bool fHelp) {
     obj.push_back(Pair("dzpiv_count", nCount));
     obj.push_back(Pair("mintpool_count", nCountLastUsed));
 
-    return obj;
-}
-
-
-void static SearchThread(CzPIVWallet* zwallet, int nCountStart, int nCountEnd)
-{
-    LogPrintf("%s: start=%d end=%d\n", __func__, nCountStart, nCountEnd);
-    CWalletDB walletDB(pwalletMain->strWalletFile);
-    try {
-        uint256 seedMaster = zwallet->GetMasterSeed();
-        uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
-        for(int i = nCountStart; i < nCountEnd; i++) {
-            boost::this_thread::interruption_point();
-            CDataStream ss(SER_GETHASH, 0);
-            ss << seedMaster << i;
-            uint512 zerocoinSeed = Hash512(ss.begin(), ss.end());
-
-            CBigNum bnValue;
-            CBigNum bnSerial;
-            CBigNum bnRandomness;
-            CKey key;
-            zwallet->SeedToZPIV(zerocoinSeed, bnValue, bnSerial, bnRandomness, key);
+    int nHeightTarget;
+    {
+        LOCK(cs_main);
+        nHeightTarget = GetWitnessTargetHeight(chainActive.Height());
+    }
 
-            uint256 hashPubcoin = GetPubCoinHash(bnValue);
-            zwallet->AddToMintPool(std::make_pair(hashPubcoin, i), true);
-            walletDB.WriteMintPoolPair(hashSeed, hashPubcoin, i);
-        }
-    } catch (std::exception& e) {
-        LogPrintf("SearchThread() exception");
-    } catch (...) {
-        LogPrintf("SearchThread() exception");
+    int nWitnesses, nFresh, nHeightLowest;
+    {
+        LOCK(pwalletMain->zpivTracker->cs_spendcache);
+        pwalletMain->zpivTracker->GetSpendCacheState(nHeightTarget, nWitnesses, nFresh, nHeightLowest);
     }
+    obj.push_back(Pair("witness_cache_count", nWitnesses));
+    obj.push_back(Pair("witness_cache_fresh", nFresh));
+    obj.push_back(Pair("witness_cache_height", nHeightLowest));
+    obj.push_back(Pair("witness_target_height", nHeightTarget));
+
+    return obj;
 }
 
+
 UniValue searchdzpiv(const UniValue& params, bool fHelp)
 {
     if(fHelp || params.size() != 3)
@@ -3638,7 +3635,7 @@ UniValue searchdzpiv(const UniValue& params, bool fHelp)
             "\nArguments\n"
             "1. \"count\"       (numeric) Which sequential zPIV to start with.\n"
             "2. \"range\"       (numeric) How many zPIV to generate.\n"
-            "3. \"threads\"     (numeric) How many threads should this operation consume.\n"
+            "3. \"threads\"     (numeric) How many threads should this operation consume (0 = one per core).\n"
 
             "\nExamples\n" +
             HelpExampleCli("searchdzpiv", "1, 100, 2") + HelpExampleRpc("searchdzpiv", "1, 100, 2"));
@@ -3657,18 +3654,8 @@ UniValue searchdzpiv(const UniValue& params, bool fHelp)
 
     CzPIVWallet* zwallet = pwalletMain->zwalletMain;
 
-    boost::thread_group* dzpivThreads = new boost::thread_group();
-    int nRangePerThread = nRange / nThreads;
-
-    int nPrevThreadEnd = nCount - 1;
-    for (int i = 0; i < nThreads; i++) {
-        int nStart = nPrevThreadEnd + 1;;
-        int nEnd = nStart + nRangePerThread;
-        nPrevThreadEnd = nEnd;
-        dzpivThreads->create_thread(boost::bind(&SearchThread, zwallet, nStart, nEnd));
-    }
-
-    dzpivThreads->join_all();
+    // Mints are derived in parallel and written to the wallet in batches, an interrupted search resumes where it stopped
+    zwallet->GenerateMintPool(nCount, nRange, nThreads);
 
     zwallet->RemoveMintsFromPool(pwalletMain->zpivTracker->GetSerialHashes());
     zwallet->SyncWithChain(false);
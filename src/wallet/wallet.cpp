@@ -1372,7 +1372,10 @@ void CWalletTx::RelayWalletTransaction(std::string strCommand)
             LogPrintf("Relaying wtx %s\n", hash.ToString());
 
             if (strCommand == "ix") {
-                mapTxLockReq.insert(std::make_pair(hash, (CTransaction) * this));
+                {
+                    LOCK(cs_swifttx);
+                    mapTxLockReq.insert(std::make_pair(hash, (CTransaction) * this));
+                }
                 CreateNewLock(((CTransaction) * this));
                 RelayTransactionLockReq((CTransaction) * this, true);
             } else {
@@ -3714,7 +3717,8 @@ int CMerkleTx::GetTransactionLockSignatures() const
     if (!fEnableSwiftTX) return -1;
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
+    LOCK(cs_swifttx);
+    TransactionLockMap::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()) {
         return (*i).second.CountSignatures();
     }
@@ -3727,7 +3731,8 @@ bool CMerkleTx::IsTransactionLockTimedOut() const
     if (!fEnableSwiftTX) return 0;
 
     //compile consessus vote
-    std::map<uint256, CTransactionLock>::iterator i = mapTxLocks.find(GetHash());
+    LOCK(cs_swifttx);
+    TransactionLockMap::iterator i = mapTxLocks.find(GetHash());
     if (i != mapTxLocks.end()) {
         return GetTime() > (*i).second.nTimeout;
     }
@@ -4800,28 +4805,42 @@ void ThreadPrecomputeSpends()
     LogPrintf("ThreadPrecomputeSpends exiting,\n");
 }
 
+/** Write the witnesses advanced since the last write to the precompute database */
+static void WriteDirtyPrecomputes(CzPIVTracker* tracker, CWalletDB& walletdb, std::set<uint256>& setDirtyWitnessData)
+{
+    if (setDirtyWitnessData.empty())
+        return;
+
+    LOCK(tracker->cs_spendcache);
+    for (const uint256& hash : setDirtyWitnessData) {
+        CoinWitnessData* witnessData = tracker->GetSpendCache(hash);
+        if (witnessData->pAccumulator && witnessData->nHeightAccEnd)
+            walletdb.WritePrecompute(hash, CoinWitnessCacheData(witnessData));
+        else
+            tracker->EraseSpendCache(hash);
+    }
+
+    LogPrint("precompute", "%s: Writing %d precomputes to database\n", __func__, setDirtyWitnessData.size());
+    setDirtyWitnessData.clear();
+}
+
 void CWallet::PrecomputeSpends()
 {
-    // We don't even need to worry about this code.. no zPIV.
-    /*
     LogPrintf("Precomputer started\n");
     RenameThread("syndicate-precomputer");
 
     CWalletDB walletdb("precomputes.dat", "cr+");
 
-    // Create LRU Cache
-    std::list<std::pair<uint256, CoinWitnessCacheData> > item_list;
-    std::map<uint256, std::list<std::pair<uint256, CoinWitnessCacheData> >::iterator> item_map;
+    // Witnesses persisted by an earlier run, consumed as the mints are seen again
+    std::map<uint256, CoinWitnessCacheData> mapStoredWitnessData;
 
-    // Dirty cache that needs to be written to disk
-    std::map<uint256, CoinWitnessCacheData> mapDirtyWitnessData;
+    // Witnesses advanced since they were last written to disk
+    std::set<uint256> setDirtyWitnessData;
 
     // Initialize Variables
     bool fLoadedPrecomputesFromDB = false;
-    bool fOnFirstLoad = true;
-    int64_t nLastCacheCleanUpTime = GetTime();
-    int64_t nLastCacheWriteDB = nLastCacheCleanUpTime;
-    int nRequiredStakeDepthBuffer = Params().Zerocoin_RequiredStakeDepth() + 10;
+    uint256 hashLastTip;
+    int64_t nLastCacheWriteDB = GetTime();
     int nAdjustableCacheLength = GetArg("-precomputecachelength", DEFAULT_PRECOMPUTE_LENGTH);
 
     // Force the cache length to be divisible by 10
@@ -4834,249 +4853,170 @@ void CWallet::PrecomputeSpends()
     if (nAdjustableCacheLength > MAX_PRECOMPUTE_LENGTH)
         nAdjustableCacheLength = MAX_PRECOMPUTE_LENGTH;
 
-    while (true) {
-        // Check to see if we need to clear the cache
-        if (fClearSpendCache) {
-            fClearSpendCache = false;
-            item_map.clear();
-            item_list.clear();
-            mapDirtyWitnessData.clear();
-            nLastCacheCleanUpTime = GetTime();
-            nLastCacheWriteDB = nLastCacheCleanUpTime;
-        }
-
-        // Get the list of zPIV inputs
-        std::list <std::unique_ptr<CStakeInput>> listInputs;
-        if (!SelectStakeCoins(listInputs, 0, true)) {
-            MilliSleep(5000);
-            continue;
-        }
-
-        if (listInputs.empty()) {
-            MilliSleep(5000);
-            continue;
-        }
-
-        if (ShutdownRequested())
-            break;
+    try {
+        while (true) {
+            boost::this_thread::interruption_point();
+            if (ShutdownRequested())
+                break;
 
-        while (IsLocked())
-            MilliSleep(5000);
+            // Check to see if we need to clear the cache
+            if (fClearSpendCache) {
+                fClearSpendCache = false;
+                mapStoredWitnessData.clear();
+                setDirtyWitnessData.clear();
+                hashLastTip.SetNull();
+            }
 
-        // If we haven't loaded from database yet, load the precomputes from the database
-        if (!fLoadedPrecomputesFromDB) {
-            // Load the precomputes into the LRU cache
-            walletdb.LoadPrecomputes(item_list, item_map);
-            fLoadedPrecomputesFromDB = true;
-            LogPrint("precompute", "%s: Loaded precomputes from database. Size of lru cache: %d\n", __func__,
-                     item_map.size());
-        }
+            // Only work when a block was connected since the last completed round
+            uint256 hashTip;
+            int nHeightEnd;
+            {
+                LOCK(cs_main);
+                hashTip = chainActive.Tip()->GetBlockHash();
+                nHeightEnd = GetWitnessTargetHeight(chainActive.Height());
+            }
 
-        // Do some precomputing of zerocoin spend knowledge proofs
-        std::set <uint256> setInputHashes;
-        for (std::unique_ptr <CStakeInput>& stakeInput : listInputs) {
-            if (ShutdownRequested() || IsLocked())
-                break;
+            if (hashTip == hashLastTip || IsLocked() || nHeightEnd < Params().Zerocoin_StartHeight()) {
+                MilliSleep(5000);
+                continue;
+            }
 
-            CoinWitnessCacheData tempDataHolder;
+            // If we haven't loaded from database yet, load the precomputes from the database
+            if (!fLoadedPrecomputesFromDB) {
+                std::list<std::pair<uint256, CoinWitnessCacheData> > listPrecomputes;
+                std::map<uint256, std::list<std::pair<uint256, CoinWitnessCacheData> >::iterator> mapPrecomputes;
+                walletdb.LoadPrecomputes(listPrecomputes, mapPrecomputes);
+                for (auto& item : listPrecomputes)
+                    mapStoredWitnessData.insert(item);
+                fLoadedPrecomputesFromDB = true;
+                LogPrint("precompute", "%s: Loaded %d precomputes from database\n", __func__, mapStoredWitnessData.size());
+            }
 
+            // Witnesses are kept for the unspent mints that are deep enough to accumulate
+            std::set<uint256> setStakeHashes;
             {
+                LOCK2(cs_main, cs_wallet);
+                for (const CMintMeta& meta : zpivTracker->ListMints(true, false, false)) {
+                    if (meta.hashStake != 0 && meta.nHeight && meta.nHeight < nHeightEnd - 10)
+                        setStakeHashes.insert(meta.hashStake);
+                }
+            }
+
+            bool fComplete = false;
+            std::set<uint256> setPrepared;
+            while (!ShutdownRequested() && !IsLocked()) {
                 TRY_LOCK(zpivTracker->cs_spendcache, fLocked);
-                if (!fLocked)
+                if (!fLocked) {
+                    MilliSleep(150);
                     continue;
-
-                if (fGlobalUnlockSpendCache) {
-                    break;
                 }
 
-                // When we see a clear spend cache bool set to true, break out of the loop
-                // All cache data will be cleared at the beginning of the while loop above
-                if (fClearSpendCache) {
+                // A spend is waiting on the cache, or it is being cleared: yield and start the round again
+                if (fGlobalUnlockSpendCache || fClearSpendCache)
                     break;
-                }
 
-                uint256 serialHash = stakeInput->GetSerialHash();
-                setInputHashes.insert(serialHash);
-                CoinWitnessData* witnessData = zpivTracker->GetSpendCache(serialHash);
-
-                // Initialize nHeightStop so it can be set below
-                int nHeightStop = 0;
-
-                if (witnessData->nHeightAccStart) { // Witness is already valid
-                    nHeightStop = std::min(chainActive.Height() - nRequiredStakeDepthBuffer,
-                                           (witnessData->nHeightAccEnd ? witnessData->nHeightAccEnd
-                                                                       : witnessData->nHeightAccStart) +
-                                           nAdjustableCacheLength);
-                } else if (item_map.count(serialHash)) { // Check Database cache
-                    // Get the witness data from the cache
-                    auto it = item_map.find(serialHash);
-                    item_list.splice(item_list.begin(), item_list, it->second);
-
-                    *witnessData = CoinWitnessData(it->second->second);
-
-                    // Set the stop height from the variables received from the database cache
-                    nHeightStop = std::min(chainActive.Height() - nRequiredStakeDepthBuffer,
-                                           (witnessData->nHeightAccEnd ? witnessData->nHeightAccEnd
-                                                                       : witnessData->nHeightAccStart) +
-                                           nAdjustableCacheLength);
-
-                    LogPrint("precompute", "%s: Got Witness Data from lru cache: %s\n", __func__,
-                             witnessData->ToString());
-                } else if (mapDirtyWitnessData.count(serialHash) || walletdb.ReadPrecompute(serialHash, tempDataHolder)) {
-                    if (mapDirtyWitnessData.count(serialHash)) {
-                        // Get the witness data from the dirty cache if it exists
-                        *witnessData = CoinWitnessData(mapDirtyWitnessData.at(serialHash));
-                        LogPrint("precompute", "%s: Got Witness Data from mapDirtyWitnessData: %s\n", __func__,
-                                 witnessData->ToString());
-                    } else {
-                        // Get the witness data from the database
-                        *witnessData = CoinWitnessData(tempDataHolder);
-                        LogPrint("precompute", "%s: Got Witness Data from precompute database: %s\n", __func__,
-                                 witnessData->ToString());
+                std::vector<CoinWitnessData*> vWitnesses;
+                std::vector<uint256> vHashes;
+                int nHeightLowest = nHeightEnd + 1;
+                for (const uint256& hashStake : setStakeHashes) {
+                    CoinWitnessData* witnessData = zpivTracker->GetSpendCache(hashStake);
+
+                    // Restore the persisted witness, or start a new one for a mint never cached
+                    if (!witnessData->coin) {
+                        auto it = mapStoredWitnessData.find(hashStake);
+                        if (it != mapStoredWitnessData.end()) {
+                            *witnessData = CoinWitnessData(it->second);
+                            mapStoredWitnessData.erase(it);
+                        } else {
+                            CZerocoinMint mint;
+                            if (!GetMintFromStakeHash(hashStake, mint)) {
+                                zpivTracker->EraseSpendCache(hashStake);
+                                continue;
+                            }
+                            *witnessData = CoinWitnessData(mint);
+                        }
                     }
 
-                    // Set the stop height from the variables received from the database cache
-                    nHeightStop = std::min(chainActive.Height() - nRequiredStakeDepthBuffer,
-                                           (witnessData->nHeightAccEnd ? witnessData->nHeightAccEnd
-                                                                       : witnessData->nHeightAccStart) +
-                                           nAdjustableCacheLength);
-
-                    // Add the serialHash found into the cache
-                    item_list.push_front(std::make_pair(serialHash, tempDataHolder));
-                    item_map.insert(std::make_pair(serialHash, item_list.begin()));
-
-                    // We just added a new hash into our LRU cache, so remove it if we also have it in the dirty map
-                    mapDirtyWitnessData.erase(serialHash);
-
-                    if (item_map.size() > PRECOMPUTE_LRU_CACHE_SIZE) {
-                        auto last_it = item_list.end(); last_it --;
-                        item_map.erase(last_it->first);
-                        CoinWitnessCacheData removedData = item_list.back().second;
-                        mapDirtyWitnessData[serialHash] = removedData;
-                        item_list.pop_back();
+                    // Rewind witnesses left on a reorganized chain and set up new ones, once per round
+                    if (!setPrepared.count(hashStake) && (!witnessData->pAccumulator || IsWitnessStale(witnessData))) {
+                        setPrepared.insert(hashStake);
+                        if (!PrepareAccumulatorWitness(witnessData)) {
+                            LogPrintf("%s: failed to prepare witness for %s\n", __func__, hashStake.GetHex());
+                            zpivTracker->EraseSpendCache(hashStake);
+                            walletdb.ErasePrecompute(hashStake);
+                            continue;
+                        }
                     }
-                } else { // This has no cache, so initialize it
-                    CZerocoinMint mint;
-                    if (!GetMintFromStakeHash(serialHash, mint))
-                        continue;
-                    *witnessData = CoinWitnessData(mint);
-                    nHeightStop = std::min(chainActive.Height() - nRequiredStakeDepthBuffer,
-                                           mint.GetHeight() + nAdjustableCacheLength);
-                }
 
-                if (nHeightStop - (witnessData->nHeightAccEnd ? witnessData->nHeightAccEnd : witnessData->nHeightAccStart) < 20)
-                    continue;
+                    int nHeightNext = std::max(witnessData->nHeightAccStart, witnessData->nHeightAccEnd + 1);
+                    if (!witnessData->pAccumulator || nHeightNext > nHeightEnd)
+                        continue;
 
-                CBlockIndex* pindexStop = chainActive[nHeightStop];
-                AccumulatorMap mapAccumulators(Params().Zerocoin_Params(false));
-                LogPrint("precompute","%s: caching mint %s of denom %d start=%d stop=%d end=%s\n", __func__,
-                          witnessData->coin->getValue().GetHex().substr(0, 6),
-                          ZerocoinDenominationToInt(witnessData->denom),
-                          witnessData->nHeightAccStart, nHeightStop, witnessData->nHeightAccEnd);
-
-                if (!GenerateAccumulatorWitness(witnessData, mapAccumulators, pindexStop)) {
-                    LogPrintf("%s: Generate witness failed!\n", __func__);
-
-                    // If we fail this check, we need to make sure we remove this from the LRU cache
-                    auto it = item_map.find(serialHash);
-                    if (it != item_map.end())
-                    {
-                        item_list.erase(it->second);
-                        item_map.erase(it);
-                    }
-                    mapDirtyWitnessData.erase(serialHash);
-                    walletdb.ErasePrecompute(serialHash);
-                    continue;
+                    vWitnesses.emplace_back(witnessData);
+                    vHashes.emplace_back(hashStake);
+                    nHeightLowest = std::min(nHeightLowest, nHeightNext);
                 }
 
-
-                CoinWitnessCacheData serialData(witnessData);
-
-                // If the LRU cache already has a entry for it, update the entry and move it to the front of the list
-                auto it = item_map.find(serialHash);
-                if (it != item_map.end()) {
-                    item_list.splice(item_list.begin(), item_list, it->second);
-                    item_list.begin()->second = serialData;
-                } else {
-                    item_list.push_front(std::make_pair(serialHash, serialData));
-                    item_map.insert(std::make_pair(serialHash, item_list.begin()));
+                if (vWitnesses.empty()) {
+                    fComplete = true;
+                    break;
                 }
 
-                // We just added a new hash into our LRU cache, so remove it if we also have it in the dirty map
-                mapDirtyWitnessData.erase(serialHash);
-
-                // Clean up the LRU cache to the max size
-                while (item_map.size() > PRECOMPUTE_LRU_CACHE_SIZE) {
-                    auto last_it = item_list.end(); last_it --;
-                    item_map.erase(last_it->first);
-                    mapDirtyWitnessData[serialHash] = item_list.back().second;
-                    item_list.pop_back();
+                // Advance every lagging witness together, at most one cache length per step
+                int nHeightStop = std::min(nHeightEnd, nHeightLowest + nAdjustableCacheLength - 1);
+                try {
+                    AccumulateRange(vWitnesses, nHeightStop);
+                } catch (GetPubcoinException& e) {
+                    LogPrintf("%s: %s\n", __func__, e.message);
+                    break;
                 }
-            }
-            // Sleep for 150ms to allow any potential spend attempt
-            MilliSleep(150);
-        }
+                setDirtyWitnessData.insert(vHashes.begin(), vHashes.end());
+                LogPrint("precompute", "%s: advanced %d witnesses from %d to %d\n", __func__, vWitnesses.size(), nHeightLowest, nHeightStop);
 
-        if (fGlobalUnlockSpendCache) {
-            fGlobalUnlockSpendCache = false;
-        }
-
-        // On first load, and every 5 minutes clean up our cache with only valid unspent inputs
-        if (fOnFirstLoad || nLastCacheCleanUpTime < GetTime() - PRECOMPUTE_FLUSH_TIME) {
-            LogPrint("precompute", "%s: Cleaning up precompute cache\n", __func__);
+                // Leave a window for any potential spend attempt
+                MilliSleep(150);
+            }
 
-            // We only want to clear the cache if we have calculated new witness data
-            if (setInputHashes.size()) {
-                // Get a list of hashes currently in the database
-                std::set <uint256> databaseHashes;
-                walletdb.LoadPrecomputes(databaseHashes);
+            if (fGlobalUnlockSpendCache) {
+                fGlobalUnlockSpendCache = false;
+            }
 
-                // Remove old cache data
-                for (auto inputHash : setInputHashes) {
-                    databaseHashes.erase(inputHash);
-                }
+            if (fComplete) {
+                hashLastTip = hashTip;
 
-                // Erase all old hashes from the database
-                for (auto hash : databaseHashes) {
-                    auto it = item_map.find(hash);
-                    if (it != item_map.end())
-                    {
-                        item_list.erase(it->second);
-                        item_map.erase(it);
+                // Forget spent mints, in memory and on disk
+                std::set<uint256> setDatabaseHashes;
+                walletdb.LoadPrecomputes(setDatabaseHashes);
+                {
+                    LOCK(zpivTracker->cs_spendcache);
+                    for (const uint256& hash : setDatabaseHashes) {
+                        if (setStakeHashes.count(hash))
+                            continue;
+                        walletdb.ErasePrecompute(hash);
+                        zpivTracker->EraseSpendCache(hash);
+                        setDirtyWitnessData.erase(hash);
                     }
-                    mapDirtyWitnessData.erase(hash);
-                    walletdb.ErasePrecompute(hash);
                 }
-
-                nLastCacheCleanUpTime = GetTime();
             }
-        }
 
-        // On first load, and every 5 minutes write the cache to database
-        if (mapDirtyWitnessData.size() > PRECOMPUTE_MAX_DIRTY_CACHE_SIZE || nLastCacheWriteDB < GetTime() - PRECOMPUTE_FLUSH_TIME || ShutdownRequested()) {
-            // Save all cache data that was dirty back into the database
-            for (auto item : mapDirtyWitnessData) {
-                walletdb.WritePrecompute(item.first, item.second);
+            // Every few minutes write the advanced witnesses to the database
+            if (setDirtyWitnessData.size() > PRECOMPUTE_MAX_DIRTY_CACHE_SIZE || nLastCacheWriteDB < GetTime() - PRECOMPUTE_FLUSH_TIME) {
+                WriteDirtyPrecomputes(zpivTracker.get(), walletdb, setDirtyWitnessData);
+                nLastCacheWriteDB = GetTime();
             }
-            mapDirtyWitnessData.clear();
 
-            // Save the LRU cache data into the database
-            for (auto item : item_list) {
-                walletdb.WritePrecompute(item.first, item.second);
-            }
+            if (ShutdownRequested())
+                break;
 
-            LogPrint("precompute", "%s: Writing precomputes to database. Precomputes size: %d\n", __func__, item_map.size());
-            nLastCacheWriteDB = GetTime();
+            MilliSleep(fComplete ? 5000 : 150);
         }
+    } catch (const boost::thread_interrupted&) {
+        // Interrupted while sleeping or between rounds: keep what was computed since the last write
+        WriteDirtyPrecomputes(zpivTracker.get(), walletdb, setDirtyWitnessData);
+        throw;
+    }
 
-        fOnFirstLoad = false;
-
-        if (ShutdownRequested())
-            break;
-
-        LogPrint("precompute", "%s: Finished precompute round...\n\n", __func__);
-        MilliSleep(5000);
-
-    }*/
+    // On shutdown, write the witnesses advanced since the last write
+    WriteDirtyPrecomputes(zpivTracker.get(), walletdb, setDirtyWitnessData);
 }
 
@@ -1375,6 +1375,29 @@ bool CWalletDB::WriteMintPoolPair(const uint256& hashMasterSeed, const uint256&
     return Write(std::make_pair(std::string("mintpool"), hashPubcoin), std::make_pair(hashMasterSeed, nCount));
 }
 
+//! range of a mint pool generation in progress, and the next count that still has to be written
+bool CWalletDB::WriteMintPoolProgress(const uint256& hashMasterSeed, const uint32_t& nCountStart, const uint32_t& nCountStop, const uint32_t& nCountNext)
+{
+    return Write(std::make_pair(std::string("mintpoolprogress"), hashMasterSeed), std::make_pair(std::make_pair(nCountStart, nCountStop), nCountNext));
+}
+
+bool CWalletDB::ReadMintPoolProgress(const uint256& hashMasterSeed, uint32_t& nCountStart, uint32_t& nCountStop, uint32_t& nCountNext)
+{
+    std::pair<std::pair<uint32_t, uint32_t>, uint32_t> progress;
+    if (!Read(std::make_pair(std::string("mintpoolprogress"), hashMasterSeed), progress))
+        return false;
+
+    nCountStart = progress.first.first;
+    nCountStop = progress.first.second;
+    nCountNext = progress.second;
+    return true;
+}
+
+bool CWalletDB::EraseMintPoolProgress(const uint256& hashMasterSeed)
+{
+    return Erase(std::make_pair(std::string("mintpoolprogress"), hashMasterSeed));
+}
+
 void CWalletDB::LoadPrecomputes(std::list<std::pair<uint256, CoinWitnessCacheData> >& itemList, std::map<uint256, std::list<std::pair<uint256, CoinWitnessCacheData> >::iterator>& itemMap)
 {
 
@@ -1421,7 +1444,7 @@ void CWalletDB::LoadPrecomputes(std::list<std::pair<uint256, CoinWitnessCacheDat
     pcursor->close();
 }
 
-void CWalletDB::LoadPrecomputes(std::set<uint256> setHashes)
+void CWalletDB::LoadPrecomputes(std::set<uint256>& setHashes)
 {
     Dbc* pcursor = GetCursor();
     if (!pcursor)
@@ -190,9 +190,12 @@ public:
     bool ReadZPIVCount(uint32_t& nCount);
     std::map<uint256, std::vector<std::pair<uint256, uint32_t> > > MapMintPool();
     bool WriteMintPoolPair(const uint256& hashMasterSeed, const uint256& hashPubcoin, const uint32_t& nCount);
+    bool WriteMintPoolProgress(const uint256& hashMasterSeed, const uint32_t& nCountStart, const uint32_t& nCountStop, const uint32_t& nCountNext);
+    bool ReadMintPoolProgress(const uint256& hashMasterSeed, uint32_t& nCountStart, uint32_t& nCountStop, uint32_t& nCountNext);
+    bool EraseMintPoolProgress(const uint256& hashMasterSeed);
 
     void LoadPrecomputes(std::list<std::pair<uint256, CoinWitnessCacheData> >& itemList, std::map<uint256, std::list<std::pair<uint256, CoinWitnessCacheData> >::iterator>& itemMap);
-    void LoadPrecomputes(std::set<uint256> setHashes);
+    void LoadPrecomputes(std::set<uint256>& setHashes);
     void EraseAllPrecomputes();
     bool WritePrecompute(const uint256& hash, const CoinWitnessCacheData& data);
     bool ReadPrecompute(const uint256& hash, CoinWitnessCacheData& data);
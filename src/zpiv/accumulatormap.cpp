@@ -72,6 +72,24 @@ bool AccumulatorMap::Accumulate(const libzerocoin::PublicCoin& pubCoin, bool fSk
     return true;
 }
 
+//Add a batch of zerocoins, with a single exponentiation per denomination.
+bool AccumulatorMap::Accumulate(const std::list<libzerocoin::PublicCoin>& listPubcoins, bool fSkipValidation)
+{
+    std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> > mapValues;
+    for (const libzerocoin::PublicCoin& pubCoin : listPubcoins) {
+        libzerocoin::CoinDenomination denom = pubCoin.getDenomination();
+        if (denom == libzerocoin::CoinDenomination::ZQ_ERROR)
+            return false;
+        if (!fSkipValidation && !pubCoin.validate())
+            return false;
+        mapValues[denom].emplace_back(pubCoin.getValue());
+    }
+
+    for (auto& it : mapValues)
+        mapAccumulators.at(it.first)->increment(it.second);
+    return true;
+}
+
 libzerocoin::Accumulator AccumulatorMap::GetAccumulator(libzerocoin::CoinDenomination denom)
 {
     return libzerocoin::Accumulator(params, denom, GetValue(denom));
@@ -18,6 +18,19 @@
 std::map<uint32_t, CBigNum> mapAccumulatorValues;
 std::list<uint256> listAccCheckpointsNoDB;
 
+//! Accumulator state after each recently calculated checkpoint block, by height
+struct CAccumulatorCheckpointState {
+    uint256 hashPrevBlock;
+    uint256 nCheckpoint;
+    AccumulatorCheckpoints::Checkpoint mapValues;
+};
+
+//! The state is carried forward from one checkpoint to the next; older states stay
+//! around as undo data so a reorg can resume from the last checkpoint before the fork.
+static CCriticalSection cs_checkpointstates;
+static std::map<int, CAccumulatorCheckpointState> mapCheckpointStates;
+static const int ACCUMULATOR_CHECKPOINT_STATES = 10;
+
 
 uint32_t ParseChecksum(uint256 nChecksum, libzerocoin::CoinDenomination denomination)
 {
@@ -193,6 +206,81 @@ bool EraseCheckpoints(int nStartHeight, int nEndHeight)
 }
 
 
+//Find the state calculated for the checkpoint at nHeight on the active chain
+static bool GetCheckpointState(int nHeight, CAccumulatorCheckpointState& state)
+{
+    if (nHeight < 1 || nHeight > chainActive.Height() + 1)
+        return false;
+
+    LOCK(cs_checkpointstates);
+    std::map<int, CAccumulatorCheckpointState>::const_iterator it = mapCheckpointStates.find(nHeight);
+    if (it == mapCheckpointStates.end() || it->second.hashPrevBlock != chainActive[nHeight - 1]->GetBlockHash())
+        return false;
+
+    state = it->second;
+    return true;
+}
+
+static void SetCheckpointState(int nHeight, const uint256& nCheckpoint, AccumulatorMap& mapAccumulators)
+{
+    CAccumulatorCheckpointState state;
+    state.hashPrevBlock = chainActive[nHeight - 1]->GetBlockHash();
+    state.nCheckpoint = nCheckpoint;
+    for (auto& denom : libzerocoin::zerocoinDenomList)
+        state.mapValues[denom] = mapAccumulators.GetValue(denom);
+
+    LOCK(cs_checkpointstates);
+    mapCheckpointStates[nHeight] = state;
+    while (mapCheckpointStates.size() > ACCUMULATOR_CHECKPOINT_STATES)
+        mapCheckpointStates.erase(mapCheckpointStates.begin());
+}
+
+
+//Get the accumulable pubcoins of a block, from the pubcoin index when possible
+static bool GetBlockPubcoins(const CBlockIndex* pindex, bool fFilterInvalid, std::list<libzerocoin::PublicCoin>& listPubcoins, bool& fFromIndex)
+{
+    listPubcoins.clear();
+    fFromIndex = true;
+
+    //blocks without mints have nothing to accumulate
+    if (pindex->vMintDenominationsInBlock.empty())
+        return true;
+
+    //the index holds the filtered list only
+    uint256 hashBlock;
+    if (fFilterInvalid && zerocoinDB->ReadBlockPubcoins(pindex->nHeight, hashBlock, listPubcoins) && hashBlock == pindex->GetBlockHash())
+        return true;
+
+    fFromIndex = false;
+    listPubcoins.clear();
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s: failed to read block from disk", __func__);
+
+    if (!BlockToPubcoinList(block, listPubcoins, fFilterInvalid))
+        return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
+
+    //fill in the index for blocks connected before it existed
+    if (fFilterInvalid)
+        zerocoinDB->WriteBlockPubcoins(pindex->nHeight, pindex->GetBlockHash(), listPubcoins);
+
+    return true;
+}
+
+
+bool IndexBlockPubcoins(const CBlock& block, const CBlockIndex* pindex)
+{
+    if (pindex->vMintDenominationsInBlock.empty())
+        return true;
+
+    std::list<libzerocoin::PublicCoin> listPubcoins;
+    if (!BlockToPubcoinList(block, listPubcoins, true))
+        return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
+
+    return zerocoinDB->WriteBlockPubcoins(pindex->nHeight, pindex->GetBlockHash(), listPubcoins);
+}
+
+
 bool InitializeAccumulators(const int nHeight, int& nHeightCheckpoint, AccumulatorMap& mapAccumulators)
 {
     if (nHeight < Params().Zerocoin_StartHeight())
@@ -231,7 +319,10 @@ bool InitializeAccumulators(const int nHeight, int& nHeightCheckpoint, Accumulat
 
     //Use the previous block's checkpoint to initialize the accumulator's state
     uint256 nCheckpointPrev = chainActive[nHeight - 1]->nAccumulatorCheckpoint;
-    if (nCheckpointPrev == 0)
+    CAccumulatorCheckpointState statePrev;
+    if (GetCheckpointState(nHeight - 10, statePrev) && statePrev.nCheckpoint == nCheckpointPrev)
+        mapAccumulators.Load(statePrev.mapValues);
+    else if (nCheckpointPrev == 0)
         mapAccumulators.Reset();
     else if (!mapAccumulators.Load(nCheckpointPrev))
         return error("%s: failed to reset to previous checkpoint", __func__);
@@ -255,7 +346,16 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
         return true;
     }
 
+    //carried forward from an earlier calculation of the same checkpoint (e.g. by the miner)
+    CAccumulatorCheckpointState state;
+    if (GetCheckpointState(nHeight, state)) {
+        mapAccumulators.Load(state.mapValues);
+        nCheckpoint = state.nCheckpoint;
+        return true;
+    }
+
     //set the accumulators to last checkpoint value
+    int64_t nTimeStart = GetTimeMicros();
     int nHeightCheckpoint;
     mapAccumulators.Reset();
     if (!InitializeAccumulators(nHeight, nHeightCheckpoint, mapAccumulators))
@@ -266,6 +366,7 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
 
     //Accumulate all coins over the last ten blocks that havent been accumulated (height - 20 through height - 11)
     int nTotalMintsFound = 0;
+    int nBlocksFromDisk = 0;
     CBlockIndex *pindex = chainActive[nHeightCheckpoint - 20];
 
     while (pindex->nHeight < nHeight - 10) {
@@ -280,22 +381,19 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
         }
 
         //grab mints from this block
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex))
-            return error("%s: failed to read block from disk", __func__);
-
         std::list<libzerocoin::PublicCoin> listPubcoins;
-        if (!BlockToPubcoinList(block, listPubcoins, fFilterInvalid))
-            return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
+        bool fFromIndex;
+        if (!GetBlockPubcoins(pindex, fFilterInvalid, listPubcoins, fFromIndex))
+            return error("%s: failed to get pubcoins of block %d", __func__, pindex->nHeight);
+        if (!fFromIndex)
+            nBlocksFromDisk++;
 
         nTotalMintsFound += listPubcoins.size();
         LogPrint("zero", "%s found %d mints\n", __func__, listPubcoins.size());
 
         //add the pubcoins to accumulator
-        for (const libzerocoin::PublicCoin& pubcoin : listPubcoins) {
-            if(!mapAccumulators.Accumulate(pubcoin, true))
-                return error("%s: failed to add pubcoin to accumulator at height %d", __func__, pindex->nHeight);
-        }
+        if(!mapAccumulators.Accumulate(listPubcoins, true))
+            return error("%s: failed to add pubcoins to accumulator at height %d", __func__, pindex->nHeight);
         pindex = chainActive.Next(pindex);
     }
 
@@ -305,7 +403,10 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
     else
         nCheckpoint = mapAccumulators.GetCheckpoint();
 
+    SetCheckpointState(nHeight, nCheckpoint, mapAccumulators);
+
     LogPrint("zero", "%s checkpoint=%s\n", __func__, nCheckpoint.GetHex());
+    LogPrint("bench", "%s: height=%d mints=%d blocks read from disk=%d: %.2fms\n", __func__, nHeight, nTotalMintsFound, nBlocksFromDisk, 0.001 * (GetTimeMicros() - nTimeStart));
     return true;
 }
 
@@ -372,36 +473,11 @@ std::list<libzerocoin::PublicCoin> GetPubcoinFromBlock(const CBlockIndex* pindex
 
 
 
-int AddBlockMintsToAccumulator(const libzerocoin::CoinDenomination den, const CBloomFilter filter, const CBlockIndex* pindex,
-                               libzerocoin::Accumulator* accumulator, bool isWitness, std::list<CBigNum>& notAddedCoins)
-{
-    // if this block contains mints of the denomination that is being spent, then add them to the witness
-    int nMintsAdded = 0;
-    if (pindex->MintedDenomination(den)) {
-        //add the mints to the witness
-        for (const libzerocoin::PublicCoin& pubcoin : GetPubcoinFromBlock(pindex)) {
-            if (pubcoin.getDenomination() != den) {
-                continue;
-            }
-
-            if (isWitness && filter.contains(pubcoin.getValue().getvch())) {
-                notAddedCoins.emplace_back(pubcoin.getValue());
-                continue;
-            }
-
-            accumulator->increment(pubcoin.getValue());
-            ++nMintsAdded;
-        }
-    }
-
-    return nMintsAdded;
-}
-
 int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nHeightMintAdded, const CBlockIndex* pindex,
                                libzerocoin::Accumulator* accumulator, bool isWitness)
 {
     // if this block contains mints of the denomination that is being spent, then add them to the witness
-    int nMintsAdded = 0;
+    std::vector<CBigNum> vValues;
     if (pindex->MintedDenomination(coin.getDenomination())) {
         //add the mints to the witness
         for (const libzerocoin::PublicCoin& pubcoin : GetPubcoinFromBlock(pindex)) {
@@ -411,12 +487,12 @@ int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nH
             if (isWitness && pindex->nHeight == nHeightMintAdded && pubcoin.getValue() == coin.getValue())
                 continue;
 
-            accumulator->increment(pubcoin.getValue());
-            ++nMintsAdded;
+            vValues.emplace_back(pubcoin.getValue());
         }
+        accumulator->increment(vValues);
     }
 
-    return nMintsAdded;
+    return vValues.size();
 }
 
 
@@ -513,6 +589,7 @@ void AccumulateRange(CoinWitnessData* coinWitness, int nHeightEnd)
     while (pindex && pindex->nHeight <= nHeightEnd) {
         coinWitness->nMintsAdded += AddBlockMintsToAccumulator(coinWitness, pindex, true);
         coinWitness->nHeightAccEnd = pindex->nHeight;
+        coinWitness->hashBlockAccEnd = pindex->GetBlockHash();
 
         // 10 blocks were accumulated twice when zPIV v2 was activated
         if (pindex->nHeight == Params().Zerocoin_Block_Double_Accumulated() + 10 && !fDoubleCounted) {
@@ -527,16 +604,97 @@ void AccumulateRange(CoinWitnessData* coinWitness, int nHeightEnd)
     LogPrint("bench", "        - Range accumulation completed in %.2fms\n", 0.001 * (nTimeEnd - nTimeStart));
 }
 
+void AccumulateRange(std::vector<CoinWitnessData*>& vWitnesses, int nHeightEnd)
+{
+    int64_t nTimeStart = GetTimeMicros();
+    int nHeightDoubleAccumulated = Params().Zerocoin_Block_Double_Accumulated() + 10;
+
+    //Witnesses crossing the double accumulated range replay it on their own
+    std::vector<CoinWitnessData*> vBatch;
+    int nHeightStart = nHeightEnd + 1;
+    for (CoinWitnessData* coinWitness : vWitnesses) {
+        int nHeightNext = std::max(coinWitness->nHeightAccStart, coinWitness->nHeightAccEnd + 1);
+        if (nHeightNext > nHeightEnd)
+            continue;
 
-bool GenerateAccumulatorWitness(CoinWitnessData* coinWitness, AccumulatorMap& mapAccumulators, CBlockIndex* pindexCheckpoint)
+        if (nHeightNext <= nHeightDoubleAccumulated && nHeightEnd >= nHeightDoubleAccumulated) {
+            AccumulateRange(coinWitness, nHeightEnd);
+            continue;
+        }
+
+        vBatch.emplace_back(coinWitness);
+        nHeightStart = std::min(nHeightStart, nHeightNext);
+    }
+
+    LogPrint("zero", "%s: witnesses=%d start=%d end=%d\n", __func__, vBatch.size(), nHeightStart, nHeightEnd);
+    CBlockIndex* pindex = chainActive[nHeightStart];
+    while (!vBatch.empty() && pindex && pindex->nHeight <= nHeightEnd) {
+        //Read the block once and split its mints by denomination for every witness
+        std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> > mapValues;
+        if (!pindex->vMintDenominationsInBlock.empty()) {
+            std::list<libzerocoin::PublicCoin> listPubcoins;
+            bool fFromIndex;
+            if (!GetBlockPubcoins(pindex, true, listPubcoins, fFromIndex))
+                throw GetPubcoinException("AccumulateRange: failed to get pubcoins of block " + std::to_string(pindex->nHeight));
+            for (const libzerocoin::PublicCoin& pubcoin : listPubcoins)
+                mapValues[pubcoin.getDenomination()].emplace_back(pubcoin.getValue());
+        }
+
+        for (CoinWitnessData* coinWitness : vBatch) {
+            if (std::max(coinWitness->nHeightAccStart, coinWitness->nHeightAccEnd + 1) > pindex->nHeight)
+                continue;
+
+            auto it = mapValues.find(coinWitness->denom);
+            if (it != mapValues.end()) {
+                //the witness leaves its own coin out of its accumulator
+                if (pindex->nHeight == coinWitness->nHeightMintAdded) {
+                    std::vector<CBigNum> vValues;
+                    for (const CBigNum& bnValue : it->second) {
+                        if (bnValue != coinWitness->coin->getValue())
+                            vValues.emplace_back(bnValue);
+                    }
+                    coinWitness->pAccumulator->increment(vValues);
+                    coinWitness->nMintsAdded += vValues.size();
+                } else {
+                    coinWitness->pAccumulator->increment(it->second);
+                    coinWitness->nMintsAdded += it->second.size();
+                }
+            }
+            coinWitness->nHeightAccEnd = pindex->nHeight;
+            coinWitness->hashBlockAccEnd = pindex->GetBlockHash();
+        }
+
+        pindex = chainActive.Next(pindex);
+    }
+    int64_t nTimeEnd = GetTimeMicros();
+    LogPrint("bench", "        - Range accumulation of %u witnesses completed in %.2fms\n", vWitnesses.size(), 0.001 * (nTimeEnd - nTimeStart));
+}
+
+int GetWitnessTargetHeight(int nChainHeight)
 {
-    try {
-        // Lock
-        LogPrint("zero", "%s: generating\n", __func__);
-        if (!LockMethod()) return false;
-        LogPrint("zero", "%s: after lock\n", __func__);
+    //stay a checkpoint behind the one stakes are checked against, ending right before a checkpoint
+    int nHeightStop = nChainHeight - Params().Zerocoin_RequiredStakeDepth() - 20;
+    nHeightStop -= nHeightStop % 10;
+    return nHeightStop - 1;
+}
 
-        int64_t nTimeStart = GetTimeMicros();
+bool IsWitnessStale(const CoinWitnessData* coinWitness)
+{
+    if (!coinWitness->nHeightAccEnd)
+        return false;
+
+    CBlockIndex* pindex = chainActive[coinWitness->nHeightAccEnd];
+    return !pindex || pindex->GetBlockHash() != coinWitness->hashBlockAccEnd;
+}
+
+bool PrepareAccumulatorWitness(CoinWitnessData* coinWitness)
+{
+    try {
+        //A reorg below the accumulated range invalidates the witness, so start over from its checkpoint
+        if (IsWitnessStale(coinWitness)) {
+            LogPrint("zero", "%s: witness accumulated to %d is not on the active chain, resetting\n", __func__, coinWitness->nHeightAccEnd);
+            coinWitness->ResetAccumulation();
+        }
 
         //If there is a Acc End height filled in, then this has already been partially accumulated.
         if (!coinWitness->nHeightAccEnd) {
@@ -555,6 +713,28 @@ bool GenerateAccumulatorWitness(CoinWitnessData* coinWitness, AccumulatorMap& ma
             coinWitness->pAccumulator->setValue(witnessAccumulator.getValue());
         }
 
+        return true;
+    } catch (searchMintHeightException e) {
+        return error("%s: searchMintHeightException: %s", __func__, e.message);
+    } catch (ChecksumInDbNotFoundException e) {
+        return error("%s: ChecksumInDbNotFoundException: %s", __func__, e.message);
+    }
+}
+
+
+bool GenerateAccumulatorWitness(CoinWitnessData* coinWitness, AccumulatorMap& mapAccumulators, CBlockIndex* pindexCheckpoint)
+{
+    try {
+        // Lock
+        LogPrint("zero", "%s: generating\n", __func__);
+        if (!LockMethod()) return false;
+        LogPrint("zero", "%s: after lock\n", __func__);
+
+        int64_t nTimeStart = GetTimeMicros();
+
+        if (!PrepareAccumulatorWitness(coinWitness))
+            return false;
+
         //add the pubcoins from the blockchain up to the next checksum starting from the block
         int nChainHeight = chainActive.Height();
         int nHeightMax = nChainHeight % 10;
@@ -604,15 +784,17 @@ bool GenerateAccumulatorWitness(CoinWitnessData* coinWitness, AccumulatorMap& ma
 bool calculateAccumulatedBlocksFor(
         int startHeight,
         int nHeightStop,
+        int nHeightMintAdded,
         CBlockIndex *pindex,
+        int &nCheckpointsAdded,
         CBigNum &bnAccValue,
         libzerocoin::Accumulator &accumulator,
-        libzerocoin::CoinDenomination den,
-        CBloomFilter filter,
         libzerocoin::Accumulator &witnessAccumulator,
-        std::list<CBigNum>& ret,
+        libzerocoin::PublicCoin coin,
         std::string& strError
 ){
+
+    int amountOfScannedBlocks = 0;
     bool fDoubleCounted = false;
     int nMintsAdded = 0;
     while (pindex) {
@@ -624,7 +806,7 @@ bool calculateAccumulatedBlocksFor(
 
             bnAccValue = 0;
             uint256 nCheckpointSpend = chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint;
-            if (!GetAccumulatorValueFromDB(nCheckpointSpend, den, bnAccValue) || bnAccValue == 0) {
+            if (!GetAccumulatorValueFromDB(nCheckpointSpend, coin.getDenomination(), bnAccValue) || bnAccValue == 0) {
                 throw new ChecksumInDbNotFoundException(
                         "calculateAccumulatedBlocksFor : failed to find checksum in database for accumulator");
             }
@@ -632,7 +814,8 @@ bool calculateAccumulatedBlocksFor(
             break;
         }
 
-        nMintsAdded += AddBlockMintsToAccumulator(den, filter, pindex, &witnessAccumulator, true, ret);
+        // Add it
+        nMintsAdded += AddBlockMintsToAccumulator(coin, nHeightMintAdded, pindex, &witnessAccumulator, true);
 
         // 10 blocks were accumulated twice when zPIV v2 was activated
         if (pindex->nHeight == 1050010 && !fDoubleCounted) {
@@ -641,6 +824,7 @@ bool calculateAccumulatedBlocksFor(
             continue;
         }
 
+        amountOfScannedBlocks++;
         pindex = chainActive.Next(pindex);
     }
 
@@ -656,145 +840,138 @@ bool calculateAccumulatedBlocksFor(
     return true;
 }
 
-bool calculateAccumulatedBlocksFor(
-        int startHeight,
-        int nHeightStop,
-        int nHeightMintAdded,
-        CBlockIndex *pindex,
-        int &nCheckpointsAdded,
-        CBigNum &bnAccValue,
-        libzerocoin::Accumulator &accumulator,
-        libzerocoin::Accumulator &witnessAccumulator,
-        libzerocoin::PublicCoin coin,
-        std::string& strError
-){
 
-    int amountOfScannedBlocks = 0;
-    bool fDoubleCounted = false;
-    int nMintsAdded = 0;
-    while (pindex) {
+void GetWitnessRangeBounds(int startingHeight, int maxCalculationRange, int& nHeightStart, int& nHeightStop)
+{
+    //get the checkpoint added at the next multiple of 10
+    nHeightStart = startingHeight + (10 - (startingHeight % 10));
+
+    int nChainHeight = chainActive.Height();
+    nHeightStop = nChainHeight - (nChainHeight % 10) - 20; // at least two checkpoints deep
+    if (nHeightStop - startingHeight > maxCalculationRange) {
+        int stop = startingHeight + maxCalculationRange;
+        nHeightStop = stop - (stop % 10) - 20;
+    }
+}
 
-        if (pindex->nHeight >= nHeightStop) {
-            //If this height is within the invalid range (when fraudulent coins were being minted), then continue past this range
-            if(InvalidCheckpointRange(pindex->nHeight))
-                continue;
+bool CalculateWitnessRange(
+        int startingHeight,
+        int maxCalculationRange,
+        libzerocoin::CoinDenomination den,
+        CWitnessRange& range,
+        std::string& strError,
+        std::atomic<int>* pnBlocksDone
+){
+    range.den = den;
+    std::vector<const CBlockIndex*> vBlocks;
+    try {
+        LOCK(cs_main);
+        int nHeightCheckpoint;
+        GetWitnessRangeBounds(startingHeight, maxCalculationRange, nHeightCheckpoint, range.nHeightStop);
 
-            bnAccValue = 0;
-            uint256 nCheckpointSpend = chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint;
-            if (!GetAccumulatorValueFromDB(nCheckpointSpend, coin.getDenomination(), bnAccValue) || bnAccValue == 0) {
-                throw new ChecksumInDbNotFoundException(
-                        "calculateAccumulatedBlocksFor : failed to find checksum in database for accumulator");
+        // Get the base accumulator, GetAccumulatorValue can move the checkpoint back
+        CBigNum bnAccValue = 0;
+        if (GetAccumulatorValue(nHeightCheckpoint, den, bnAccValue))
+            range.bnWitnessBase = bnAccValue;
+        range.bnAccValue = range.bnWitnessBase;
+        range.nHeightStart = nHeightCheckpoint - 10;
+
+        if (range.nHeightStop + 10 > chainActive.Height())
+            return error("%s: stop height %d is not two checkpoints deep", __func__, range.nHeightStop);
+        range.hashStop = chainActive[range.nHeightStop]->GetBlockHash();
+
+        // Collect the blocks up to the checkpoint at nHeightStop, the pubcoins are read without cs_main
+        int nScanned = 0;
+        bool fDoubleCounted = false;
+        const CBlockIndex* pindex = chainActive[range.nHeightStart];
+        while (pindex) {
+            if (pindex->nHeight >= range.nHeightStop && !InvalidCheckpointRange(pindex->nHeight)) {
+                uint256 nCheckpointSpend = chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint;
+                range.bnAccValue = 0;
+                if (!GetAccumulatorValueFromDB(nCheckpointSpend, den, range.bnAccValue) || range.bnAccValue == 0)
+                    throw ChecksumInDbNotFoundException("CalculateWitnessRange : failed to find checksum in database for accumulator");
+                break;
             }
-            accumulator.setValue(bnAccValue);
-            break;
-        }
 
-        // Add it
-        nMintsAdded += AddBlockMintsToAccumulator(coin, nHeightMintAdded, pindex, &witnessAccumulator, true);
+            if (pindex->MintedDenomination(den))
+                vBlocks.emplace_back(pindex);
+            nScanned++;
 
-        // 10 blocks were accumulated twice when zPIV v2 was activated
-        if (pindex->nHeight == 1050010 && !fDoubleCounted) {
-            pindex = chainActive[1050000];
-            fDoubleCounted = true;
-            continue;
+            // 10 blocks were accumulated twice when zPIV v2 was activated
+            if (pindex->nHeight == 1050010 && !fDoubleCounted) {
+                pindex = chainActive[1050000];
+                fDoubleCounted = true;
+                continue;
+            }
+            pindex = chainActive.Next(pindex);
         }
-
-        amountOfScannedBlocks++;
-        pindex = chainActive.Next(pindex);
+        // blocks without mints of the denomination are done already
+        if (pnBlocksDone)
+            (*pnBlocksDone) += nScanned - vBlocks.size();
+    } catch (ChecksumInDbNotFoundException e) {
+        return error("%s: ChecksumInDbNotFoundException: %s", __func__, e.message);
     }
 
-    // A certain amount of accumulated coins are required
-    if (nMintsAdded < Params().Zerocoin_RequiredAccumulation()) {
-        strError = _(strprintf("Less than %d mints added, unable to create spend",
-                               Params().Zerocoin_RequiredAccumulation()).c_str());
-        throw NotEnoughMintsException(strError);
+    try {
+        for (const CBlockIndex* pindex : vBlocks) {
+            boost::this_thread::interruption_point();
+            for (const libzerocoin::PublicCoin& pubcoin : GetPubcoinFromBlock(pindex)) {
+                if (pubcoin.getDenomination() == den)
+                    range.vPubcoins.emplace_back(pubcoin.getValue());
+            }
+            if (pnBlocksDone)
+                (*pnBlocksDone)++;
+        }
+    } catch (GetPubcoinException e) {
+        strError = e.message;
+        return error("%s: GetPubcoinException: %s", __func__, e.message);
     }
 
-    LogPrintf("calculateAccumulatedBlocksFor() : nMintsAdded %d",nMintsAdded);
+    range.bnProduct = range.vPubcoins.empty() ? CBigNum(1) : libzerocoin::ProductTree(range.vPubcoins, 0, range.vPubcoins.size());
 
+    LogPrint("zero", "%s : %d pubcoins of denomination %d in blocks %d to %d\n", __func__, range.vPubcoins.size(),
+             libzerocoin::ZerocoinDenominationToInt(den), range.nHeightStart, range.nHeightStop);
     return true;
 }
 
-
 bool CalculateAccumulatorWitnessFor(
         const libzerocoin::ZerocoinParams* params,
-        int startHeight,
-        int maxCalulationRange,
-        libzerocoin::CoinDenomination den,
+        const CWitnessRange& range,
         const CBloomFilter& filter,
         libzerocoin::Accumulator& accumulator,
         libzerocoin::AccumulatorWitness& witness,
         int& nMintsAdded,
         std::string& strError,
-        std::list<CBigNum>& ret,
-        int &heightStop
+        std::list<CBigNum>& ret
 ){
-    // Lock
-    if (!LockMethod()) return false;
-
-    try {
-        // Dummy coin init
-        libzerocoin::PublicCoin temp(params, 0, den);
-        // Dummy Acc init
-        libzerocoin::Accumulator testingAcc(params, den);
-
-        //get the checkpoint added at the next multiple of 10
-        int nHeightCheckpoint = startHeight + (10 - (startHeight % 10));
-
-        // Get the base accumulator
-        // TODO: This needs to be changed to the partial witness calculation on the next version.
-        CBigNum bnAccValue = 0;
-        if (GetAccumulatorValue(nHeightCheckpoint, den, bnAccValue)) {
-            accumulator.setValue(bnAccValue);
-            witness.resetValue(accumulator, temp);
-        }
-
-        // Add the pubcoins from the blockchain up to the next checksum starting from the block
-        CBlockIndex *pindex = chainActive[nHeightCheckpoint -10];
-        int nChainHeight = chainActive.Height();
-        int nHeightStop = nChainHeight % 10;
-        nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
-
-        if (nHeightStop - startHeight > maxCalulationRange) {
-            int stop = (startHeight + maxCalulationRange);
-            int nHeightStop = stop % 10;
-            nHeightStop = stop - nHeightStop - 20;
+    // The client's own coins are left out of its witness and handed back instead
+    std::vector<CBigNum> vExcluded;
+    for (const CBigNum& bnValue : range.vPubcoins) {
+        if (filter.contains(bnValue.getvch())) {
+            ret.emplace_back(bnValue);
+            vExcluded.emplace_back(bnValue);
         }
-        heightStop = nHeightStop;
-
-        nMintsAdded = 0;
-
-        // Starts on top of the witness that the node sent
-        libzerocoin::Accumulator witnessAccumulator(params, den, witness.getValue());
-
-        if(!calculateAccumulatedBlocksFor(
-                startHeight,
-                nHeightStop,
-                pindex,
-                bnAccValue,
-                accumulator,
-                den,
-                filter,
-                witnessAccumulator,
-                ret,
-                strError
-        ))
-            return error("CalculateAccumulatorWitnessFor(): Calculate accumulated coins failed");
+    }
 
-        // reset the value
-        witness.resetValue(witnessAccumulator, temp);
+    nMintsAdded = range.vPubcoins.size() - ret.size();
+    if (nMintsAdded < Params().Zerocoin_RequiredAccumulation()) {
+        strError = _(strprintf("Less than %d mints added, unable to create spend",
+                               Params().Zerocoin_RequiredAccumulation()).c_str());
+        throw NotEnoughMintsException(strError);
+    }
 
-        // calculate how many mints of this denomination existed in the accumulator we initialized
-        nMintsAdded += ComputeAccumulatedCoins(startHeight, den);
-        LogPrint("zero", "%s : %d mints added to witness\n", __func__, nMintsAdded);
+    // Starts on top of the checkpoint when there is one, otherwise on the witness the client sent
+    libzerocoin::PublicCoin temp(params, 0, range.den);
+    libzerocoin::Accumulator witnessAccumulator(params, range.den, range.bnWitnessBase != 0 ? range.bnWitnessBase : witness.getValue());
+    CBigNum bnExponent = vExcluded.empty() ? range.bnProduct : range.bnProduct / libzerocoin::ProductTree(vExcluded, 0, vExcluded.size());
+    witnessAccumulator.setValue(witnessAccumulator.getValue().pow_mod_public(bnExponent, params->accumulatorParams.accumulatorModulus));
+    witness.resetValue(witnessAccumulator, temp);
 
-        return true;
+    if (range.bnAccValue != 0)
+        accumulator.setValue(range.bnAccValue);
 
-    } catch (ChecksumInDbNotFoundException e) {
-        return error("%s: ChecksumInDbNotFoundException: %s", __func__, e.message);
-    } catch (GetPubcoinException e) {
-        return error("%s: GetPubcoinException: %s", __func__, e.message);
-    }
+    LogPrint("zero", "%s : %d mints added to witness\n", __func__, nMintsAdded);
+    return true;
 }
 
 bool GenerateAccumulatorWitness(
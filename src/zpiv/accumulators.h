@@ -16,27 +16,70 @@
 #include "bloom.h"
 #include "witness.h"
 
+#include <atomic>
+
 class CBlockIndex;
 
 std::map<libzerocoin::CoinDenomination, int> GetMintMaturityHeight();
 
 /**
- * Calculate the acc witness for a single coin.
- * @return true if the witness was calculated well
+ * Pubcoins of one denomination accumulated between two checkpoints. Light witness requests
+ * that start in the same checkpoint window are served from one range, so its blocks are
+ * read and multiplied together once.
  */
+class CWitnessRange
+{
+public:
+    libzerocoin::CoinDenomination den;
+    //! First block accumulated
+    int nHeightStart;
+    //! Height the accumulator value is taken at, also sent to the client
+    int nHeightStop;
+    uint256 hashStop;
+    //! Checkpoint value the witness starts from, 0 to start from the client's value
+    CBigNum bnWitnessBase;
+    //! Accumulator value at nHeightStop
+    CBigNum bnAccValue;
+    std::vector<CBigNum> vPubcoins;
+    //! Product of vPubcoins
+    CBigNum bnProduct;
+
+    CWitnessRange() : den(libzerocoin::ZQ_ERROR), nHeightStart(0), nHeightStop(0), hashStop(0), bnWitnessBase(0), bnAccValue(0), bnProduct(1) {}
+};
 
-bool CalculateAccumulatorWitnessFor(
-        const libzerocoin::ZerocoinParams* params,
+/**
+ * Bounds of the range a light witness request starting at startingHeight accumulates,
+ * at most maxCalculationRange blocks long. Requests with the same bounds share a range.
+ */
+void GetWitnessRangeBounds(int startingHeight, int maxCalculationRange, int& nHeightStart, int& nHeightStop);
+
+/**
+ * Read the pubcoins of a witness range from the chain. pnBlocksDone, when set, is advanced
+ * as blocks are read so progress can be reported while the range is built.
+ */
+bool CalculateWitnessRange(
         int startingHeight,
         int maxCalculationRange,
         libzerocoin::CoinDenomination den,
+        CWitnessRange& range,
+        std::string& strError,
+        std::atomic<int>* pnBlocksDone = nullptr
+);
+
+/**
+ * Calculate the acc witness for a light client's coins from a shared range: every pubcoin
+ * of the range is accumulated except the ones matching the filter, which are returned in ret.
+ * @return true if the witness was calculated well
+ */
+bool CalculateAccumulatorWitnessFor(
+        const libzerocoin::ZerocoinParams* params,
+        const CWitnessRange& range,
         const CBloomFilter& filter,
         libzerocoin::Accumulator& accumulator,
         libzerocoin::AccumulatorWitness& witness,
         int& nMintsAdded,
         std::string& strError,
-        std::list<CBigNum>& ret,
-        int &heightStop
+        std::list<CBigNum>& ret
 );
 
 bool GenerateAccumulatorWitness(
@@ -49,12 +92,22 @@ bool GenerateAccumulatorWitness(
 
 
 bool GenerateAccumulatorWitness(CoinWitnessData* coinWitness, AccumulatorMap& mapAccumulators, CBlockIndex* pindexCheckpoint);
+bool PrepareAccumulatorWitness(CoinWitnessData* coinWitness);
+bool IsWitnessStale(const CoinWitnessData* coinWitness);
+int GetWitnessTargetHeight(int nChainHeight);
+
+/**
+ * Advance several witnesses up to nHeightEnd in one pass over the chain. Each block's
+ * pubcoins are read once and shared by every witness of the denomination.
+ */
+void AccumulateRange(std::vector<CoinWitnessData*>& vWitnesses, int nHeightEnd);
 std::list<libzerocoin::PublicCoin> GetPubcoinFromBlock(const CBlockIndex* pindex);
 bool GetAccumulatorValueFromDB(uint256 nCheckpoint, libzerocoin::CoinDenomination denom, CBigNum& bnAccValue);
 bool GetAccumulatorValue(int& nHeight, const libzerocoin::CoinDenomination denom, CBigNum& bnAccValue);
 bool GetAccumulatorValueFromChecksum(uint32_t nChecksum, bool fMemoryOnly, CBigNum& bnAccValue);
 void AddAccumulatorChecksum(const uint32_t nChecksum, const CBigNum &bnValue, bool fMemoryOnly);
 bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, AccumulatorMap& mapAccumulators);
+bool IndexBlockPubcoins(const CBlock& block, const CBlockIndex* pindex);
 void DatabaseChecksums(AccumulatorMap& mapAccumulators);
 bool LoadAccumulatorValuesFromDB(const uint256 nCheckpoint);
 bool EraseAccumulatorValues(const uint256& nCheckpointErase, const uint256& nCheckpointPrevious);
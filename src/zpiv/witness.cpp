@@ -16,6 +16,16 @@ void CoinWitnessData::SetNull()
     nHeightCheckpoint = 0;
     nHeightAccStart = 0;
     nHeightAccEnd = 0;
+    hashBlockAccEnd.SetNull();
+}
+
+//Drop the accumulated state so the witness is rebuilt from the checkpoint before its mint
+void CoinWitnessData::ResetAccumulation()
+{
+    pAccumulator = nullptr;
+    nMintsAdded = 0;
+    nHeightAccEnd = 0;
+    hashBlockAccEnd.SetNull();
 }
 
 CoinWitnessData::CoinWitnessData()
@@ -60,6 +70,7 @@ CoinWitnessData::CoinWitnessData(CoinWitnessCacheData& data)
     nHeightCheckpoint = data.nHeightCheckpoint;
     nHeightAccStart = data.nHeightAccStart;
     nHeightAccEnd = data.nHeightAccEnd;
+    hashBlockAccEnd = data.hashBlockAccEnd;
     txid = data.txid;
 }
 
@@ -83,7 +94,7 @@ void CoinWitnessCacheData::SetNull()
     coinDenom = libzerocoin::CoinDenomination::ZQ_ERROR;
     accumulatorAmount = CBigNum(0);
     accumulatorDenom = libzerocoin::CoinDenomination::ZQ_ERROR;
-
+    hashBlockAccEnd.SetNull();
 }
 
 CoinWitnessCacheData::CoinWitnessCacheData()
@@ -102,6 +113,7 @@ CoinWitnessCacheData::CoinWitnessCacheData(CoinWitnessData* coinWitnessData)
     nHeightCheckpoint = coinWitnessData->nHeightCheckpoint;
     nHeightAccStart = coinWitnessData->nHeightAccStart;
     nHeightAccEnd = coinWitnessData->nHeightAccEnd;
+    hashBlockAccEnd = coinWitnessData->hashBlockAccEnd;
     coinAmount = coinWitnessData->coin->getValue();
     coinDenom = coinWitnessData->coin->getDenomination();
     accumulatorAmount = coinWitnessData->pAccumulator->getValue();
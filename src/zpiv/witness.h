@@ -30,6 +30,7 @@ public:
     int nHeightAccEnd;
     int nMintsAdded;
     uint256 txid;
+    uint256 hashBlockAccEnd;
     bool isV1;
 
     CoinWitnessData();
@@ -37,6 +38,7 @@ public:
     CoinWitnessData(CoinWitnessCacheData& data);
     void SetHeightMintAdded(int nHeight);
     void SetNull();
+    void ResetAccumulation();
     std::string ToString();
 };
 
@@ -55,6 +57,7 @@ public:
     libzerocoin::CoinDenomination coinDenom;
     CBigNum accumulatorAmount;
     libzerocoin::CoinDenomination accumulatorDenom;
+    uint256 hashBlockAccEnd;
 
     CoinWitnessCacheData();
     CoinWitnessCacheData(CoinWitnessData* coinWitnessData);
@@ -77,6 +80,7 @@ public:
         READWRITE(coinDenom);
         READWRITE(accumulatorAmount); // used to create the pAccumulator
         READWRITE(accumulatorDenom);
+        READWRITE(hashBlockAccEnd); // detects witnesses left on a reorganized chain
     };
 };
 #endif //SYNX_WITNESS_H
@@ -129,4 +129,29 @@ namespace ZPIVModule {
         }
         return true;
     }
+
+    bool ParseZerocoinPublicSpend(const CTransaction& tx, unsigned int nIn, CValidationState& state, std::shared_ptr<const PublicCoinSpend>& publicSpend)
+    {
+        const CTxIn& txIn = tx.vin[nIn];
+        CTxOut prevOut;
+        if(!GetOutput(txIn.prevout.hash, txIn.prevout.n ,state, prevOut)){
+            return state.DoS(100, error("%s: public zerocoin spend prev output not found, prevTx %s, index %d",
+                                        __func__, txIn.prevout.hash.GetHex(), txIn.prevout.n));
+        }
+
+        const CZerocoinSpendCache::SpendKey key(tx.GetHash(), nIn);
+        libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
+        publicSpend = std::static_pointer_cast<const PublicCoinSpend>(zerocoinSpendCache.Get(key, params));
+        if (publicSpend)
+            return true;
+
+        std::shared_ptr<PublicCoinSpend> spend = std::make_shared<PublicCoinSpend>(params);
+        if (!ZPIVModule::parseCoinSpend(txIn, tx, prevOut, *spend)) {
+            return state.Invalid(error("%s: invalid public coin spend parse %s\n", __func__,
+                                       tx.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-zpiv");
+        }
+        zerocoinSpendCache.Set(key, params, spend);
+        publicSpend = spend;
+        return true;
+    }
 }
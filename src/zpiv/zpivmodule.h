@@ -19,6 +19,8 @@
 #include "zpiv/zerocoin.h"
 #include "chainparams.h"
 
+#include <memory>
+
 static int const COIN_SPEND_PUBLIC_SPEND_VERSION = 3;
 
 class PublicCoinSpend : public libzerocoin::CoinSpend{
@@ -87,6 +89,12 @@ namespace ZPIVModule {
      * @return true if everything went ok
      */
     bool ParseZerocoinPublicSpend(const CTxIn &in, const CTransaction& tx, CValidationState& state, PublicCoinSpend& publicCoinSpend);
+
+    /**
+     * Same as above for tx.vin[nIn], sharing the spend parsed by an earlier validation stage.
+     * The prev output is still looked up, so a spend of a mint that left the chain keeps failing.
+     */
+    bool ParseZerocoinPublicSpend(const CTransaction& tx, unsigned int nIn, CValidationState& state, std::shared_ptr<const PublicCoinSpend>& publicCoinSpend);
 };
 
 
@@ -20,6 +20,8 @@ CzPIVTracker::CzPIVTracker(std::string strWalletFile)
     this->strWalletFile = strWalletFile;
     mapSerialHashes.clear();
     mapPendingSpends.clear();
+    nStatusMempoolUpdated = 0;
+    fStatusDirty = true;
     fInitialized = false;
 }
 
@@ -29,6 +31,68 @@ CzPIVTracker::~CzPIVTracker()
     mapPendingSpends.clear();
 }
 
+//! Store a mint's meta, keeping the lookup indexes and the unspent balance counters in step
+void CzPIVTracker::SetMeta(const CMintMeta& meta)
+{
+    auto it = mapSerialHashes.find(meta.hashSerial);
+    if (it != mapSerialHashes.end()) {
+        UnindexMeta(it->second);
+        it->second = meta;
+    } else {
+        mapSerialHashes.insert(std::make_pair(meta.hashSerial, meta));
+    }
+    IndexMeta(meta);
+}
+
+void CzPIVTracker::IndexMeta(const CMintMeta& meta)
+{
+    mapPubcoinHashes[meta.hashPubcoin] = meta.hashSerial;
+    if (meta.hashStake != 0)
+        mapStakeHashes[meta.hashStake] = meta.hashSerial;
+    if (meta.txid != 0)
+        mapMintTxids[meta.txid].insert(meta.hashSerial);
+
+    if (!meta.isUsed && !meta.isArchived) {
+        mapUnspentDenoms[meta.denom]++;
+        mapUnspentHeights[meta.nHeight] += libzerocoin::ZerocoinDenominationToAmount(meta.denom);
+    }
+}
+
+void CzPIVTracker::UnindexMeta(const CMintMeta& meta)
+{
+    auto itPubcoin = mapPubcoinHashes.find(meta.hashPubcoin);
+    if (itPubcoin != mapPubcoinHashes.end() && itPubcoin->second == meta.hashSerial)
+        mapPubcoinHashes.erase(itPubcoin);
+
+    auto itStake = mapStakeHashes.find(meta.hashStake);
+    if (itStake != mapStakeHashes.end() && itStake->second == meta.hashSerial)
+        mapStakeHashes.erase(itStake);
+
+    auto itTx = mapMintTxids.find(meta.txid);
+    if (itTx != mapMintTxids.end()) {
+        itTx->second.erase(meta.hashSerial);
+        if (itTx->second.empty())
+            mapMintTxids.erase(itTx);
+    }
+
+    if (!meta.isUsed && !meta.isArchived) {
+        if (--mapUnspentDenoms[meta.denom] <= 0)
+            mapUnspentDenoms.erase(meta.denom);
+        mapUnspentHeights[meta.nHeight] -= libzerocoin::ZerocoinDenominationToAmount(meta.denom);
+        if (mapUnspentHeights[meta.nHeight] <= 0)
+            mapUnspentHeights.erase(meta.nHeight);
+    }
+}
+
+//! Mint statuses only change with the chain tip, the mempool or the tracker's own updates
+bool CzPIVTracker::IsStatusStale() const
+{
+    if (fStatusDirty || mempool.GetTransactionsUpdated() != nStatusMempoolUpdated)
+        return true;
+
+    return !chainActive.Tip() || chainActive.Tip()->GetBlockHash() != hashStatusTip;
+}
+
 void CzPIVTracker::Init()
 {
     //Load all CZerocoinMints and CDeterministicMints from the database
@@ -40,8 +104,11 @@ void CzPIVTracker::Init()
 
 bool CzPIVTracker::Archive(CMintMeta& meta)
 {
-    if (mapSerialHashes.count(meta.hashSerial))
-        mapSerialHashes.at(meta.hashSerial).isArchived = true;
+    if (mapSerialHashes.count(meta.hashSerial)) {
+        CMintMeta metaArchived = mapSerialHashes.at(meta.hashSerial);
+        metaArchived.isArchived = true;
+        SetMeta(metaArchived);
+    }
 
     CWalletDB walletdb(strWalletFile);
     CZerocoinMint mint;
@@ -90,25 +157,21 @@ CMintMeta CzPIVTracker::Get(const uint256 &hashSerial)
 
 CMintMeta CzPIVTracker::GetMetaFromPubcoin(const uint256& hashPubcoin)
 {
-    for (auto it : mapSerialHashes) {
-        CMintMeta meta = it.second;
-        if (meta.hashPubcoin == hashPubcoin)
-            return meta;
-    }
+    auto it = mapPubcoinHashes.find(hashPubcoin);
+    if (it == mapPubcoinHashes.end())
+        return CMintMeta();
 
-    return CMintMeta();
+    return Get(it->second);
 }
 
 bool CzPIVTracker::GetMetaFromStakeHash(const uint256& hashStake, CMintMeta& meta) const
 {
-    for (auto& it : mapSerialHashes) {
-        if (it.second.hashStake == hashStake) {
-            meta = it.second;
-            return true;
-        }
-    }
+    auto it = mapStakeHashes.find(hashStake);
+    if (it == mapStakeHashes.end())
+        return false;
 
-    return false;
+    meta = mapSerialHashes.at(it->second);
+    return true;
 }
 
 CoinWitnessData* CzPIVTracker::GetSpendCache(const uint256& hashStake)
@@ -134,6 +197,32 @@ bool CzPIVTracker::ClearSpendCache()
     return false;
 }
 
+void CzPIVTracker::EraseSpendCache(const uint256& hashStake)
+{
+    AssertLockHeld(cs_spendcache);
+    mapStakeCache.erase(hashStake);
+}
+
+//! Count the cached witnesses and how many of them are accumulated up to nHeightTarget
+void CzPIVTracker::GetSpendCacheState(int nHeightTarget, int& nCount, int& nFresh, int& nHeightLowest)
+{
+    AssertLockHeld(cs_spendcache);
+    nCount = 0;
+    nFresh = 0;
+    nHeightLowest = 0;
+    for (auto& it : mapStakeCache) {
+        const CoinWitnessData* witnessData = it.second.get();
+        if (!witnessData->nHeightAccEnd)
+            continue;
+
+        nCount++;
+        if (witnessData->nHeightAccEnd >= nHeightTarget)
+            nFresh++;
+        if (!nHeightLowest || witnessData->nHeightAccEnd < nHeightLowest)
+            nHeightLowest = witnessData->nHeightAccEnd;
+    }
+}
+
 std::vector<uint256> CzPIVTracker::GetSerialHashes()
 {
     std::vector<uint256> vHashes;
@@ -151,28 +240,19 @@ std::vector<uint256> CzPIVTracker::GetSerialHashes()
 CAmount CzPIVTracker::GetBalance(bool fConfirmedOnly, bool fUnconfirmedOnly) const
 {
     CAmount nTotal = 0;
-    //! zerocoin specific fields
-    std::map<libzerocoin::CoinDenomination, unsigned int> myZerocoinSupply;
-    for (auto& denom : libzerocoin::zerocoinDenomList) {
-        myZerocoinSupply.insert(std::make_pair(denom, 0));
-    }
-
-    {
-        //LOCK(cs_pivtracker);
-        // Get Unused coins
-        for (auto& it : mapSerialHashes) {
-            CMintMeta meta = it.second;
-            if (meta.isUsed || meta.isArchived)
-                continue;
-            bool fConfirmed = ((meta.nHeight < chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations()) && !(meta.nHeight == 0));
-            if (fConfirmedOnly && !fConfirmed)
-                continue;
-            if (fUnconfirmedOnly && fConfirmed)
-                continue;
-
-            nTotal += libzerocoin::ZerocoinDenominationToAmount(meta.denom);
-            myZerocoinSupply.at(meta.denom)++;
-        }
+    for (auto& it : mapUnspentDenoms)
+        nTotal += libzerocoin::ZerocoinDenominationToAmount(it.first) * it.second;
+
+    if (fConfirmedOnly || fUnconfirmedOnly) {
+        // Mints without a height, or inside the confirmation window, are unconfirmed
+        int nHeightConfirmed = chainActive.Height() - Params().Zerocoin_MintRequiredConfirmations();
+        CAmount nUnconfirmed = 0;
+        for (auto it = mapUnspentHeights.lower_bound(nHeightConfirmed); it != mapUnspentHeights.end(); ++it)
+            nUnconfirmed += it->second;
+        if (nHeightConfirmed > 0 && mapUnspentHeights.count(0))
+            nUnconfirmed += mapUnspentHeights.at(0);
+
+        nTotal = fConfirmedOnly ? nTotal - nUnconfirmed : nUnconfirmed;
     }
 
     if (nTotal < 0 ) nTotal = 0; // Sanity never hurts
@@ -203,12 +283,7 @@ std::vector<CMintMeta> CzPIVTracker::GetMints(bool fConfirmedOnly) const
 //Does a mint in the tracker have this txid
 bool CzPIVTracker::HasMintTx(const uint256& txid)
 {
-    for (auto it : mapSerialHashes) {
-        if (it.second.txid == txid)
-            return true;
-    }
-
-    return false;
+    return mapMintTxids.count(txid);
 }
 
 bool CzPIVTracker::HasPubcoin(const CBigNum &bnValue) const
@@ -220,12 +295,7 @@ bool CzPIVTracker::HasPubcoin(const CBigNum &bnValue) const
 
 bool CzPIVTracker::HasPubcoinHash(const uint256& hashPubcoin) const
 {
-    for (auto it : mapSerialHashes) {
-        CMintMeta meta = it.second;
-        if (meta.hashPubcoin == hashPubcoin)
-            return true;
-    }
-    return false;
+    return mapPubcoinHashes.count(hashPubcoin);
 }
 
 bool CzPIVTracker::HasSerial(const CBigNum& bnSerial) const
@@ -252,7 +322,7 @@ bool CzPIVTracker::UpdateZerocoinMint(const CZerocoinMint& mint)
     meta.isUsed = mint.IsUsed();
     meta.denom = mint.GetDenomination();
     meta.nHeight = mint.GetHeight();
-    mapSerialHashes.at(hashSerial) = meta;
+    SetMeta(meta);
 
     //Write to db
     return CWalletDB(strWalletFile).WriteZerocoinMint(mint);
@@ -296,7 +366,7 @@ bool CzPIVTracker::UpdateState(const CMintMeta& meta)
             return error("%s: failed to write mint to database", __func__);
     }
 
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
 
     return true;
 }
@@ -320,7 +390,8 @@ void CzPIVTracker::Add(const CDeterministicMint& dMint, bool isNew, bool isArchi
     meta.isSeedCorrect = zPIVWallet->CheckSeed(dMint);
     if (! iszPIVWalletInitialized)
         delete zPIVWallet;
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
+    fStatusDirty = true;
 
     if (isNew)
         CWalletDB(strWalletFile).WriteDeterministicMint(dMint);
@@ -341,7 +412,8 @@ void CzPIVTracker::Add(const CZerocoinMint& mint, bool isNew, bool isArchived)
     meta.isArchived = isArchived;
     meta.isDeterministic = false;
     meta.isSeedCorrect = true;
-    mapSerialHashes[meta.hashSerial] = meta;
+    SetMeta(meta);
+    fStatusDirty = true;
 
     if (isNew)
         CWalletDB(strWalletFile).WriteZerocoinMint(mint);
@@ -354,6 +426,7 @@ void CzPIVTracker::SetPubcoinUsed(const uint256& hashPubcoin, const uint256& txi
     CMintMeta meta = GetMetaFromPubcoin(hashPubcoin);
     meta.isUsed = true;
     mapPendingSpends.insert(std::make_pair(meta.hashSerial, txid));
+    fStatusDirty = true;
     UpdateState(meta);
 }
 
@@ -367,6 +440,7 @@ void CzPIVTracker::SetPubcoinNotUsed(const uint256& hashPubcoin)
     if (mapPendingSpends.count(meta.hashSerial))
         mapPendingSpends.erase(meta.hashSerial);
 
+    fStatusDirty = true;
     UpdateState(meta);
 }
 
@@ -462,6 +536,10 @@ bool CzPIVTracker::UpdateStatusInternal(const std::set<uint256>& setMempool, CMi
 
 std::set<CMintMeta> CzPIVTracker::ListMints(bool fUnusedOnly, bool fMatureOnly, bool fUpdateStatus, bool fWrongSeed, bool fExcludeV1)
 {
+    // Nothing the statuses depend on changed since they were last updated
+    if (fUpdateStatus && !IsStatusStale())
+        fUpdateStatus = false;
+
     CWalletDB walletdb(strWalletFile);
     if (fUpdateStatus) {
         std::list<CZerocoinMint> listMintsDB = walletdb.ListMintedCoins();
@@ -487,6 +565,12 @@ std::set<CMintMeta> CzPIVTracker::ListMints(bool fUnusedOnly, bool fMatureOnly,
     {
         LOCK(mempool.cs);
         mempool.getTransactions(setMempool);
+        if (fUpdateStatus)
+            nStatusMempoolUpdated = mempool.GetTransactionsUpdated();
+    }
+    if (fUpdateStatus) {
+        hashStatusTip = chainActive.Tip() ? chainActive.Tip()->GetBlockHash() : uint256();
+        fStatusDirty = false;
     }
 
     std::map<libzerocoin::CoinDenomination, int> mapMaturity = GetMintMaturityHeight();
@@ -533,4 +617,10 @@ std::set<CMintMeta> CzPIVTracker::ListMints(bool fUnusedOnly, bool fMatureOnly,
 void CzPIVTracker::Clear()
 {
     mapSerialHashes.clear();
+    mapPubcoinHashes.clear();
+    mapStakeHashes.clear();
+    mapMintTxids.clear();
+    mapUnspentDenoms.clear();
+    mapUnspentHeights.clear();
+    fStatusDirty = true;
 }
@@ -10,6 +10,7 @@
 #include "witness.h"
 #include "sync.h"
 #include <list>
+#include <set>
 
 class CDeterministicMint;
 class CzPIVWallet;
@@ -22,6 +23,18 @@ private:
     std::map<uint256, CMintMeta> mapSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
     std::map<uint256, std::unique_ptr<CoinWitnessData> > mapStakeCache; //serialhash, witness value, height
+    std::map<uint256, uint256> mapPubcoinHashes; //pubcoinhash, serialhash
+    std::map<uint256, uint256> mapStakeHashes; //stakehash, serialhash
+    std::map<uint256, std::set<uint256> > mapMintTxids; //txid, serialhashes minted in it
+    std::map<libzerocoin::CoinDenomination, int> mapUnspentDenoms; //denom, count of unspent mints
+    std::map<int, CAmount> mapUnspentHeights; //mint height, value of unspent mints
+    uint256 hashStatusTip; //tip the mint statuses were last updated at
+    unsigned int nStatusMempoolUpdated; //mempool update counter the mint statuses were last updated at
+    bool fStatusDirty;
+    void SetMeta(const CMintMeta& meta);
+    void IndexMeta(const CMintMeta& meta);
+    void UnindexMeta(const CMintMeta& meta);
+    bool IsStatusStale() const;
     bool UpdateStatusInternal(const std::set<uint256>& setMempool, CMintMeta& mint);
 public:
     CzPIVTracker(std::string strWalletFile);
@@ -44,6 +57,8 @@ public:
     mutable CCriticalSection cs_spendcache;
     CoinWitnessData* GetSpendCache(const uint256& hashStake) EXCLUSIVE_LOCKS_REQUIRED(cs_spendcache);
     bool ClearSpendCache() EXCLUSIVE_LOCKS_REQUIRED(cs_spendcache);
+    void EraseSpendCache(const uint256& hashStake) EXCLUSIVE_LOCKS_REQUIRED(cs_spendcache);
+    void GetSpendCacheState(int nHeightTarget, int& nCount, int& nFresh, int& nHeightLowest) EXCLUSIVE_LOCKS_REQUIRED(cs_spendcache);
     std::vector<CMintMeta> GetMints(bool fConfirmedOnly) const;
     CAmount GetUnconfirmedBalance() const;
     std::set<CMintMeta> ListMints(bool fUnusedOnly, bool fMatureOnly, bool fUpdateStatus, bool fWrongSeed = false, bool fExcludeV1 = false);
@@ -12,6 +12,10 @@
 #include "deterministicmint.h"
 #include "zpivchain.h"
 
+#include <atomic>
+
+#include <boost/thread.hpp>
+
 
 CzPIVWallet::CzPIVWallet(std::string strWalletFile)
 {
@@ -104,7 +108,7 @@ void CzPIVWallet::AddToMintPool(const std::pair<uint256, uint32_t>& pMint, bool
 }
 
 //Add the next 20 mints to the mint pool
-void CzPIVWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
+void CzPIVWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd, int nThreads)
 {
 
     //Is locked
@@ -120,38 +124,92 @@ void CzPIVWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
     if (nCountEnd > 0)
         nStop = std::max(n, n + nCountEnd);
 
-    bool fFound;
-
     uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
+    CWalletDB walletdb(strWalletFile);
+
+    //Ranges spanning several batches keep a progress marker so an interrupted run can resume
+    bool fProgress = nStop - n > MINTPOOL_BATCH_SIZE;
+    uint32_t nCountFirst = n;
+    uint32_t nProgressStart, nProgressStop, nProgressNext;
+    if (fProgress && walletdb.ReadMintPoolProgress(hashSeed, nProgressStart, nProgressStop, nProgressNext) &&
+            nProgressStart == n && nProgressStop == nStop && nProgressNext > n) {
+        LogPrintf("%s : resuming at count=%d\n", __func__, nProgressNext);
+        n = nProgressNext;
+    }
+
+    // Prevent unnecessary repeated minted
+    std::set<uint32_t> setCounts;
+    for (auto& pair : mintPool)
+        setCounts.insert(pair.second);
+
     LogPrintf("%s : n=%d nStop=%d\n", __func__, n, nStop - 1);
-    for (uint32_t i = n; i < nStop; ++i) {
-        if (ShutdownRequested())
-            return;
+    for (uint32_t nBatchStart = n; nBatchStart < nStop; nBatchStart += MINTPOOL_BATCH_SIZE) {
+        uint32_t nBatchStop = std::min(nStop, nBatchStart + MINTPOOL_BATCH_SIZE);
+
+        std::vector<uint32_t> vCounts;
+        for (uint32_t i = nBatchStart; i < nBatchStop; ++i) {
+            if (!setCounts.count(i))
+                vCounts.emplace_back(i);
+        }
 
-        fFound = false;
+        std::vector<std::pair<uint256, uint32_t> > vMints;
+        if (!DeriveMintPool(seedMaster, vCounts, nThreads, vMints))
+            return;
 
-        // Prevent unnecessary repeated minted
-        for (auto& pair : mintPool) {
-            if(pair.second == i) {
-                fFound = true;
-                break;
-            }
+        //Write the batch in count order, together with the progress it completes
+        walletdb.TxnBegin();
+        for (const std::pair<uint256, uint32_t>& pMint : vMints) {
+            mintPool.Add(pMint);
+            walletdb.WriteMintPoolPair(hashSeed, pMint.first, pMint.second);
         }
+        if (fProgress)
+            walletdb.WriteMintPoolProgress(hashSeed, nCountFirst, nStop, nBatchStop);
+        walletdb.TxnCommit();
 
-        if(fFound)
-            continue;
+        LogPrintf("%s : added %d mints to the pool, count=%d\n", __func__, vMints.size(), nBatchStop - 1);
+    }
 
-        uint512 seedZerocoin = GetZerocoinSeed(i);
-        CBigNum bnValue;
-        CBigNum bnSerial;
-        CBigNum bnRandomness;
-        CKey key;
-        SeedToZPIV(seedZerocoin, bnValue, bnSerial, bnRandomness, key);
+    if (fProgress)
+        walletdb.EraseMintPoolProgress(hashSeed);
+}
+
+//! Derive the pubcoins of vCounts over nThreads threads (0 = one per core). vMints is returned in the order of vCounts.
+bool CzPIVWallet::DeriveMintPool(const uint256& seedMaster, const std::vector<uint32_t>& vCounts, int nThreads, std::vector<std::pair<uint256, uint32_t> >& vMints)
+{
+    vMints.assign(vCounts.size(), std::make_pair(uint256(0), 0));
+    std::atomic<size_t> nNext(0);
+    std::atomic<bool> fInterrupted(false);
+
+    auto derive = [&]() {
+        for (size_t i = nNext++; i < vCounts.size(); i = nNext++) {
+            if (ShutdownRequested()) {
+                fInterrupted = true;
+                return;
+            }
 
-        mintPool.Add(bnValue, i);
-        CWalletDB(strWalletFile).WriteMintPoolPair(hashSeed, GetPubCoinHash(bnValue), i);
-        LogPrintf("%s : %s count=%d\n", __func__, bnValue.GetHex().substr(0, 6), i);
+            CBigNum bnValue;
+            CBigNum bnSerial;
+            CBigNum bnRandomness;
+            CKey key;
+            SeedToZPIV(GetZerocoinSeed(seedMaster, vCounts[i]), bnValue, bnSerial, bnRandomness, key);
+            vMints[i] = std::make_pair(GetPubCoinHash(bnValue), vCounts[i]);
+        }
+    };
+
+    if (nThreads <= 0)
+        nThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+    nThreads = std::min(nThreads, (int)vCounts.size());
+
+    if (nThreads <= 1) {
+        derive();
+    } else {
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(derive);
+        threadGroup.join_all();
     }
+
+    return !fInterrupted;
 }
 
 // pubcoin hashes are stored to db so that a full accounting of mints belonging to the seed can be tracked without regenerating
@@ -372,8 +430,8 @@ void CzPIVWallet::SeedToZPIV(const uint512& seedZerocoin, CBigNum& bnValue, CBig
 
     //See if serial and randomness make a valid commitment
     // Generate a Pedersen commitment to the serial number
-    CBigNum commitmentValue = params->coinCommitmentGroup.g.pow_mod(bnSerial, params->coinCommitmentGroup.modulus).mul_mod(
-                        params->coinCommitmentGroup.h.pow_mod(bnRandomness, params->coinCommitmentGroup.modulus),
+    CBigNum commitmentValue = params->coinCommitmentGroup.pow_g(bnSerial).mul_mod(
+                        params->coinCommitmentGroup.pow_h(bnRandomness),
                         params->coinCommitmentGroup.modulus);
 
     CBigNum random;
@@ -395,11 +453,16 @@ void CzPIVWallet::SeedToZPIV(const uint512& seedZerocoin, CBigNum& bnValue, CBig
                               attempts256.begin(), attempts256.end());
         random.setuint256(hashRandomness);
         bnRandomness = (bnRandomness + random) % params->coinCommitmentGroup.groupOrder;
-        commitmentValue = commitmentValue.mul_mod(params->coinCommitmentGroup.h.pow_mod(random, params->coinCommitmentGroup.modulus), params->coinCommitmentGroup.modulus);
+        commitmentValue = commitmentValue.mul_mod(params->coinCommitmentGroup.pow_h(random), params->coinCommitmentGroup.modulus);
     }
 }
 
 uint512 CzPIVWallet::GetZerocoinSeed(uint32_t n)
+{
+    return GetZerocoinSeed(seedMaster, n);
+}
+
+uint512 CzPIVWallet::GetZerocoinSeed(const uint256& seedMaster, uint32_t n)
 {
     CDataStream ss(SER_GETHASH, 0);
     ss << seedMaster << n;
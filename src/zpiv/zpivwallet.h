@@ -7,6 +7,7 @@
 #define SYNX_ZPIVWALLET_H
 
 #include <map>
+#include <vector>
 #include "libzerocoin/Coin.h"
 #include "mintpool.h"
 #include "uint256.h"
@@ -14,6 +15,9 @@
 
 class CDeterministicMint;
 
+//! Number of mints derived and written to the database together when generating the mint pool
+static const uint32_t MINTPOOL_BATCH_SIZE = 1000;
+
 class CzPIVWallet
 {
 private:
@@ -33,14 +37,16 @@ public:
     void GenerateMint(const uint32_t& nCount, const libzerocoin::CoinDenomination denom, libzerocoin::PrivateCoin& coin, CDeterministicMint& dMint);
     void GetState(int& nCount, int& nLastGenerated);
     bool RegenerateMint(const CDeterministicMint& dMint, CZerocoinMint& mint);
-    void GenerateMintPool(uint32_t nCountStart = 0, uint32_t nCountEnd = 0);
+    void GenerateMintPool(uint32_t nCountStart = 0, uint32_t nCountEnd = 0, int nThreads = 0);
     bool LoadMintPoolFromDB();
     void RemoveMintsFromPool(const std::vector<uint256>& vPubcoinHashes);
     bool SetMintSeen(const CBigNum& bnValue, const int& nHeight, const uint256& txid, const libzerocoin::CoinDenomination& denom);
     bool IsInMintPool(const CBigNum& bnValue) { return mintPool.Has(bnValue); }
     void UpdateCount();
     void Lock();
-    void SeedToZPIV(const uint512& seed, CBigNum& bnValue, CBigNum& bnSerial, CBigNum& bnRandomness, CKey& key);
+    static void SeedToZPIV(const uint512& seed, CBigNum& bnValue, CBigNum& bnSerial, CBigNum& bnRandomness, CKey& key);
+    static uint512 GetZerocoinSeed(const uint256& seedMaster, uint32_t n);
+    static bool DeriveMintPool(const uint256& seedMaster, const std::vector<uint32_t>& vCounts, int nThreads, std::vector<std::pair<uint256, uint32_t> >& vMints);
     bool CheckSeed(const CDeterministicMint& dMint);
 
 private:
@@ -7,14 +7,68 @@
 #include "zpiv/zpivmodule.h"
 #include "invalid.h"
 #include "main.h"
+#include "random.h"
 #include "txdb.h"
 #include "guiinterface.h"
 
+#include <atomic>
+
+#include <boost/thread.hpp>
+
 // 6 comes from OPCODE (1) + vch.size() (1) + BIGNUM size (4)
 #define SCRIPT_OFFSET 6
 // For Script size (BIGNUM/Uint256 size)
 #define BIGNUM_SIZE   4
 
+//! Blocks decoded in parallel, then written together, per step of ReindexZerocoinDB
+static const int ZEROCOIN_REINDEX_CHUNK = 1000;
+
+CZerocoinSpendCache zerocoinSpendCache;
+
+std::shared_ptr<const libzerocoin::CoinSpend> CZerocoinSpendCache::Get(const SpendKey& key, const libzerocoin::ZerocoinParams* paramsAccumulator)
+{
+    boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+    auto it = mapSpends.find(key);
+    if (it == mapSpends.end() || it->second.paramsAccumulator != paramsAccumulator) {
+        nMisses++;
+        return nullptr;
+    }
+    nHits++;
+    return it->second.spend;
+}
+
+void CZerocoinSpendCache::Set(const SpendKey& key, const libzerocoin::ZerocoinParams* paramsAccumulator, std::shared_ptr<const libzerocoin::CoinSpend> spend)
+{
+    // A private spend is ~25kB, so the default keeps the cache around 50MB
+    int64_t nMaxCacheSize = GetArg("-maxzcspendcachesize", DEFAULT_MAX_ZC_SPEND_CACHE_SIZE);
+    if (nMaxCacheSize <= 0) return;
+
+    boost::unique_lock<boost::shared_mutex> lock(cs_spendcache);
+    while (static_cast<int64_t>(mapSpends.size()) >= nMaxCacheSize) {
+        // Evict a random entry, same as the signature cache
+        SpendKey keyRandom(GetRandHash(), 0);
+        auto it = mapSpends.lower_bound(keyRandom);
+        if (it == mapSpends.end())
+            it = mapSpends.begin();
+        mapSpends.erase(it);
+    }
+    CacheEntry& entry = mapSpends[key];
+    entry.paramsAccumulator = paramsAccumulator;
+    entry.spend = spend;
+}
+
+void CZerocoinSpendCache::Clear()
+{
+    boost::unique_lock<boost::shared_mutex> lock(cs_spendcache);
+    mapSpends.clear();
+}
+
+size_t CZerocoinSpendCache::Size()
+{
+    boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+    return mapSpends.size();
+}
+
 bool BlockToMintValueVector(const CBlock& block, const libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues)
 {
     for (const CTransaction& tx : block.vtx) {
@@ -127,11 +181,185 @@ bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMin
     return true;
 }
 
+//return every zerocoin mint and spend of a block, flagged with whether the consensus filters keep it
+bool BlockToZerocoinIndex(const CBlock& block, CZerocoinBlockIndex& zerocoinIndex)
+{
+    zerocoinIndex.vMints.clear();
+    zerocoinIndex.vSpends.clear();
+    for (unsigned int nTxPos = 0; nTxPos < block.vtx.size(); nTxPos++) {
+        const CTransaction& tx = block.vtx[nTxPos];
+        if (!tx.ContainsZerocoins())
+            continue;
+
+        uint256 txHash = tx.GetHash();
+        if (tx.HasZerocoinSpendInputs()) {
+            for (unsigned int i = 0; i < tx.vin.size(); i++) {
+                const CTxIn& txin = tx.vin[i];
+                bool isPublicSpend = txin.IsZerocoinPublicSpend();
+                if (!txin.IsZerocoinSpend() && !isPublicSpend)
+                    continue;
+
+                CZerocoinIndexEntry entry;
+                if (isPublicSpend) {
+                    std::shared_ptr<const PublicCoinSpend> publicSpend;
+                    CValidationState state;
+                    if (!ZPIVModule::ParseZerocoinPublicSpend(tx, i, state, publicSpend))
+                        return error("%s: failed to parse public spend in tx %s", __func__, txHash.GetHex());
+                    entry.bnValue = publicSpend->getCoinSerialNumber();
+                    entry.denom = publicSpend->getDenomination();
+                    entry.fPublicSpend = true;
+                } else {
+                    std::shared_ptr<const libzerocoin::CoinSpend> spend = TxInToZerocoinSpend(tx, i);
+                    entry.bnValue = spend->getCoinSerialNumber();
+                    entry.denom = spend->getDenomination();
+                    entry.fValid = !invalid_out::ContainsSerial(entry.bnValue);
+                }
+                entry.txid = txHash;
+                entry.nTxPos = nTxPos;
+                entry.nIndex = i;
+                entry.txoutFirst = tx.vout[0];
+                zerocoinIndex.vSpends.emplace_back(entry);
+            }
+        }
+
+        if (tx.HasZerocoinMintOutputs()) {
+            // Same filtering as BlockToZerocoinMintList: mints of a tx with an invalid input, and any mint
+            // from the first invalid output on, are dropped
+            bool fValid = true;
+            for (const CTxIn& in : tx.vin) {
+                if (!ValidOutPoint(in.prevout, INT_MAX)) {
+                    fValid = false;
+                    break;
+                }
+            }
+
+            for (unsigned int i = 0; i < tx.vout.size(); i++) {
+                if (fValid && !ValidOutPoint(COutPoint(txHash, i), INT_MAX))
+                    fValid = false;
+
+                const CTxOut& txOut = tx.vout[i];
+                if (!txOut.IsZerocoinMint())
+                    continue;
+
+                CValidationState state;
+                libzerocoin::PublicCoin pubCoin(Params().Zerocoin_Params(false));
+                if (!TxOutToPublicCoin(txOut, pubCoin, state))
+                    return error("%s: failed to parse mint %d of tx %s", __func__, i, txHash.GetHex());
+
+                CZerocoinIndexEntry entry;
+                entry.bnValue = pubCoin.getValue();
+                entry.denom = pubCoin.getDenomination();
+                entry.txid = txHash;
+                entry.nTxPos = nTxPos;
+                entry.nIndex = i;
+                entry.fValid = fValid;
+                zerocoinIndex.vMints.emplace_back(entry);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool GetZerocoinBlockIndex(const CBlockIndex* pindex, CZerocoinBlockIndex& zerocoinIndex)
+{
+    // A record left behind by a block that was reorganized away has a different hash, so it is rebuilt from disk
+    if (fZerocoinIndex && zerocoinDB->ReadZerocoinBlockIndex(pindex->nHeight, zerocoinIndex) &&
+        zerocoinIndex.hashBlock == pindex->GetBlockHash())
+        return true;
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s: failed to read block %d from disk", __func__, pindex->nHeight);
+
+    zerocoinIndex.hashBlock = pindex->GetBlockHash();
+    return BlockToZerocoinIndex(block, zerocoinIndex);
+}
+
+bool IndexZerocoinBlock(const CBlock& block, const CBlockIndex* pindex)
+{
+    if (!fZerocoinIndex || pindex->nHeight < Params().Zerocoin_StartHeight())
+        return true;
+
+    CZerocoinBlockIndex zerocoinIndex;
+    zerocoinIndex.hashBlock = pindex->GetBlockHash();
+    if (!BlockToZerocoinIndex(block, zerocoinIndex))
+        return error("%s: failed to get zerocoin data from block %d", __func__, pindex->nHeight);
+
+    return zerocoinDB->WriteZerocoinBlockIndex(pindex->nHeight, zerocoinIndex);
+}
+
+typedef std::map<uint256, std::pair<int, CZerocoinIndexEntry> > IndexedMintMap;
+
+//check a mint against one scan of the zerocoin block index, false when the full lookup has to decide
+static bool FindMintInIndex(CMintMeta meta, const IndexedMintMap& mapMints, const std::map<uint256, uint256>& mapSpends, std::vector<CMintMeta>& vMintsToUpdate)
+{
+    IndexedMintMap::const_iterator itMint = mapMints.find(meta.hashPubcoin);
+    if (itMint == mapMints.end())
+        return false;
+
+    const int nHeight = itMint->second.first;
+    const CZerocoinIndexEntry& mint = itMint->second.second;
+    uint256 txHash;
+    if (!zerocoinDB->ReadCoinMint(meta.hashPubcoin, txHash) || txHash != mint.txid)
+        return false;
+
+    //a spend recorded in zerocoinDB but not in the active chain is left to the full lookup to undo
+    uint256 hashTxSpend = 0;
+    bool fSpent = zerocoinDB->ReadCoinSpend(meta.hashSerial, hashTxSpend);
+    if (fSpent) {
+        std::map<uint256, uint256>::const_iterator itSpend = mapSpends.find(meta.hashSerial);
+        if (itSpend == mapSpends.end() || itSpend->second != hashTxSpend)
+            return false;
+    }
+
+    if (mint.denom != meta.denom) {
+        LogPrintf("%s: found mismatched denom pubcoinhash = %s\n", __func__, meta.hashPubcoin.GetHex());
+        meta.denom = mint.denom;
+        vMintsToUpdate.emplace_back(meta);
+    }
+
+    if (meta.txid == txHash && meta.nHeight == nHeight && meta.isUsed == fSpent)
+        return true;
+
+    meta.txid = txHash;
+    meta.nHeight = nHeight;
+    meta.isUsed = fSpent;
+    LogPrintf("%s: found updates for pubcoinhash = %s\n", __func__, meta.hashPubcoin.GetHex());
+
+    vMintsToUpdate.push_back(meta);
+    return true;
+}
+
 void FindMints(std::vector<CMintMeta> vMintsToFind, std::vector<CMintMeta>& vMintsToUpdate, std::vector<CMintMeta>& vMissingMints)
 {
+    // With -zerocoinindex, one range scan of the index from the lowest recorded mint height locates the
+    // mints and spends, instead of reading every mint and spend transaction back from disk
+    IndexedMintMap mapIndexedMints;
+    std::map<uint256, uint256> mapIndexedSpends;
+    if (fZerocoinIndex && !vMintsToFind.empty()) {
+        LOCK(cs_main);
+        int nHeightStart = chainActive.Height() + 1;
+        for (const CMintMeta& meta : vMintsToFind)
+            nHeightStart = std::min(nHeightStart, meta.nHeight > 0 ? meta.nHeight : 0);
+        nHeightStart = std::max(nHeightStart, Params().Zerocoin_StartHeight());
+        for (int nHeight = nHeightStart; nHeight <= chainActive.Height(); nHeight++) {
+            CZerocoinBlockIndex zerocoinIndex;
+            if (!zerocoinDB->ReadZerocoinBlockIndex(nHeight, zerocoinIndex) || zerocoinIndex.hashBlock != chainActive[nHeight]->GetBlockHash())
+                continue;
+            for (const CZerocoinIndexEntry& mint : zerocoinIndex.vMints)
+                mapIndexedMints.emplace(GetPubCoinHash(mint.bnValue), std::make_pair(nHeight, mint));
+            for (const CZerocoinIndexEntry& spend : zerocoinIndex.vSpends)
+                mapIndexedSpends.emplace(GetSerialHash(spend.bnValue), spend.txid);
+        }
+    }
+
     // see which mints are in our public zerocoin database. The mint should be here if it exists, unless
     // something went wrong
     for (CMintMeta meta : vMintsToFind) {
+        if (!mapIndexedMints.empty() && FindMintInIndex(meta, mapIndexedMints, mapIndexedSpends, vMintsToUpdate))
+            continue;
+
         uint256 txHash;
         if (!zerocoinDB->ReadCoinMint(meta.hashPubcoin, txHash)) {
             vMissingMints.push_back(meta);
@@ -263,79 +491,51 @@ std::string ReindexZerocoinDB()
 
     uiInterface.ShowProgress(_("Reindexing zerocoin database..."), 0);
 
-    CBlockIndex* pindex = chainActive[Params().Zerocoin_StartHeight()];
-    std::vector<std::pair<libzerocoin::CoinSpend, uint256> > vSpendInfo;
-    std::vector<std::pair<libzerocoin::PublicCoin, uint256> > vMintInfo;
-    while (pindex) {
-        uiInterface.ShowProgress(_("Reindexing zerocoin database..."), std::max(1, std::min(99, (int)((double)(pindex->nHeight - Params().Zerocoin_StartHeight()) / (double)(chainActive.Height() - Params().Zerocoin_StartHeight()) * 100))));
-
-        if (pindex->nHeight % 1000 == 0)
-            LogPrintf("Reindexing zerocoin : block %d...\n", pindex->nHeight);
-
-        CBlock block;
-        if (!ReadBlockFromDisk(block, pindex)) {
-            return _("Reindexing zerocoin failed");
-        }
-
-        for (const CTransaction& tx : block.vtx) {
-            for (unsigned int i = 0; i < tx.vin.size(); i++) {
-                if (tx.IsCoinBase())
-                    break;
-
-                if (tx.ContainsZerocoins()) {
-                    uint256 txid = tx.GetHash();
-                    //Record Serials
-                    if (tx.HasZerocoinSpendInputs()) {
-                        for (auto& in : tx.vin) {
-                            bool isPublicSpend = in.IsZerocoinPublicSpend();
-                            if (!in.IsZerocoinSpend() && !isPublicSpend)
-                                continue;
-                            if (isPublicSpend) {
-                                libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
-                                PublicCoinSpend publicSpend(params);
-                                CValidationState state;
-                                if (!ZPIVModule::ParseZerocoinPublicSpend(in, tx, state, publicSpend)){
-                                    return _("Failed to parse public spend");
-                                }
-                                vSpendInfo.push_back(std::make_pair(publicSpend, txid));
-                            } else {
-                                libzerocoin::CoinSpend spend = TxInToZerocoinSpend(in);
-                                vSpendInfo.push_back(std::make_pair(spend, txid));
-                            }
-                        }
-                    }
-
-                    //Record mints
-                    if (tx.HasZerocoinMintOutputs()) {
-                        for (auto& out : tx.vout) {
-                            if (!out.IsZerocoinMint())
-                                continue;
-
-                            CValidationState state;
-                            libzerocoin::PublicCoin coin(Params().Zerocoin_Params(pindex->nHeight < Params().Zerocoin_Block_V2_Start()));
-                            TxOutToPublicCoin(out, coin, state);
-                            vMintInfo.push_back(std::make_pair(coin, txid));
-                        }
-                    }
+    const int nHeightStart = Params().Zerocoin_StartHeight();
+    const int nHeightEnd = chainActive.Height();
+    const int nThreads = std::max(1, (int)boost::thread::hardware_concurrency());
+    for (int nChunkStart = nHeightStart; nChunkStart <= nHeightEnd; nChunkStart += ZEROCOIN_REINDEX_CHUNK) {
+        uiInterface.ShowProgress(_("Reindexing zerocoin database..."), std::max(1, std::min(99, (int)((double)(nChunkStart - nHeightStart) / (double)(nHeightEnd - nHeightStart) * 100))));
+        LogPrintf("Reindexing zerocoin : block %d...\n", nChunkStart);
+
+        // Reading and parsing the blocks dominates, so the chunk is decoded on every core and written in chain order
+        const int nChunkEnd = std::min(nHeightEnd, nChunkStart + ZEROCOIN_REINDEX_CHUNK - 1);
+        std::vector<CZerocoinBlockIndex> vIndexes(nChunkEnd - nChunkStart + 1);
+        std::atomic<int> nNext(0);
+        std::atomic<bool> fFailed(false);
+        boost::thread_group threadGroup;
+        for (int n = 0; n < nThreads; n++) {
+            threadGroup.create_thread([&]() {
+                int i;
+                while (!fFailed && (i = nNext++) < (int)vIndexes.size()) {
+                    const CBlockIndex* pindex = chainActive[nChunkStart + i];
+                    CBlock block;
+                    vIndexes[i].hashBlock = pindex->GetBlockHash();
+                    if (!ReadBlockFromDisk(block, pindex) || !BlockToZerocoinIndex(block, vIndexes[i]))
+                        fFailed = true;
                 }
-            }
+            });
         }
+        threadGroup.join_all();
+        if (fFailed)
+            return _("Reindexing zerocoin failed");
 
-        // Flush the zerocoinDB to disk every 100 blocks
-        if (pindex->nHeight % 100 == 0) {
-            if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
-                return _("Error writing zerocoinDB to disk");
-            vSpendInfo.clear();
-            vMintInfo.clear();
+        std::vector<std::pair<CBigNum, uint256> > vSpendInfo;
+        std::vector<std::pair<CBigNum, uint256> > vMintInfo;
+        std::vector<std::pair<int, CZerocoinBlockIndex> > vBlockIndexes;
+        for (unsigned int i = 0; i < vIndexes.size(); i++) {
+            for (const CZerocoinIndexEntry& spend : vIndexes[i].vSpends)
+                vSpendInfo.emplace_back(spend.bnValue, spend.txid);
+            for (const CZerocoinIndexEntry& mint : vIndexes[i].vMints)
+                vMintInfo.emplace_back(mint.bnValue, mint.txid);
+            if (fZerocoinIndex)
+                vBlockIndexes.emplace_back(nChunkStart + i, vIndexes[i]);
         }
 
-        pindex = chainActive.Next(pindex);
+        if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)) ||
+            (!vBlockIndexes.empty() && !zerocoinDB->WriteZerocoinBlockIndexBatch(vBlockIndexes)))
+            return _("Error writing zerocoinDB to disk");
     }
-    uiInterface.ShowProgress("", 100);
-
-    // Final flush to disk in case any remaining information exists
-    if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
-        return _("Error writing zerocoinDB to disk");
 
     uiInterface.ShowProgress("", 100);
 
@@ -360,6 +560,18 @@ libzerocoin::CoinSpend TxInToZerocoinSpend(const CTxIn& txin)
     return spend;
 }
 
+std::shared_ptr<const libzerocoin::CoinSpend> TxInToZerocoinSpend(const CTransaction& tx, unsigned int nIn)
+{
+    const CZerocoinSpendCache::SpendKey key(tx.GetHash(), nIn);
+    libzerocoin::ZerocoinParams* paramsAccumulator = Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start());
+    std::shared_ptr<const libzerocoin::CoinSpend> spend = zerocoinSpendCache.Get(key, paramsAccumulator);
+    if (!spend) {
+        spend = std::make_shared<const libzerocoin::CoinSpend>(TxInToZerocoinSpend(tx.vin[nIn]));
+        zerocoinSpendCache.Set(key, paramsAccumulator, spend);
+    }
+    return spend;
+}
+
 bool TxOutToPublicCoin(const CTxOut& txout, libzerocoin::PublicCoin& pubCoin, CValidationState& state)
 {
     CBigNum publicZerocoin;
@@ -8,24 +8,74 @@
 #include "libzerocoin/Coin.h"
 #include "libzerocoin/Denominations.h"
 #include "libzerocoin/CoinSpend.h"
+#include "uint256.h"
+#include <atomic>
 #include <list>
+#include <map>
+#include <memory>
 #include <string>
 
+#include <boost/thread/shared_mutex.hpp>
+
 class CBlock;
+class CBlockIndex;
 class CBigNum;
 struct CMintMeta;
 class CTransaction;
 class CTxIn;
 class CTxOut;
 class CValidationState;
+class CZerocoinBlockIndex;
 class CZerocoinMint;
-class uint256;
+
+//! Default for -maxzcspendcachesize
+static const unsigned int DEFAULT_MAX_ZC_SPEND_CACHE_SIZE = 2000;
+
+/**
+ * Spends parsed from zerocoin inputs, keyed by txid and input index. CheckTransaction,
+ * AcceptToMemoryPool, CheckBlock, AcceptBlock and ConnectBlock all read the same input; the
+ * first one deserializes the scriptSig and the rest reuse its object. A txid commits to the
+ * scriptSig, so an entry never goes stale.
+ */
+class CZerocoinSpendCache
+{
+public:
+    typedef std::pair<uint256, unsigned int> SpendKey;
+
+    CZerocoinSpendCache() : nHits(0), nMisses(0) {}
+
+    //! paramsAccumulator has to match the params the entry was parsed with
+    std::shared_ptr<const libzerocoin::CoinSpend> Get(const SpendKey& key, const libzerocoin::ZerocoinParams* paramsAccumulator);
+    void Set(const SpendKey& key, const libzerocoin::ZerocoinParams* paramsAccumulator, std::shared_ptr<const libzerocoin::CoinSpend> spend);
+    void Clear();
+    size_t Size();
+
+    //! Deserializations avoided
+    uint64_t GetHits() const { return nHits; }
+    //! Inputs that had to be deserialized
+    uint64_t GetMisses() const { return nMisses; }
+
+private:
+    struct CacheEntry {
+        const libzerocoin::ZerocoinParams* paramsAccumulator;
+        std::shared_ptr<const libzerocoin::CoinSpend> spend;
+    };
+    std::map<SpendKey, CacheEntry> mapSpends;
+    boost::shared_mutex cs_spendcache;
+    std::atomic<uint64_t> nHits;
+    std::atomic<uint64_t> nMisses;
+};
+
+extern CZerocoinSpendCache zerocoinSpendCache;
 
 bool BlockToMintValueVector(const CBlock& block, const libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues);
 bool BlockToPubcoinList(const CBlock& block, std::list<libzerocoin::PublicCoin>& listPubcoins, bool fFilterInvalid);
+bool BlockToZerocoinIndex(const CBlock& block, CZerocoinBlockIndex& zerocoinIndex);
 bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMints, bool fFilterInvalid);
 void FindMints(std::vector<CMintMeta> vMintsToFind, std::vector<CMintMeta>& vMintsToUpdate, std::vector<CMintMeta>& vMissingMints);
+bool GetZerocoinBlockIndex(const CBlockIndex* pindex, CZerocoinBlockIndex& zerocoinIndex);
 int GetZerocoinStartHeight();
+bool IndexZerocoinBlock(const CBlock& block, const CBlockIndex* pindex);
 bool GetZerocoinMint(const CBigNum& bnPubcoin, uint256& txHash);
 bool IsPubcoinInBlockchain(const uint256& hashPubcoin, uint256& txid);
 bool IsSerialKnown(const CBigNum& bnSerial);
@@ -35,6 +85,8 @@ bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& tx
 bool RemoveSerialFromDB(const CBigNum& bnSerial);
 std::string ReindexZerocoinDB();
 libzerocoin::CoinSpend TxInToZerocoinSpend(const CTxIn& txin);
+/** Spend of tx.vin[nIn], parsed once and shared through zerocoinSpendCache. Throws like TxInToZerocoinSpend. */
+std::shared_ptr<const libzerocoin::CoinSpend> TxInToZerocoinSpend(const CTransaction& tx, unsigned int nIn);
 bool TxOutToPublicCoin(const CTxOut& txout, libzerocoin::PublicCoin& pubCoin, CValidationState& state);
 std::list<libzerocoin::CoinDenomination> ZerocoinSpendListFromBlock(const CBlock& block, bool fFilterInvalid);
 
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The SYNX developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test compact block relay.
+
+- Nodes 0-1-2 are connected in a line and share a mempool of transactions.
+- Node 0 mines them into a block, which crosses the line as a compact block
+  and is rebuilt from the mempool of each node.
+- Report the bytes node 0 sent and how long the block took to reach node 2."""
+import os
+import re
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_greater_than, sync_blocks, sync_mempools
+
+NUM_TXS = 50
+
+def reconstructed_blocks(node):
+    with open(os.path.join(node.datadir, "regtest", "debug.log"), encoding='utf-8') as log:
+        return re.findall(r"Successfully reconstructed block (\w+) with (\d+) txn prefilled, (\d+) txn from mempool and (\d+) txn requested", log.read())
+
+class CompactBlocksTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 3
+
+    def run_test(self):
+        # Stays below the last PoW block of regtest, with mature coinbases to spend
+        self.log.info("Mine 110 blocks")
+        self.nodes[0].generate(110)
+        sync_blocks(self.nodes)
+
+        self.log.info("Relay %d transactions" % NUM_TXS)
+        for i in range(NUM_TXS):
+            self.nodes[0].sendtoaddress(self.nodes[i % 3].getnewaddress(), 1)
+        sync_mempools(self.nodes)
+
+        self.log.info("Mine them and relay the block")
+        sent_before = self.nodes[0].getnettotals()['totalbytessent']
+        start = time.time()
+        blockhash = self.nodes[0].generate(1)[0]
+        sync_blocks(self.nodes, wait=0.05)
+        elapsed = time.time() - start
+        sent = self.nodes[0].getnettotals()['totalbytessent'] - sent_before
+
+        block = self.nodes[0].getblock(blockhash)
+        assert_equal(len(block['tx']), NUM_TXS + 1)
+        self.log.info("Block of %d bytes relayed with %d bytes sent by node 0, reached node 2 in %.3fs" % (block['size'], sent, elapsed))
+        assert_greater_than(block['size'], sent)
+
+        # Both receiving nodes had every transaction
+        for node in self.nodes[1:]:
+            assert_equal(node.getrawmempool(), [])
+            rebuilt = [r for r in reconstructed_blocks(node) if r[0] == blockhash]
+            assert_equal(len(rebuilt), 1)
+            assert_equal(int(rebuilt[0][2]), NUM_TXS)
+            assert_equal(int(rebuilt[0][3]), 0)
+
+if __name__ == '__main__':
+    CompactBlocksTest().main()
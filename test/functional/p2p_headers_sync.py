@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The SYNX developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Test headers-first initial sync from several peers.
+
+- Node 0 mines a chain, nodes 1-3 sync it from node 0.
+- A fresh node 4 connects to all of them and syncs the whole chain. It gets the headers
+  first, then downloads the blocks from more than one peer at a time.
+- Report how long the sync took."""
+import os
+import re
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal, assert_greater_than, connect_nodes_bi, sync_blocks
+
+# Stays below the last PoW block of regtest
+CHAIN_LENGTH = 120
+
+class HeadersSyncTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 5
+
+    def setup_network(self):
+        # Node 4 only joins once the others have the chain
+        self.setup_nodes()
+        for i in range(1, 4):
+            connect_nodes_bi(self.nodes, 0, i)
+
+    def run_test(self):
+        self.log.info("Mine %d blocks and sync them to the serving nodes" % CHAIN_LENGTH)
+        self.nodes[0].generate(CHAIN_LENGTH)
+        sync_blocks(self.nodes[:4])
+
+        self.log.info("Sync a fresh node from 4 peers")
+        start = time.time()
+        for i in range(4):
+            connect_nodes_bi(self.nodes, 4, i)
+        sync_blocks(self.nodes)
+        elapsed = time.time() - start
+        self.log.info("Synced %d blocks in %.2fs" % (CHAIN_LENGTH, elapsed))
+
+        info = self.nodes[4].getblockchaininfo()
+        assert_equal(info['blocks'], CHAIN_LENGTH)
+        assert_equal(info['headers'], CHAIN_LENGTH)
+
+        # Blocks were asked from several peers rather than all from the one that sent the headers
+        with open(os.path.join(self.nodes[4].datadir, "regtest", "debug.log"), encoding='utf-8') as log:
+            peers = set(re.findall(r"Requesting block \w+ \(\d+\) peer=(\d+)", log.read()))
+        self.log.info("Blocks downloaded from %d peers" % len(peers))
+        assert_greater_than(len(peers), 1)
+
+if __name__ == '__main__':
+    HeadersSyncTest().main()
@@ -102,6 +102,8 @@ BASE_SCRIPTS= [
     #'rpc_users.py',
     'rpc_signrawtransaction.py',
     'p2p_disconnect_ban.py',
+    'p2p_headers_sync.py',
+    'p2p_compactblocks.py',
     'rpc_decodescript.py',
     'rpc_blockchain.py',
     #'rpc_deprecated.py',
@@ -135,6 +137,7 @@ EXTENDED_SCRIPTS = [
     # Longest test should go first, to favor running tests in parallel
     # vv Tests less than 20m vv
     #'feature_fee_estimation.py',
+    'wallet_searchdzpiv.py',
     # vv Tests less than 5m vv
     # vv Tests less than 2m vv
     #'p2p_timeouts.py',
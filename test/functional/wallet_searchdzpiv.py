@@ -0,0 +1,48 @@
+#!/usr/bin/env python3
+# Copyright (c) 2019 The SYNX developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+"""Benchmark searchdzpiv on a 10k mint range.
+
+- Derive 10000 deterministic mints on one thread, then the next 10000 on one thread per core.
+- Restart the node and search the first range again: the mint pool written to the wallet
+  covers it, so nothing has to be derived a second time."""
+import time
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import assert_equal
+
+MINT_RANGE = 10000
+
+class SearchDzpivBenchmarkTest(BitcoinTestFramework):
+    def set_test_params(self):
+        self.setup_clean_chain = True
+        self.num_nodes = 1
+
+    def setup_nodes(self):
+        # deriving the single threaded range takes far longer than the default rpc timeout
+        self.add_nodes(self.num_nodes, timewait=3600)
+        self.start_nodes()
+
+    def search(self, count, threads):
+        start = time.time()
+        assert_equal(self.nodes[0].searchdzpiv(count, MINT_RANGE, threads), "done")
+        return time.time() - start
+
+    def run_test(self):
+        self.log.info("Derive %d mints on one thread" % MINT_RANGE)
+        sequential = self.search(1, 1)
+        self.log.info("Single thread: %.2fs (%.2fms per mint)" % (sequential, 1000 * sequential / MINT_RANGE))
+
+        self.log.info("Derive %d mints on every core" % MINT_RANGE)
+        parallel = self.search(1 + MINT_RANGE, 0)
+        self.log.info("All cores: %.2fs (%.2fms per mint)" % (parallel, 1000 * parallel / MINT_RANGE))
+
+        self.log.info("Search the first range again after a restart")
+        self.restart_node(0)
+        cached = self.search(1, 0)
+        self.log.info("From the stored mint pool: %.2fs" % cached)
+        assert cached < parallel
+
+if __name__ == '__main__':
+    SearchDzpivBenchmarkTest().main()